@@ -340,6 +340,41 @@ typedef struct {
     IO32 PIN_CNF[32];
 } GPIO_T;
 
+typedef struct {
+    IO32 EEP;
+    IO32 TEP;
+} PPI_CH_T;
+
+typedef struct {
+    IO32 TASKS_CHG[12];
+    IO32 RESERVED[308];
+    IO32 CHEN;
+    IO32 CHENSET;
+    IO32 CHENCLR;
+    IO32 RESERVED1;
+    PPI_CH_T CH[20];
+} PPI_T;
+
+typedef struct {
+    IO32 RESERVED[256];
+    IO32 READY;
+    IO32 RESERVED1;
+    IO32 READYNEXT;
+    IO32 RESERVED2[62];
+    IO32 CONFIG;
+    IO32 ERASEPAGE;
+    IO32 ERASEALL;
+    IO32 ERASEPCR0;
+    IO32 ERASEUICR;
+    IO32 ERASEPAGEPARTIAL;
+    IO32 ERASEPAGEPARTIALCFG;
+    IO32 RESERVED3[8];
+    IO32 ICACHECNF;
+    IO32 RESERVED4;
+    IO32 IHIT;
+    IO32 IMISS;
+} NVMC_T;
+
 typedef struct {
     IO32 ISER[8];
     IO32 RESERVED0[24];
@@ -356,6 +391,24 @@ typedef struct {
     IO32 STIR;
 } NVIC_T;
 
+typedef struct {
+    IO32 DHCSR;
+    IO32 DCRSR;
+    IO32 DCRDR;
+    IO32 DEMCR;
+} COREDEBUG_T;
+
+typedef struct {
+    IO32 CTRL;
+    IO32 CYCCNT;
+    IO32 CPICNT;
+    IO32 EXCCNT;
+    IO32 SLEEPCNT;
+    IO32 LSUCNT;
+    IO32 FOLDCNT;
+    IO32 PCSR;
+} DWT_T;
+
 /* --- BITFIELDS --------------------------------------------------------------------- */
 /* ----------------------------------------------------------------------------------- */
 
@@ -391,13 +444,26 @@ typedef struct {
 
 /* --- CLOCK --------------------------------------------------------------- */
 
+#define CLOCK_INTEN_HFCLKSTARTED_                           (1 << 0)
+
+/* --- POWER -------------------------------------------------------------- */
+
+#define POWER_INTEN_USBDETECTED_                            (1 << 7)
+#define POWER_INTEN_USBREMOVED_                             (1 << 8)
+#define POWER_INTEN_USBPWRRDY_                              (1 << 9)
+
+#define POWER_USBREGSTATUS_VBUSDETECT_                      (1 << 0)
+#define POWER_USBREGSTATUS_OUTPUTRDY_                       (1 << 1)
+
 /* --- RADIO --------------------------------------------------------------- */
 
 #define RADIO_SHORTS_READY_START_                           (1 << 0)
 #define RADIO_SHORTS_END_DISABLE_                           (1 << 1)
 #define RADIO_SHORTS_DISABLED_TXEN_                         (1 << 2)
 #define RADIO_SHORTS_DISABLED_RXEN_                         (1 << 3)
+#define RADIO_SHORTS_ADDRESS_RSSISTART_                     (1 << 4)
 #define RADIO_SHORTS_END_START_                             (1 << 5)
+#define RADIO_SHORTS_DISABLED_RSSISTOP_                     (1 << 8)
 #define RADIO_SHORTS_RXREADY_START_                         (1 << 19)
 
 #define RADIO_INTENSET_END_Set                              (1 << 3)
@@ -431,7 +497,9 @@ typedef struct {
 #define TIMER_SHORTS_COMPARE0_STOP_Enabled                  (1 << 8)
 
 #define TIMER_INTENSET_COMPARE0_Set                         (1 << 16)
+#define TIMER_INTENSET_COMPARE2_Set                         (1 << 18)
 #define TIMER_INTENCLR_COMPARE0_Clr                         (1 << 16)
+#define TIMER_INTENCLR_COMPARE2_Clr                         (1 << 18)
 
 #define TIMER_MODE_MODE_Timer                               (0 << 0)
 #define TIMER_MODE_MODE_Counter                             (1 << 0)
@@ -443,8 +511,20 @@ typedef struct {
 
 /* --- USBD ---------------------------------------------------------------- */
 
+#define USBD_EVENTCAUSE_SUSPEND_                            (1 << 8)
+#define USBD_EVENTCAUSE_RESUME_                             (1 << 9)
+#define USBD_EVENTCAUSE_USBWUALLOWED_                       (1 << 10)
 #define USBD_EVENTCAUSE_READY_                              (1 << 11)
 
+#define USBD_DPDMVALUE_STATE_Resume                         (1 << 0)
+#define USBD_DPDMVALUE_STATE_J                              (1 << 1)
+#define USBD_DPDMVALUE_STATE_K                              (1 << 2)
+
+#define USBD_LOWPOWER_LOWPOWER_ForceNormal                  (0 << 0)
+#define USBD_LOWPOWER_LOWPOWER_LowPower                     (1 << 0)
+
+#define USBD_FRAMECNTR_FRAMECNTR_Msk                        (0x7FF)
+
 #define USBD_INTEN_USBRESET_                                (1 << 0)
 #define USBD_INTEN_ENDEPIN0_                                (1 << 2)
 #define USBD_INTEN_EP0DATADONE_                             (1 << 10)
@@ -492,6 +572,16 @@ typedef struct {
 #define GPIO_PIN_CNF_SENSE_High                             (0b10 << GPIO_PIN_CNF_SENSE_Shft)
 #define GPIO_PIN_CNF_SENSE_Low                              (0b11 << GPIO_PIN_CNF_SENSE_Shft)
 
+/* --- NVMC --------------------------------------------------------------- */
+
+#define NVMC_ICACHECNF_CACHEEN_Enabled                      (1 << 0)
+#define NVMC_ICACHECNF_CACHEPROFEN_Enabled                  (1 << 8)
+
+/* --- DWT / COREDEBUG ----------------------------------------------------- */
+
+#define COREDEBUG_DEMCR_TRCENA                              (1 << 24)
+#define DWT_CTRL_CYCCNTENA                                  (1 << 0)
+
 /* --- NVIC IRQ Numbers -------------------------------------------------------------- */
 /* ----------------------------------------------------------------------------------- */
 
@@ -539,6 +629,10 @@ typedef struct {
 #define NVIC_PWM3_IRQ                               45
 #define NVIC_SPIM3_IRQ                              47
 
+/* nRF52 implements the top 3 bits of each IPR byte, 0 = highest */
+#define NVIC_PRIO_BITS                              3
+#define NVIC_PRIO(prio)                             ((prio) << (8 - NVIC_PRIO_BITS))
+
 /* --- POINTERS ---------------------------------------------------------------------- */
 /* ----------------------------------------------------------------------------------- */
 
@@ -550,9 +644,51 @@ typedef struct {
 #define TIMER0      ((TIMER_T *)  0x40008000)
 #define TIMER1      ((TIMER_T *)  0x40009000)
 #define TIMER2      ((TIMER_T *)  0x4000A000)
+#define TIMER3      ((TIMER_T *)  0x4001A000)
+#define TIMER4      ((TIMER_T *)  0x4001B000)
 #define COMP        ((COMP_T  *)  0x40013000)
+#define NVMC        ((NVMC_T  *)  0x4001E000)
+#define PPI         ((PPI_T   *)  0x4001F000)
 #define USBD        ((USBD_T  *)  0x40027000)
 #define P0          ((GPIO_T  *)  0x50000000)
 #define NVIC        ((NVIC_T  *)  0xE000E100)
+#define COREDEBUG   ((COREDEBUG_T *) 0xE000EDF0)
+#define DWT         ((DWT_T   *)  0xE0001000)
+
+/* --- CORE -------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+#ifndef HOST_SIM
+#define HOST_SIM 0
+#endif
+
+#if HOST_SIM
+
+/* `make sim`: PRIMASK and the sleep belong to the simulated core (fw/sim) */
+uint32_t sim_irq_save(void);
+void     sim_irq_restore(uint32_t primask);
+void     sim_wfi(void);
+
+static inline uint32_t irq_save(void)                { return sim_irq_save(); }
+static inline void     irq_restore(uint32_t primask) { sim_irq_restore(primask); }
+static inline void     wfi(void)                     { sim_wfi(); }
+
+#else
+
+static inline uint32_t irq_save(void) {
+    uint32_t primask;
+    __asm__ volatile ("mrs %0, primask\n cpsid i" : "=r" (primask) :: "memory");
+    return primask;
+}
+
+static inline void irq_restore(uint32_t primask) {
+    __asm__ volatile ("msr primask, %0" :: "r" (primask) : "memory");
+}
+
+static inline void wfi(void) {
+    __asm__ volatile ("wfi" ::: "memory");
+}
+
+#endif
 
 #endif
\ No newline at end of file
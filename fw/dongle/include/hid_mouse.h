@@ -0,0 +1,131 @@
+/***********************************************************************************
+ ** file            : hid_mouse.h
+ ** description     : the HID mouse interface, the dongle's and the mouse's own
+ **                   on the cable (mouse wired.c), see hid_mouse.c note 1
+ **
+ **********************************************************************************/
+
+#ifndef HID_MOUSE_H
+#define HID_MOUSE_H
+
+#include <stdint.h>
+#include "usb.h"
+#include "hid.h"
+
+/* PS1.11 p.860 claims interrupt/bulk transactions
+ * must be multiples of 4 bytes and 32-bit aligned
+ */
+struct hid_mouse_report {
+    uint8_t buttons;
+    int16_t x;
+    int16_t y;
+    int16_t wheel;
+    uint8_t padding;
+} __attribute__((packed, aligned(4)));
+
+/* byte 0:
+ *   REPORT_COUNT (2), REPORT_SIZE(1)  = button 1,2  = 2 bits
+ *   REPORT_COUNT (1), REPORT_SIZE(6)  = padding     = 6 bits
+ * bytes 1-6:
+ *   REPORT_COUNT (3), REPORT_SIZE(16) = X, Y, Wheel = 3 * 2 bytes
+ * bytes 7:
+ *   REPORT_COUNT (1), REPORT_SIZE(8)  = padding     = 8 bits
+ *
+ * `...` are items of the application collection after the pointer,
+ * the dongle's battery feature. nothing there for the input report
+ */
+#define HID_MOUSE_REPORT_DESCRIPTOR(...) {                                  \
+    0x05, 0x01,         /* USAGE_PAGE (Generic Desktop)         */          \
+    0x09, 0x02,         /* USAGE (Mouse)                        */          \
+    0xa1, 0x01,         /* COLLECTION (Application)             */          \
+    0x09, 0x01,         /*   USAGE (Pointer)                    */          \
+    0xa1, 0x00,         /*   COLLECTION (Physical)              */          \
+    0x05, 0x09,         /*     USAGE_PAGE (Button)              */          \
+    0x19, 0x01,         /*     USAGE_MINIMUM (Button 1)         */          \
+    0x29, 0x02,         /*     USAGE_MAXIMUM (Button 2)         */          \
+    0x15, 0x00,         /*     LOGICAL_MINIMUM (0)              */          \
+    0x25, 0x01,         /*     LOGICAL_MAXIMUM (1)              */          \
+    0x95, 0x02,         /*     REPORT_COUNT (2)                 */          \
+    0x75, 0x01,         /*     REPORT_SIZE (1)                  */          \
+    0x81, 0x02,         /*     INPUT (Data,Var,Abs)             */          \
+    0x95, 0x01,         /*     REPORT_COUNT (1)                 */          \
+    0x75, 0x06,         /*     REPORT_SIZE (6)                  */          \
+    0x81, 0x01,         /*     INPUT (Cnst,Ary,Abs)             */          \
+    0x05, 0x01,         /*     USAGE_PAGE (Generic Desktop)     */          \
+    0x09, 0x30,         /*     USAGE (X)                        */          \
+    0x09, 0x31,         /*     USAGE (Y)                        */          \
+    0x09, 0x38,         /*     USAGE (Wheel)                    */          \
+    0x16, 0x01, 0x80,   /*     LOGICAL_MINIMUM (-32767)         */          \
+    0x26, 0xff, 0x7f,   /*     LOGICAL_MAXIMUM (32767)          */          \
+    0x95, 0x03,         /*     REPORT_COUNT (3)                 */          \
+    0x75, 0x10,         /*     REPORT_SIZE (16)                 */          \
+    0x81, 0x06,         /*     INPUT (Data,Var,Rel)             */          \
+    0x95, 0x01,         /*     REPORT_COUNT (1)                 */          \
+    0x75, 0x08,         /*     REPORT_SIZE (8)                  */          \
+    0x81, 0x01,         /*     INPUT (Cnst,Ary,Abs)             */          \
+    0xc0,               /*   END_COLLECTION                     */          \
+    __VA_OPT__(__VA_ARGS__,)                                                \
+    0xc0                /* END_COLLECTION                       */          \
+}
+
+/* the same but for the PID: the host keeps the two apart (note 1) */
+#define HID_MOUSE_DEVICE_DESCRIPTOR(pid) {                                  \
+    .bLength            = USB_DT_DEVICE_SIZE,                               \
+    .bDescriptorType    = USB_DT_DEVICE,                                    \
+    .bcdUSB             = 0x0200,                                           \
+    .bDeviceClass       = 0,                                                \
+    .bDeviceSubClass    = 0,                                                \
+    .bDeviceProtocol    = 0,                                                \
+    .bMaxPacketSize0    = 64,                                               \
+    .idVendor           = 0x1915,                                           \
+    .idProduct          = (pid),                                            \
+    .bcdDevice          = 0x0200,                                           \
+    .iManufacturer      = 1,                                                \
+    .iProduct           = 2,                                                \
+    .iSerialNumber      = 3,                                                \
+    .bNumConfigurations = 1,                                                \
+}
+
+/* interface 0 of a config block with `if0`, `if0_hid` and `if0_hid_ep` */
+#define HID_MOUSE_IF0(report_descriptor)                                    \
+    .if0 = {                                                                \
+        .bLength                = USB_DT_INTERFACE_SIZE,                    \
+        .bDescriptorType        = USB_DT_INTERFACE,                         \
+        .bInterfaceNumber       = 0,                                        \
+        .bAlternateSetting      = 0,                                        \
+        .bNumEndpoints          = 1,                                        \
+        .bInterfaceClass        = USB_CLASS_HID,                            \
+        .bInterfaceSubClass     = USB_HID_SUBCLASS_NO,                      \
+        .bInterfaceProtocol     = USB_HID_INTERFACE_PROTOCOL_NONE,          \
+        .iInterface             = 0,                                        \
+    },                                                                      \
+    .if0_hid = {                                                            \
+        .bLength                 = sizeof(struct usb_hid_descriptor),       \
+        .bDescriptorType         = USB_HID_DT_HID,                          \
+        .bcdHID                  = 0x0111,                                  \
+        .bCountryCode            = 0,                                       \
+        .bNumDescriptors         = 1,                                       \
+        .bReportDescriptorType   = USB_HID_DT_REPORT,                       \
+        .wReportDescriptorLength = sizeof(report_descriptor),               \
+    },                                                                      \
+    .if0_hid_ep = {                                                         \
+        .bLength                = USB_DT_ENDPOINT_SIZE,                     \
+        .bDescriptorType        = USB_DT_ENDPOINT,                          \
+        .bEndpointAddress       = 0x81,                                     \
+        .bmAttributes           = USB_EP_ATTR_INTERRUPT,                    \
+        .wMaxPacketSize         = sizeof(struct hid_mouse_report),          \
+        .bInterval              = 0x01,                                     \
+    }
+
+#define HID_MOUSE_STRINGS 4
+
+extern const struct usb_string_descriptor * const hid_mouse_strings[HID_MOUSE_STRINGS];
+
+enum usb_req_result hid_mouse_get_report_descriptor(struct usb_setup_data *req,
+                                                    const uint8_t *desc, uint16_t size,
+                                                    uint8_t **buf, uint16_t *len);
+uint8_t hid_mouse_write_report(usb_device *dev, struct hid_mouse_report *report,
+                               uint8_t buttons, volatile int32_t *x,
+                               volatile int32_t *y, volatile int32_t *wheel);
+
+#endif
@@ -0,0 +1,85 @@
+/***********************************************************************************
+ ** file            : isr_prof.h
+ ** description     : DWT->CYCCNT isr profiler, `make PROF=1` to build it in
+ **
+ **                   put ISR_PROF_SCOPE(id) first thing in an isr, it stops
+ **                   the clock on every return path (cleanup attribute)
+ **
+ **********************************************************************************/
+
+#ifndef ISR_PROF_H
+#define ISR_PROF_H
+
+#include <stdint.h>
+
+#ifndef ISR_PROF
+#define ISR_PROF 0
+#endif
+
+#define ISR_PROF_CPU_HZ     64000000
+#define ISR_PROF_BINS       16          /* log2 cycles, bin 0 = [0, 2)      */
+#define ISR_PROF_DEPTH      8           /* max isr nesting tracked          */
+#define ISR_PROF_MAGIC      0x50525349  /* 'ISRP'                           */
+
+enum isr_prof_id {
+    ISR_PROF_RADIO,
+    ISR_PROF_USBD,
+    ISR_PROF_TIMER0,
+    ISR_PROF_TIMER1,
+    ISR_PROF_TIMER2,
+    ISR_PROF_SWI0,
+    ISR_PROF_POWER,
+    ISR_PROF_COUNT
+};
+
+#define ISR_PROF_NAMES { "radio", "usbd", "timer0", "timer1", "timer2", "swi0", "power" }
+
+struct isr_prof_entry {
+    char     name[8];
+    uint32_t count;
+    uint32_t min;               /* self cycles, nested isrs excluded        */
+    uint32_t max;
+    uint32_t sum;               /* sum / sum_n = mean, both halved          */
+    uint32_t sum_n;             /* before sum would overflow                */
+    uint32_t preempted;         /* times another isr ran inside this one    */
+    uint32_t preempt_cycles;
+    uint32_t lat_n;             /* entry latency, only for isrs whose event */
+    uint32_t lat_sum;           /* has a hw timestamp (ISR_PROF_LATENCY)    */
+    uint32_t lat_max;
+    uint16_t hist[ISR_PROF_BINS];
+};
+
+/* the whole table is one symbol, so a debugger can dump it as is
+ * (prof.exp, tools/isr-prof.c)
+ */
+struct isr_prof {
+    uint32_t magic;
+    uint16_t count;
+    uint16_t entry_size;
+    uint32_t cpu_hz;
+    struct isr_prof_entry isr[ISR_PROF_COUNT];
+};
+
+#if ISR_PROF
+
+extern struct isr_prof isr_prof;
+
+void    isr_prof_init(void);
+uint8_t isr_prof_enter(uint8_t id);
+void    isr_prof_exit(uint8_t *id);
+void    isr_prof_latency(uint8_t id, uint32_t cycles);
+
+#define ISR_PROF_INIT()                 isr_prof_init()
+#define ISR_PROF_SCOPE(id)              uint8_t isr_prof_id_ __attribute__((cleanup(isr_prof_exit))) \
+                                            = isr_prof_enter(ISR_PROF_##id)
+#define ISR_PROF_LATENCY(id, cycles)    isr_prof_latency(ISR_PROF_##id, (cycles))
+
+#else
+
+#define ISR_PROF_INIT()
+#define ISR_PROF_SCOPE(id)
+#define ISR_PROF_LATENCY(id, cycles)
+
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+/***********************************************************************************
+ ** file            : link_stats.h
+ ** description     : rolling-window radio link and motion latency statistics,
+ **                   fed from radio_isr/send_hid_report, advanced from the
+ **                   telemetry timer, read over ep0
+ **
+ **********************************************************************************/
+
+#ifndef LINK_STATS_H
+#define LINK_STATS_H
+
+#include <stdint.h>
+
+#define LINK_STATS_BUCKETS          10      /* window = BUCKETS x tick period       */
+#define LINK_STATS_HIST_BINS        16
+
+#define LINK_STATS_RSSI_MIN         30      /* -dBm, bin 0 lower edge               */
+#define LINK_STATS_RSSI_BIN         5       /* dB per bin                           */
+#define LINK_STATS_TURN_MIN_US      40      /* bin 0 lower edge                     */
+#define LINK_STATS_TURN_BIN_US      8       /* us per bin                           */
+
+/* motion latency stages, see note 2 in link_stats.c */
+enum link_stats_stage {
+    LINK_STAGE_SENSOR,      /* burst completion -> mouse TX start                   */
+    LINK_STAGE_AIR,         /* TX start -> dongle radio_isr                         */
+    LINK_STAGE_QUEUE,       /* radio_isr -> ep1 armed                               */
+    LINK_STAGE_POLL,        /* ep1 armed -> host IN                                 */
+    LINK_STAGE_TOTAL,
+    LINK_STAGES
+};
+
+/* percentiles are the upper edge of the bin they fall in, 0 = no samples */
+struct link_stats_pct {
+    uint16_t p50;
+    uint16_t p90;
+    uint16_t p99;
+    uint16_t max;
+} __attribute__((packed));
+
+/* vendor request 0xC0/0x03 payload, see note 1 in link_stats.c */
+struct link_stats_report {
+    uint16_t window_ms;
+    uint16_t rx_ok;         /* mouse packets with good CRC                          */
+    uint16_t rx_crc_err;    /* mouse packets with bad CRC                           */
+    uint16_t missed;        /* slots with nothing received, from seq gaps           */
+    uint16_t resync;        /* seq gaps too long to count (mouse slept, lost link)  */
+    uint16_t turnarounds;   /* samples in turnaround_hist                           */
+    struct link_stats_pct rssi;         /* -dBm                                     */
+    struct link_stats_pct turnaround;   /* rx END -> reply ADDRESS, us              */
+    uint16_t rssi_hist[LINK_STATS_HIST_BINS];
+    uint16_t turnaround_hist[LINK_STATS_HIST_BINS];
+} __attribute__((packed, aligned(4)));
+
+/* vendor request 0xC0/0x04 payload, log2 bins: bin i = [2^i, 2^(i+1)) us, bin 0 = [0, 2) */
+struct link_stats_latency_report {
+    uint16_t window_ms;
+    uint16_t samples;       /* reports that carried a fresh packet                  */
+    struct link_stats_pct stage[LINK_STAGES];
+    uint16_t hist[LINK_STAGES][LINK_STATS_HIST_BINS];
+} __attribute__((packed, aligned(4)));
+
+void link_stats_rx(uint8_t crc_ok, uint8_t seq, uint8_t rssi);
+void link_stats_turnaround(uint32_t us);
+void link_stats_latency(const uint32_t stage_us[LINK_STAGES - 1]);
+void link_stats_tick(uint32_t period_ms);
+void link_stats_reset(void);
+const struct link_stats_report *link_stats_read(void);
+const struct link_stats_latency_report *link_stats_read_latency(void);
+
+#endif
@@ -0,0 +1,81 @@
+/***********************************************************************************
+ ** file            : trace.h
+ ** description     : deferred binary trace, built in with DBG >= 1
+ **
+ **                   TRACE(id, a0, a1, a2) stores a timestamped record in a ring,
+ **                   trace_drain() ships the ring to RTT from thread mode.
+ **                   decode with tools/trace-decode.c or trace-timeline.c
+ **
+ **********************************************************************************/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include "trace_events.h"
+
+#ifndef DBG
+#define DBG 0
+#endif
+
+#define TRACE_RECORDS       128         /* power of 2, 16 bytes each        */
+#define TRACE_RTT           1           /* drained to RTT, drops when full  */
+#define TRACE_MAGIC         0x45435254  /* 'TRCE'                           */
+
+/* CYCCNT stops in the suspend wfi, TIMER4 at 1MHz is ours alone and never cleared */
+#define TRACE_CLOCK_INIT()  do { TIMER4->MODE        = TIMER_MODE_MODE_Timer;       \
+                                 TIMER4->BITMODE     = TIMER_BITMODE_BITMODE_32Bit; \
+                                 TIMER4->PRESCALER   = 4;                           \
+                                 TIMER4->TASKS_START = 1; } while (0)
+#define TRACE_NOW()         (TIMER4->TASKS_CAPTURE[0] = 1, TIMER4->CC[0])
+
+#define TRACE_EVENT_ID(id, ph, track, fmt)  id,
+
+enum trace_event {
+    TRACE_EVENTS(TRACE_EVENT_ID)
+    TRACE_EVENT_COUNT
+};
+
+/* one record, a0 shares the first word with the id */
+struct trace_record {
+    uint32_t ts;                /* TRACE_NOW()                              */
+    uint32_t id_a0;             /* id | a0 << 8                             */
+    uint32_t a1;
+    uint32_t a2;
+};
+
+/* one symbol, so a debugger can dump it as is (tools/trace-timeline.c) */
+struct trace {
+    uint32_t magic;
+    uint16_t records;
+    uint16_t record_size;
+    uint32_t tick_hz;
+    uint32_t head;              /* records written since trace_init()       */
+    uint32_t tail;              /* records drained, TRACE_RTT only          */
+    uint32_t dropped;           /* records lost to a full ring, ditto       */
+    struct trace_record rec[TRACE_RECORDS];
+};
+
+#if DBG >= 1
+
+void trace_init(void);
+void trace_write(uint32_t id_a0, uint32_t a1, uint32_t a2);
+void trace_drain(void);
+uint8_t trace_pending(void);
+
+#define TRACE_(id, a0, a1, a2, ...) trace_write((id) | ((uint32_t) (a0) << 8), (a1), (a2))
+#define TRACE(...)                  TRACE_(__VA_ARGS__, 0, 0, 0)
+#define TRACE_INIT()                trace_init()
+#define TRACE_DRAIN()               trace_drain()
+#define TRACE_PENDING()             trace_pending()
+
+#else
+
+#define TRACE(...)
+#define TRACE_INIT()
+#define TRACE_DRAIN()
+#define TRACE_PENDING()             0
+
+#endif
+
+#endif
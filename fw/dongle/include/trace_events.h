@@ -0,0 +1,51 @@
+/***********************************************************************************
+ ** file            : trace_events.h
+ ** description     : dongle trace events: id, timeline phase, track, format
+ **
+ **                   the firmware only sees the ids, the rest is compiled into
+ **                   the host tools (tools/trace-decode.c, trace-timeline.c).
+ **                   phase is 'i' (instant), 'B'/'E' (begin/end of a slice on
+ **                   the track). formats take up to three unsigned args (a0
+ **                   is 24-bit), add new events at the end so old captures
+ **                   still decode
+ **
+ **********************************************************************************/
+
+#ifndef TRACE_EVENTS_H
+#define TRACE_EVENTS_H
+
+#define TRACE_TICK_HZ   1000000         /* TIMER4                       */
+
+#define TRACE_EVENTS(X)                                                                     \
+    X(TR_DROPPED,           'i', "trace", "-- %u events dropped, ring full --")            \
+    X(TR_USB_RESET,         'i', "usb",   "RESET")                                          \
+    X(TR_USB_ENDEP,         'i', "usb",   "ENDEP")                                          \
+    X(TR_USB_EP0DATADONE,   'i', "usb",   "EP0DATADONE")                                    \
+    X(TR_USB_EP0_STAGE,     'i', "usb",   "stage: %u")                                      \
+    X(TR_USB_EPDATA,        'i', "usb",   "EPDATA")                                         \
+    X(TR_USB_EP0SETUP,      'i', "usb",   "EP0SETUP")                                       \
+    X(TR_USB_EP0STALL,      'i', "ep0",   "TASKS_EP0STALL = 1")                             \
+    X(TR_USB_EP0STATUS,     'i', "ep0",   "TASKS_EP0STATUS = 1")                            \
+    X(TR_EP0_REQ,           'i', "ep0",   "bmRequestType: x%02X  bRequest: %03u  wValue: x%04X") \
+    X(TR_EP0_REQ_LEN,       'i', "ep0",   "  wIndex: x%04X  wLength: x%04X")                \
+    X(TR_EP0_DATA_IN,       'i', "ep0",   "    DATA_IN")                                    \
+    X(TR_EP0_LAST_DATA_IN,  'i', "ep0",   "    LAST_DATA_IN")                               \
+    X(TR_EP0_STATUS_IN,     'i', "ep0",   "    STATUS_IN")                                  \
+    X(TR_EP0_STATUS_OUT,    'i', "ep0",   "    STATUS_OUT")                                 \
+    X(TR_SET_DPI,           'i', "ep0",   "set dpi: %u")                                    \
+    X(TR_SET_INTERVAL,      'i', "ep0",   "set report interval: %ums")                      \
+    X(TR_SET_PROFILE,       'i', "ep0",   "set profile: %u")                                \
+    X(TR_HID_IN,            'i', "ep1",   "IN at %u us")                                    \
+    X(TR_RADIO_RX,          'i', "radio", "rx seq %u  crc %u  rssi -%u")                    \
+    X(TR_RADIO_REPLY,       'B', "radio", "reply cc %u")                                    \
+    X(TR_RADIO_REPLY_END,   'E', "radio", "turnaround %u us")                               \
+    X(TR_HID_ARM,           'i', "ep1",   "arm, leftover %u")                               \
+    X(TR_ISR_ENTER,         'B', "isr",   "isr %u")                                         \
+    X(TR_ISR_EXIT,          'E', "isr",   "isr %u")                                         \
+    X(TR_MOUSE_ENERGY,      'i', "radio", "mouse energy record, %u mC since boot")          \
+    X(TR_USB_SUSPEND,       'i', "usb",   "SUSPEND")                                        \
+    X(TR_USB_RESUME,        'i', "usb",   "RESUME")                                         \
+    X(TR_USB_WAKEUP,        'i', "usb",   "remote wakeup")                                  \
+    X(TR_HID_WAKE,          'i', "ep1",   "first report %u us after the wake")
+
+#endif
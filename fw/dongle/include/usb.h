@@ -68,6 +68,12 @@ struct usb_setup_data {
 #define USB_DT_OTHER_SPEED_CONFIGURATION        7
 #define USB_DT_INTERFACE_POWER                  8
 
+/* table 9-6: standard feature selectors */
+
+#define USB_FEAT_ENDPOINT_HALT                  0
+#define USB_FEAT_DEVICE_REMOTE_WAKEUP           1
+#define USB_FEAT_TEST_MODE                      2
+
 /* ----------------------------------------------------------------------------------- */
 /* --- USB_20 -- 9.5/9.6: STANDARD USB DESCRIPTOR DEFINITIONS ------------------------ */
 /* ----------------------------------------------------------------------------------- */
@@ -119,6 +125,8 @@ struct usb_configuration_descriptor {
 
 #define USB_STATUS_SELF_POWERED                 0x0
 #define USB_STATUS_BUS_POWERED                  0x1
+/* [1] remote wakeup, enabled by the host with SET_FEATURE */
+#define USB_STATUS_REMOTE_WAKEUP                0x2
 
 /* table 9-12: standard interface descriptor */
 struct usb_interface_descriptor {
@@ -135,6 +143,9 @@ struct usb_interface_descriptor {
 
 #define USB_DT_INTERFACE_SIZE sizeof(struct usb_interface_descriptor)
 
+/* usb.org defined class codes: interface bInterfaceClass */
+#define USB_CLASS_VENDOR_SPECIFIC               0xFF
+
 /* table 9-13: standard endpoint descriptor */
 struct usb_endpoint_descriptor {
     uint8_t  bLength;
@@ -204,7 +215,7 @@ enum usb_xfer_stage {
 };
 
 #define MAX_ENDPOINTS               8
-#define MAX_USER_EP0_REQ_HANDLER    4
+#define MAX_USER_EP0_REQ_HANDLER    12
 #define MAX_CIB_PACKET_SIZE         64
 
 typedef void (*usb_ep0_req_complete_callback)(usb_device *usb_dev,
@@ -222,14 +233,23 @@ typedef void (*usb_set_config_callback)(usb_device *usb_dev,
 typedef void (*usb_endpoint_callback)(usb_device *usb_dev, 
                                       uint8_t ep);
 
+typedef void (*usb_suspend_callback)(usb_device *usb_dev,
+                                     uint8_t suspended);
+
+struct usb_dma_stats {
+    uint32_t queued;        /* xfers that had to wait for the dma             */
+    uint32_t dropped;       /* xfers refused, their ep already had one queued */
+};
+
 typedef struct usb_device {
 
     const struct usb_device_descriptor *dev_desc;
     const struct usb_configuration_descriptor *config;
     const struct usb_string_descriptor * const *str_descs;
     uint8_t  num_str_descs;
-    uint16_t status;        /* bus-powered OR self-powered */
+    uint16_t status;        /* bus-powered OR self-powered, remote wakeup */
     uint8_t  configured;    /* 0 = address/default state, 1 = configured state */
+    uint8_t  suspended;     /* bus suspended, the USBD in LOWPOWER (usb.c note 3) */
 
     /* ep0 state machine */
     struct usb_ep0_state {
@@ -249,6 +269,9 @@ typedef struct usb_device {
 
     usb_endpoint_callback user_ctr_callback[MAX_ENDPOINTS][3];
     usb_set_config_callback user_set_config_callback;
+    usb_suspend_callback user_suspend_callback;
+
+    struct usb_dma_stats dma_stats;
 
 } usb_device;
 
@@ -292,6 +315,9 @@ extern int usb_register_ep0_req_handler(usb_device *dev, uint8_t type,
                                         uint8_t type_mask, usb_ep0_req_handler callback);
 extern void usb_register_set_config_callback(usb_device *dev, 
                                              usb_set_config_callback callback);
+extern void usb_register_suspend_callback(usb_device *dev,
+                                          usb_suspend_callback callback);
+int usb_remote_wakeup(usb_device *dev);
 
 /* ----------------------------------------------------------------------------------- */
 /* --- FOR USB_EP0.c ---------------------------------------------------------------- */
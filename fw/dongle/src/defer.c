@@ -0,0 +1,90 @@
+/********************************************************************
+ ** file         : defer.c
+ ** description  : deferred work queue on a software interrupt
+ **
+ **                built into both firmwares, the vector
+ **                and depth live in each firmware's defer.h
+ **
+ ********************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "device.h"
+#include "isr_prof.h"
+#include "defer.h"
+
+struct defer_item {
+    defer_fn fn;
+    uint32_t arg;
+};
+
+struct defer_ctx {
+    uint32_t head;              /* items posted, any priority           */
+    uint32_t tail;              /* items taken, DEFER_ISR only          */
+    uint32_t dropped;           /* posts that found the queue full      */
+    struct defer_item item[DEFER_DEPTH];
+};
+
+static volatile struct defer_ctx defer_ctx;
+
+/* also after anything that clears the NVIC enables, queued work is kept */
+void defer_init(uint8_t prio) {
+
+    NVIC->IPR[DEFER_IRQ] = NVIC_PRIO(prio);
+    NVIC->ISER[DEFER_IRQ / 32] = (1 << (DEFER_IRQ % 32));
+
+}
+
+/* any priority. 1 = queued, 0 = queue full (see note 1) */
+uint8_t defer(defer_fn fn, uint32_t arg) {
+
+    uint32_t primask = irq_save();
+
+    if (defer_ctx.head - defer_ctx.tail >= DEFER_DEPTH) {
+        defer_ctx.dropped++;
+        irq_restore(primask);
+        return 0;
+    }
+
+    volatile struct defer_item *it = &defer_ctx.item[defer_ctx.head % DEFER_DEPTH];
+    it->fn  = fn;
+    it->arg = arg;
+    defer_ctx.head++;
+
+    irq_restore(primask);
+
+    NVIC->ISPR[DEFER_IRQ / 32] = (1 << (DEFER_IRQ % 32));
+    return 1;
+}
+
+void DEFER_ISR(void) {
+
+    ISR_PROF_SCOPE(SWI0);
+
+    while (defer_ctx.tail != defer_ctx.head) {
+
+        /* copy out first, the slot is free once tail moves */
+        volatile struct defer_item *it = &defer_ctx.item[defer_ctx.tail % DEFER_DEPTH];
+        defer_fn fn  = it->fn;
+        uint32_t arg = it->arg;
+        defer_ctx.tail++;
+
+        fn(arg);
+    }
+
+}
+
+/* note 1 : deferred work
+ *
+ *          time-critical isrs post the slow part of their job and return:
+ *          defer() is a PRIMASK-protected copy of two words and an NVIC pend,
+ *          callable from any priority. DEFER_ISR runs the items in order at the
+ *          priority set by defer_init(), preempted by everything above it.
+ *
+ *          items that run at the same level as the code that shares their state
+ *          need no locking against it; the level is each firmware's call (dongle.c
+ *          note 4, mouse.c note 2).
+ *
+ *          a full queue refuses the post (returns 0, counted in `dropped`), the
+ *          caller decides whether the work can be skipped or must be retried.
+ */
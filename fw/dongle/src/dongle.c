@@ -6,18 +6,19 @@
  **
  ********************************************************************/
 
-#define PRINT 0
-
 #include <stdint.h>
 #include <stddef.h>
 #include "device.h"
 #include "utils.h"
 #include "usb.h"
 #include "hid.h"
+#include "hid_mouse.h"
+#include "link_stats.h"
+#include "isr_prof.h"
+#include "trace.h"
+#include "defer.h"
 #include "SEGGER_RTT.h"
 
-static void hid_set_configuration(usb_device *dev, uint16_t wValue);
-
 #define LED_PIN GPIO6
 
 struct mouse_packet {
@@ -26,105 +27,212 @@ struct mouse_packet {
     int16_t  dx;
     int16_t  dy;
     int8_t   wheel;
+    uint8_t  seq;           /* +1 per mouse TX slot */
+    uint8_t  sensor_us;     /* burst completion -> TX start, saturates */
+} __attribute__((packed));
+
+/* fw/mouse/include/energy.h, appended to a packet about every 10s (note 5) */
+struct mouse_energy {
+    uint32_t ms[8];         /* tx rx ramp spi cpu wfi idle sleep, since boot */
+    uint32_t charge_uc;
+} __attribute__((packed));
+
+/* fw/mouse/include/battery.h, with the energy record */
+struct mouse_battery {
+    uint16_t mv;            /* filtered, 0 = no reading yet     */
+    uint8_t  soc;           /* %                                */
+    uint16_t minutes;       /* left at the mean current         */
+} __attribute__((packed));
+
+/* what the radio receives into, LENGTH says whether the records are there */
+struct mouse_packet_ext {
+    struct mouse_packet  pkt;
+    struct mouse_energy  energy;
+    struct mouse_battery battery;
 } __attribute__((packed));
 
+#define MOUSE_PKT_LEN (sizeof(struct mouse_packet) - 1)
+
 struct dongle_packet {
     uint8_t  LENGTH;
     uint16_t cc;
     uint16_t dpi;
+    uint8_t  profile;       /* competitive, balanced, eco: mouse.c note 6 */
 } __attribute__((packed));
 
+#define LINK_PROFILES 3
+
 enum radio_state {
     STATE_RX,
-    STATE_TX
+    STATE_TX,
+    STATE_LISTEN,           /* bus suspended: RX without a reply, note 7    */
+    STATE_OFF               /* bus suspended, between listen windows        */
+};
+
+/* where the oldest packet in a report spent its time, see note 3 */
+struct hid_stamp {
+    int32_t  rx_us;         /* TIMER0 at radio_isr, HID_NO_STAMP = none     */
+    uint16_t sensor_us;     /* from the mouse                               */
+    uint16_t air_us;        /* TX start -> radio_isr                        */
+};
+
+/* ep1 report bookkeeping, see note 1 */
+struct hid_ctx {
+    uint8_t  armed;         /* ep1 holds a report the host hasn't read yet  */
+    uint8_t  pending;       /* motion/buttons not yet handed to ep1         */
+    uint8_t  idle_rate;     /* HID1_11 7.2.4: 4ms units, 0 = on change only */
+    uint8_t  buttons;
+    uint8_t  gated;         /* too soon after the last report, see note 2   */
+    uint8_t  held;          /* gated for the next packet, see note 8        */
+    int32_t  x;
+    int32_t  y;
+    int32_t  wheel;
+    uint32_t poll_us;       /* measured host polling period                 */
+    uint32_t poll_sof;      /* FRAMECNTR << 16 | TIMER3 at the last IN, n.8 */
+    uint32_t report_us;     /* selected report interval                     */
+    uint32_t arm_us;        /* TIMER0 when the armed report was armed       */
+    struct hid_stamp rx;    /* oldest packet not yet handed to ep1          */
+    struct hid_stamp report;/* oldest packet in the armed report            */
 };
 
+#define HID_NO_STAMP INT32_MIN
+
+/* ep2 telemetry accumulators, see note 3 */
+struct telemetry_ctx {
+    uint8_t  armed;         /* ep2 holds a record the host hasn't read yet  */
+    uint8_t  rssi_worst;
+    uint8_t  phase_set;     /* phase_min/max_us hold this record's errors   */
+    uint16_t seq;
+    uint16_t ticks;         /* TIMER2 periods since the last record         */
+    uint16_t rx_ok;
+    uint16_t rx_crc_err;
+    uint16_t reports;
+    uint16_t ages;
+    uint16_t age_max_us;
+    int16_t  phase_min_us;
+    int16_t  phase_max_us;
+    int32_t  lead_us;       /* rx to next poll of the last packet, -1 none  */
+    uint32_t age_sum_us;
+    uint32_t rssi_sum;
+};
+
+#define TELEMETRY_INTERVAL_US 100000
+
+/* bus suspended: TIMER1 opens a listen window once a period, see note 7 */
+enum listen_step {
+    LISTEN_XO,              /* crystal on                                   */
+    LISTEN_OPEN,            /* RX on                                        */
+    LISTEN_CLOSE            /* RX and crystal off                           */
+};
+
+struct suspend_ctx {
+    uint8_t  listening;     /* TIMER1 runs the windows, not the report gate */
+    uint8_t  wakeup;        /* usb_remote_wakeup() done for this suspend    */
+    uint8_t  step;          /* enum listen_step, TIMER1's next compare      */
+    int32_t  wake_us;       /* TIMER0 at the packet that woke the host      */
+};
+
+#define LISTEN_PERIOD_US    20000
+#define LISTEN_US           2500    /* an eco slot of two polls, + its RX window  */
+#define XO_STARTUP_US       400     /* HFXO, 360us typ. on the datasheet          */
+
+/* radio_isr -> radio_rx_work handoff, see note 4 */
+struct radio_rx_event {
+    struct mouse_packet pkt;
+    uint8_t  crc_ok;
+    uint8_t  rssi;
+    int32_t  lead_us;       /* rx to next poll                              */
+    uint32_t rx_us;         /* TIMER0 at radio_isr                          */
+    uint32_t air_us;        /* TX start -> radio_isr                        */
+    uint8_t  listen;        /* heard in a listen window, no reply went out  */
+};
+
+#define RADIO_RX_QUEUE 8    /* power of 2 */
+
+struct radio_rx_queue {
+    uint8_t  head;          /* written by radio_isr only                    */
+    uint8_t  tail;          /* written by radio_rx_work only                */
+    struct radio_rx_event ev[RADIO_RX_QUEUE];
+};
+
+/* interrupt priorities, see note 4 */
+#define IRQ_PRIO_RADIO      0   /* mouse packet -> reply TXEN                   */
+#define IRQ_PRIO_USB        2   /* USBD and everything that shares its state    */
+
+/* preamble + address + LENGTH + payload + CRC, 4us per byte at 2Mbit */
+#define RADIO_AIR_US(len) ((1 + 4 + 1 + (len) + 2) * 4)
+
+/* the reply's cc, see note 8 */
+#define RADIO_RAMP_US       40      /* fast ramp-up, both sides                     */
+#define REPLY_NEXT_END_US   (2 * RADIO_RAMP_US + RADIO_AIR_US(sizeof(struct dongle_packet) - 1) \
+                             + RADIO_AIR_US(MOUSE_PKT_LEN))
+#define REPLY_ARM_US        100     /* mouse END to ep1 armed, with margin          */
+#define REPLY_CC_MIN_US     300     /* the mouse's RX window + 50, the longest      */
+#define USB_FRAME_US        1000
+
 volatile enum radio_state radio_state    = STATE_RX;
-volatile struct mouse_packet  rx_pkt     = {0};
+volatile uint32_t         radio_rx_end   = 0;   /* TIMER2 at the last mouse packet END */
+volatile struct mouse_packet_ext rx_pkt  = {0};
+volatile struct mouse_energy  mouse_energy  = {0};
+volatile struct mouse_battery mouse_battery = {0};
 volatile struct mouse_packet  mouse_pkt  = {0};
-volatile struct dongle_packet dongle_pkt = {.LENGTH = 4, .dpi = 800};
+volatile struct dongle_packet dongle_pkt = {.LENGTH = 5, .dpi = 800, .profile = 1};
+volatile struct hid_ctx       hid_ctx    = {.poll_us = 1000, .report_us = 1000,
+                                             .rx.rx_us = HID_NO_STAMP, .report.rx_us = HID_NO_STAMP};
+volatile struct telemetry_ctx telemetry_ctx = {.lead_us = -1};
+volatile struct suspend_ctx   suspend_ctx   = {.wake_us = HID_NO_STAMP};
+volatile struct radio_rx_queue radio_rx_queue = {0};
 
 /* our handle (ptr) to the device alloc'd in `usb.c` */
 static usb_device *usb_dev;
 
-/* byte 0:
- *   REPORT_COUNT (2), REPORT_SIZE(1)  = button 1,2  = 2 bits
- *   REPORT_COUNT (1), REPORT_SIZE(6)  = padding     = 6 bits
- * bytes 1-6: 
- *   REPORT_COUNT (3), REPORT_SIZE(16) = X, Y, Wheel = 3 * 2 bytes
- * bytes 7:
- *   REPORT_COUNT (1), REPORT_SIZE(8)  = padding     = 8 bits
- */
-const uint8_t hid_mouse_report_descriptor[] = {
-    0x05, 0x01,         /* USAGE_PAGE (Generic Desktop)         */
-    0x09, 0x02,         /* USAGE (Mouse)                        */
-    0xa1, 0x01,         /* COLLECTION (Application)             */
-    0x09, 0x01,         /*   USAGE (Pointer)                    */
-    0xa1, 0x00,         /*   COLLECTION (Physical)              */
-    0x05, 0x09,         /*     USAGE_PAGE (Button)              */
-    0x19, 0x01,         /*     USAGE_MINIMUM (Button 1)         */
-    0x29, 0x02,         /*     USAGE_MAXIMUM (Button 2)         */
-    0x15, 0x00,         /*     LOGICAL_MINIMUM (0)              */
-    0x25, 0x01,         /*     LOGICAL_MAXIMUM (1)              */
-    0x95, 0x02,         /*     REPORT_COUNT (2)                 */
-    0x75, 0x01,         /*     REPORT_SIZE (1)                  */
-    0x81, 0x02,         /*     INPUT (Data,Var,Abs)             */
-    0x95, 0x01,         /*     REPORT_COUNT (1)                 */
-    0x75, 0x06,         /*     REPORT_SIZE (6)                  */
-    0x81, 0x01,         /*     INPUT (Cnst,Ary,Abs)             */
-    0x05, 0x01,         /*     USAGE_PAGE (Generic Desktop)     */
-    0x09, 0x30,         /*     USAGE (X)                        */
-    0x09, 0x31,         /*     USAGE (Y)                        */
-    0x09, 0x38,         /*     USAGE (Wheel)                    */
-    0x16, 0x01, 0x80,   /*     LOGICAL_MINIMUM (-32767)         */
-    0x26, 0xff, 0x7f,   /*     LOGICAL_MAXIMUM (32767)          */
-    0x95, 0x03,         /*     REPORT_COUNT (3)                 */
-    0x75, 0x10,         /*     REPORT_SIZE (16)                 */
-    0x81, 0x06,         /*     INPUT (Data,Var,Rel)             */
-    0x95, 0x01,         /*     REPORT_COUNT (1)                 */
-    0x75, 0x08,         /*     REPORT_SIZE (8)                  */
-    0x81, 0x01,         /*     INPUT (Cnst,Ary,Abs)             */
-    0xc0,               /*   END_COLLECTION                     */
-    0x09, 0x3c,         /*   USAGE (Motion Wakeup)              */
-    0xc0                /* END_COLLECTION                       */
-};
-
-/* PS1.11 p.860 claims interrupt/bulk transactions
- * must be multiples of 4 bytes and 32-bit aligned
- */
-struct hid_mouse_report {
-    uint8_t buttons;
-    int16_t x;
-    int16_t y;
-    int16_t wheel;
-    uint8_t padding;
+/* the dongle's battery feature after the pointer, see note 6 */
+const uint8_t hid_mouse_report_descriptor[] = HID_MOUSE_REPORT_DESCRIPTOR(
+    0x05, 0x06,         /*   USAGE_PAGE (Generic Dev Ctrls)     */
+    0x09, 0x20,         /*   USAGE (Battery Strength)           */
+    0x15, 0x00,         /*   LOGICAL_MINIMUM (0)                */
+    0x25, 0x64,         /*   LOGICAL_MAXIMUM (100)              */
+    0x95, 0x01,         /*   REPORT_COUNT (1)                   */
+    0x75, 0x08,         /*   REPORT_SIZE (8)                    */
+    0xb1, 0x02,         /*   FEATURE (Data,Var,Abs), note 6     */
+    0x05, 0x01,         /*   USAGE_PAGE (Generic Desktop)       */
+    0x09, 0x3c          /*   USAGE (Motion Wakeup)              */
+);
+
+static struct hid_mouse_report hid_report = {0};
+
+/* one record per TELEMETRY_INTERVAL_US on ep2, read by tools/libusb-telemetry.c */
+struct telemetry_record {
+    uint16_t seq;           /* gaps = records the host didn't read in time  */
+    uint16_t interval_ms;   /* time covered by this record                  */
+    uint16_t rx_ok;         /* mouse packets with good CRC                  */
+    uint16_t rx_crc_err;    /* mouse packets with bad CRC                   */
+    int16_t  phase_min_us;  /* sync phase error, slot to slot               */
+    int16_t  phase_max_us;
+    uint16_t age_avg_us;    /* packet rx -> host read of the report         */
+    uint16_t age_max_us;
+    uint16_t reports;       /* HID reports read by the host                 */
+    uint16_t usb_dropped;   /* usb_dma_stats.dropped, low 16 bits           */
+    uint8_t  soc;           /* mouse battery %, 0 until its first record    */
+    uint8_t  rssi_avg;      /* -dBm, good packets only                      */
+    uint8_t  rssi_worst;
+    uint8_t  padding;
 } __attribute__((packed, aligned(4)));
 
-const struct usb_device_descriptor device_descriptor = {
-    .bLength            = USB_DT_DEVICE_SIZE,
-    .bDescriptorType    = USB_DT_DEVICE,
-    .bcdUSB             = 0x0200,
-    .bDeviceClass       = 0,
-    .bDeviceSubClass    = 0,
-    .bDeviceProtocol    = 0,
-    .bMaxPacketSize0    = 64,
-    .idVendor           = 0x1915,
-    .idProduct          = 0x572B,
-    .bcdDevice          = 0x0200,
-    .iManufacturer      = 1,
-    .iProduct           = 2,
-    .iSerialNumber      = 3,
-    .bNumConfigurations = 1,
-};
+static struct telemetry_record telemetry_record = {0};
+
+const struct usb_device_descriptor device_descriptor = HID_MOUSE_DEVICE_DESCRIPTOR(0x572B);
 
 struct config_block {
     struct usb_configuration_descriptor config;
     struct usb_interface_descriptor     if0;
     struct usb_hid_descriptor           if0_hid;
     struct usb_endpoint_descriptor      if0_hid_ep;
+    struct usb_interface_descriptor     if1;
+    struct usb_endpoint_descriptor      if1_telemetry_ep;
 } __attribute__((packed));
 
-struct config_block hid_mouse_cfg_block = {
+const struct config_block hid_mouse_cfg_block = {
     
     .config = {
         .bLength                = USB_DT_CONFIGURATION_SIZE,
@@ -132,95 +240,67 @@ struct config_block hid_mouse_cfg_block = {
         .wTotalLength           = sizeof(struct usb_configuration_descriptor) +
                                   sizeof(struct usb_interface_descriptor) +
                                   sizeof(struct usb_hid_descriptor) +
+                                  sizeof(struct usb_endpoint_descriptor) +
+                                  sizeof(struct usb_interface_descriptor) +
                                   sizeof(struct usb_endpoint_descriptor),
-        .bNumInterfaces         = 1,
+        .bNumInterfaces         = 2,
         .bConfigurationValue    = 1,
         .iConfiguration         = 0,
-        .bmAttributes           = 0x80,
+        .bmAttributes           = USB_CFG_ATTR_RESERVED | USB_CFG_ATTR_REMOTE_WAKEUP,
         .bMaxPower              = 0x32,
     },
 
-    .if0 = {
+    HID_MOUSE_IF0(hid_mouse_report_descriptor),
+
+    .if1 = {
         .bLength                = USB_DT_INTERFACE_SIZE,
         .bDescriptorType        = USB_DT_INTERFACE,
-        .bInterfaceNumber       = 0,
+        .bInterfaceNumber       = 1,
         .bAlternateSetting      = 0,
         .bNumEndpoints          = 1,
-        .bInterfaceClass        = USB_CLASS_HID,
-        .bInterfaceSubClass     = USB_HID_SUBCLASS_NO,
-        .bInterfaceProtocol     = USB_HID_INTERFACE_PROTOCOL_NONE,
+        .bInterfaceClass        = USB_CLASS_VENDOR_SPECIFIC,
+        .bInterfaceSubClass     = 0,
+        .bInterfaceProtocol     = 0,
         .iInterface             = 0,
     },
 
-    .if0_hid = {
-        .bLength                 = sizeof(struct usb_hid_descriptor),
-        .bDescriptorType         = USB_HID_DT_HID,
-        .bcdHID                  = 0x0111,
-        .bCountryCode            = 0,
-        .bNumDescriptors         = 1,
-        .bReportDescriptorType   = USB_HID_DT_REPORT,
-        .wReportDescriptorLength = sizeof(hid_mouse_report_descriptor),
-    },
-
-    .if0_hid_ep = {
+    .if1_telemetry_ep = {
         .bLength                = USB_DT_ENDPOINT_SIZE,
         .bDescriptorType        = USB_DT_ENDPOINT,
-        .bEndpointAddress       = 0x81,
+        .bEndpointAddress       = 0x82,
         .bmAttributes           = USB_EP_ATTR_INTERRUPT,
-        .wMaxPacketSize         = sizeof(struct hid_mouse_report),
-        .bInterval              = 0x01,
+        .wMaxPacketSize         = sizeof(struct telemetry_record),
+        .bInterval              = 10,
     }
 
 };
 
-const struct usb_string_descriptor str_langid = {
-    .bLength            = 4,
-    .bDescriptorType    = USB_DT_STRING,
-    .wString            = { USB_LANGID_EN_US },
-};
+static void power_setup(void) {
+    POWER->TASKS_CONSTLAT = 1;
+}
 
-const struct usb_string_descriptor str_mfr = {
-    /* bLength = bLength + bDescriptorType + (UTF-16 chars * 2)
-     *         =    1    +        1        + (      9      * 2)
-     *         =   20
-     */
-    .bLength            = 20,
-    .bDescriptorType    = USB_DT_STRING,
-    .wString            = {
-        'H','i','i','r','i',' ','C','o','.'
-    },
-};
+static void irq_setup(void) {
 
-const struct usb_string_descriptor str_product = {
-    .bLength            = 20,
-    .bDescriptorType    = USB_DT_STRING,
-    .wString            = {
-        'H','I','D',' ','M','o','u','s','e'
-    }
-};
+    NVIC->IPR[NVIC_RADIO_IRQ]     = NVIC_PRIO(IRQ_PRIO_RADIO);
 
-const struct usb_string_descriptor str_serial = {
-    .bLength            = 12,
-    .bDescriptorType    = USB_DT_STRING,
-    .wString            = {
-        '6','9','4','2','0'
-    }
-};
+    /* equal priority: these never preempt each other */
+    NVIC->IPR[NVIC_USBD_IRQ]      = NVIC_PRIO(IRQ_PRIO_USB);
+    NVIC->IPR[NVIC_TIMER0_IRQ]    = NVIC_PRIO(IRQ_PRIO_USB);
+    NVIC->IPR[NVIC_TIMER1_IRQ]    = NVIC_PRIO(IRQ_PRIO_USB);
+    NVIC->IPR[NVIC_TIMER2_IRQ]    = NVIC_PRIO(IRQ_PRIO_USB);
+    NVIC->IPR[NVIC_CLOCK_POWER_IRQ] = NVIC_PRIO(IRQ_PRIO_USB);
 
-const struct usb_string_descriptor * const strings[] = {
-    &str_langid,
-    &str_mfr,
-    &str_product,
-    &str_serial,
-};
+    /* radio bookkeeping, posted from radio_isr */
+    defer_init(IRQ_PRIO_USB);
 
-static void power_setup(void) {
-    POWER->TASKS_CONSTLAT = 1;
 }
 
 static void clock_setup(void) {
     CLOCK->TASKS_HFCLKSTART = 1;
     while (!(CLOCK->EVENTS_HFCLKSTARTED));
+
+    /* HFCLKSTARTED only while the bus comes back, see listen_stop() */
+    NVIC->ISER[NVIC_CLOCK_POWER_IRQ / 32] = (1 << (NVIC_CLOCK_POWER_IRQ % 32));
 }
 
 static void timer_setup(void) {
@@ -230,8 +310,59 @@ static void timer_setup(void) {
     TIMER0->MODE        = TIMER_MODE_MODE_Timer;
     TIMER0->BITMODE     = TIMER_BITMODE_BITMODE_32Bit;
     TIMER0->PRESCALER   = 4;
+    NVIC->ISER[NVIC_TIMER0_IRQ / 32] = (1 << (NVIC_TIMER0_IRQ % 32));
 
     TIMER0->TASKS_START = 1;
+
+    /* report interval gate, one-shot */
+    TIMER1->TASKS_STOP  = 1;
+    TIMER1->TASKS_CLEAR = 1;
+    TIMER1->MODE        = TIMER_MODE_MODE_Timer;
+    TIMER1->BITMODE     = TIMER_BITMODE_BITMODE_32Bit;
+    TIMER1->PRESCALER   = 4;
+    TIMER1->SHORTS      = TIMER_SHORTS_COMPARE0_STOP_Enabled
+                        | TIMER_SHORTS_COMPARE0_CLEAR_Enabled;
+    TIMER1->INTENSET    = TIMER_INTENSET_COMPARE0_Set;
+    NVIC->ISER[NVIC_TIMER1_IRQ / 32] = (1 << (NVIC_TIMER1_IRQ % 32));
+
+    /* telemetry record interval, free running */
+    TIMER2->TASKS_STOP  = 1;
+    TIMER2->TASKS_CLEAR = 1;
+    TIMER2->MODE        = TIMER_MODE_MODE_Timer;
+    TIMER2->BITMODE     = TIMER_BITMODE_BITMODE_32Bit;
+    TIMER2->PRESCALER   = 4;
+    TIMER2->CC[0]       = TELEMETRY_INTERVAL_US;
+    TIMER2->SHORTS      = TIMER_SHORTS_COMPARE0_CLEAR_Enabled;
+    TIMER2->INTENSET    = TIMER_INTENSET_COMPARE0_Set;
+    NVIC->ISER[NVIC_TIMER2_IRQ / 32] = (1 << (NVIC_TIMER2_IRQ % 32));
+
+    TIMER2->TASKS_START = 1;
+
+    /* time since the last SOF: cleared by it over PPI, free running */
+    TIMER3->TASKS_STOP  = 1;
+    TIMER3->TASKS_CLEAR = 1;
+    TIMER3->MODE        = TIMER_MODE_MODE_Timer;
+    TIMER3->BITMODE     = TIMER_BITMODE_BITMODE_32Bit;
+    TIMER3->PRESCALER   = 4;
+    PPI->CH[2].EEP      = (uint32_t) &USBD->EVENTS_SOF;
+    PPI->CH[2].TEP      = (uint32_t) &TIMER3->TASKS_CLEAR;
+    PPI->CHENSET        = (1 << 2);
+
+    TIMER3->TASKS_START = 1;
+}
+
+/* TIMER3 into CC[cc] and the frame it's in, read again if a SOF got between */
+RAMFUNC static uint32_t sof_capture(uint8_t cc, uint32_t *frame) {
+
+    uint32_t f;
+
+    do {
+        f = USBD->FRAMECNTR;
+        TIMER3->TASKS_CAPTURE[cc] = 1;
+    } while (USBD->FRAMECNTR != f);
+
+    *frame = f;
+    return TIMER3->CC[cc];
 }
 
 static void radio_setup(void) {
@@ -245,7 +376,7 @@ static void radio_setup(void) {
                    (RADIO_PCNF0_S1INCL_Automatic) |
                    (RADIO_PCNF0_PLEN_8bit);
 
-    RADIO->PCNF1 = (8 << RADIO_PCNF1_MAXLEN_Shft)   |
+    RADIO->PCNF1 = ((sizeof(rx_pkt) - 1) << RADIO_PCNF1_MAXLEN_Shft) |
                    (0 << RADIO_PCNF1_STATLEN_Shft)  |
                    (3 << RADIO_PCNF1_BALEN_Shft)    |
                    (RADIO_PCNF1_ENDIAN_Little)      |
@@ -272,38 +403,24 @@ static void radio_setup(void) {
     RADIO->TXADDRESS   = 1;
     RADIO->RXADDRESSES = RADIO_RXADDRESSES_ADDR0_Enabled;
 
-    /* shortcuts */
+    /* shortcuts, RSSISAMPLE is taken over each packet's address */
     RADIO->SHORTS = RADIO_SHORTS_READY_START_
-                  | RADIO_SHORTS_END_DISABLE_;
+                  | RADIO_SHORTS_END_DISABLE_
+                  | RADIO_SHORTS_ADDRESS_RSSISTART_
+                  | RADIO_SHORTS_DISABLED_RSSISTOP_;
 
     /* enable interrupt for packet sent/received */
     RADIO->INTENSET = RADIO_INTENSET_DISABLED_Set;
     NVIC->ISER[NVIC_RADIO_IRQ / 32] = (1 << (NVIC_RADIO_IRQ % 32));
 
-}
-
-static void set_polling_rate(usb_device *dev, struct usb_setup_data *req) {
-
-    (void)dev;
-
-    uint8_t bInterval = req->wIndex;
-    hid_mouse_cfg_block.if0_hid_ep.bInterval = bInterval;
-
-    #if DBG >= 1
-    SEGGER_RTT_printf(0, "\nRESETTING DEVICE WITH NEW POLLING RATE!\nbInterval = %d\n\n", 
-                         bInterval);
-    #endif
-
-    /* arbitrary delay to allow status stage to be acknowledged.. 
-     * no way to detect an acked status in the nordic periph
+    /* hw timestamps for the reply turnaround (link_stats note 1):
+     * END -> TIMER2 CC[1], ADDRESS -> TIMER2 CC[2]
      */
-    for (volatile uint32_t i = 0; i < 50000; i++);
-
-    usb_stop(usb_dev);
-    usb_dev = usb_init(&device_descriptor, &hid_mouse_cfg_block.config,
-                        strings, sizeof(strings) / sizeof(strings[0]));
-    usb_register_set_config_callback(usb_dev, hid_set_configuration);
-    usb_start(usb_dev);
+    PPI->CH[0].EEP = (uint32_t) &RADIO->EVENTS_END;
+    PPI->CH[0].TEP = (uint32_t) &TIMER2->TASKS_CAPTURE[1];
+    PPI->CH[1].EEP = (uint32_t) &RADIO->EVENTS_ADDRESS;
+    PPI->CH[1].TEP = (uint32_t) &TIMER2->TASKS_CAPTURE[2];
+    PPI->CHENSET   = (1 << 0) | (1 << 1);
 
 }
 
@@ -313,6 +430,7 @@ handle_set_mousesettings(usb_device *dev, struct usb_setup_data *req, uint8_t **
     (void)dev;
     (void)buf;
     (void)len;
+    (void)cb;
 
     /* custom 'vendor-specific' request for setting DPI/pollrate */
     if ((req->bmRequestType != 0b01000000) || (req->bRequest != 0x01)) {
@@ -320,33 +438,161 @@ handle_set_mousesettings(usb_device *dev, struct usb_setup_data *req, uint8_t **
     }
 
     if (req->wValue > 0) {
-        #if DBG >= 1
-        SEGGER_RTT_printf(0, "set dpi: %d\n", req->wValue);
-        #endif
+        TRACE(TR_SET_DPI, req->wValue);
         dongle_pkt.dpi = req->wValue;
     }
 
-    if (req->wIndex > 0) {
-        *cb = set_polling_rate;
+    /* wIndex = report interval in ms (the old bInterval). applied by
+     * decimating reports, the device stays enumerated (see note 2)
+     */
+    if ((req->wIndex > 0) && (req->wIndex <= 255)) {
+        TRACE(TR_SET_INTERVAL, req->wIndex);
+        hid_ctx.report_us = req->wIndex * 1000;
     }
 
     return USB_REQ_HANDLED;
 }
 
+static enum usb_req_result
+handle_set_profile(usb_device *dev, struct usb_setup_data *req, uint8_t **buf,
+                   uint16_t *len, usb_ep0_req_complete_callback *cb) {
+    (void)dev;
+    (void)buf;
+    (void)len;
+    (void)cb;
+
+    /* custom 'vendor-specific' request for setting the mouse's power profile,
+     * it goes out with every reply and the mouse applies it on a change
+     */
+    if ((req->bmRequestType != 0b01000000) || (req->bRequest != 0x05)) {
+        return USB_REQ_DEFER;
+    }
+
+    if (req->wValue >= LINK_PROFILES) {
+        return USB_REQ_ERR;
+    }
+
+    TRACE(TR_SET_PROFILE, req->wValue);
+    dongle_pkt.profile = req->wValue;
+
+    return USB_REQ_HANDLED;
+}
+
+static enum usb_req_result
+handle_get_profile(usb_device *dev, struct usb_setup_data *req, uint8_t **buf,
+                   uint16_t *len, usb_ep0_req_complete_callback *cb) {
+    (void)dev;
+    (void)cb;
+
+    /* custom 'vendor-specific' request for getting the power profile */
+    if ((req->bmRequestType != 0b11000000) || req->bRequest != 0x05) {
+        return USB_REQ_DEFER;
+    }
+
+    *buf = (uint8_t *) &dongle_pkt.profile;
+    *len = MIN(*len, sizeof(dongle_pkt.profile));
+
+    return USB_REQ_HANDLED;
+}
+
 static enum usb_req_result
 handle_get_mousevbat(usb_device *dev, struct usb_setup_data *req, uint8_t **buf,
                      uint16_t *len, usb_ep0_req_complete_callback *cb) {
     (void)dev;
     (void)cb;
 
-    /* custom 'vendor-specific' request for getting mouse vbat */
+    static struct mouse_battery battery;
+
+    /* custom 'vendor-specific' request for getting the mouse's battery:
+     * mV, % and minutes left, calibrated on the mouse (note 5)
+     */
     if ((req->bmRequestType != 0b11000000) || req->bRequest != 0x01) {
         return USB_REQ_DEFER;
     }
 
-    /* point ep0 xfer buf to data requested */
-    *buf = (uint8_t *) &mouse_pkt.btn_vbat;
-    *len = sizeof(mouse_pkt.btn_vbat);
+    /* radio_isr writes it from above */
+    uint32_t primask = irq_save();
+    battery = mouse_battery;
+    irq_restore(primask);
+
+    *buf = (uint8_t *) &battery;
+    *len = MIN(*len, sizeof(battery));
+
+    return USB_REQ_HANDLED;
+}
+
+static enum usb_req_result
+handle_get_mouseenergy(usb_device *dev, struct usb_setup_data *req, uint8_t **buf,
+                       uint16_t *len, usb_ep0_req_complete_callback *cb) {
+    (void)dev;
+    (void)cb;
+
+    static struct mouse_energy energy;
+
+    /* custom 'vendor-specific' request for getting the mouse's last energy
+     * record, all zero until the first one comes in (note 5)
+     */
+    if ((req->bmRequestType != 0b11000000) || req->bRequest != 0x06) {
+        return USB_REQ_DEFER;
+    }
+
+    /* radio_isr writes it from above */
+    uint32_t primask = irq_save();
+    energy = mouse_energy;
+    irq_restore(primask);
+
+    *buf = (uint8_t *) &energy;
+    *len = MIN(*len, sizeof(energy));
+
+    return USB_REQ_HANDLED;
+}
+
+static enum usb_req_result
+handle_get_usbstats(usb_device *dev, struct usb_setup_data *req, uint8_t **buf,
+                    uint16_t *len, usb_ep0_req_complete_callback *cb) {
+    (void)cb;
+
+    /* custom 'vendor-specific' request for getting usb dma queue/drop counters */
+    if ((req->bmRequestType != 0b11000000) || req->bRequest != 0x02) {
+        return USB_REQ_DEFER;
+    }
+
+    *buf = (uint8_t *) &dev->dma_stats;
+    *len = MIN(*len, sizeof(dev->dma_stats));
+
+    return USB_REQ_HANDLED;
+}
+
+static enum usb_req_result
+handle_get_linkstats(usb_device *dev, struct usb_setup_data *req, uint8_t **buf,
+                     uint16_t *len, usb_ep0_req_complete_callback *cb) {
+    (void)dev;
+    (void)cb;
+
+    /* custom 'vendor-specific' request for getting the rolling link statistics */
+    if ((req->bmRequestType != 0b11000000) || req->bRequest != 0x03) {
+        return USB_REQ_DEFER;
+    }
+
+    *buf = (uint8_t *) link_stats_read();
+    *len = MIN(*len, sizeof(struct link_stats_report));
+
+    return USB_REQ_HANDLED;
+}
+
+static enum usb_req_result
+handle_get_latency(usb_device *dev, struct usb_setup_data *req, uint8_t **buf,
+                   uint16_t *len, usb_ep0_req_complete_callback *cb) {
+    (void)dev;
+    (void)cb;
+
+    /* custom 'vendor-specific' request for getting the motion latency histograms */
+    if ((req->bmRequestType != 0b11000000) || req->bRequest != 0x04) {
+        return USB_REQ_DEFER;
+    }
+
+    *buf = (uint8_t *) link_stats_read_latency();
+    *len = MIN(*len, sizeof(struct link_stats_latency_report));
 
     return USB_REQ_HANDLED;
 }
@@ -357,44 +603,384 @@ handle_hid_get_report_descriptor(usb_device *dev, struct usb_setup_data *req, ui
     (void)dev;
     (void)cb;
 
-    if ((req->bmRequestType != 0b10000001) || (req->bRequest != USB_REQ_GET_DESCRIPTOR)
-       || (req->wValue != (USB_HID_DT_REPORT << 8))) {
-        return USB_REQ_DEFER; /* defer handling to std handlers or subsequent user cb */
+    return hid_mouse_get_report_descriptor(req, hid_mouse_report_descriptor,
+                                           sizeof(hid_mouse_report_descriptor), buf, len);
+}
+
+static uint32_t hid_nominal_poll_us(void) {
+    return hid_mouse_cfg_block.if0_hid_ep.bInterval * 1000;
+}
+
+/* hand everything accumulated since the last report to ep1. if the
+ * driver refuses the write, it all stays pending for the next packet
+ */
+static void hid_arm_report(usb_device *dev) {
+
+    if (!hid_mouse_write_report(dev, &hid_report, hid_ctx.buttons,
+                                &hid_ctx.x, &hid_ctx.y, &hid_ctx.wheel)) {
+        return;
     }
 
-    /* point ep0 xfer buf to data requested */
-    *buf = (uint8_t *)hid_mouse_report_descriptor;
-    *len = sizeof(hid_mouse_report_descriptor);
+    hid_ctx.pending = hid_ctx.x || hid_ctx.y || hid_ctx.wheel;
+    hid_ctx.armed   = 1;
+
+    TIMER0->TASKS_CAPTURE[3] = 1;
+    hid_ctx.arm_us = TIMER0->CC[3];
+    hid_ctx.report = hid_ctx.rx;
+    if (!hid_ctx.pending) {
+        hid_ctx.rx.rx_us = HID_NO_STAMP;
+    }
+
+    #if DBG >= 2
+    TRACE(TR_HID_ARM, hid_ctx.pending);
+    #endif
+
+}
+
+/* arm ep1 now, or once the report interval since the last report
+ * has run out (see timer1_isr)
+ */
+static void hid_try_arm_report(usb_device *dev) {
+
+    if (hid_ctx.gated) {
+        return;
+    }
+
+    hid_arm_report(dev);
 
-    return USB_REQ_HANDLED;
 }
 
+/* input while the bus is suspended: wake the host, the report goes out once
+ * it's back. a host that didn't allow it never gets the input (note 7)
+ */
+static void hid_wakeup(usb_device *dev) {
+
+    if (suspend_ctx.wakeup) {
+        return;
+    }
+
+    if (usb_remote_wakeup(dev)) {
+        suspend_ctx.wakeup  = 1;
+        suspend_ctx.wake_us = hid_ctx.rx.rx_us;
+        return;
+    }
+
+    hid_ctx.pending  = 0;
+    hid_ctx.x        = 0;
+    hid_ctx.y        = 0;
+    hid_ctx.wheel    = 0;
+    hid_ctx.rx.rx_us = HID_NO_STAMP;
+
+}
+
+/* fold a freshly received mouse packet into the next report,
+ * rx_us = TIMER0 when it arrived, air_us = TX start -> then
+ */
+static void hid_queue_packet(usb_device *dev, uint32_t rx_us, uint32_t air_us) {
+
+    uint8_t buttons = mouse_pkt.btn_vbat & 0b11;
+
+    if (mouse_pkt.dx || mouse_pkt.dy || mouse_pkt.wheel || (buttons != hid_ctx.buttons)) {
+        hid_ctx.pending = 1;
+        if (hid_ctx.rx.rx_us == HID_NO_STAMP) {
+            hid_ctx.rx.rx_us     = rx_us;
+            hid_ctx.rx.sensor_us = mouse_pkt.sensor_us;
+            hid_ctx.rx.air_us    = air_us;
+        }
+    }
+
+    hid_ctx.buttons = buttons;
+    hid_ctx.x      += mouse_pkt.dx;
+    hid_ctx.y      += mouse_pkt.dy;
+    hid_ctx.wheel  += mouse_pkt.wheel;
+
+    if (!hid_ctx.pending || !dev->configured) {
+        return;
+    }
+    if (hid_ctx.held) {
+        hid_ctx.held  = 0;
+        hid_ctx.gated = 0;
+    }
+    if (dev->suspended) {
+        hid_wakeup(dev);
+    }
+    else if (!hid_ctx.armed) {
+        hid_try_arm_report(dev);
+    }
+
+}
+
+static void hid_set_idle(uint8_t rate) {
+
+    hid_ctx.idle_rate = rate;
+
+    TIMER0->INTENCLR = TIMER_INTENCLR_COMPARE2_Clr;
+    TIMER0->EVENTS_COMPARE[2] = 0;
+
+    if (rate == 0) {
+        return;
+    }
+
+    /* TIMER0 counts from the last ep1 IN, so the new period is
+     * measured from there unless that point has already passed
+     */
+    uint32_t duration = rate * 4000;
+    TIMER0->TASKS_CAPTURE[3] = 1;
+    uint32_t now = TIMER0->CC[3];
+
+    TIMER0->CC[2]    = (now < duration) ? duration : (now + duration);
+    TIMER0->INTENSET = TIMER_INTENSET_COMPARE2_Set;
+
+}
+
+static void telemetry_report_age(uint32_t age_us) {
+
+    if (age_us > 0xFFFF) {
+        age_us = 0xFFFF;
+    }
+
+    telemetry_ctx.ages++;
+    telemetry_ctx.age_sum_us += age_us;
+    if (age_us > telemetry_ctx.age_max_us) {
+        telemetry_ctx.age_max_us = age_us;
+    }
+
+}
+
+/* per packet: lead = time from rx to the next ep1 poll. a locked
+ * mouse lands at the same point of every poll period, so the slot
+ * to slot change of the lead is the sync loop's phase error
+ */
+static void telemetry_rx_packet(uint8_t crc_ok, int32_t lead_us, uint8_t rssi) {
+
+    if (telemetry_ctx.lead_us >= 0) {
+
+        int32_t err  = lead_us - telemetry_ctx.lead_us;
+        int32_t half = hid_ctx.poll_us / 2;
+
+        if (err >  half) err -= hid_ctx.poll_us;
+        if (err < -half) err += hid_ctx.poll_us;
+
+        /* the first error of a record seeds both, a record without one says 0/0 */
+        if (!telemetry_ctx.phase_set || err < telemetry_ctx.phase_min_us) telemetry_ctx.phase_min_us = err;
+        if (!telemetry_ctx.phase_set || err > telemetry_ctx.phase_max_us) telemetry_ctx.phase_max_us = err;
+        telemetry_ctx.phase_set = 1;
+    }
+    telemetry_ctx.lead_us = lead_us;
+
+    if (!crc_ok) {
+        telemetry_ctx.rx_crc_err++;
+        return;
+    }
+
+    telemetry_ctx.rx_ok++;
+    telemetry_ctx.rssi_sum += rssi;
+    if (rssi > telemetry_ctx.rssi_worst) {
+        telemetry_ctx.rssi_worst = rssi;
+    }
+
+}
+
+/* snapshot and reset the accumulators into ep2. if the driver refuses
+ * the write, keep accumulating and try again next tick
+ */
+static void telemetry_arm_record(usb_device *dev) {
+
+    uint32_t interval_ms = telemetry_ctx.ticks * (TELEMETRY_INTERVAL_US / 1000);
+
+    telemetry_record.seq          = telemetry_ctx.seq;
+    telemetry_record.interval_ms  = MIN(interval_ms, 0xFFFF);
+    telemetry_record.rx_ok        = telemetry_ctx.rx_ok;
+    telemetry_record.rx_crc_err   = telemetry_ctx.rx_crc_err;
+    telemetry_record.phase_min_us = telemetry_ctx.phase_min_us;
+    telemetry_record.phase_max_us = telemetry_ctx.phase_max_us;
+    telemetry_record.age_avg_us   = telemetry_ctx.ages ? (telemetry_ctx.age_sum_us / telemetry_ctx.ages) : 0;
+    telemetry_record.age_max_us   = telemetry_ctx.age_max_us;
+    telemetry_record.reports      = telemetry_ctx.reports;
+    telemetry_record.usb_dropped  = dev->dma_stats.dropped;
+    telemetry_record.soc          = mouse_battery.soc;
+    telemetry_record.rssi_avg     = telemetry_ctx.rx_ok ? (telemetry_ctx.rssi_sum / telemetry_ctx.rx_ok) : 0;
+    telemetry_record.rssi_worst   = telemetry_ctx.rssi_worst;
+
+    if (usb_ep_write_packet(dev, 0x82, &telemetry_record, sizeof(telemetry_record)) == 0xFFFF) {
+        return;
+    }
+
+    telemetry_ctx.armed        = 1;
+    telemetry_ctx.seq++;
+    telemetry_ctx.ticks        = 0;
+    telemetry_ctx.rx_ok        = 0;
+    telemetry_ctx.rx_crc_err   = 0;
+    telemetry_ctx.reports      = 0;
+    telemetry_ctx.ages         = 0;
+    telemetry_ctx.age_sum_us   = 0;
+    telemetry_ctx.age_max_us   = 0;
+    telemetry_ctx.phase_set    = 0;
+    telemetry_ctx.phase_min_us = 0;
+    telemetry_ctx.phase_max_us = 0;
+    telemetry_ctx.rssi_sum     = 0;
+    telemetry_ctx.rssi_worst   = 0;
+
+}
+
+/* ep2 IN complete: the host read the record, next one goes out on the next tick */
+static void send_telemetry_record(usb_device *dev, uint8_t ep) {
+
+    (void)dev;
+    (void)ep;
+
+    telemetry_ctx.armed = 0;
+
+}
+
+/* ep1 IN complete: the host just read our report */
 static void send_hid_report(usb_device *dev, uint8_t ep) {
 
     (void)ep;
-    static struct hid_mouse_report report = {0};
 
     TIMER0->TASKS_CAPTURE[0] = 1;
     TIMER0->TASKS_CLEAR = 1;
 
-    report.buttons = mouse_pkt.btn_vbat;
-    report.x       = mouse_pkt.dx;
-    report.y       = mouse_pkt.dy;
-    report.wheel   = mouse_pkt.wheel;
+    /* where in its frame the host polls, radio_isr aims at it (note 8).
+     * one word, radio_isr can come in between two stores
+     */
+    uint32_t frame;
+    uint32_t sof_us  = sof_capture(1, &frame);
+    hid_ctx.poll_sof = (frame << 16) | MIN(sof_us, 0xFFFF);
+
+    /* back-to-back reports measure the real polling period,
+     * anything else (idle gaps) is a multiple of it
+     */
+    uint32_t nominal = hid_nominal_poll_us();
+    if ((TIMER0->CC[0] > nominal - (nominal / 8)) && (TIMER0->CC[0] < nominal + (nominal / 8))) {
+        hid_ctx.poll_us = TIMER0->CC[0];
+    }
 
-    usb_ep_write_packet(dev, 0x81, &report, sizeof(report));
+    if (hid_ctx.idle_rate) {
+        TIMER0->CC[2] = hid_ctx.idle_rate * 4000;
+    }
 
-    #if PRINT 
-    SEGGER_RTT_printf(0, "USB: %d\n", TIMER0->CC[0]);
+    /* the first report after a remote wakeup, from the packet that woke it */
+    if (suspend_ctx.wake_us != HID_NO_STAMP) {
+        TRACE(TR_HID_WAKE, TIMER0->CC[0] - suspend_ctx.wake_us);
+        suspend_ctx.wake_us = HID_NO_STAMP;
+    }
+
+    /* stamps are relative to the IN we just saw, rebase what's left over:
+     * it came in before this IN, so it goes negative and keeps its age
+     */
+    telemetry_ctx.reports++;
+    if (hid_ctx.report.rx_us != HID_NO_STAMP) {
+
+        uint32_t stage_us[LINK_STAGES - 1] = {
+            [LINK_STAGE_SENSOR] = hid_ctx.report.sensor_us,
+            [LINK_STAGE_AIR]    = hid_ctx.report.air_us,
+            [LINK_STAGE_QUEUE]  = hid_ctx.arm_us - hid_ctx.report.rx_us,
+            [LINK_STAGE_POLL]   = TIMER0->CC[0] - hid_ctx.arm_us,
+        };
+        link_stats_latency(stage_us);
+
+        telemetry_report_age(TIMER0->CC[0] - hid_ctx.report.rx_us);
+        hid_ctx.report.rx_us = HID_NO_STAMP;
+    }
+    if (hid_ctx.rx.rx_us != HID_NO_STAMP) {
+        hid_ctx.rx.rx_us -= (int32_t) TIMER0->CC[0];
+    }
+
+    /* close the gate until half a poll before the next report slot,
+     * so the report armed then goes out on the slot's poll. motion that
+     * came in after its poll waits for the next packet, which lands just
+     * before the next one (note 8): one report for both, not a report
+     * that is a poll behind from then on. the timer is only there for
+     * a packet that doesn't come
+     */
+    uint32_t gate_us = 0;
+    hid_ctx.held = 0;
+    if (hid_ctx.report_us > hid_ctx.poll_us) {
+        gate_us = hid_ctx.report_us - (hid_ctx.poll_us / 2);
+    }
+    if (hid_ctx.pending && (gate_us < hid_ctx.poll_us - (REPLY_ARM_US / 2))) {
+        gate_us = hid_ctx.poll_us - (REPLY_ARM_US / 2);
+        hid_ctx.held = 1;
+    }
+    if (gate_us) {
+        TIMER1->TASKS_STOP  = 1;
+        TIMER1->TASKS_CLEAR = 1;
+        TIMER1->CC[0]       = gate_us;
+        TIMER1->TASKS_START = 1;
+        hid_ctx.gated = 1;
+    }
+
+    /* nothing new: leave ep1 unarmed, host gets NAKs */
+    hid_ctx.armed = 0;
+    if (hid_ctx.pending) {
+        hid_try_arm_report(dev);
+    }
+
+    #if DBG >= 2
+    TRACE(TR_HID_IN, TIMER0->CC[0]);
     #endif
 
 }
 
+static enum usb_req_result
+handle_hid_class_request(usb_device *dev, struct usb_setup_data *req, uint8_t **buf,
+                         uint16_t *len, usb_ep0_req_complete_callback *cb) {
+    (void)dev;
+    (void)cb;
+
+    static uint8_t battery_pct;
+
+    /* interface 0 is the HID one, the vendor interface has no class requests */
+    if (req->wIndex != 0) {
+        return USB_REQ_DEFER;
+    }
+
+    switch (req->bRequest) {
+
+        case USB_HID_REQ_TYPE_SET_IDLE:
+            /* HID1_11 7.2.4: duration in the high byte, report ID in the low byte.
+             * we only have the one report
+             */
+            hid_set_idle(req->wValue >> 8);
+            return USB_REQ_HANDLED;
+
+        case USB_HID_REQ_TYPE_GET_IDLE:
+            *buf = (uint8_t *) &hid_ctx.idle_rate;
+            *len = MIN(*len, sizeof(hid_ctx.idle_rate));
+            return USB_REQ_HANDLED;
+
+        case USB_HID_REQ_TYPE_GET_REPORT:
+            /* HID1_11 7.2.1: type in the high byte. input is the last
+             * report, the same as mouse wired.c
+             */
+            if ((req->wValue >> 8) == USB_HID_REPORT_TYPE_INPUT) {
+                *buf = (uint8_t *) &hid_report;
+                *len = MIN(*len, sizeof(hid_report));
+                return USB_REQ_HANDLED;
+            }
+            /* the only feature is the battery, stalled until the mouse has
+             * sent one so the host says unknown rather than 0% (note 6)
+             */
+            if ((req->wValue >> 8) != USB_HID_REPORT_TYPE_FEATURE || !mouse_battery.mv) {
+                return USB_REQ_ERR;
+            }
+            battery_pct = mouse_battery.soc;
+            *buf = &battery_pct;
+            *len = MIN(*len, sizeof(battery_pct));
+            return USB_REQ_HANDLED;
+
+        default:
+            return USB_REQ_DEFER;
+    }
+}
+
 static void hid_set_configuration(usb_device *dev, uint16_t wValue) {
 
     (void)wValue;
 
     usb_setup_ep(dev, 0x81, USB_EP_ATTR_INTERRUPT, sizeof(struct hid_mouse_report), send_hid_report);
+    usb_setup_ep(dev, 0x82, USB_EP_ATTR_INTERRUPT, sizeof(struct telemetry_record), send_telemetry_record);
 
     usb_register_ep0_req_handler(dev, 
         USB_REQ_TYPE_IN        | USB_REQ_TYPE_STANDARD | USB_REQ_TYPE_INTERFACE,
@@ -411,8 +997,63 @@ static void hid_set_configuration(usb_device *dev, uint16_t wValue) {
         USB_REQ_TYPE_DIRECTION | USB_REQ_TYPE_TYPE   | USB_REQ_TYPE_RECIPIENT,
         handle_get_mousevbat);
 
-    /* fill ep1 tx buffer with first report; start chain of CTR IN events */
-    send_hid_report(dev, 0x81);
+    usb_register_ep0_req_handler(dev, 
+        USB_REQ_TYPE_IN        | USB_REQ_TYPE_VENDOR | USB_REQ_TYPE_DEVICE,
+        USB_REQ_TYPE_DIRECTION | USB_REQ_TYPE_TYPE   | USB_REQ_TYPE_RECIPIENT,
+        handle_get_usbstats);
+
+    usb_register_ep0_req_handler(dev, 
+        USB_REQ_TYPE_IN        | USB_REQ_TYPE_VENDOR | USB_REQ_TYPE_DEVICE,
+        USB_REQ_TYPE_DIRECTION | USB_REQ_TYPE_TYPE   | USB_REQ_TYPE_RECIPIENT,
+        handle_get_linkstats);
+
+    usb_register_ep0_req_handler(dev, 
+        USB_REQ_TYPE_IN        | USB_REQ_TYPE_VENDOR | USB_REQ_TYPE_DEVICE,
+        USB_REQ_TYPE_DIRECTION | USB_REQ_TYPE_TYPE   | USB_REQ_TYPE_RECIPIENT,
+        handle_get_latency);
+
+    usb_register_ep0_req_handler(dev, 
+        USB_REQ_TYPE_OUT       | USB_REQ_TYPE_VENDOR | USB_REQ_TYPE_DEVICE,
+        USB_REQ_TYPE_DIRECTION | USB_REQ_TYPE_TYPE   | USB_REQ_TYPE_RECIPIENT,
+        handle_set_profile);
+
+    usb_register_ep0_req_handler(dev, 
+        USB_REQ_TYPE_IN        | USB_REQ_TYPE_VENDOR | USB_REQ_TYPE_DEVICE,
+        USB_REQ_TYPE_DIRECTION | USB_REQ_TYPE_TYPE   | USB_REQ_TYPE_RECIPIENT,
+        handle_get_profile);
+
+    usb_register_ep0_req_handler(dev, 
+        USB_REQ_TYPE_IN        | USB_REQ_TYPE_VENDOR | USB_REQ_TYPE_DEVICE,
+        USB_REQ_TYPE_DIRECTION | USB_REQ_TYPE_TYPE   | USB_REQ_TYPE_RECIPIENT,
+        handle_get_mouseenergy);
+
+    usb_register_ep0_req_handler(dev, 
+        USB_REQ_TYPE_CLASS | USB_REQ_TYPE_INTERFACE,
+        USB_REQ_TYPE_TYPE  | USB_REQ_TYPE_RECIPIENT,
+        handle_hid_class_request);
+
+    TIMER1->TASKS_STOP  = 1;
+    TIMER1->TASKS_CLEAR = 1;
+
+    hid_ctx.armed   = 0;
+    hid_ctx.gated   = 0;
+    hid_ctx.held    = 0;
+    hid_ctx.pending = 0;
+    hid_ctx.x       = 0;
+    hid_ctx.y       = 0;
+    hid_ctx.wheel   = 0;
+    hid_ctx.poll_us = hid_nominal_poll_us();
+    hid_ctx.rx.rx_us     = HID_NO_STAMP;
+    hid_ctx.report.rx_us = HID_NO_STAMP;
+
+    telemetry_ctx.armed   = 0;
+    telemetry_ctx.ticks   = 0;
+    telemetry_ctx.lead_us = -1;
+
+    link_stats_reset();
+
+    /* fill ep1 tx buffer with first report, its IN gives radio_isr a timing anchor */
+    hid_arm_report(dev);
 
     /* device configured .. start receiving mouse packets */
     RADIO->PACKETPTR  = (uint32_t) &rx_pkt;
@@ -420,8 +1061,185 @@ static void hid_set_configuration(usb_device *dev, uint16_t wValue) {
 
 }
 
+/* TIMER1 compare while the bus is suspended: crystal on, a window, both off */
+static void listen_step(void) {
+
+    uint32_t next_us;
+
+    switch (suspend_ctx.step) {
+
+        case LISTEN_XO:
+            CLOCK->TASKS_HFCLKSTART = 1;
+            suspend_ctx.step = LISTEN_OPEN;
+            next_us = XO_STARTUP_US;
+            break;
+
+        case LISTEN_OPEN:
+            radio_state = STATE_LISTEN;
+            RADIO->PACKETPTR  = (uint32_t) &rx_pkt;
+            RADIO->TASKS_RXEN = 1;
+            suspend_ctx.step = LISTEN_CLOSE;
+            next_us = LISTEN_US;
+            break;
+
+        default: {
+            uint32_t primask = irq_save();
+            radio_state = STATE_OFF;
+            RADIO->TASKS_DISABLE = 1;
+            irq_restore(primask);
+
+            CLOCK->EVENTS_HFCLKSTARTED = 0;
+            CLOCK->TASKS_HFCLKSTOP = 1;
+            suspend_ctx.step = LISTEN_XO;
+            next_us = LISTEN_PERIOD_US - LISTEN_US - XO_STARTUP_US;
+            break;
+        }
+    }
+
+    TIMER1->CC[0]       = next_us;
+    TIMER1->TASKS_START = 1;
+
+}
+
+/* bus suspended: radio, crystal and CONSTLAT off, TIMER1 from the report
+ * gate to the listen windows. what the host didn't take before it left is
+ * dropped
+ */
+static void listen_start(void) {
+
+    uint32_t primask = irq_save();
+    radio_state = STATE_OFF;
+    RADIO->TASKS_DISABLE = 1;
+    irq_restore(primask);
+
+    P0->DIRCLR = LED_PIN;
+
+    CLOCK->INTENCLR            = CLOCK_INTEN_HFCLKSTARTED_;
+    CLOCK->EVENTS_HFCLKSTARTED = 0;
+    CLOCK->TASKS_HFCLKSTOP = 1;
+    POWER->TASKS_LOWPWR    = 1;
+
+    hid_ctx.pending  = 0;
+    hid_ctx.gated    = 0;
+    hid_ctx.held     = 0;
+    hid_ctx.x        = 0;
+    hid_ctx.y        = 0;
+    hid_ctx.wheel    = 0;
+    hid_ctx.rx.rx_us = HID_NO_STAMP;
+
+    suspend_ctx.listening = 1;
+    suspend_ctx.wakeup    = 0;
+    suspend_ctx.step      = LISTEN_XO;
+
+    TIMER1->TASKS_STOP  = 1;
+    TIMER1->TASKS_CLEAR = 1;
+    TIMER1->CC[0]       = LISTEN_PERIOD_US - LISTEN_US - XO_STARTUP_US;
+    TIMER1->TASKS_START = 1;
+
+}
+
+/* bus back: crystal on, clock_power_isr puts the radio back to answering
+ * once it runs. from a window that's at once, otherwise the crystal starts
+ * inside the host's 20ms of resume signalling
+ */
+static void listen_stop(void) {
+
+    TIMER1->TASKS_STOP  = 1;
+    TIMER1->TASKS_CLEAR = 1;
+    suspend_ctx.listening = 0;
+
+    POWER->TASKS_CONSTLAT   = 1;
+    CLOCK->INTENSET         = CLOCK_INTEN_HFCLKSTARTED_;
+    CLOCK->TASKS_HFCLKSTART = 1;
+
+}
+
+/* the crystal is up after a suspend (listen_stop): radio back to answering.
+ * a window that was open keeps its RX, only stops sending packets down as
+ * `listen`
+ */
+void clock_power_isr(void) {
+
+    ISR_PROF_SCOPE(POWER);
+
+    if (!CLOCK->EVENTS_HFCLKSTARTED) {
+        return;
+    }
+    CLOCK->EVENTS_HFCLKSTARTED = 0;
+    CLOCK->INTENCLR            = CLOCK_INTEN_HFCLKSTARTED_;
+
+    uint32_t primask = irq_save();
+    if (radio_state != STATE_LISTEN) {
+        RADIO->PACKETPTR  = (uint32_t) &rx_pkt;
+        RADIO->TASKS_RXEN = 1;
+    }
+    radio_state = STATE_RX;
+    irq_restore(primask);
+
+}
+
+/* usb.c note 3: SUSPEND, and RESUME or our own wakeup */
+static void hid_suspend(usb_device *dev, uint8_t suspended) {
+
+    if (suspended) {
+        listen_start();
+        return;
+    }
+    if (!suspend_ctx.listening) {
+        return;
+    }
+    listen_stop();
+
+    /* what woke the host, for its first poll. its age is the wake's
+     * (TR_HID_WAKE), not the link's
+     */
+    hid_ctx.rx.rx_us = HID_NO_STAMP;
+    if (hid_ctx.pending && !hid_ctx.armed && dev->configured) {
+        hid_try_arm_report(dev);
+    }
+
+}
+
+#if ISR_PROF
+
+static volatile uint8_t prof_ticks = 0;
+
+/* isr_prof.c note 1, cycles at 64MHz */
+static void isr_prof_dump(void) {
+
+    SEGGER_RTT_printf(0, "%-8s %8s %6s %6s %6s %8s %10s %6s %6s\n", "isr", "count", "min",
+                      "mean", "max", "preempt", "preempt_cy", "lat", "latmax");
+
+    for (uint8_t i = 0; i < ISR_PROF_COUNT; i++) {
+
+        struct isr_prof_entry *e = &isr_prof.isr[i];
+
+        SEGGER_RTT_printf(0, "%-8s %8u %6u %6u %6u %8u %10u %6u %6u\n", e->name, e->count,
+                          e->count ? e->min : 0, e->sum_n ? (e->sum / e->sum_n) : 0, e->max,
+                          e->preempted, e->preempt_cycles,
+                          e->lat_n ? (e->lat_sum / e->lat_n) : 0, e->lat_max);
+
+        SEGGER_RTT_printf(0, "  log2:");
+        for (uint8_t j = 0; j < ISR_PROF_BINS; j++) {
+            SEGGER_RTT_printf(0, " %u", e->hist[j]);
+        }
+        SEGGER_RTT_printf(0, "\n");
+    }
+
+    /* flash fetches since the last dump, RAMFUNC code doesn't count */
+    SEGGER_RTT_printf(0, "icache   hit %u miss %u\n", NVMC->IHIT, NVMC->IMISS);
+    NVMC->IHIT  = 0;
+    NVMC->IMISS = 0;
+}
+
+#endif
+
 int main(void) {
 
+    ISR_PROF_INIT();
+    TRACE_INIT();
+
+    irq_setup();
     power_setup();
     clock_setup();
     timer_setup();
@@ -430,39 +1248,179 @@ int main(void) {
 
     /* receive usb device handler */
     usb_dev = usb_init(&device_descriptor, &hid_mouse_cfg_block.config, 
-                        strings, sizeof(strings) / sizeof(strings[0]));
+                        hid_mouse_strings, HID_MOUSE_STRINGS);
 
     /* register the func that will run when the host sends the `set_configuration` request */
     usb_register_set_config_callback(usb_dev, hid_set_configuration);
 
+    /* bus suspend: listen windows instead of the radio always on (note 7) */
+    usb_register_suspend_callback(usb_dev, hid_suspend);
+
     /* enable peripheral, start enumeration */
     usb_start(usb_dev);
 
     for (;;) {
-        
+
+        TRACE_DRAIN();
+
+        /* a spinning cpu alone is over the suspend budget (note 7). the
+         * checks again with irqs masked: a trace or a resume from an isr
+         * in between would wait for the next wake. wfi still wakes on it
+         */
+        if (suspend_ctx.listening) {
+            uint32_t primask = irq_save();
+            if (suspend_ctx.listening && !TRACE_PENDING()) {
+                wfi();
+            }
+            irq_restore(primask);
+        }
+
+        #if ISR_PROF
+        /* dump from thread mode, every 5s */
+        if (prof_ticks >= 50) {
+            prof_ticks = 0;
+            isr_prof_dump();
+        }
+        #endif
+
     }
 
 }
 
-void usbd_isr(void) {
+RAMFUNC void usbd_isr(void) {
+    ISR_PROF_SCOPE(USBD);
     usb_handle_event(usb_dev);
 }
 
-void radio_isr(void) {
+/* radio_isr's bookkeeping, deferred to usb priority (note 4) */
+static void radio_rx_work(uint32_t arg) {
+
+    (void) arg;
+
+    while (radio_rx_queue.tail != radio_rx_queue.head) {
+
+        volatile struct radio_rx_event *ev = &radio_rx_queue.ev[radio_rx_queue.tail];
+
+        /* one in a listen window says nothing about the link (note 7) */
+        if (!ev->listen) {
+            telemetry_rx_packet(ev->crc_ok, ev->lead_us, ev->rssi);
+            link_stats_rx(ev->crc_ok, ev->pkt.seq, ev->rssi);
+        }
+
+        if (ev->crc_ok) {
+            mouse_pkt = ev->pkt;
+            hid_queue_packet(usb_dev, ev->rx_us, ev->air_us);
+        }
+
+        radio_rx_queue.tail = (radio_rx_queue.tail + 1) & (RADIO_RX_QUEUE - 1);
+    }
+
+}
+
+static void radio_turnaround_work(uint32_t turnaround_us) {
+    link_stats_turnaround(turnaround_us);
+}
+
+/* queue rx_pkt for radio_rx_work, TIMER0->CC[1] is when it came in */
+RAMFUNC static void radio_rx_push(uint8_t crc_ok, uint8_t rssi, int32_t lead_us, uint32_t air_us) {
+
+    uint8_t head = radio_rx_queue.head;
+    uint8_t next = (head + 1) & (RADIO_RX_QUEUE - 1);
+    if (next != radio_rx_queue.tail) {
+        volatile struct radio_rx_event *ev = &radio_rx_queue.ev[head];
+        ev->pkt     = rx_pkt.pkt;
+        ev->crc_ok  = crc_ok;
+        ev->rssi    = rssi;
+        ev->lead_us = lead_us;
+        ev->rx_us   = TIMER0->CC[1];
+        ev->air_us  = air_us;
+        ev->listen  = radio_state == STATE_LISTEN;
+        radio_rx_queue.head = next;
+    }
+    defer(radio_rx_work, 0);
+
+}
+
+RAMFUNC void radio_isr(void) {
+
+    ISR_PROF_SCOPE(RADIO);
 
     RADIO->EVENTS_DISABLED = 0;
 
+    /* a window closing, or the radio turned off for the suspend */
+    if (radio_state == STATE_OFF) {
+        return;
+    }
+
+    /* bus suspended: no reply, straight back to RX for the rest of the
+     * window. the packet only decides whether to wake the host (note 7)
+     */
+    if (radio_state == STATE_LISTEN) {
+
+        TIMER0->TASKS_CAPTURE[1] = 1;
+        uint8_t crc_ok = RADIO->CRCSTATUS;
+        uint8_t rssi   = RADIO->RSSISAMPLE;
+
+        radio_rx_push(crc_ok, rssi, -1, 0);
+
+        RADIO->PACKETPTR  = (uint32_t) &rx_pkt;
+        RADIO->TASKS_RXEN = 1;
+        return;
+    }
+
     if (radio_state == STATE_RX) {
 
+        /* time until the host's next ep1 poll: whole frames since the
+         * last IN we saw, on the host's SOFs, so NAKed polls in between
+         * add no error. cc puts the mouse's next END ahead of it (note 8)
+         */
         TIMER0->TASKS_CAPTURE[1] = 1;
-        dongle_pkt.cc = ((TIMER0->CC[0]) - (TIMER0->CC[1])) - 100;
+        TIMER2->TASKS_CAPTURE[3] = 1;
+        uint32_t frame;
+        uint32_t sof_us   = sof_capture(0, &frame);
+        int32_t  poll_us  = hid_nominal_poll_us();
+        uint32_t poll_sof = hid_ctx.poll_sof;
+        int32_t  since_us = ((frame - (poll_sof >> 16)) & USBD_FRAMECNTR_FRAMECNTR_Msk) * USB_FRAME_US
+                          + sof_us - (poll_sof & 0xFFFF);
+        int32_t  phase_us = since_us % poll_us;
+        if (phase_us < 0) {
+            phase_us += poll_us;
+        }
+        int32_t lead_us = poll_us - phase_us;
+        int32_t cc      = lead_us - REPLY_NEXT_END_US - REPLY_ARM_US;
+        if (cc < REPLY_CC_MIN_US) {
+            cc += poll_us;
+        }
+        dongle_pkt.cc = cc;
+
+        /* the reply's ADDRESS restarts RSSI, sample it first */
+        uint8_t crc_ok = RADIO->CRCSTATUS;
+        uint8_t rssi   = RADIO->RSSISAMPLE;
 
         RADIO->PACKETPTR = (uint32_t) &dongle_pkt;
         RADIO->TASKS_TXEN = 1;
 
-        if (RADIO->CRCSTATUS) {
-            mouse_pkt = rx_pkt;
+        /* bookkeeping after TXEN, it's not part of the turnaround */
+        radio_rx_end = TIMER2->CC[1];
+        uint32_t isr_lat_us = (TIMER2->CC[3] + TELEMETRY_INTERVAL_US - radio_rx_end) % TELEMETRY_INTERVAL_US;
+        ISR_PROF_LATENCY(RADIO, isr_lat_us * (ISR_PROF_CPU_HZ / 1000000));
+
+        /* records ride on the odd packet, its END is that much later */
+        uint8_t len = rx_pkt.pkt.LENGTH;
+        if (crc_ok && len >= sizeof(rx_pkt) - 1) {
+            mouse_energy  = rx_pkt.energy;
+            mouse_battery = rx_pkt.battery;
+            TRACE(TR_MOUSE_ENERGY, rx_pkt.energy.charge_uc / 1000);
         }
+        lead_us += RADIO_AIR_US(len) - RADIO_AIR_US(MOUSE_PKT_LEN);
+
+        /* the rest touches usb state, hand it down (note 4) */
+        radio_rx_push(crc_ok, rssi, lead_us, RADIO_AIR_US(len) + isr_lat_us);
+
+        #if DBG >= 2
+        TRACE(TR_RADIO_RX, rx_pkt.pkt.seq, crc_ok, rssi);
+        TRACE(TR_RADIO_REPLY, dongle_pkt.cc);
+        #endif
 
         radio_state = STATE_TX;
         P0->DIRSET = LED_PIN;
@@ -472,8 +1430,13 @@ void radio_isr(void) {
         RADIO->PACKETPTR = (uint32_t) &rx_pkt;
         RADIO->TASKS_RXEN = 1;
 
-        #if PRINT
-        SEGGER_RTT_printf(0, "RADIO: %3d, pkt.cc = %d\n", TIMER0->CC[1], dongle_pkt.cc);
+        /* TIMER2 wraps every telemetry interval */
+        uint32_t turnaround_us = (TIMER2->CC[2] + TELEMETRY_INTERVAL_US - radio_rx_end)
+                               % TELEMETRY_INTERVAL_US;
+        defer(radio_turnaround_work, turnaround_us);
+
+        #if DBG >= 2
+        TRACE(TR_RADIO_REPLY_END, turnaround_us);
         #endif
 
         radio_state = STATE_RX;
@@ -481,3 +1444,227 @@ void radio_isr(void) {
     }
 
 }
+
+void timer0_isr(void) {
+
+    ISR_PROF_SCOPE(TIMER0);
+
+    /* HID idle period ran out without a report: repeat the button state */
+    if (TIMER0->EVENTS_COMPARE[2]) {
+        TIMER0->EVENTS_COMPARE[2] = 0;
+
+        if (!hid_ctx.armed && usb_dev->configured && !usb_dev->suspended) {
+            hid_try_arm_report(usb_dev);
+        }
+
+        /* dma busy, gated or suspended, try again in 4ms */
+        if (!hid_ctx.armed) {
+            TIMER0->CC[2] += 4000;
+        }
+    }
+
+}
+
+void timer1_isr(void) {
+
+    ISR_PROF_SCOPE(TIMER1);
+
+    /* report interval elapsed: send whatever piled up meanwhile */
+    if (TIMER1->EVENTS_COMPARE[0]) {
+        TIMER1->EVENTS_COMPARE[0] = 0;
+
+        /* bus suspended, TIMER1 times the listen windows (note 7) */
+        if (suspend_ctx.listening) {
+            listen_step();
+            return;
+        }
+
+        hid_ctx.gated = 0;
+        if (hid_ctx.pending && !hid_ctx.armed && usb_dev->configured) {
+            hid_arm_report(usb_dev);
+        }
+    }
+
+}
+
+void timer2_isr(void) {
+
+    ISR_PROF_SCOPE(TIMER2);
+
+    /* telemetry interval: hand a record to ep2 unless the last one is still unread */
+    if (TIMER2->EVENTS_COMPARE[0]) {
+        TIMER2->EVENTS_COMPARE[0] = 0;
+
+        telemetry_ctx.ticks++;
+        #if ISR_PROF
+        prof_ticks++;
+        #endif
+        link_stats_tick(TELEMETRY_INTERVAL_US / 1000);
+        if (!telemetry_ctx.armed && usb_dev->configured && !usb_dev->suspended) {
+            telemetry_arm_record(usb_dev);
+        }
+    }
+
+}
+
+/* note 1 : motion-only reporting
+ *
+ *          ep1 used to be re-armed on every IN completion, so the host took an
+ *          interrupt (and libinput a wakeup) every poll even with the mouse sitting
+ *          still. now ep1 is only armed when there is something to say: motion,
+ *          a button change, or an expired HID idle period (SET_IDLE, 0 by default).
+ *          otherwise the hw NAKs the host's IN tokens.
+ *
+ *          motion is accumulated in `hid_ctx` rather than overwritten, so packets
+ *          that arrive while ep1 still holds an unread report aren't lost.
+ *
+ *          the mouse's slot timing (`dongle_pkt.cc`) is still anchored to the last
+ *          ep1 IN, but since there can now be any number of NAK'd polls since then,
+ *          radio_isr counts the frames in between (note 8).
+ *
+ * note 2 : report interval
+ *
+ *          changing the polling rate used to mean patching bInterval, then a
+ *          usb_stop()/usb_init()/usb_start() cycle: the device dropped off the bus
+ *          and every open handle broke. ep1 now always advertises bInterval = 1
+ *          and the selected rate is applied here by decimation: after each report
+ *          TIMER1 holds the gate closed until half a poll before the next slot,
+ *          motion keeps accumulating in `hid_ctx` meanwhile. switching is instant
+ *          and invisible to the host.
+ *
+ *          the radio link keeps running at the poll rate, so a lower report rate
+ *          only batches motion, it doesn't add radio latency on top.
+ *
+ * note 3 : telemetry
+ *
+ *          interface 1 is vendor specific with a single interrupt IN endpoint (ep2).
+ *          every TELEMETRY_INTERVAL_US TIMER2 snapshots the link counters in
+ *          `telemetry_ctx` into a `struct telemetry_record` and arms ep2; the host
+ *          just keeps an interrupt transfer pending on it (tools/libusb-telemetry.c).
+ *          no control transfers, and the HID interface is left alone, so usbhid
+ *          keeps its claim on if0.
+ *
+ *          if the host stops reading, ep2 stays armed with the old record and the
+ *          counters keep running, `interval_ms` says how long the next one covers.
+ *
+ *          report age is measured on TIMER0 from the radio rx of the oldest packet
+ *          in a report to the ep1 IN that delivered it. rx that had to wait for
+ *          a later report (clamped, gated) is rebased on the IN in between, to
+ *          before it (negative), so it keeps its age. the same stamp (`struct hid_stamp`),
+ *          extended with the mouse's `sensor_us` and the on-air time, feeds the
+ *          per-stage latency histograms (link_stats.c note 2).
+ *
+ * note 4 : interrupt priorities
+ *
+ *          the reply to a mouse packet has to be on air before the mouse's RX window
+ *          (RX_TIMEOUT_US) closes, counted from the packet's END. with every isr at
+ *          the reset priority, a long usb_handle_event() (ep0 descriptor stages,
+ *          callbacks) ran to completion first and could push radio_isr past it.
+ *
+ *            IRQ_PRIO_RADIO  RADIO        capture, reply TXEN, queue the packet
+ *            IRQ_PRIO_USB    USBD, TIMER0 (idle), TIMER1 (report gate),
+ *                            TIMER2 (telemetry), SWI0 (deferred work),
+ *                            CLOCK (crystal up after a suspend, note 7)
+ *
+ *          the timers all arm ep1/ep2 and share `hid_ctx`/`telemetry_ctx` with the
+ *          usb callbacks, so they sit with USBD at one level and never preempt each
+ *          other, as before; their timestamps come from CAPTURE tasks and PPI, not
+ *          from isr entry. the same goes for radio_isr's own bookkeeping
+ *          (hid_queue_packet, telemetry, link stats): radio_isr queues the packet in
+ *          `radio_rx_queue` and posts radio_rx_work, which defer.c runs from SWI0 at
+ *          usb priority. the packet queue is single producer/single consumer and
+ *          needs no locking, a lost post is picked up by the next one. it holds
+ *          RADIO_RX_QUEUE packets, a usb isr would have to run for that many ms
+ *          before one is dropped.
+ *
+ *          tools/libusb-ep0-stress.c loads ep0 while watching the turnaround
+ *          percentiles (0xC0/0x03), with PROF=1 the radio row of the isr profiler
+ *          dump has the entry latency itself.
+ *
+ * note 5 : mouse energy and battery records
+ *
+ *          about every 10s the mouse appends its energy record (state residency
+ *          and charge since boot, fw/mouse/src/mouse.c note 7) and its battery
+ *          state (mV, %, minutes left, note 8 there) to a packet, so the radio
+ *          receives into `struct mouse_packet_ext` with MAXLEN to match.
+ *          radio_isr copies records that come in with a good CRC to
+ *          `mouse_energy` and `mouse_battery` after TXEN, the vendor requests
+ *          0xC0/0x06 and 0xC0/0x01 hand out the last ones, the telemetry record
+ *          carries the %. btn_vbat's raw ladder step isn't used any more.
+ *
+ *          the longer packet ENDs later than its slot would say, `lead_us` is
+ *          taken back by the difference so the telemetry phase doesn't jump.
+ *
+ * note 6 : battery strength
+ *
+ *          the report descriptor has a Battery Strength feature (Generic Device
+ *          Controls 0x20, 0..100%) next to the mouse's input report, so the OS's
+ *          own battery support shows the mouse without a vendor tool: linux's
+ *          hid-input makes it a power_supply and reads it with GET_REPORT when
+ *          something asks for the capacity. nothing changes on ep1: a feature
+ *          needs no report ID next to the one input report, and the host only
+ *          transfers it when it wants it, which is never more often than the
+ *          level can change (a record every ~10s). until the first record the
+ *          dongle stalls it, the host says unknown rather than 0%.
+ *
+ *          an input report would push each change, but with a second input
+ *          report every mouse report would carry a report ID byte.
+ *
+ * note 7 : bus suspend and remote wakeup
+ *
+ *          3ms without frames and the bus is suspended (usb.c note 3): the dongle
+ *          has 2.5mA from then on, and the radio always in RX is ~10. so the
+ *          report interval's TIMER1 times listen windows instead, HFXO on
+ *          XO_STARTUP_US ahead, RX for LISTEN_US, both off for the rest of
+ *          LISTEN_PERIOD_US: ~13% radio, ~1.3mA at the sim's RX current, CONSTLAT
+ *          off and the main loop in WFI. LISTEN_US holds a whole eco slot, the
+ *          longest between two packets of a moving mouse, so a window hears one.
+ *
+ *          a packet in a window gets no reply (STATE_LISTEN), the mouse sees a
+ *          missed slot and carries on, and neither telemetry nor the link stats
+ *          count it. motion or a button in it is remote wakeup, if the host
+ *          enabled it with SET_FEATURE (the configuration says we can):
+ *          usb_remote_wakeup() takes the USBD out of LOWPOWER, usb.c drives K on
+ *          USBWUALLOWED and calls hid_suspend(), which starts the crystal and
+ *          arms the report for the host's first poll. the radio goes back to
+ *          answering from HFCLKSTARTED (clock_power_isr), nothing at usb
+ *          priority waits the crystal's startup out. without it
+ *          the input is dropped, as is what the host left unread when it
+ *          suspended: neither should move the cursor once it's back.
+ *
+ *          from input to that report is up to a period to be heard, a slot,
+ *          then the host's 20ms of resume (and whatever its driver adds, linux
+ *          waits longer): 35ms mean in `dongle-sim -S`. TR_HID_WAKE has it on
+ *          the board, from the packet to the IN. a mouse on its idle heartbeat
+ *          isn't heard until the input pulls its slots in (mouse.c note 5),
+ *          ~1ms more.
+ *
+ * note 8 : reply phase
+ *
+ *          `dongle_pkt.cc` tells the mouse when to send its next packet, counted
+ *          from the reply's END. it used to come from TIMER0 modulo the measured
+ *          poll, i.e. from the last ep1 IN, which drifts with every NAKed poll
+ *          since, and it aimed the packet's END ~100us after the poll rather
+ *          than before: a report waited most of a frame, ~1.5ms mean age.
+ *
+ *          now the host's own clock is the reference. the USBD's SOF clears
+ *          TIMER3 over PPI and FRAMECNTR counts the frames, both tick on
+ *          whether ep1 is armed or not. send_hid_report stamps frame and TIMER3
+ *          at each IN (`poll_sof`), radio_isr takes the same pair and has the
+ *          time since that IN in whole frames plus the offset within, so the
+ *          poll's place in the frame carries over any number of NAKs. cc puts
+ *          the next END REPLY_ARM_US ahead of the next poll, past the reply
+ *          and the mouse's packet (REPLY_NEXT_END_US), a period later if that
+ *          is shorter than the mouse's RX window allows. ~0.7ms mean age in
+ *          `dongle-sim`, the sensor to the radio being the rest.
+ *
+ *          a packet that still misses its poll (an energy record's longer
+ *          air time, a retry, host jitter) would leave ep1 holding its report
+ *          when the next one comes in, and re-arming right at the IN from
+ *          then on puts every report a poll behind. send_hid_report holds
+ *          what's left instead (`held`) and the next packet arms both, with
+ *          its REPLY_ARM_US ahead of the poll, and the phase is back. TIMER1
+ *          only arms it if no packet comes by REPLY_ARM_US / 2 ahead, which
+ *          is too late for that poll more often than not: arming from TIMER1
+ *          there would lock the reports a poll behind again.
+ */
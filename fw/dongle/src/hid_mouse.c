@@ -0,0 +1,121 @@
+/********************************************************************
+ ** file         : hid_mouse.c
+ ** description  : the HID mouse interface, strings and ep1 report
+ **                for both the dongle and the mouse on the cable
+ **
+ ********************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "utils.h"
+#include "usb.h"
+#include "hid.h"
+#include "hid_mouse.h"
+
+static const struct usb_string_descriptor str_langid = {
+    .bLength            = 4,
+    .bDescriptorType    = USB_DT_STRING,
+    .wString            = { USB_LANGID_EN_US },
+};
+
+static const struct usb_string_descriptor str_mfr = {
+    /* bLength = bLength + bDescriptorType + (UTF-16 chars * 2)
+     *         =    1    +        1        + (      9      * 2)
+     *         =   20
+     */
+    .bLength            = 20,
+    .bDescriptorType    = USB_DT_STRING,
+    .wString            = {
+        'H','i','i','r','i',' ','C','o','.'
+    },
+};
+
+static const struct usb_string_descriptor str_product = {
+    .bLength            = 20,
+    .bDescriptorType    = USB_DT_STRING,
+    .wString            = {
+        'H','I','D',' ','M','o','u','s','e'
+    }
+};
+
+static const struct usb_string_descriptor str_serial = {
+    .bLength            = 12,
+    .bDescriptorType    = USB_DT_STRING,
+    .wString            = {
+        '6','9','4','2','0'
+    }
+};
+
+const struct usb_string_descriptor * const hid_mouse_strings[HID_MOUSE_STRINGS] = {
+    &str_langid,
+    &str_mfr,
+    &str_product,
+    &str_serial,
+};
+
+/* GET_DESCRIPTOR(REPORT) for interface 0, anything else is deferred
+ * to the std handlers or the next user cb
+ */
+enum usb_req_result hid_mouse_get_report_descriptor(struct usb_setup_data *req,
+                                                    const uint8_t *desc, uint16_t size,
+                                                    uint8_t **buf, uint16_t *len) {
+
+    if ((req->bmRequestType != 0b10000001) || (req->bRequest != USB_REQ_GET_DESCRIPTOR)
+       || (req->wValue != (USB_HID_DT_REPORT << 8)) || (req->wIndex != 0)) {
+        return USB_REQ_DEFER;
+    }
+
+    /* point ep0 xfer buf to data requested */
+    *buf = (uint8_t *) desc;
+    *len = MIN(*len, size);
+
+    return USB_REQ_HANDLED;
+}
+
+static int16_t hid_clamp(int32_t val) {
+    if (val >  32767) return  32767;
+    if (val < -32767) return -32767;
+    return (int16_t) val;
+}
+
+/* everything accumulated in x/y/wheel into `report` and on to ep1.
+ * 0 if the driver refuses the write, it all stays accumulated then.
+ * else what went out comes off, anything clamped away stays for the
+ * next report
+ */
+uint8_t hid_mouse_write_report(usb_device *dev, struct hid_mouse_report *report,
+                               uint8_t buttons, volatile int32_t *x,
+                               volatile int32_t *y, volatile int32_t *wheel) {
+
+    report->buttons = buttons;
+    report->x       = hid_clamp(*x);
+    report->y       = hid_clamp(*y);
+    report->wheel   = hid_clamp(*wheel);
+
+    if (usb_ep_write_packet(dev, 0x81, report, sizeof(*report)) == 0xFFFF) {
+        return 0;
+    }
+
+    *x     -= report->x;
+    *y     -= report->y;
+    *wheel -= report->wheel;
+
+    return 1;
+}
+
+/* note 1 : one mouse, two devices
+ *
+ *          the dongle and the mouse on its cable (mouse wired.c) show the
+ *          host the same interface 0: report descriptor, 8 byte report on
+ *          ep 0x81 every frame, strings. each keeps its own config block
+ *          around it and its own PID, 0x572B for the dongle and 0x572C for
+ *          the mouse, so the host keeps the two apart and tools/ doesn't
+ *          talk vendor requests to the wrong one. the dongle adds the
+ *          battery feature (dongle.c note 6) through the `...` of
+ *          HID_MOUSE_REPORT_DESCRIPTOR, the mouse on the cable has nothing
+ *          that would fill it.
+ *
+ *          the mouse's Makefile builds this and usb.c / usb_ep0.c out of
+ *          ../dongle/src, with its own device.h and utils.h first. the
+ *          same for utils.c, defer.c, trace.c and isr_prof.c.
+ */
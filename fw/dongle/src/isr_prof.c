@@ -0,0 +1,159 @@
+/********************************************************************
+ ** file         : isr_prof.c
+ ** description  : DWT->CYCCNT isr profiler
+ **
+ **                built into both firmwares, the isr
+ **                list lives in each firmware's isr_prof.h
+ **
+ ********************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "device.h"
+#include "utils.h"
+#include "isr_prof.h"
+#include "trace.h"
+
+#if ISR_PROF
+
+struct isr_prof_frame {
+    uint8_t  id;
+    uint32_t start;
+    uint32_t nested;            /* cycles spent in isrs that preempted us   */
+};
+
+struct isr_prof isr_prof;
+
+static struct isr_prof_frame stack[ISR_PROF_DEPTH];
+static volatile uint8_t depth = 0;
+
+static uint8_t isr_prof_bin(uint32_t cycles) {
+
+    if (cycles < 2) {
+        return 0;
+    }
+
+    return MIN(31 - __builtin_clz(cycles), ISR_PROF_BINS - 1);
+}
+
+void isr_prof_init(void) {
+
+    static const char *names[ISR_PROF_COUNT] = ISR_PROF_NAMES;
+
+    my_memset(&isr_prof, 0, sizeof(isr_prof));
+    isr_prof.magic      = ISR_PROF_MAGIC;
+    isr_prof.count      = ISR_PROF_COUNT;
+    isr_prof.entry_size = sizeof(struct isr_prof_entry);
+    isr_prof.cpu_hz     = ISR_PROF_CPU_HZ;
+
+    for (uint8_t i = 0; i < ISR_PROF_COUNT; i++) {
+        my_memcpy(isr_prof.isr[i].name, names[i],
+                  MIN(my_strlen(names[i]), sizeof(isr_prof.isr[i].name)));
+        isr_prof.isr[i].min = 0xFFFFFFFF;
+    }
+
+    COREDEBUG->DEMCR |= COREDEBUG_DEMCR_TRCENA;
+    DWT->CYCCNT       = 0;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA;
+
+}
+
+uint8_t isr_prof_enter(uint8_t id) {
+
+    /* isr nesting on the trace timeline, outside the measured window */
+    #if DBG >= 2
+    TRACE(TR_ISR_ENTER, id);
+    #endif
+
+    uint32_t primask = irq_save();
+
+    if (depth < ISR_PROF_DEPTH) {
+        stack[depth].id     = id;
+        stack[depth].nested = 0;
+        stack[depth].start  = DWT->CYCCNT;
+    }
+    depth++;
+
+    irq_restore(primask);
+    return id;
+}
+
+void isr_prof_exit(uint8_t *id) {
+
+    uint32_t primask = irq_save();
+    uint32_t now     = DWT->CYCCNT;
+
+    depth--;
+
+    if (depth < ISR_PROF_DEPTH) {
+
+        struct isr_prof_entry *e = &isr_prof.isr[*id];
+        uint32_t total = now - stack[depth].start;
+        uint32_t self  = total - stack[depth].nested;
+
+        e->count++;
+        e->hist[isr_prof_bin(self)]++;
+        if (self < e->min) e->min = self;
+        if (self > e->max) e->max = self;
+
+        if (e->sum > 0x80000000) {
+            e->sum   >>= 1;
+            e->sum_n >>= 1;
+        }
+        e->sum += self;
+        e->sum_n++;
+
+        /* charge our whole run, nested ones included, to whoever we preempted */
+        if ((depth > 0) && (depth - 1 < ISR_PROF_DEPTH)) {
+            struct isr_prof_entry *p = &isr_prof.isr[stack[depth - 1].id];
+            stack[depth - 1].nested += total;
+            p->preempted++;
+            p->preempt_cycles += total;
+        }
+    }
+
+    irq_restore(primask);
+
+    #if DBG >= 2
+    TRACE(TR_ISR_EXIT, *id);
+    #endif
+}
+
+/* cycles from the isr's hw event to isr entry, for the isrs that can tell */
+void isr_prof_latency(uint8_t id, uint32_t cycles) {
+
+    struct isr_prof_entry *e = &isr_prof.isr[id];
+
+    if (e->lat_sum > 0x80000000) {
+        e->lat_sum >>= 1;
+        e->lat_n   >>= 1;
+    }
+    e->lat_sum += cycles;
+    e->lat_n++;
+    if (cycles > e->lat_max) e->lat_max = cycles;
+}
+
+#endif
+
+/* note 1 : isr profiler
+ *
+ *          each profiled isr opens with ISR_PROF_SCOPE(id), which reads CYCCNT on
+ *          entry and again when the isr's scope ends (all return paths). a small
+ *          stack tracks nesting, so an isr's histogram holds its self time and
+ *          the preempted one gets `preempted`/`preempt_cycles` instead.
+ *
+ *          not included: the 12 cycle exception entry/exit and the profiler's own
+ *          ~20 cycles at each end. all in cycles at ISR_PROF_CPU_HZ.
+ *
+ *          entry latency needs to know when the hw event happened, so only isrs
+ *          whose event gets timestamped by a TIMER (capture or compare) report it,
+ *          at that TIMER's 1us resolution.
+ *
+ *          with PROF=0 (default) the macros are empty and none of this is built.
+ *          PROF=1 DBG=2 also puts isr entry/exit on the trace (trace.c).
+ *
+ *          PROF=1 also turns on the NVMC cache profiling counters (startup.c), the
+ *          dongle prints IHIT/IMISS with the table and prof.exp reads them. the
+ *          RAMFUNC isrs run from RAM and show up in neither: compare their rows here
+ *          with a build where RAMFUNC is defined empty (utils.h).
+ */
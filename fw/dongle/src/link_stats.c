@@ -0,0 +1,278 @@
+/********************************************************************
+ ** file         : link_stats.c
+ ** description  : rolling-window radio link and motion latency statistics
+ **
+ **                nRF52840 dongle
+ **
+ ********************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "utils.h"
+#include "link_stats.h"
+
+/* mouse seq is 8-bit, one per TX slot. a longer gap than this
+ * is a sleep or a lost link rather than a run of missed slots
+ */
+#define SEQ_GAP_MAX 32
+
+struct link_stats_bucket {
+    uint16_t rx_ok;
+    uint16_t rx_crc_err;
+    uint16_t missed;
+    uint16_t resync;
+    uint16_t turnarounds;
+    uint16_t latencies;
+    uint16_t rssi_hist[LINK_STATS_HIST_BINS];
+    uint16_t turnaround_hist[LINK_STATS_HIST_BINS];
+    uint16_t latency_hist[LINK_STAGES][LINK_STATS_HIST_BINS];
+};
+
+struct link_stats_ctx {
+    uint8_t  head;          /* bucket being filled                          */
+    uint8_t  filled;        /* completed buckets in the window              */
+    uint8_t  have_seq;
+    uint8_t  last_seq;
+    uint16_t crc_since_ok;  /* bad packets since the last good one          */
+    uint16_t period_ms;     /* tick period, as last passed to _tick()       */
+};
+
+static struct link_stats_bucket buckets[LINK_STATS_BUCKETS];
+static struct link_stats_ctx    ctx;
+static struct link_stats_report report;
+static struct link_stats_latency_report latency_report;
+
+static uint8_t link_stats_bin(uint32_t val, uint32_t min, uint32_t width) {
+
+    if (val < min) {
+        return 0;
+    }
+
+    val = (val - min) / width;
+    return MIN(val, LINK_STATS_HIST_BINS - 1);
+}
+
+static uint8_t link_stats_log2_bin(uint32_t val) {
+
+    if (val < 2) {
+        return 0;
+    }
+
+    return MIN(31 - __builtin_clz(val), LINK_STATS_HIST_BINS - 1);
+}
+
+/* upper edge of the bin holding the p-th percentile sample,
+ * width = 0 for log2 bins
+ */
+static uint16_t link_stats_pct(const uint16_t *hist, uint32_t total, uint32_t p,
+                               uint32_t min, uint32_t width) {
+
+    if (total == 0) {
+        return 0;
+    }
+
+    uint32_t want = (total * p + 99) / 100;
+    uint32_t acc  = 0;
+    uint8_t  bin  = 0;
+
+    for (bin = 0; bin < LINK_STATS_HIST_BINS - 1; bin++) {
+        acc += hist[bin];
+        if (acc >= want) {
+            break;
+        }
+    }
+
+    if (width == 0) {
+        return MIN(2UL << bin, 0xFFFF);
+    }
+    return min + (bin + 1) * width;
+}
+
+static void link_stats_fill_pct(struct link_stats_pct *pct, const uint16_t *hist,
+                                uint32_t total, uint32_t min, uint32_t width) {
+
+    pct->p50 = link_stats_pct(hist, total, 50,  min, width);
+    pct->p90 = link_stats_pct(hist, total, 90,  min, width);
+    pct->p99 = link_stats_pct(hist, total, 99,  min, width);
+    pct->max = link_stats_pct(hist, total, 100, min, width);
+}
+
+/* a mouse packet made it to DISABLED, rssi = RSSISAMPLE (-dBm) */
+void link_stats_rx(uint8_t crc_ok, uint8_t seq, uint8_t rssi) {
+
+    struct link_stats_bucket *b = &buckets[ctx.head];
+
+    /* seq is only trustworthy once the CRC passed */
+    if (!crc_ok) {
+        b->rx_crc_err++;
+        ctx.crc_since_ok++;
+        return;
+    }
+
+    b->rx_ok++;
+    b->rssi_hist[link_stats_bin(rssi, LINK_STATS_RSSI_MIN, LINK_STATS_RSSI_BIN)]++;
+
+    if (ctx.have_seq) {
+
+        uint8_t gap = seq - ctx.last_seq;
+
+        /* slots in between that didn't even show up as a bad packet */
+        if (gap > SEQ_GAP_MAX) {
+            b->resync++;
+        }
+        else if (gap > ctx.crc_since_ok + 1) {
+            b->missed += gap - ctx.crc_since_ok - 1;
+        }
+    }
+
+    ctx.have_seq     = 1;
+    ctx.last_seq     = seq;
+    ctx.crc_since_ok = 0;
+
+}
+
+/* mouse packet END to the reply's ADDRESS, see radio_isr */
+void link_stats_turnaround(uint32_t us) {
+
+    struct link_stats_bucket *b = &buckets[ctx.head];
+
+    b->turnarounds++;
+    b->turnaround_hist[link_stats_bin(us, LINK_STATS_TURN_MIN_US, LINK_STATS_TURN_BIN_US)]++;
+
+}
+
+/* one report that carried a fresh packet: per-stage times of its oldest packet */
+void link_stats_latency(const uint32_t stage_us[LINK_STAGES - 1]) {
+
+    struct link_stats_bucket *b = &buckets[ctx.head];
+    uint32_t total = 0;
+
+    b->latencies++;
+
+    for (uint8_t i = 0; i < LINK_STAGES - 1; i++) {
+        b->latency_hist[i][link_stats_log2_bin(stage_us[i])]++;
+        total += stage_us[i];
+    }
+    b->latency_hist[LINK_STAGE_TOTAL][link_stats_log2_bin(total)]++;
+
+}
+
+/* close the current bucket, the oldest one drops out of the window */
+void link_stats_tick(uint32_t period_ms) {
+
+    ctx.period_ms = period_ms;
+    ctx.head      = (ctx.head + 1) % LINK_STATS_BUCKETS;
+
+    if (ctx.filled < LINK_STATS_BUCKETS - 1) {
+        ctx.filled++;
+    }
+
+    my_memset(&buckets[ctx.head], 0, sizeof(buckets[ctx.head]));
+
+}
+
+void link_stats_reset(void) {
+
+    my_memset(buckets, 0, sizeof(buckets));
+    ctx.head         = 0;
+    ctx.filled       = 0;
+    ctx.have_seq     = 0;
+    ctx.crc_since_ok = 0;
+
+}
+
+/* sum the window up, the result stays valid until the next call */
+const struct link_stats_report *link_stats_read(void) {
+
+    my_memset(&report, 0, sizeof(report));
+
+    for (uint8_t i = 0; i < LINK_STATS_BUCKETS; i++) {
+
+        const struct link_stats_bucket *b = &buckets[i];
+
+        report.rx_ok       += b->rx_ok;
+        report.rx_crc_err  += b->rx_crc_err;
+        report.missed      += b->missed;
+        report.resync      += b->resync;
+        report.turnarounds += b->turnarounds;
+
+        for (uint8_t j = 0; j < LINK_STATS_HIST_BINS; j++) {
+            report.rssi_hist[j]       += b->rssi_hist[j];
+            report.turnaround_hist[j] += b->turnaround_hist[j];
+        }
+    }
+
+    /* the head bucket is still filling, count it as a whole period */
+    report.window_ms = (ctx.filled + 1) * ctx.period_ms;
+
+    link_stats_fill_pct(&report.rssi, report.rssi_hist, report.rx_ok,
+                        LINK_STATS_RSSI_MIN, LINK_STATS_RSSI_BIN);
+    link_stats_fill_pct(&report.turnaround, report.turnaround_hist, report.turnarounds,
+                        LINK_STATS_TURN_MIN_US, LINK_STATS_TURN_BIN_US);
+
+    return &report;
+}
+
+const struct link_stats_latency_report *link_stats_read_latency(void) {
+
+    my_memset(&latency_report, 0, sizeof(latency_report));
+
+    for (uint8_t i = 0; i < LINK_STATS_BUCKETS; i++) {
+
+        const struct link_stats_bucket *b = &buckets[i];
+
+        latency_report.samples += b->latencies;
+
+        for (uint8_t st = 0; st < LINK_STAGES; st++) {
+            for (uint8_t j = 0; j < LINK_STATS_HIST_BINS; j++) {
+                latency_report.hist[st][j] += b->latency_hist[st][j];
+            }
+        }
+    }
+
+    latency_report.window_ms = (ctx.filled + 1) * ctx.period_ms;
+
+    for (uint8_t st = 0; st < LINK_STAGES; st++) {
+        link_stats_fill_pct(&latency_report.stage[st], latency_report.hist[st],
+                            latency_report.samples, 0, 0);
+    }
+
+    return &latency_report;
+}
+
+/* note 1 : link statistics
+ *
+ *          the window is a ring of LINK_STATS_BUCKETS buckets, one per telemetry
+ *          tick (TIMER2, 100ms), so a read always covers the last ~1s and a burst
+ *          of interference ages out on its own instead of being diluted by a
+ *          long-running total.
+ *
+ *          missed slots come from the mouse's per-slot sequence number: a gap of
+ *          n between two good packets is n-1 slots, minus the ones that did arrive
+ *          but failed CRC. packets whose address never matched don't reach
+ *          radio_isr at all, this is the only way to see them.
+ *
+ *          turnaround is timestamped in hw (PPI: RADIO END/ADDRESS -> TIMER2
+ *          CAPTURE), so it includes the radio_isr entry latency and the TX ramp-up,
+ *          i.e. everything the mouse's RX window has to allow for.
+ *
+ *          the histograms have fixed bins (LINK_STATS_*_MIN/_BIN); percentiles
+ *          are resolved to the bin's upper edge, so they err on the pessimistic side.
+ *
+ * note 2 : motion latency
+ *
+ *          per HID report that carried a fresh packet, the age of its oldest packet
+ *          is split into stages:
+ *
+ *            SENSOR  burst completion -> TX start, measured by the mouse and sent
+ *                    along as `sensor_us`
+ *            AIR     TX start -> radio_isr: on-air time from the packet length plus
+ *                    END -> isr entry (TIMER2)
+ *            QUEUE   radio_isr -> ep1 armed: waiting on an unread report or the
+ *                    report interval gate (TIMER0)
+ *            POLL    ep1 armed -> host IN (TIMER0)
+ *
+ *          the stages span a few us to tens of ms, so these use log2 bins.
+ *          packets left over after a clamped report are rebased to the IN in
+ *          between (dongle.c note 3), QUEUE is a lower bound for those.
+ */
@@ -1,11 +1,13 @@
 /********************************************************************
  ** file         : startup.c
- ** description  : copy .data, zero .bss, branch to main()
+ ** description  : copy .data and .ramfunc, zero .bss, branch to main()
  **
  **
  ********************************************************************/
 
 #include <stdint.h>
+#include "device.h"
+#include "utils.h"
 
 #define APPROTECT_DISABLE   *((volatile uint32_t *) 0x40000558)
 
@@ -14,21 +16,25 @@ extern uint32_t _estack;
 extern uint32_t _etext;
 extern uint32_t _sdata;
 extern uint32_t _edata;
+extern uint32_t _siramfunc;
+extern uint32_t _sramfunc;
+extern uint32_t _eramfunc;
 extern uint32_t _sbss;
 extern uint32_t _ebss;
 
 void reset_handler(void) {
 
-    uint32_t *src = &_etext;
-    uint32_t *dst = &_sdata;
-    while (dst < &_edata) {
-        *dst++ = *src++;
-    }
+    /* whatever stays in flash: cache hits skip the wait states */
+    NVMC->ICACHECNF = NVMC_ICACHECNF_CACHEEN_Enabled
+    #if ISR_PROF
+                    | NVMC_ICACHECNF_CACHEPROFEN_Enabled
+    #endif
+                    ;
 
-    dst = &_sbss;
-    while (dst < &_ebss) {
-        *dst++ = 0;
-    }
+    /* word/LDM-STM copies, utils.c note 1 */
+    my_memcpy(&_sdata, &_etext, (uint8_t *) &_edata - (uint8_t *) &_sdata);
+    my_memcpy(&_sramfunc, &_siramfunc, (uint8_t *) &_eramfunc - (uint8_t *) &_sramfunc);
+    my_memset(&_sbss, 0, (uint8_t *) &_ebss - (uint8_t *) &_sbss);
 
     /* pre_main() ? */
     APPROTECT_DISABLE = 0x5A;
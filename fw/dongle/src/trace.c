@@ -0,0 +1,169 @@
+/********************************************************************
+ ** file         : trace.c
+ ** description  : deferred binary trace
+ **
+ **                built into both firmwares, the clock,
+ **                ring size and drain mode live in each firmware's
+ **                trace.h, the events in trace_events.h
+ **
+ ********************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "device.h"
+#include "utils.h"
+#include "trace.h"
+
+#if TRACE_RTT
+#include "SEGGER_RTT.h"
+#endif
+
+#if DBG >= 1
+
+#define TRACE_LINE_LEN  34              /* '#', 4 x 8 hex digits, '\n'      */
+#define TRACE_MASK      (TRACE_RECORDS - 1)
+
+struct trace trace;
+
+void trace_init(void) {
+
+    my_memset(&trace, 0, sizeof(trace));
+    trace.magic       = TRACE_MAGIC;
+    trace.records     = TRACE_RECORDS;
+    trace.record_size = sizeof(struct trace_record);
+    trace.tick_hz     = TRACE_TICK_HZ;
+
+    TRACE_CLOCK_INIT();
+
+}
+
+/* any priority, see note 1 */
+void trace_write(uint32_t id_a0, uint32_t a1, uint32_t a2) {
+
+    uint32_t primask = irq_save();
+
+    #if TRACE_RTT
+    if (trace.head - trace.tail >= TRACE_RECORDS) {
+        trace.dropped++;
+        irq_restore(primask);
+        return;
+    }
+    #endif
+
+    struct trace_record *r = &trace.rec[trace.head & TRACE_MASK];
+    r->ts    = TRACE_NOW();
+    r->id_a0 = id_a0;
+    r->a1    = a1;
+    r->a2    = a2;
+    trace.head++;
+
+    irq_restore(primask);
+}
+
+#if TRACE_RTT
+
+static void trace_hex(char *dst, uint32_t val) {
+
+    static const char digits[] = "0123456789ABCDEF";
+
+    for (int8_t i = 7; i >= 0; i--) {
+        dst[i] = digits[val & 0xF];
+        val  >>= 4;
+    }
+}
+
+static void trace_send(const struct trace_record *r) {
+
+    char line[TRACE_LINE_LEN];
+
+    line[0] = '#';
+    trace_hex(&line[1],  r->ts);
+    trace_hex(&line[9],  r->id_a0);
+    trace_hex(&line[17], r->a1);
+    trace_hex(&line[25], r->a2);
+    line[TRACE_LINE_LEN - 1] = '\n';
+
+    SEGGER_RTT_Write(0, line, sizeof(line));
+}
+
+/* thread mode only. stops early rather than let RTT skip half a line */
+void trace_drain(void) {
+
+    for (;;) {
+
+        while (trace.tail != trace.head) {
+
+            if (SEGGER_RTT_GetAvailWriteSpace(0) < TRACE_LINE_LEN) {
+                return;
+            }
+
+            trace_send(&trace.rec[trace.tail & TRACE_MASK]);
+            trace.tail++;
+        }
+
+        if (!trace.dropped || (SEGGER_RTT_GetAvailWriteSpace(0) < TRACE_LINE_LEN)) {
+            return;
+        }
+
+        /* the drops came after whatever the ring holds now: that goes
+         * out first, or the marker's stamp runs backwards (note 1)
+         */
+        uint32_t primask = irq_save();
+        if (trace.tail != trace.head) {
+            irq_restore(primask);
+            continue;
+        }
+        struct trace_record r = {
+            .ts    = TRACE_NOW(),
+            .id_a0 = TR_DROPPED | (trace.dropped << 8),
+            .a1    = 0,
+            .a2    = 0,
+        };
+        trace.dropped = 0;
+        irq_restore(primask);
+
+        trace_send(&r);
+        return;
+    }
+}
+
+/* what trace_drain() would send now, the main loop's check before wfi */
+uint8_t trace_pending(void) {
+    return (trace.tail != trace.head || trace.dropped) &&
+           (SEGGER_RTT_GetAvailWriteSpace(0) >= TRACE_LINE_LEN);
+}
+
+#else
+
+/* flight recorder, read with a debugger */
+void trace_drain(void) {
+}
+
+uint8_t trace_pending(void) {
+    return 0;
+}
+
+#endif
+
+#endif
+
+/* note 1 : deferred trace
+ *
+ *          SEGGER_RTT_printf() from an isr costs tens of us of formatting and
+ *          a locked copy into the RTT buffer, which is enough to move the radio
+ *          turnaround and the ep0 timing it's supposed to be observing. an event
+ *          here is a PRIMASK-protected copy of four words (~20 cycles).
+ *
+ *          TRACE_RTT (dongle): the drain runs from the main loop and writes each
+ *          record as a hex line (`#` + ts, id|a0, a1, a2), so it survives log.exp's
+ *          telnet capture and mixes with plain printf output. when the drain falls
+ *          behind, new records are dropped and counted, and a TR_DROPPED record is
+ *          sent once the ring is empty again.
+ *
+ *          otherwise (mouse, no RTT): the ring keeps the last TRACE_RECORDS events,
+ *          overwriting the oldest, and the whole `trace` symbol is dumped through
+ *          the debug port (trace.exp) without stopping the target.
+ *
+ *          tools/trace-decode.c turns dongle captures into text, trace-timeline.c
+ *          puts both firmwares on one Chrome/Perfetto timeline.
+ */
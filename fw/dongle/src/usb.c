@@ -7,20 +7,26 @@
 
 #include <stdint.h>
 #include <stddef.h>
-#include <stdatomic.h>
 #include "device.h"
 #include "utils.h"
 #include "usb.h"
 #include "usb_ep0.h"
-
-#include "SEGGER_RTT.h"
+#include "trace.h"
 
 static void usbd_errata_no187(void);
 static void usbd_errata_no199(uint8_t start);
 
+/* one pending easyDMA xfer per endpoint and direction, see note 1 */
+struct usb_dma_xfer {
+    void    *buf;
+    uint16_t len;
+    uint8_t  queued;
+};
+
 static usb_device nrf_usbfs_dev;
 static uint8_t dma_buf[MAX_CIB_PACKET_SIZE];
-static atomic_flag dma_busy = ATOMIC_FLAG_INIT;
+static volatile uint8_t dma_busy = 0;
+static struct usb_dma_xfer dma_queue[2][MAX_ENDPOINTS];   /* [dir][ep] */
 
 void usb_enable_isr(void) {
     NVIC->ISER[NVIC_USBD_IRQ / 32] = (1 << (NVIC_USBD_IRQ % 32));
@@ -43,6 +49,11 @@ usb_device * usb_init(const struct usb_device_descriptor *dev_desc,
     usb_dev->user_ctr_callback[0][USB_TRANSACTION_IN]    = usb_ep0_in;
 
     usb_dev->user_set_config_callback = NULL;
+    usb_dev->user_suspend_callback    = NULL;
+    usb_dev->suspended                = 0;
+
+    usb_dev->dma_stats.queued  = 0;
+    usb_dev->dma_stats.dropped = 0;
 
     for (int i = 0; i < MAX_USER_EP0_REQ_HANDLER; i++) {
         usb_dev->user_ep0_req_handler[i].cb = NULL;
@@ -55,19 +66,21 @@ void usb_start(usb_device *dev) {
 
     (void)dev;
 
-    /* verify VBUS */
-    while (!(POWER->EVENTS_USBDETECTED));
+    /* verify VBUS, the status rather than the event: a POWER isr
+     * may have taken that already
+     */
+    while (!(POWER->USBREGSTATUS & POWER_USBREGSTATUS_VBUSDETECT_));
     
     /* enable peripheral */
     usbd_errata_no187();
 
     /* verify usb phy power */
-    while (!(POWER->EVENTS_USBPWRRDY));
+    while (!(POWER->USBREGSTATUS & POWER_USBREGSTATUS_OUTPUTRDY_));
 
     /* enable interrupts */
     USBD->INTENSET = USBD_INTEN_USBRESET_  | USBD_INTEN_EP0DATADONE_ |
                      USBD_INTEN_EP0SETUP_  | USBD_INTEN_EPDATA_      |
-                     USBD_INTEN_ENDEP_;
+                     USBD_INTEN_ENDEP_     | USBD_INTEN_USBEVENT_;
 
     /* present FS device */
     USBD->USBPULLUP = 1;
@@ -76,10 +89,9 @@ void usb_start(usb_device *dev) {
 
 void usb_stop(usb_device *dev) {
 
-    (void)dev;
-
     /* disable interrupts */
     USBD->INTEN = 0x0;
+    dev->suspended = 0;
 
     /* disable peripheral */
     USBD->ENABLE = 0;
@@ -124,9 +136,7 @@ void usb_ep_set_stall(usb_device *dev, uint8_t addr) {
 
     USBD->TASKS_EP0STALL = 1;
 
-    #if DBG >= 1
-    SEGGER_RTT_printf(0, "TASKS_EP0STALL = 1\n");
-    #endif
+    TRACE(TR_USB_EP0STALL);
 
 }
 
@@ -155,9 +165,7 @@ void usb_prepare_for_status(usb_device *dev, uint8_t dir) {
 
     USBD->TASKS_EP0STATUS = 1;
 
-    #if DBG >= 1
-    SEGGER_RTT_printf(0, "TASKS_EP0STATUS = 1\n");
-    #endif
+    TRACE(TR_USB_EP0STATUS);
 
     if (dev->ep0.req_cmpl) {
         dev->ep0.req_cmpl(dev, &dev->ep0.req);
@@ -187,51 +195,118 @@ void usb_set_device_address(usb_device *dev, uint8_t addr) {
 
 }
 
-uint16_t usb_ep_write_packet(usb_device *dev, uint8_t addr, const void *buf, uint16_t len) {
+static void usb_dma_start(uint8_t dir, uint8_t ep, void *buf, uint16_t len) {
 
-    (void)dev;
-    uint8_t ep = addr & 0x7F;
+    if (dir == 1) {
 
-    /* only 1 dma xfer at a time (see note 1) */
-    if (atomic_flag_test_and_set(&dma_busy)) {
-        return 0xFFFF;
-    }
+        if (buf < (void *) 0x100000) {
+            /* buf in FLASH, must copy to RAM */
+            my_memcpy(dma_buf, buf, len);
+            buf = dma_buf;
+        }
 
-    if (buf < (void *) 0x100000) {
-        /* buf in FLASH, must copy to RAM */
-        my_memcpy(dma_buf, buf, len);
-        USBD->EPIN[ep].PTR    = (uint32_t) dma_buf;
+        USBD->EPIN[ep].PTR    = (uint32_t) buf;
         USBD->EPIN[ep].MAXCNT = len;
+
+        usbd_errata_no199(1);
+        USBD->TASKS_STARTEPIN[ep] = 1;
     }
     else {
-        /* buf already in RAM */
-        USBD->EPIN[ep].PTR    = (uint32_t) buf;
-        USBD->EPIN[ep].MAXCNT = len;
+
+        USBD->EPOUT[ep].PTR    = (uint32_t) buf;
+        USBD->EPOUT[ep].MAXCNT = len;
+
+        usbd_errata_no199(1);
+        USBD->TASKS_STARTEPOUT[ep] = 1;
     }
 
-    usbd_errata_no199(1);
+}
+
+static uint16_t usb_dma_submit(usb_device *dev, uint8_t dir, uint8_t ep, void *buf, uint16_t len) {
+
+    uint32_t primask = irq_save();
+
+    /* only 1 dma xfer at a time (see note 1) */
+    if (!dma_busy) {
+        dma_busy = 1;
+        irq_restore(primask);
+        usb_dma_start(dir, ep, buf, len);
+        return len;
+    }
 
-    USBD->TASKS_STARTEPIN[ep] = 1;
+    struct usb_dma_xfer *xfer = &dma_queue[dir][ep];
+
+    if (xfer->queued) {
+        /* ep already has an xfer waiting: refuse this one */
+        dev->dma_stats.dropped++;
+        irq_restore(primask);
+        return 0xFFFF;
+    }
+
+    xfer->buf    = buf;
+    xfer->len    = len;
+    xfer->queued = 1;
+    dev->dma_stats.queued++;
+
+    irq_restore(primask);
     return len;
 }
 
-uint16_t usb_ep_read_packet(usb_device *dev, uint8_t addr, void *buf, uint16_t len) {
+/* called on ENDEPIN/ENDEPOUT: start the next queued xfer, if any.
+ * ep1..7 go first so HID data never waits behind an ep0 descriptor
+ */
+static void usb_dma_next(void) {
 
-    (void)dev;
-    uint8_t ep = addr & 0x7F;
+    uint32_t primask = irq_save();
 
-    if (atomic_flag_test_and_set(&dma_busy)) { 
-        return 0xFFFF;
+    dma_busy = 0;
+
+    for (uint8_t i = 1; i <= MAX_ENDPOINTS; i++) {
+
+        uint8_t ep = i % MAX_ENDPOINTS;
+
+        for (uint8_t d = 0; d < 2; d++) {
+
+            uint8_t dir = 1 - d;    /* IN before OUT */
+            struct usb_dma_xfer *xfer = &dma_queue[dir][ep];
+            if (!xfer->queued) {
+                continue;
+            }
+
+            xfer->queued = 0;
+            dma_busy = 1;
+            irq_restore(primask);
+
+            usb_dma_start(dir, ep, xfer->buf, xfer->len);
+            return;
+        }
     }
 
-    len = MIN(USBD->SIZE.EPOUT[ep], len);
-    USBD->EPOUT[ep].PTR    = (uint32_t) buf;
-    USBD->EPOUT[ep].MAXCNT = len;
+    irq_restore(primask);
+}
 
-    usbd_errata_no199(1);
+static void usb_dma_flush(void) {
 
-    USBD->TASKS_STARTEPOUT[ep] = 1;
-    return len;
+    for (uint8_t ep = 0; ep < MAX_ENDPOINTS; ep++) {
+        dma_queue[0][ep].queued = 0;
+        dma_queue[1][ep].queued = 0;
+    }
+    dma_busy = 0;
+}
+
+uint16_t usb_ep_write_packet(usb_device *dev, uint8_t addr, const void *buf, uint16_t len) {
+
+    uint8_t ep = addr & 0x7F;
+
+    return usb_dma_submit(dev, 1, ep, (void *) buf, len);
+}
+
+uint16_t usb_ep_read_packet(usb_device *dev, uint8_t addr, void *buf, uint16_t len) {
+
+    uint8_t ep = addr & 0x7F;
+
+    len = MIN(USBD->SIZE.EPOUT[ep], len);
+    return usb_dma_submit(dev, 0, ep, buf, len);
 }
 
 void usb_reset_endpoints(usb_device *dev) {
@@ -246,14 +321,83 @@ void usb_reset_endpoints(usb_device *dev) {
      */
 }
 
+/* bus back from a suspend: host resume, our remote wakeup or a reset */
+static void usb_bus_resumed(usb_device *dev) {
+
+    if (!dev->suspended) {
+        return;
+    }
+
+    USBD->LOWPOWER = USBD_LOWPOWER_LOWPOWER_ForceNormal;
+    dev->suspended = 0;
+
+    if (dev->user_suspend_callback) {
+        dev->user_suspend_callback(dev, 0);
+    }
+}
+
+/* USBEVENT: suspend, resume and the go-ahead for remote wakeup (note 3) */
+static void usb_bus_event(usb_device *dev) {
+
+    uint32_t cause = USBD->EVENTCAUSE & (USBD_EVENTCAUSE_SUSPEND_ |
+                                         USBD_EVENTCAUSE_RESUME_  |
+                                         USBD_EVENTCAUSE_USBWUALLOWED_);
+    USBD->EVENTCAUSE = cause;
+
+    if ((cause & USBD_EVENTCAUSE_SUSPEND_) && !dev->suspended) {
+
+        TRACE(TR_USB_SUSPEND);
+
+        dev->suspended = 1;
+        USBD->LOWPOWER = USBD_LOWPOWER_LOWPOWER_LowPower;
+
+        if (dev->user_suspend_callback) {
+            dev->user_suspend_callback(dev, 1);
+        }
+    }
+
+    if (cause & USBD_EVENTCAUSE_RESUME_) {
+
+        TRACE(TR_USB_RESUME);
+
+        usb_bus_resumed(dev);
+    }
+
+    /* out of LOWPOWER for usb_remote_wakeup(), unless the host got there first */
+    if ((cause & USBD_EVENTCAUSE_USBWUALLOWED_) && dev->suspended) {
+
+        TRACE(TR_USB_WAKEUP);
+
+        USBD->DPDMVALUE       = USBD_DPDMVALUE_STATE_Resume;
+        USBD->TASKS_DPDMDRIVE = 1;
+
+        usb_bus_resumed(dev);
+    }
+}
+
+/* wake the host, if it allowed it. returns 0 if it didn't, or the
+ * bus isn't suspended. the resume itself starts on USBWUALLOWED
+ */
+int usb_remote_wakeup(usb_device *dev) {
+
+    if (!dev->suspended || !(dev->status & USB_STATUS_REMOTE_WAKEUP)) {
+        return 0;
+    }
+
+    USBD->LOWPOWER = USBD_LOWPOWER_LOWPOWER_ForceNormal;
+    return 1;
+}
+
 static void usb_reset(usb_device * dev) {
 
-    /* default state */
+    /* default state, remote wakeup off (9.4.5) */
     dev->configured = 0;
+    dev->status    &= ~USB_STATUS_REMOTE_WAKEUP;
+    usb_bus_resumed(dev);
 
-    /* in case reset interrupted dma */
+    /* in case reset interrupted dma, anything queued is stale */
     usbd_errata_no199(0);
-    atomic_flag_clear(&dma_busy);
+    usb_dma_flush();
 
     /* ep0 is set up by default, and hw already handles
      * setting DADDR back to 0 and everything..
@@ -263,7 +407,7 @@ static void usb_reset(usb_device * dev) {
 
 }
 
-void usb_handle_event(usb_device *dev) {
+RAMFUNC void usb_handle_event(usb_device *dev) {
 
     uint32_t events = 0;
     volatile uint32_t *events_reg = &USBD->EVENTS_USBRESET;
@@ -277,20 +421,20 @@ void usb_handle_event(usb_device *dev) {
 
     if (events & USBD_INTEN_ENDEP_) {
 
-        #if DBG >= 1
-        SEGGER_RTT_printf(0, "ENDEP\n");
-        #endif
+        TRACE(TR_USB_ENDEP);
 
         usbd_errata_no199(0);
-        atomic_flag_clear(&dma_busy);
+        usb_dma_next();
         
     }
 
+    if (events & USBD_INTEN_USBEVENT_) {
+        usb_bus_event(dev);
+    }
+
     if (events & USBD_INTEN_USBRESET_) {
 
-        #if DBG >= 1
-        SEGGER_RTT_printf(0, "RESET\n");
-        #endif
+        TRACE(TR_USB_RESET);
 
         usb_reset(dev);
         return;
@@ -298,9 +442,7 @@ void usb_handle_event(usb_device *dev) {
 
     if (events & USBD_INTEN_EP0DATADONE_) {
 
-        #if DBG >= 1
-        SEGGER_RTT_printf(0, "EP0DATADONE\n");
-        #endif
+        TRACE(TR_USB_EP0DATADONE);
 
         uint8_t stage = dev->ep0.stage;
 
@@ -311,18 +453,14 @@ void usb_handle_event(usb_device *dev) {
             dev->user_ctr_callback[0][USB_TRANSACTION_OUT] (dev, 0);
         }
         else {
-            #if DBG >= 1
-            SEGGER_RTT_printf(0, "stage: %d\n", stage);
-            #endif
+            TRACE(TR_USB_EP0_STAGE, stage);
         }
         
     }
 
     if (events & USBD_INTEN_EPDATA_) {
 
-        #if DBG >= 1
-        SEGGER_RTT_printf(0, "EPDATA\n");
-        #endif
+        TRACE(TR_USB_EPDATA);
 
         uint32_t data_status = USBD->EPDATASTATUS;
 
@@ -340,9 +478,7 @@ void usb_handle_event(usb_device *dev) {
 
     if (events & USBD_INTEN_EP0SETUP_) {
 
-        #if DBG >= 1
-        SEGGER_RTT_printf(0, "EP0SETUP\n");
-        #endif
+        TRACE(TR_USB_EP0SETUP);
 
         dev->ep0.req.bmRequestType  = USBD->BMREQUESTTYPE;
         dev->ep0.req.bRequest       = USBD->BREQUEST;
@@ -357,7 +493,9 @@ void usb_handle_event(usb_device *dev) {
 
 static void usbd_errata_no187(void) {
 
-    /* nrf52840 rev. 3 errata v1.3
+    /* nrf52840 rev. 3 errata v1.3, and the
+     * nrf52820's anomaly 187 (wired.c), same
+     * registers and workaround
      * conditions:
      *      most recent reset is soft, like
      *      after flashing new firmware
@@ -382,7 +520,9 @@ static void usbd_errata_no187(void) {
 
 static void usbd_errata_no199(uint8_t start) {
 
-    /* nrf52840 rev. 3 errata v1.3
+    /* nrf52840 rev. 3 errata v1.3, and the
+     * nrf52820's anomaly 199 (wired.c), same
+     * register and workaround
      * conditions:
      *      easyDMA xfer is in progress
      * symptoms:
@@ -401,7 +541,7 @@ static void usbd_errata_no199(uint8_t start) {
     }
 }
 
-/* note 1 : `dma_busy` 
+/* note 1 : `dma_busy` / `dma_queue`
  *
  *          PS1.11 p.856 states that "only a single EasyDMA transfer can take place
  *          in USBD at any time"..
@@ -409,13 +549,41 @@ static void usbd_errata_no199(uint8_t start) {
  *          as such, we consult `dma_busy` before starting any EPIN/OUT task.
  *          it gets set when `TASKS_STARTEPIN/OUT` is called and cleared upon
  *          receiving any `ENDEPIN/OUT` event.
- * 
- *          atomic in case someone uses write/read from both thread/isr context.. 
+ *
+ *          writes/reads that find the dma busy used to be refused with 0xFFFF,
+ *          which callers ignored, so an ep0 descriptor xfer could silently eat a
+ *          mouse report. now each endpoint/direction can park one xfer in
+ *          `dma_queue`, started from `usb_dma_next()` on the next ENDEP with
+ *          ep1..7 ahead of ep0. only a second xfer for an endpoint that already
+ *          has one waiting is refused; those land in `dev->dma_stats.dropped`.
+ *
+ *          the busy check and queue are updated with interrupts masked in case
+ *          someone uses write/read from both thread/isr context..
  * 
  * note 2 : RTT_printf vs. RTT_WriteString
  * 
  *          changing all eligible printfs to WriteString resulted in the same code size
  *          (-Os), so I just kept the printfs
  * 
+ * note 3 : suspend, resume, remote wakeup
+ *
+ *          3ms of idle bus is a suspend: USBEVENT with EVENTCAUSE SUSPEND. the
+ *          USBD goes to LOWPOWER and the user callback gets 1, the device then
+ *          has to stay under 2.5mA (USB_20 7.2.3) until the bus comes back,
+ *          which it does one of three ways, each ending in usb_bus_resumed():
+ *          LOWPOWER off and the callback with 0.
+ *
+ *            host resume   EVENTCAUSE RESUME, the host's K on the lines
+ *            bus reset     USBRESET, usb_reset() goes through it too
+ *            our wakeup    usb_remote_wakeup() takes the USBD out of LOWPOWER,
+ *                          on USBWUALLOWED it drives resume (K) with
+ *                          DPDMVALUE/DPDMDRIVE, the hw times it
+ *
+ *          the same order nrfx_usbd uses. remote wakeup needs the host's
+ *          SET_FEATURE(DEVICE_REMOTE_WAKEUP), which usb_ep0.c only takes with
+ *          USB_CFG_ATTR_REMOTE_WAKEUP in bmAttributes, and which a reset
+ *          clears. the host's own resume follows ours within 1ms and lasts
+ *          at least 20ms, ep traffic starts after that. the USBD needs the
+ *          crystal out of LOWPOWER, the user callback stops and starts it.
  */
 
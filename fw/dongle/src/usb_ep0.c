@@ -20,8 +20,7 @@
 #include "utils.h"
 #include "usb.h"
 #include "usb_ep0.h"
-
-#include "SEGGER_RTT.h"
+#include "trace.h"
 
 /* ----------------------------------------------------------------------------------- */
 /* --- USB STANDARD REQUEST HANDLERS (device, interface, endpoint) ------------------- */
@@ -38,6 +37,30 @@ usb_std_req_device_get_status(usb_device *dev, struct usb_setup_data *req,
     return USB_REQ_HANDLED;
 }
 
+/* 9.4.1/9.4.9: remote wakeup is the only device feature a full speed
+ * device has, and only if the configuration says so
+ */
+static enum usb_req_result
+usb_std_req_device_feature(usb_device *dev, struct usb_setup_data *req, 
+                           uint8_t **buf, uint16_t *len) {
+    (void)buf;
+    (void)len;
+
+    if ((req->wValue != USB_FEAT_DEVICE_REMOTE_WAKEUP) ||
+        !(dev->config->bmAttributes & USB_CFG_ATTR_REMOTE_WAKEUP)) {
+        return USB_REQ_ERR;
+    }
+
+    if (req->bRequest == USB_REQ_SET_FEATURE) {
+        dev->status |= USB_STATUS_REMOTE_WAKEUP;
+    }
+    else {
+        dev->status &= ~USB_STATUS_REMOTE_WAKEUP;
+    }
+
+    return USB_REQ_HANDLED;
+}
+
 static enum usb_req_result
 usb_std_req_device_set_address(usb_device *dev, struct usb_setup_data *req, 
                                 uint8_t **buf, uint16_t *len) {
@@ -136,6 +159,38 @@ usb_std_req_device_set_configuration(usb_device *dev, struct usb_setup_data *req
     return USB_REQ_HANDLED;
 }
 
+static enum usb_req_result
+usb_std_req_interface_get_interface(usb_device *dev, struct usb_setup_data *req, 
+                                     uint8_t **buf, uint16_t *len) {
+
+    /* no interface has alternate settings, see note 4 */
+    static uint8_t alt_setting = 0;
+
+    if (!dev->configured || (req->wIndex >= dev->config->bNumInterfaces)) {
+        return USB_REQ_ERR;
+    }
+
+    *buf = &alt_setting;
+    *len = MIN(*len, sizeof(alt_setting));
+
+    return USB_REQ_HANDLED;
+}
+
+static enum usb_req_result
+usb_std_req_interface_set_interface(usb_device *dev, struct usb_setup_data *req, 
+                                     uint8_t **buf, uint16_t *len) {
+
+    (void)buf;
+    (void)len;
+
+    if (!dev->configured || (req->wIndex >= dev->config->bNumInterfaces)) {
+        return USB_REQ_ERR;
+    }
+
+    /* alternate setting 0 is the only one we have */
+    return (req->wValue == 0) ? USB_REQ_HANDLED : USB_REQ_ERR;
+}
+
 /* --- STANDARD REQUEST HANDLER ------------------------------------------------------ */
 
 static enum usb_req_result
@@ -156,8 +211,8 @@ usb_std_req_handler(usb_device *dev, struct usb_setup_data *req,
 
             case USB_REQ_CLEAR_FEATURE:
             case USB_REQ_SET_FEATURE:
-                /* only used for remote wakeup/test mode - not supported here */
-                return USB_REQ_ERR;
+                /* remote wakeup, test mode is high speed only */
+                return usb_std_req_device_feature(dev, req, buf, len);
 
             case USB_REQ_SET_ADDRESS:
                 return usb_std_req_device_set_address(dev, req, buf, len);
@@ -183,11 +238,15 @@ usb_std_req_handler(usb_device *dev, struct usb_setup_data *req,
     case USB_REQ_TYPE_INTERFACE:
 
         switch (req->bRequest) {
+            case USB_REQ_GET_INTERFACE:
+                return usb_std_req_interface_get_interface(dev, req, buf, len);
+
+            case USB_REQ_SET_INTERFACE:
+                return usb_std_req_interface_set_interface(dev, req, buf, len);
+
             case USB_REQ_GET_STATUS:
             case USB_REQ_CLEAR_FEATURE:
             case USB_REQ_SET_FEATURE:
-            case USB_REQ_GET_INTERFACE:
-            case USB_REQ_SET_INTERFACE:
             default:
                 /* not yet implemented */
                 return USB_REQ_ERR;
@@ -283,10 +342,8 @@ void usb_ep0_setup(usb_device *dev, uint8_t ep) {
     usb_setup_acked(dev);
     struct usb_setup_data *req = &(dev->ep0.req);
 
-    #if DBG >= 1
-    SEGGER_RTT_printf(0, "bmRequestType: x%02X  bRequest: %03d  wValue: x%04X  wIndex: x%04X  wLength: x%04X\n", 
-                      req->bmRequestType, req->bRequest, req->wValue, req->wIndex, req->wLength);
-    #endif
+    TRACE(TR_EP0_REQ, req->bmRequestType, req->bRequest, req->wValue);
+    TRACE(TR_EP0_REQ_LEN, req->wIndex, req->wLength);
 
     if ((req->wLength == 0) || (req->bmRequestType & USB_REQ_TYPE_IN)) {
 
@@ -339,18 +396,14 @@ void usb_ep0_in(usb_device *dev, uint8_t ep) {
 
         case USB_DATA_IN:
 
-            #if DBG >= 1
-            SEGGER_RTT_printf(0, "    DATA_IN\n");
-            #endif
+            TRACE(TR_EP0_DATA_IN);
 
             usb_ep0_data_in(dev);
             break;
         
         case USB_LAST_DATA_IN:
 
-            #if DBG >= 1
-            SEGGER_RTT_printf(0, "    LAST_DATA_IN\n");
-            #endif
+            TRACE(TR_EP0_LAST_DATA_IN);
 
             usb_prepare_for_status(dev, USB_STATUS_OUT);
             dev->ep0.stage = USB_STATUS_OUT;
@@ -358,9 +411,7 @@ void usb_ep0_in(usb_device *dev, uint8_t ep) {
 
         case USB_STATUS_IN:
 
-            #if DBG >= 1
-            SEGGER_RTT_printf(0, "    STATUS_IN\n");
-            #endif
+            TRACE(TR_EP0_STATUS_IN);
 
             usb_status_acked(dev, USB_STATUS_IN);
             dev->ep0.stage = USB_IDLE;
@@ -382,9 +433,7 @@ void usb_ep0_out(usb_device *dev, uint8_t ep) {
 
         case USB_STATUS_OUT:
 
-            #if DBG >= 1
-            SEGGER_RTT_printf(0, "    STATUS_OUT\n");
-            #endif
+            TRACE(TR_EP0_STATUS_OUT);
 
             usb_status_acked(dev, USB_STATUS_OUT);
             dev->ep0.stage = USB_IDLE;
@@ -408,6 +457,13 @@ void usb_register_set_config_callback(usb_device *dev, usb_set_config_callback c
     dev->user_set_config_callback = callback;
 }
 
+/* user API for registering a bus suspend/resume callback, e.g., `hid_suspend()`.
+ * 1 on suspend, 0 once the bus is back (usb.c note 3)
+ */
+void usb_register_suspend_callback(usb_device *dev, usb_suspend_callback callback) {
+    dev->user_suspend_callback = callback;
+}
+
 /* user API for registering control request handlers, e.g., `handle_get_hid_report_descriptor()`
  */
 int usb_register_ep0_req_handler(usb_device *dev, uint8_t type, 
@@ -474,4 +530,12 @@ int usb_register_ep0_req_handler(usb_device *dev, uint8_t type,
  *          data stages. so, we force the requested len to be our bmaxPacketSize0, 
  *          such that we send the data in one stage and are ready for the STATUS OUT.
  * 
+ * note 4 : get/set_interface()
+ *
+ *          alternate settings were considered for switching the HID polling rate
+ *          without re-enumerating, but hosts only issue SET_INTERFACE when a driver
+ *          asks for it, and usbhid never does. the dongle decimates reports instead
+ *          (see dongle.c), so every interface only has alternate setting 0 and
+ *          these handlers exist to answer the requests correctly.
+ * 
  */
@@ -1,30 +1,102 @@
 /**********************************************************************************
  ** file            : utils.c
  ** description     : simple implementations of libc functions
- ** 
+ **
+ **                   built into both firmwares (the mouse's Makefile takes
+ **                   it from here), host-built and checked by
+ **                   tools/utils-bench.c
+ **
  **********************************************************************************/
 
 #include <stdint.h>
 #include <stddef.h>
 
-/* simple byte-loop 
+/* word views of byte buffers, see note 1 */
+typedef uint32_t __attribute__((may_alias)) word_t;
+
+struct unaligned_word {
+    uint32_t w;
+} __attribute__((packed, may_alias));
+
+/* bytes up to dest's word boundary, then 4-word blocks, words and
+ * the byte tail (see note 1)
  */
 void *my_memcpy(void *dest, const void *src, size_t len) {
 
     uint8_t *d = dest;
     const uint8_t *s = src;
 
-    while(len--) {
+    while (((uintptr_t) d & 3) && len) {
+        *d++ = *s++;
+        len--;
+    }
+
+    word_t *dw = (word_t *) d;
+
+    if (((uintptr_t) s & 3) == 0) {
+
+        const word_t *sw = (const word_t *) s;
+
+        while (len >= 16) {
+            uint32_t a = sw[0], b = sw[1], c = sw[2], e = sw[3];
+            dw[0] = a; dw[1] = b; dw[2] = c; dw[3] = e;
+            dw += 4;
+            sw += 4;
+            len -= 16;
+        }
+
+        while (len >= 4) {
+            *dw++ = *sw++;
+            len -= 4;
+        }
+
+        s = (const uint8_t *) sw;
+    }
+    else {
+
+        const struct unaligned_word *su = (const struct unaligned_word *) s;
+
+        while (len >= 4) {
+            *dw++ = (su++)->w;
+            len -= 4;
+        }
+
+        s = (const uint8_t *) su;
+    }
+
+    d = (uint8_t *) dw;
+    while (len--) {
         *d++ = *s++;
     }
     return dest;
 }
 
 void *my_memset(void *dest, int c, size_t len) {
-    
+
     uint8_t *p = dest;
+    uint32_t w = (uint8_t) c * 0x01010101u;
+
+    while (((uintptr_t) p & 3) && len) {
+        *p++ = (uint8_t) c;
+        len--;
+    }
+
+    word_t *pw = (word_t *) p;
+
+    while (len >= 16) {
+        pw[0] = w; pw[1] = w; pw[2] = w; pw[3] = w;
+        pw += 4;
+        len -= 16;
+    }
+
+    while (len >= 4) {
+        *pw++ = w;
+        len -= 4;
+    }
+
+    p = (uint8_t *) pw;
     while (len--) {
-        *p++ = (uint8_t)c;
+        *p++ = (uint8_t) c;
     }
     return dest;
 }
@@ -36,4 +108,21 @@ size_t my_strlen(const char *str) {
         s++;
     }
     return s - str;
-}
\ No newline at end of file
+}
+
+/* note 1 : word copies
+ *
+ *          dest is brought to a word boundary with single bytes first. if src is
+ *          then aligned too (the common case: descriptors and buffers are word
+ *          aligned), 4 loads followed by 4 stores per block let gcc emit one
+ *          LDM/STM pair for them, and the remainder goes by words and bytes. a
+ *          src with a different alignment is read with unaligned LDRs, which the
+ *          cortex-m4 does in hardware (CCR.UNALIGN_TRP is left clear), so the
+ *          stores stay aligned.
+ *
+ *          the word types are may_alias: callers pass byte buffers and structs,
+ *          a plain uint32_t * over them would let gcc reorder across the copy.
+ *
+ *          startup.c uses both for .data, .ramfunc and .bss, before any of them
+ *          exist: nothing here touches RAM besides the stack and the arguments.
+ */
@@ -0,0 +1,28 @@
+/***********************************************************************************
+ ** file            : battery.h
+ ** description     : calibrated battery state from the COMP ladder readings
+ **
+ **                   voltage filtered over readings, state of charge from a
+ **                   Li-ion discharge curve, time remaining at the mean
+ **                   current energy.c counts. see battery.c note 1
+ **
+ **********************************************************************************/
+
+#ifndef BATTERY_H
+#define BATTERY_H
+
+#include <stdint.h>
+
+#define BATTERY_STEPS   64      /* COMP TH, VDDH/5 against 1/64ths of 1.2V  */
+
+/* what goes with the energy record, the dongle hands it to the host as is */
+struct battery_status {
+    uint16_t mv;            /* filtered, 0 = no reading yet     */
+    uint8_t  soc;           /* %                                */
+    uint16_t minutes;       /* left at the mean current, saturates */
+} __attribute__((packed));
+
+void battery_reading(uint8_t step);
+void battery_status(struct battery_status *b, uint32_t charge_uc, uint32_t uptime_ms);
+
+#endif
@@ -0,0 +1,24 @@
+/***********************************************************************************
+ ** file            : defer.h
+ ** description     : deferred work, run from a software interrupt
+ **
+ **                   an isr posts fn(arg) with defer() and returns, the queue
+ **                   is drained at the priority given to defer_init()
+ **
+ **********************************************************************************/
+
+#ifndef DEFER_H
+#define DEFER_H
+
+#include <stdint.h>
+
+#define DEFER_DEPTH     16                  /* power of 2                   */
+#define DEFER_IRQ       NVIC_EGU0_SWI0_IRQ
+#define DEFER_ISR       egu0_swi0_isr
+
+typedef void (*defer_fn)(uint32_t arg);
+
+void    defer_init(uint8_t prio);
+uint8_t defer(defer_fn fn, uint32_t arg);
+
+#endif
@@ -293,6 +293,30 @@ typedef struct {
     IO32 CC[6];
 } TIMER_T;
 
+typedef struct {
+    IO32 TASKS_START;
+    IO32 TASKS_STOP;
+    IO32 TASKS_CLEAR;
+    IO32 TASKS_TRIGOVRFLW;
+    IO32 RESERVED[60];
+    IO32 EVENTS_TICK;
+    IO32 EVENTS_OVRFLW;
+    IO32 RESERVED1[14];
+    IO32 EVENTS_COMPARE[4];
+    IO32 RESERVED2[109];
+    IO32 INTENSET;
+    IO32 INTENCLR;
+    IO32 RESERVED3[13];
+    IO32 EVTEN;
+    IO32 EVTENSET;
+    IO32 EVTENCLR;
+    IO32 RESERVED4[110];
+    IO32 COUNTER;
+    IO32 PRESCALER;
+    IO32 RESERVED5[13];
+    IO32 CC[4];
+} RTC_T;
+
 typedef struct {
     IO32 LED;
     IO32 A;
@@ -480,6 +504,41 @@ typedef struct {
     IO32 PIN_CNF[32];
 } GPIO_T;
 
+typedef struct {
+    IO32 EEP;
+    IO32 TEP;
+} PPI_CH_T;
+
+typedef struct {
+    IO32 TASKS_CHG[12];
+    IO32 RESERVED[308];
+    IO32 CHEN;
+    IO32 CHENSET;
+    IO32 CHENCLR;
+    IO32 RESERVED1;
+    PPI_CH_T CH[20];
+} PPI_T;
+
+typedef struct {
+    IO32 RESERVED[256];
+    IO32 READY;
+    IO32 RESERVED1;
+    IO32 READYNEXT;
+    IO32 RESERVED2[62];
+    IO32 CONFIG;
+    IO32 ERASEPAGE;
+    IO32 ERASEALL;
+    IO32 ERASEPCR0;
+    IO32 ERASEUICR;
+    IO32 ERASEPAGEPARTIAL;
+    IO32 ERASEPAGEPARTIALCFG;
+    IO32 RESERVED3[8];
+    IO32 ICACHECNF;
+    IO32 RESERVED4;
+    IO32 IHIT;
+    IO32 IMISS;
+} NVMC_T;
+
 typedef struct {
     IO32 ISER[8];
     IO32 RESERVED0[24];
@@ -496,6 +555,24 @@ typedef struct {
     IO32 STIR;
 } NVIC_T;
 
+typedef struct {
+    IO32 DHCSR;
+    IO32 DCRSR;
+    IO32 DCRDR;
+    IO32 DEMCR;
+} COREDEBUG_T;
+
+typedef struct {
+    IO32 CTRL;
+    IO32 CYCCNT;
+    IO32 CPICNT;
+    IO32 EXCCNT;
+    IO32 SLEEPCNT;
+    IO32 LSUCNT;
+    IO32 FOLDCNT;
+    IO32 PCSR;
+} DWT_T;
+
 /* --- BITFIELDS --------------------------------------------------------------------- */
 /* ----------------------------------------------------------------------------------- */
 
@@ -536,6 +613,8 @@ typedef struct {
 #define COMP_TH_THUP_Shft               8U
 #define COMP_MODE_SP_Shft               0U
 
+#define USBD_INTEN_ENDEPIN0_Shft        2U
+#define USBD_INTEN_ENDEPOUT0_Shft       12U
 #define USBD_INTEN_EPDATA_Shft          24U
 
 #define GPIO_PIN_CNF_DIR_Shft           0U
@@ -546,6 +625,9 @@ typedef struct {
 
 /* --- BITMASKS ------------------------------------------------------------ */
 
+#define RTC_COUNTER_Msk                 0x00FFFFFFU
+#define RADIO_PCNF1_MAXLEN_Msk          0x000000FFU
+
 
 
 /* --- BITFIELD VALUES --------------------------------------------------------------- */
@@ -553,6 +635,18 @@ typedef struct {
 
 /* --- CLOCK --------------------------------------------------------------- */
 
+#define CLOCK_LFCLKSRC_SRC_RC                               (0b00 << 0)
+#define CLOCK_LFCLKSRC_SRC_Xtal                             (0b01 << 0)
+
+/* --- POWER -------------------------------------------------------------- */
+
+#define POWER_INTEN_USBDETECTED_                            (1 << 7)
+#define POWER_INTEN_USBREMOVED_                             (1 << 8)
+#define POWER_INTEN_USBPWRRDY_                              (1 << 9)
+
+#define POWER_USBREGSTATUS_VBUSDETECT_                      (1 << 0)
+#define POWER_USBREGSTATUS_OUTPUTRDY_                       (1 << 1)
+
 /* --- RADIO --------------------------------------------------------------- */
 
 #define RADIO_SHORTS_READY_START_                           (1 << 0)
@@ -632,9 +726,11 @@ typedef struct {
 
 #define TIMER_INTENSET_COMPARE0_Set                         (1 << 16)
 #define TIMER_INTENSET_COMPARE1_Set                         (1 << 17)
+#define TIMER_INTENSET_COMPARE2_Set                         (1 << 18)
 
 #define TIMER_INTENCLR_COMPARE0_Clear                       (1 << 16)
 #define TIMER_INTENCLR_COMPARE1_Clear                       (1 << 17)
+#define TIMER_INTENCLR_COMPARE2_Clear                       (1 << 18)
 
 #define TIMER_MODE_MODE_Timer                               (0 << 0)
 #define TIMER_MODE_MODE_Counter                             (1 << 0)
@@ -644,12 +740,30 @@ typedef struct {
 #define TIMER_BITMODE_BITMODE_24Bit                         (0b10 << 0)
 #define TIMER_BITMODE_BITMODE_32Bit                         (0b11 << 0)
 
+/* --- RTC ----------------------------------------------------------------- */
+
+#define RTC_INTENSET_OVRFLW_Set                             (1 << 1)
+
+#define RTC_EVTENSET_COMPARE0_Set                           (1 << 16)
+#define RTC_EVTENSET_COMPARE1_Set                           (1 << 17)
+
+#define RTC_EVTENCLR_COMPARE0_Clear                         (1 << 16)
+#define RTC_EVTENCLR_COMPARE1_Clear                         (1 << 17)
+
 /* --- QDEC ---------------------------------------------------------------- */
 
+#define QDEC_INTENSET_REPORTRDY_Set                         (1 << 1)
+#define QDEC_INTENCLR_REPORTRDY_Clear                       (1 << 1)
+#define QDEC_INTENSET_STOPPED_Set                           (1 << 4)
+#define QDEC_INTENCLR_STOPPED_Clear                         (1 << 4)
+
 #define QDEC_ENABLE_ENABLE_Enabled                          (1 << 0)
 #define QDEC_ENABLE_ENABLE_Disabled                         (0 << 0)
 
 #define QDEC_SAMPLEPER_SAMPLEPER_128us                      (0b0000 << QDEC_SAMPLEPER_SAMPLEPER_Shft)
+#define QDEC_SAMPLEPER_SAMPLEPER_256us                      (0b0001 << QDEC_SAMPLEPER_SAMPLEPER_Shft)
+#define QDEC_SAMPLEPER_SAMPLEPER_512us                      (0b0010 << QDEC_SAMPLEPER_SAMPLEPER_Shft)
+#define QDEC_SAMPLEPER_SAMPLEPER_1024us                     (0b0011 << QDEC_SAMPLEPER_SAMPLEPER_Shft)
 
 #define QDEC_PSEL_CONNECT_Disconnected                      (1 << QDEC_PSEL_CONNECT_Shft)
 #define QDEC_PSEL_CONNECT_Connected                         (0 << QDEC_PSEL_CONNECT_Shft)
@@ -679,15 +793,26 @@ typedef struct {
 
 /* --- USBD ---------------------------------------------------------------- */
 
+#define USBD_EVENTCAUSE_SUSPEND_                            (1 << 8)
+#define USBD_EVENTCAUSE_RESUME_                             (1 << 9)
+#define USBD_EVENTCAUSE_USBWUALLOWED_                       (1 << 10)
 #define USBD_EVENTCAUSE_READY_                              (1 << 11)
 
+#define USBD_DPDMVALUE_STATE_Resume                         (1 << 0)
+#define USBD_DPDMVALUE_STATE_J                              (1 << 1)
+#define USBD_DPDMVALUE_STATE_K                              (1 << 2)
+
+#define USBD_LOWPOWER_LOWPOWER_ForceNormal                  (0 << 0)
+#define USBD_LOWPOWER_LOWPOWER_LowPower                     (1 << 0)
+
 #define USBD_INTEN_USBRESET_                                (1 << 0)
 #define USBD_INTEN_ENDEPIN0_                                (1 << 2)
 #define USBD_INTEN_EP0DATADONE_                             (1 << 10)
 #define USBD_INTEN_ENDEPOUT0_                               (1 << 12)
 #define USBD_INTEN_USBEVENT_                                (1 << 22)
 #define USBD_INTEN_EP0SETUP_                                (1 << 23)
-#define USBD_INTEN_EPDATA_                                  (1 << 24)                            
+#define USBD_INTEN_EPDATA_                                  (1 << 24)
+#define USBD_INTEN_ENDEP_                                   ((0xFF << USBD_INTEN_ENDEPIN0_Shft) | (0xFF << USBD_INTEN_ENDEPOUT0_Shft))
 
 /* --- GPIO ---------------------------------------------------------------- */
 
@@ -727,6 +852,16 @@ typedef struct {
 #define GPIO_PIN_CNF_SENSE_High                             (0b10 << GPIO_PIN_CNF_SENSE_Shft)
 #define GPIO_PIN_CNF_SENSE_Low                              (0b11 << GPIO_PIN_CNF_SENSE_Shft)
 
+/* --- NVMC --------------------------------------------------------------- */
+
+#define NVMC_ICACHECNF_CACHEEN_Enabled                      (1 << 0)
+#define NVMC_ICACHECNF_CACHEPROFEN_Enabled                  (1 << 8)
+
+/* --- DWT / COREDEBUG ----------------------------------------------------- */
+
+#define COREDEBUG_DEMCR_TRCENA                              (1 << 24)
+#define DWT_CTRL_CYCCNTENA                                  (1 << 0)
+
 /* --- NVIC IRQ Numbers -------------------------------------------------------------- */
 /* ----------------------------------------------------------------------------------- */
 
@@ -774,6 +909,10 @@ typedef struct {
 #define NVIC_PWM3_IRQ                               45
 #define NVIC_SPIM3_IRQ                              47
 
+/* nRF52 implements the top 3 bits of each IPR byte, 0 = highest */
+#define NVIC_PRIO_BITS                              3
+#define NVIC_PRIO(prio)                             ((prio) << (8 - NVIC_PRIO_BITS))
+
 /* --- POINTERS ---------------------------------------------------------------------- */
 /* ----------------------------------------------------------------------------------- */
 
@@ -785,10 +924,51 @@ typedef struct {
 #define TIMER0      ((TIMER_T *)  0x40008000)
 #define TIMER1      ((TIMER_T *)  0x40009000)
 #define TIMER2      ((TIMER_T *)  0x4000A000)
+#define RTC1        ((RTC_T   *)  0x40011000)
 #define QDEC        ((QDEC_T   *) 0x40012000)
 #define COMP        ((COMP_T  *)  0x40013000)
+#define NVMC        ((NVMC_T  *)  0x4001E000)
+#define PPI         ((PPI_T   *)  0x4001F000)
 #define USBD        ((USBD_T  *)  0x40027000)
 #define P0          ((GPIO_T  *)  0x50000000)
 #define NVIC        ((NVIC_T  *)  0xE000E100)
+#define COREDEBUG   ((COREDEBUG_T *) 0xE000EDF0)
+#define DWT         ((DWT_T   *)  0xE0001000)
+
+/* --- CORE -------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+#ifndef HOST_SIM
+#define HOST_SIM 0
+#endif
+
+#if HOST_SIM
+
+/* `make sim`: PRIMASK and the sleep belong to the simulated core (fw/sim) */
+uint32_t sim_irq_save(void);
+void     sim_irq_restore(uint32_t primask);
+void     sim_wfi(void);
+
+static inline uint32_t irq_save(void)                { return sim_irq_save(); }
+static inline void     irq_restore(uint32_t primask) { sim_irq_restore(primask); }
+static inline void     wfi(void)                     { sim_wfi(); }
+
+#else
+
+static inline uint32_t irq_save(void) {
+    uint32_t primask;
+    __asm__ volatile ("mrs %0, primask\n cpsid i" : "=r" (primask) :: "memory");
+    return primask;
+}
+
+static inline void irq_restore(uint32_t primask) {
+    __asm__ volatile ("msr primask, %0" :: "r" (primask) : "memory");
+}
+
+static inline void wfi(void) {
+    __asm__ volatile ("wfi" ::: "memory");
+}
+
+#endif
 
 #endif
\ No newline at end of file
@@ -0,0 +1,44 @@
+/***********************************************************************************
+ ** file            : energy.h
+ ** description     : state residency and charge since boot, for the dongle
+ **
+ **                   the radio, SPI and crystal parts are counted where they
+ **                   happen, the rest is wall time (RTC1) split into cpu
+ **                   (DWT->CYCCNT) and the mode the cpu waits in. see
+ **                   energy.c note 1
+ **
+ **********************************************************************************/
+
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <stdint.h>
+
+enum energy_state {
+    ENERGY_TX,              /* on air                                   */
+    ENERGY_RX,              /* RX listen, ramp-up not included          */
+    ENERGY_RAMP,            /* TX and RX ramp-up                        */
+    ENERGY_SPI,             /* SPIM0 clocking a motion burst            */
+    ENERGY_CPU,             /* running, any isr                         */
+    ENERGY_WFI,             /* wfi with the crystal up                  */
+    ENERGY_IDLE,            /* wfi between idle slots, RC only          */
+    ENERGY_SLEEP,           /* system ON sleep                          */
+    ENERGY_STATES
+};
+
+/* what the mouse sends every VBAT_INTERVAL, both counts wrap */
+struct energy_record {
+    uint32_t ms[ENERGY_STATES];     /* residency since boot         */
+    uint32_t charge_uc;             /* from energy.c's current table */
+} __attribute__((packed));
+
+void energy_init(void);
+void energy_mode(uint8_t mode, uint8_t constlat);   /* ENERGY_WFI, _IDLE or _SLEEP  */
+void energy_checkpoint(void);                       /* the same mode, CYCCNT's wrap */
+void energy_tx(uint32_t us, int8_t dbm);
+void energy_add(uint8_t state, uint32_t us);        /* ENERGY_RX, _RAMP or _SPI     */
+void energy_xo(uint32_t ticks);                     /* crystal up in an idle slot   */
+void energy_overflow(void);                         /* RTC1 OVRFLW                  */
+void energy_record(struct energy_record *r);
+
+#endif
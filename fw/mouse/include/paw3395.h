@@ -50,5 +50,6 @@
 
 void paw_init(void);
 void paw_set_dpi(uint16_t dpi);
+void paw_set_downshift(uint8_t run, uint8_t rest1, uint8_t rest2);
 
 #endif
@@ -0,0 +1,52 @@
+/***********************************************************************************
+ ** file            : trace_events.h
+ ** description     : mouse trace events: id, timeline phase, track, format
+ **
+ **                   the firmware only sees the ids, the rest is compiled into
+ **                   tools/trace-timeline.c. phase is 'i' (instant), 'B'/'E'
+ **                   (begin/end of a slice on the track). formats take up to
+ **                   three unsigned args (a0 is 24-bit), add new events at the
+ **                   end so old dumps still decode
+ **
+ **********************************************************************************/
+
+#ifndef TRACE_EVENTS_H
+#define TRACE_EVENTS_H
+
+#define TRACE_TICK_HZ   1000000         /* TIMER2                       */
+
+#define TRACE_EVENTS(X)                                                                     \
+    X(TR_DROPPED,           'i', "trace", "-- %u events dropped --")                        \
+    X(TR_TX,                'B', "radio", "tx seq %u")                                      \
+    X(TR_TX_READY,          'i', "radio", "txready, fresh %u  sensor %u us")                \
+    X(TR_TX_END,            'E', "radio", "")                                               \
+    X(TR_RX,                'B', "radio", "rx window")                                      \
+    X(TR_RX_TIMEOUT,        'i', "radio", "rx timeout")                                     \
+    X(TR_RX_END,            'E', "radio", "crc %u  cc %u")                                  \
+    X(TR_BURST,             'B', "spi",   "motion burst")                                   \
+    X(TR_BURST_END,         'E', "spi",   "")                                               \
+    X(TR_SLOT,              'i', "slot",  "next slot in %u us")                             \
+    X(TR_SLEEP,             'i', "slot",  "sleep")                                          \
+    X(TR_WAKE,              'i', "slot",  "wake, enc %u  latch 0x%x")                       \
+    X(TR_PROFILE,           'i', "slot",  "profile %u")                                     \
+    X(TR_ISR_ENTER,         'B', "isr",   "isr %u")                                         \
+    X(TR_ISR_EXIT,          'E', "isr",   "isr %u")                                         \
+    X(TR_USB_RESET,         'i', "usb",   "RESET")                                          \
+    X(TR_USB_ENDEP,         'i', "usb",   "ENDEP")                                          \
+    X(TR_USB_EP0DATADONE,   'i', "usb",   "EP0DATADONE")                                    \
+    X(TR_USB_EP0_STAGE,     'i', "usb",   "stage: %u")                                      \
+    X(TR_USB_EPDATA,        'i', "usb",   "EPDATA")                                         \
+    X(TR_USB_EP0SETUP,      'i', "usb",   "EP0SETUP")                                       \
+    X(TR_USB_EP0STALL,      'i', "ep0",   "TASKS_EP0STALL = 1")                             \
+    X(TR_USB_EP0STATUS,     'i', "ep0",   "TASKS_EP0STATUS = 1")                            \
+    X(TR_EP0_REQ,           'i', "ep0",   "bmRequestType: x%02X  bRequest: %03u  wValue: x%04X") \
+    X(TR_EP0_REQ_LEN,       'i', "ep0",   "  wIndex: x%04X  wLength: x%04X")                \
+    X(TR_EP0_DATA_IN,       'i', "ep0",   "    DATA_IN")                                    \
+    X(TR_EP0_LAST_DATA_IN,  'i', "ep0",   "    LAST_DATA_IN")                               \
+    X(TR_EP0_STATUS_IN,     'i', "ep0",   "    STATUS_IN")                                  \
+    X(TR_EP0_STATUS_OUT,    'i', "ep0",   "    STATUS_OUT")                                 \
+    X(TR_USB_SUSPEND,       'i', "usb",   "SUSPEND")                                        \
+    X(TR_USB_RESUME,        'i', "usb",   "RESUME")                                         \
+    X(TR_USB_WAKEUP,        'i', "usb",   "remote wakeup")
+
+#endif
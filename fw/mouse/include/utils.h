@@ -13,6 +13,9 @@
 #define MIN(a, b)       ((a) < (b) ? (a) : (b))
 #define ARR_SIZE(x)     (sizeof(x) / sizeof((x)[0]))
 
+/* run from RAM: no flash wait states or cache misses on entry */
+#define RAMFUNC         __attribute__((section(".ramfunc")))
+
 void *my_memcpy(void *dest, const void *src, size_t len);
 void *my_memset(void *dest, int c, size_t len);
 size_t my_strlen(const char *str);
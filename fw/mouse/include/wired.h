@@ -0,0 +1,20 @@
+/***********************************************************************************
+ ** file            : wired.h
+ ** description     : the mouse as a USB HID mouse of its own while on the cable
+ **
+ **                   the dongle's usb.c / usb_ep0.c with a single HID
+ **                   interface. mouse.c starts it on VBUS and feeds it one
+ **                   report per usb frame, see mouse.c note 9
+ **
+ **********************************************************************************/
+
+#ifndef WIRED_H
+#define WIRED_H
+
+#include <stdint.h>
+
+void wired_start(void);
+void wired_stop(void);
+void wired_report(uint8_t buttons, int16_t dx, int16_t dy, int8_t wheel);
+
+#endif
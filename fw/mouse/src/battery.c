@@ -0,0 +1,121 @@
+/********************************************************************
+ ** file         : battery.c
+ ** description  : ladder step -> filtered voltage, state of charge
+ **                and time remaining, see note 1
+ **
+ ********************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "utils.h"
+#include "battery.h"
+
+#define BATTERY_MAH     500     /* the cell on the board, note 2             */
+
+/* vddh halfway between step s's threshold and the next, in mV * 16:
+ * (s + 1.5) / 64 * 1.2V * 5
+ */
+#define STEP_MV_Q4(s)   ((2 * (uint32_t) (s) + 3) * 750)
+#define MV_SHIFT        2       /* filter, 1/4 per reading                  */
+#define MEAN_MS         60000   /* mean current over the last 1..2 of these */
+
+/* single Li-ion cell resting at light load, mV at 0, 10, .. 100% */
+static const uint16_t curve_mv[] = {
+    3300, 3680, 3740, 3770, 3790, 3820, 3870, 3920, 3980, 4060, 4200,
+};
+
+#define CURVE_POINTS (sizeof(curve_mv) / sizeof(curve_mv[0]))
+
+struct battery_ctx {
+    int32_t  mv_q4;         /* 0 until the first reading            */
+    uint32_t mean_uc;       /* charge and time the mean is over     */
+    uint32_t mean_ms;
+    uint32_t charge_uc;     /* at the last record                   */
+    uint32_t uptime_ms;
+};
+
+static struct battery_ctx b_ctx;
+
+/* from comp_lpcomp_isr, once the search is done */
+void battery_reading(uint8_t step) {
+
+    int32_t mv_q4 = STEP_MV_Q4(step);
+
+    if (!b_ctx.mv_q4) {
+        b_ctx.mv_q4 = mv_q4;
+        return;
+    }
+    b_ctx.mv_q4 += (mv_q4 - b_ctx.mv_q4) >> MV_SHIFT;
+
+}
+
+static uint8_t soc_pct(uint16_t mv) {
+
+    if (mv <= curve_mv[0]) {
+        return 0;
+    }
+    for (uint8_t i = 1; i < CURVE_POINTS; i++) {
+        if (mv < curve_mv[i]) {
+            uint16_t lo = curve_mv[i - 1];
+            return (i - 1) * 10 + (mv - lo) * 10 / (curve_mv[i] - lo);
+        }
+    }
+    return 100;
+}
+
+/* the charge since boot from the energy record, what it added since the
+ * last one goes into the mean current (note 2)
+ */
+void battery_status(struct battery_status *b, uint32_t charge_uc, uint32_t uptime_ms) {
+
+    b_ctx.mean_uc  += charge_uc - b_ctx.charge_uc;
+    b_ctx.mean_ms  += uptime_ms - b_ctx.uptime_ms;
+    b_ctx.charge_uc = charge_uc;
+    b_ctx.uptime_ms = uptime_ms;
+
+    while (b_ctx.mean_ms > 2 * MEAN_MS) {
+        b_ctx.mean_uc >>= 1;
+        b_ctx.mean_ms >>= 1;
+    }
+
+    /* uC / ms = mA, the remainder's * 1000 fits with ms that short */
+    uint32_t ua = 0;
+    if (b_ctx.mean_ms) {
+        ua = b_ctx.mean_uc / b_ctx.mean_ms * 1000
+           + b_ctx.mean_uc % b_ctx.mean_ms * 1000 / b_ctx.mean_ms;
+    }
+
+    b->mv  = (b_ctx.mv_q4 + 8) >> 4;
+    b->soc = b->mv ? soc_pct(b->mv) : 0;
+
+    /* % of BATTERY_MAH at ua, in minutes */
+    uint32_t minutes = ua ? (uint32_t) b->soc * BATTERY_MAH * 600 / ua : 0xFFFF;
+    b->minutes = MIN(minutes, 0xFFFF);
+
+}
+
+/* note 1 : battery
+ *
+ *          comp_lpcomp_isr binary searches the COMP threshold for VDDH/5, six
+ *          comparisons for the 64 steps of 1.2V/64 (93.75mV at VDDH). a
+ *          reading is the middle of its step; the filter's 1/4 per reading
+ *          (one every VBAT_INTERVAL) smooths the sag under the radio. a
+ *          voltage that dithers across a threshold settles in between, finer
+ *          than the ladder; a steady one sits in the middle of its step.
+ *
+ *          state of charge is the filtered voltage on a generic Li-ion resting
+ *          curve, linear between the 10% points. it reads a little low right
+ *          after a burst of radio and is only as good as the curve is for the
+ *          cell, the flat middle of it most of all.
+ *
+ * note 2 : time remaining
+ *
+ *          the energy record's charge and uptime since boot, against the last
+ *          record, add to a window that's halved once it's past 2 * MEAN_MS:
+ *          the mean current over the last one to two minutes, each record
+ *          weighed by the time it covers, so the short one from boot or an
+ *          hour asleep count for what they are. the charge is energy.c's
+ *          current table (note 2 there), not a measurement. BATTERY_MAH is
+ *          the cell's rating, the state of charge's share of it at that
+ *          current is the time left.
+ */
@@ -0,0 +1,234 @@
+/********************************************************************
+ ** file         : energy.c
+ ** description  : state residency counters and the charge they
+ **                add up to, see note 1
+ **
+ ********************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "device.h"
+#include "utils.h"
+#include "energy.h"
+
+/* nRF52820 at 3V on the LDO, datasheet typicals in uA. fw/sim/mouse_sim.c
+ * charges the same numbers from its own residency, see note 2
+ */
+#define TX_UA(dbm)      ((dbm) >= 4 ? 13000 : (dbm) >= 0 ? 9600 : (dbm) >= -4 ? 8100 : 7300)
+#define RX_UA           9800    /* listening or receiving, the same       */
+#define RAMP_UA         6000
+#define SPI_UA          50
+#define CPU_UA          3700    /* running from flash, on top of the floor  */
+#define FLOOR_UA        2       /* wfi or sleep, RC oscillator and RTC1     */
+#define HFXO_UA         250
+#define CONSTLAT_UA     350
+
+#define CYC_US_SHIFT    6       /* DWT->CYCCNT at 64MHz                     */
+#define TICKS_US(t)     (((uint64_t) (t) * 15625) >> 9)     /* 1e6 / 32768  */
+#define MODES           3       /* ENERGY_WFI, ENERGY_IDLE, ENERGY_SLEEP    */
+
+struct energy_ctx {
+    uint64_t us[ENERGY_CPU];    /* TX, RX, RAMP, SPI: counted as they go    */
+    uint64_t wall[MODES];       /* RTC1 ticks in each mode, cpu included    */
+    uint64_t cpu_us[MODES];     /* running, in each mode                    */
+    uint64_t xo_us;             /* IDLE's wall time with the crystal up     */
+    uint64_t pc;                /* uA * us                                  */
+    uint64_t ticks;             /* RTC1 at the last checkpoint              */
+    uint32_t cyc;               /* DWT->CYCCNT at the last checkpoint       */
+    uint32_t ovf;               /* RTC1 overflows                           */
+    uint8_t  mode;
+    uint8_t  constlat;
+};
+
+static struct energy_ctx e;
+
+/* n / d a halfword at a time, the M4 only divides 32 bits and there's
+ * no libgcc for the rest
+ */
+static uint64_t udiv64(uint64_t n, uint16_t d) {
+
+    uint64_t q = 0;
+    uint32_t r = 0;
+
+    for (int shift = 48; shift >= 0; shift -= 16) {
+        uint32_t cur = (r << 16) | (uint32_t) ((n >> shift) & 0xFFFF);
+        q = (q << 16) | (cur / d);
+        r = cur % d;
+    }
+    return q;
+}
+
+static uint16_t floor_ua(uint8_t mode, uint8_t constlat) {
+
+    if (mode != ENERGY_WFI) {
+        return FLOOR_UA;
+    }
+    return FLOOR_UA + HFXO_UA + (constlat ? CONSTLAT_UA : 0);
+}
+
+/* what the mode ran up since the last one, irqs off */
+static void checkpoint(void) {
+
+    /* an overflow not yet counted: COUNTER is past it when read again */
+    uint32_t cnt = RTC1->COUNTER;
+    uint32_t ovf = e.ovf;
+    if (RTC1->EVENTS_OVRFLW) {
+        cnt = RTC1->COUNTER;
+        ovf++;
+    }
+
+    uint64_t ticks = ((uint64_t) ovf << 24) | cnt;
+    uint32_t cpu   = (DWT->CYCCNT - e.cyc) >> CYC_US_SHIFT;
+    uint64_t wall  = TICKS_US(ticks - e.ticks);
+
+    uint8_t m = e.mode - ENERGY_WFI;
+    e.wall[m]   += ticks - e.ticks;
+    e.cpu_us[m] += cpu;
+    e.ticks      = ticks;
+    e.cyc       += cpu << CYC_US_SHIFT;     /* cycles short of a us stay */
+    e.pc        += wall * floor_ua(e.mode, e.constlat) + (uint64_t) cpu * CPU_UA;
+
+}
+
+void energy_init(void) {
+
+    COREDEBUG->DEMCR |= COREDEBUG_DEMCR_TRCENA;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA;
+
+    e.cyc   = DWT->CYCCNT;
+    e.ticks = RTC1->COUNTER;
+    e.mode  = ENERGY_WFI;
+
+    RTC1->EVENTS_OVRFLW = 0;
+    RTC1->INTENSET      = RTC_INTENSET_OVRFLW_Set;
+
+}
+
+/* the running mode so far, with no change: see note 1 */
+void energy_checkpoint(void) {
+
+    uint32_t primask = irq_save();
+    checkpoint();
+    irq_restore(primask);
+
+}
+
+/* from any level: the new mode and whether it has CONSTLAT */
+void energy_mode(uint8_t mode, uint8_t constlat) {
+
+    uint32_t primask = irq_save();
+
+    checkpoint();
+    e.mode     = mode;
+    e.constlat = constlat;
+
+    irq_restore(primask);
+
+}
+
+/* the counted states come from IRQ_PRIO_RADIO and IRQ_PRIO_SENSOR,
+ * each adds with irqs off
+ */
+void energy_tx(uint32_t us, int8_t dbm) {
+
+    uint32_t primask = irq_save();
+    e.us[ENERGY_TX] += us;
+    e.pc            += (uint64_t) us * TX_UA(dbm);
+    irq_restore(primask);
+
+}
+
+void energy_add(uint8_t state, uint32_t us) {
+
+    static const uint16_t ua[ENERGY_CPU] = {
+        [ENERGY_RX] = RX_UA, [ENERGY_RAMP] = RAMP_UA, [ENERGY_SPI] = SPI_UA,
+    };
+
+    uint32_t primask = irq_save();
+    e.us[state] += us;
+    e.pc        += (uint64_t) us * ua[state];
+    irq_restore(primask);
+
+}
+
+void energy_xo(uint32_t ticks) {
+
+    uint32_t us = TICKS_US(ticks);
+
+    uint32_t primask = irq_save();
+    e.xo_us += us;
+    e.pc    += (uint64_t) us * HFXO_UA;
+    irq_restore(primask);
+
+}
+
+void energy_overflow(void) {
+
+    if (RTC1->EVENTS_OVRFLW) {
+        RTC1->EVENTS_OVRFLW = 0;
+        e.ovf++;
+    }
+
+}
+
+/* a snapshot up to now. the divides run with irqs on */
+void energy_record(struct energy_record *r) {
+
+    uint64_t us[ENERGY_STATES];
+
+    uint32_t primask = irq_save();
+
+    checkpoint();
+    for (uint8_t i = 0; i < ENERGY_CPU; i++) {
+        us[i] = e.us[i];
+    }
+    us[ENERGY_CPU] = e.cpu_us[0] + e.cpu_us[1] + e.cpu_us[2];
+    for (uint8_t m = 0; m < MODES; m++) {
+        us[ENERGY_WFI + m] = TICKS_US(e.wall[m]) - MIN(e.cpu_us[m], TICKS_US(e.wall[m]));
+    }
+    us[ENERGY_WFI]  += e.xo_us;
+    us[ENERGY_IDLE] -= MIN(e.xo_us, us[ENERGY_IDLE]);
+    uint64_t pc = e.pc;
+
+    irq_restore(primask);
+
+    for (uint8_t i = 0; i < ENERGY_STATES; i++) {
+        r->ms[i] = (uint32_t) udiv64(us[i], 1000);
+    }
+    r->charge_uc = (uint32_t) udiv64(udiv64(pc, 1000), 1000);
+
+}
+
+/* note 1 : states
+ *
+ *          TX, RX, RAMP and SPI are counted where they happen, from what
+ *          the firmware already knows: a packet's air time from its LENGTH,
+ *          RX from TIMER1 (started at TX END) less the ramp-up, 40us per
+ *          TXEN or RXEN, 2us a byte of motion burst at 4MHz. they overlap
+ *          the rest, the radio and SPIM draw on top of whatever the cpu does.
+ *          SPI outside the burst (dpi, downshift, paw_init) isn't counted.
+ *
+ *          CPU, WFI, IDLE and SLEEP add up to the time since energy_init():
+ *          RTC1 (the RC oscillator, 24 bits, OVRFLW counted) gives the wall
+ *          time of each mode, DWT->CYCCNT the part the cpu ran, it stops in
+ *          wfi. a checkpoint closes the running mode whenever mouse.c changes
+ *          it: power_setup() (WFI, with or without CONSTLAT), idle_slot()
+ *          (IDLE) and enter_sleep() (SLEEP). an idle slot starts the crystal
+ *          XO_STARTUP_US ahead, that part of IDLE is reported as WFI. CYCCNT
+ *          wraps after 67s running and a checkpoint has to come before that.
+ *          a record every VBAT_INTERVAL is one, but records ride on the
+ *          dongle's replies: while wired (mouse.c note 9) or with no dongle
+ *          around there are none. mouse.c posts energy_checkpoint() every
+ *          CHECKPOINT_SLOTS slots or wired bursts instead, 10s at 1ms and
+ *          80s on the idle link's 8ms slots, which run the cpu far less than
+ *          that.
+ *
+ * note 2 : charge
+ *
+ *          each state's time at its current above, the crystal and CONSTLAT
+ *          on top while they are up. a checkpoint charges the interval it
+ *          closes, so a mode's own floor is what it had then. the table is
+ *          datasheet typicals, so the charge is as good as they are for a
+ *          given board; mouse-sim compares the record with its own count
+ *          of the same currents, the difference is what the counters miss.
+ */
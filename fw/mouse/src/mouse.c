@@ -9,12 +9,38 @@
 #include <stdint.h>
 #include <stddef.h>
 #include "device.h"
-#include "delay.h"
 #include "paw3395.h"
 #include "utils.h"
-
-#define RX_TIMEOUT_US   200        /* 200us */
-#define VBAT_INTERVAL   10000000   /* 10s   */
+#include "isr_prof.h"
+#include "trace.h"
+#include "defer.h"
+#include "energy.h"
+#include "battery.h"
+#include "wired.h"
+
+#define SLOT_US         1000       /* until the dongle's cc says otherwise */
+#define VBAT_INTERVAL   10000000   /* 10s, a record follows each reading (note 7) */
+#define WAKE_BLINK_US   100000     /* 100ms */
+#define WAKE_SLOT_US    2          /* first TX after wake, see note 3 */
+#define WAKE_HOLD_SLOTS 1000       /* awake at least this long, note 4 */
+#define IDLE_SLOT_US    8000       /* slot period while idle */
+#define XO_STARTUP_US   400        /* HFXO start to a usable radio, with margin */
+#define RAMP_US         40         /* fast ramp-up, TX or RX */
+#define SPI_BYTE_US     2          /* SPIM0 at 4MHz */
+#define SOF_US          1000       /* usb full-speed frame */
+#define WIRED_LEAD_US   100        /* wired burst start before the next SOF, note 9 */
+#define CHECKPOINT_SLOTS 10000     /* TIMER1 slots or bursts, energy.c note 1 */
+
+/* preamble + address + LENGTH + payload + CRC, 4us per byte at 2Mbit */
+#define RADIO_AIR_US(len) ((1 + 4 + 1 + (len) + 2) * 4)
+
+/* RTC1 ticks (32768Hz) in us, rounded down, in 32-bit math (no libgcc
+ * for a 64-bit divide): `us * 512` wraps past ~8.3s, keep `us` below
+ * that. the crystal's lead is rounded up, so it never gets less than
+ * XO_STARTUP_US
+ */
+#define RTC_TICKS(us)   ((uint32_t) (us) * 512 / 15625)
+#define RTC_XO_TICKS    (RTC_TICKS(XO_STARTUP_US) + 1)
 
 #define LED_PIN         7
 #define L_NO_PIN        8
@@ -33,21 +59,70 @@
 #define CH_L_NC         1
 #define CH_R_NO         2
 #define CH_R_NC         3
+#define CH_MOTION       4       /* only while the link idles */
+
+#define PPI_CH_XO       0       /* RTC1 COMPARE0 -> HFCLKSTART  */
+#define PPI_CH_SLOT     1       /* RTC1 COMPARE1 -> TIMER1 START */
+#define PPI_CH_SOF      2       /* USBD SOF -> TIMER1 START, wired only */
+
+/* the TX packet's DISABLED starts the RX itself, see note 2 */
+#define RADIO_SHORTS_RX (RADIO_SHORTS_END_DISABLE_ | RADIO_SHORTS_RXREADY_START_)
+#define RADIO_SHORTS_TX (RADIO_SHORTS_RX | RADIO_SHORTS_DISABLED_RXEN_)
+
+/* interrupt priorities, see note 2 */
+#define IRQ_PRIO_RADIO  0       /* RADIO, TIMER1: slot timing               */
+#define IRQ_PRIO_SENSOR 1       /* SPIM0, TIMER0, USBD: motion burst, ep1   */
+#define IRQ_PRIO_SLOW   2       /* GPIOTE, QDEC, COMP, POWER: buttons, vbat, wakeup, VBUS */
+#define IRQ_PRIO_DEFER  3       /* SWI0: work posted by the isrs above      */
 
 struct mouse_packet {
     uint8_t  LENGTH;
-    uint8_t  btn_vbat;
+    uint8_t  btn_vbat;      /* ladder step in [7:2], battery carries the calibrated */
     int16_t  dx;
     int16_t  dy;
     int8_t   wheel;
+    uint8_t  seq;           /* +1 per TX slot, dongle counts gaps as missed slots */
+    uint8_t  sensor_us;     /* burst completion -> TX start, saturates at 255     */
+    struct energy_record  energy;   /* only when LENGTH covers them, note 7       */
+    struct battery_status battery;
 } __attribute__((packed));
 
+#define MOUSE_PKT_LEN   (offsetof(struct mouse_packet, energy) - 1)
+
 struct dongle_packet {
     uint8_t  LENGTH;
     uint16_t cc;
     uint16_t dpi;
+    uint8_t  profile;
 } __attribute__((packed));
 
+/* power/performance profiles, the host picks one through the dongle (note 6) */
+enum profile_id {
+    PROFILE_COMPETITIVE,
+    PROFILE_BALANCED,
+    PROFILE_ECO,
+    PROFILE_COUNT,
+};
+
+struct profile {
+    uint8_t  constlat;      /* CONSTLAT while the link is active, else LOWPWR */
+    int8_t   txpower;       /* dBm, RADIO->TXPOWER                            */
+    uint8_t  slot_polls;    /* host polls per slot                            */
+    uint8_t  sampleper;     /* QDEC->SAMPLEPER                                */
+    uint16_t rx_us;         /* RX window from TX END                          */
+    uint16_t idle_after;    /* quiet slots before the link idles, note 5      */
+    uint8_t  downshift[3];  /* paw_set_downshift(): run, rest1, rest2         */
+};
+
+static const struct profile profiles[PROFILE_COUNT] = {
+    /* sensor: 26s run, 30s rest1, 64s rest2 */
+    [PROFILE_COMPETITIVE] = { 1, +4, 1, QDEC_SAMPLEPER_SAMPLEPER_128us, 250, 1000, {255, 234, 10} },
+    /* what the mouse did before profiles: 15s, 30s, 64s */
+    [PROFILE_BALANCED]    = { 1,  0, 1, QDEC_SAMPLEPER_SAMPLEPER_128us, 200,  100, {146, 234, 10} },
+    /* 5s, 10s, 32s */
+    [PROFILE_ECO]         = { 0, -4, 2, QDEC_SAMPLEPER_SAMPLEPER_512us, 150,   20, { 49,  78,  5} },
+};
+
 struct radio_ctx {
     enum {
         RADIO_STATE_DISABLED,
@@ -69,25 +144,83 @@ struct spim_ctx {
 
 struct comp_ctx {
     uint8_t active;
-    uint8_t ladder;
+    uint8_t ladder;         /* threshold being compared         */
+    uint8_t lo;             /* vbat is in [lo, hi], note 8      */
+    uint8_t hi;
 };
 
-volatile struct mouse_packet  mouse_pkt  = {.LENGTH = 6};
+struct sleep_ctx {
+    uint32_t iser[2];       /* NVIC enables parked by enter_sleep() */
+    uint8_t  enc;           /* encoder AB going to sleep            */
+    uint16_t hold;          /* slots left before sleep is allowed   */
+    uint8_t  asleep;        /* between enter_sleep() and exit_sleep() */
+};
+
+struct link_ctx {
+    uint8_t  idle;          /* slots on RTC1, HFXO and CONSTLAT off between */
+    uint8_t  resync;        /* TIMER1 CC[0] is a one-off, SLOT_US after it  */
+    uint8_t  buttons;       /* last sent, a change is activity              */
+    uint16_t quiet;         /* slots in a row with nothing to send          */
+    uint8_t  energy;        /* mouse_pkt.energy goes with the next slot     */
+    uint8_t  wired;         /* VBUS up: bursts go to ep1, no slots (note 9) */
+    uint16_t checkpoint;    /* slots or bursts since energy_checkpoint()    */
+};
+
+volatile struct mouse_packet  mouse_pkt  = {.LENGTH = MOUSE_PKT_LEN};
 volatile struct dongle_packet dongle_pkt = {0};
 volatile struct radio_ctx     radio_ctx  = {0};
 volatile struct spim_ctx      spim_ctx   = {0};
 volatile struct comp_ctx      comp_ctx   = {0};
+static   struct sleep_ctx     sleep_ctx  = {0};
+volatile struct link_ctx      link_ctx   = {0};
 
 volatile uint8_t  paw_data[BURST_SIZE] = {0};
 volatile uint32_t elapsed_us = VBAT_INTERVAL;
 volatile uint16_t curr_dpi   = 0;
+volatile uint8_t  curr_profile = PROFILE_BALANCED;
 volatile uint8_t  vbat       = 0;
 volatile uint8_t  op_mode    = 0;
 volatile uint8_t  l_click    = 0;
 volatile uint8_t  r_click    = 0;
+volatile int8_t   wake_wheel = 0;
+
+/* QDEC's count for a move from AB (prev << 2 | curr), 11 -> 10 -> 00 -> 01
+ * is +1, a two-bit jump gives no direction
+ */
+static const int8_t enc_step[16] = {
+     0, +1, -1,  0,
+    -1,  0,  0, +1,
+    +1,  0,  0, -1,
+     0, -1, +1,  0,
+};
 
 static void power_setup(void) {
-    POWER->TASKS_CONSTLAT = 1;
+    if (profiles[curr_profile].constlat) {
+        POWER->TASKS_CONSTLAT = 1;
+    }
+    else {
+        POWER->TASKS_LOWPWR = 1;
+    }
+    energy_mode(ENERGY_WFI, profiles[curr_profile].constlat);
+}
+
+/* IPR survives enter_sleep(), only the enables are cleared there */
+static void irq_setup(void) {
+
+    NVIC->IPR[NVIC_RADIO_IRQ]       = NVIC_PRIO(IRQ_PRIO_RADIO);
+    NVIC->IPR[NVIC_TIMER1_IRQ]      = NVIC_PRIO(IRQ_PRIO_RADIO);
+    NVIC->IPR[NVIC_SPI0_SPIM0_SPIS0_TWI0_TWIM0_TWIS0_IRQ] = NVIC_PRIO(IRQ_PRIO_SENSOR);
+    NVIC->IPR[NVIC_TIMER0_IRQ]      = NVIC_PRIO(IRQ_PRIO_SENSOR);
+    NVIC->IPR[NVIC_TIMER2_IRQ]      = NVIC_PRIO(IRQ_PRIO_SLOW);
+    NVIC->IPR[NVIC_GPIOTE_IRQ]      = NVIC_PRIO(IRQ_PRIO_SLOW);
+    NVIC->IPR[NVIC_QDEC_IRQ]        = NVIC_PRIO(IRQ_PRIO_SLOW);
+    NVIC->IPR[NVIC_RTC1_IRQ]        = NVIC_PRIO(IRQ_PRIO_SLOW);
+    NVIC->IPR[NVIC_COMP_LPCOMP_IRQ] = NVIC_PRIO(IRQ_PRIO_SLOW);
+    NVIC->IPR[NVIC_USBD_IRQ]        = NVIC_PRIO(IRQ_PRIO_SENSOR);
+    NVIC->IPR[NVIC_CLOCK_POWER_IRQ] = NVIC_PRIO(IRQ_PRIO_SLOW);
+
+    defer_init(IRQ_PRIO_DEFER);
+
 }
 
 static void clock_setup(void) {
@@ -96,6 +229,33 @@ static void clock_setup(void) {
     CLOCK->EVENTS_HFCLKSTARTED = 0;
 }
 
+/* RTC1 on the RC oscillator times the idle slots (note 5): COMPARE0
+ * starts the crystal, COMPARE1 the slot. the PPI channels stay on,
+ * RTC1's EVTEN decides whether the events happen at all
+ */
+static void rtc_setup(void) {
+
+    CLOCK->LFCLKSRC         = CLOCK_LFCLKSRC_SRC_RC;
+    CLOCK->TASKS_LFCLKSTART = 1;
+    while (!(CLOCK->EVENTS_LFCLKSTARTED));
+    CLOCK->EVENTS_LFCLKSTARTED = 0;
+
+    RTC1->PRESCALER   = 0;
+    RTC1->EVTENCLR    = RTC_EVTENCLR_COMPARE0_Clear
+                      | RTC_EVTENCLR_COMPARE1_Clear;
+    RTC1->TASKS_START = 1;
+
+    PPI->CH[PPI_CH_XO].EEP   = (uint32_t) &RTC1->EVENTS_COMPARE[0];
+    PPI->CH[PPI_CH_XO].TEP   = (uint32_t) &CLOCK->TASKS_HFCLKSTART;
+    PPI->CH[PPI_CH_SLOT].EEP = (uint32_t) &RTC1->EVENTS_COMPARE[1];
+    PPI->CH[PPI_CH_SLOT].TEP = (uint32_t) &TIMER1->TASKS_START;
+    PPI->CHENSET = (1 << PPI_CH_XO) | (1 << PPI_CH_SLOT);
+
+    /* OVRFLW for energy.c, its INTEN is set there */
+    NVIC->ISER[NVIC_RTC1_IRQ / 32] = (1 << (NVIC_RTC1_IRQ % 32));
+
+}
+
 static void timer_setup(void) {
 
     /* delay timer */
@@ -113,7 +273,7 @@ static void timer_setup(void) {
     TIMER1->BITMODE     = TIMER_BITMODE_BITMODE_32Bit;
     TIMER1->PRESCALER   = 4;
 
-    TIMER1->CC[0]       = 1000;
+    TIMER1->CC[0]       = SLOT_US;
     TIMER1->CC[1]       = 0xFFFFFFFF;
     TIMER1->SHORTS      = TIMER_SHORTS_COMPARE0_STOP_Enabled
                         | TIMER_SHORTS_COMPARE0_CLEAR_Enabled;
@@ -123,6 +283,17 @@ static void timer_setup(void) {
 
     NVIC->ISER[NVIC_TIMER1_IRQ / 32] = (1 << (NVIC_TIMER1_IRQ % 32));
 
+    /* latency timebase, free running: CC[0] = burst done, CC[1] = TX start,
+     * CC[2] = led off, CC[3] = trace clock
+     */
+    TIMER2->TASKS_STOP  = 1;
+    TIMER2->TASKS_CLEAR = 1;
+    TIMER2->MODE        = TIMER_MODE_MODE_Timer;
+    TIMER2->BITMODE     = TIMER_BITMODE_BITMODE_32Bit;
+    TIMER2->PRESCALER   = 4;
+    TIMER2->TASKS_START = 1;
+    NVIC->ISER[NVIC_TIMER2_IRQ / 32] = (1 << (NVIC_TIMER2_IRQ % 32));
+
 }
 
 static void gpio_setup(void) {
@@ -141,21 +312,23 @@ static void gpio_setup(void) {
 
 static void gpiote_setup(void) {
 
-    /* CH 0: L_NO ; trigger on first switch press */
-    GPIOTE->CONFIG[CH_L_NO] = GPIOTE_CONFIG_MODE_Event
-                            | GPIOTE_CONFIG_POLARITY_HiToLo
-                            | (L_NO_PIN << GPIOTE_CONFIG_PSEL_Shft);
-
-    /* CH 1: L_NC */
-    GPIOTE->CONFIG[CH_L_NC] = 0;
-
-    /* CH 2: R_NO ; trigger on first switch press */
-    GPIOTE->CONFIG[CH_R_NO] = GPIOTE_CONFIG_MODE_Event
-                            | GPIOTE_CONFIG_POLARITY_HiToLo
-                            | (R_NO_PIN << GPIOTE_CONFIG_PSEL_Shft);
-
-    /* CH 3: R_NC */
-    GPIOTE->CONFIG[CH_R_NC] = 0;
+    /* CH 0/1: L_NO/L_NC ; trigger on first switch press, or on the release
+     * of a press that came with us through sleep (note 4)
+     */
+    GPIOTE->CONFIG[CH_L_NO] = l_click ? 0 : GPIOTE_CONFIG_MODE_Event
+                                          | GPIOTE_CONFIG_POLARITY_HiToLo
+                                          | (L_NO_PIN << GPIOTE_CONFIG_PSEL_Shft);
+    GPIOTE->CONFIG[CH_L_NC] = l_click ? GPIOTE_CONFIG_MODE_Event
+                                      | GPIOTE_CONFIG_POLARITY_HiToLo
+                                      | (L_NC_PIN << GPIOTE_CONFIG_PSEL_Shft) : 0;
+
+    /* CH 2/3: R_NO/R_NC ; same */
+    GPIOTE->CONFIG[CH_R_NO] = r_click ? 0 : GPIOTE_CONFIG_MODE_Event
+                                          | GPIOTE_CONFIG_POLARITY_HiToLo
+                                          | (R_NO_PIN << GPIOTE_CONFIG_PSEL_Shft);
+    GPIOTE->CONFIG[CH_R_NC] = r_click ? GPIOTE_CONFIG_MODE_Event
+                                      | GPIOTE_CONFIG_POLARITY_HiToLo
+                                      | (R_NC_PIN << GPIOTE_CONFIG_PSEL_Shft) : 0;
 
     /* clear any spurious events */
     GPIOTE->EVENTS_IN[CH_L_NO] = 0;
@@ -174,7 +347,7 @@ static void gpiote_setup(void) {
 
 static void qdec_setup(void) {
 
-    QDEC->SAMPLEPER = QDEC_SAMPLEPER_SAMPLEPER_128us;
+    QDEC->SAMPLEPER = profiles[curr_profile].sampleper;
     QDEC->DBFEN     = QDEC_DBFEN_DBFEN_Disabled;
 
     QDEC->PSEL.A    = (ENC_A_PIN << QDEC_PSEL_PIN_Shft) | (QDEC_PSEL_CONNECT_Connected);
@@ -183,10 +356,14 @@ static void qdec_setup(void) {
     QDEC->ENABLE    = QDEC_ENABLE_ENABLE_Enabled;
     QDEC->TASKS_START = 1;
 
+    /* REPORTRDY is only enabled while the link idles (note 5) */
+    NVIC->ISER[NVIC_QDEC_IRQ / 32] = (1 << (NVIC_QDEC_IRQ % 32));
+
 }
 
-static void spi_setup(void) {
-    
+/* pins only, enter_sleep() lets go of them */
+static void spi_pins(void) {
+
     uint8_t out_pins[] = {NCS_PIN, MOSI_PIN, SCK_PIN};
     for (uint8_t i = 0; i < ARR_SIZE(out_pins); i++) {
         P0->PIN_CNF[out_pins[i]] = GPIO_PIN_CNF_DIR_Output
@@ -208,6 +385,12 @@ static void spi_setup(void) {
     P0->OUTSET = (1 << NCS_PIN) | (1 << SCK_PIN);
     P0->OUTCLR = (1 << MOSI_PIN);
 
+}
+
+static void spi_setup(void) {
+
+    spi_pins();
+
     SPIM0->PSEL.MISO = (MISO_PIN << SPIM_PSEL_PIN_Shft) | (SPIM_PSEL_CONNECT_Connected);
     SPIM0->PSEL.MOSI = (MOSI_PIN << SPIM_PSEL_PIN_Shft) | (SPIM_PSEL_CONNECT_Connected);
     SPIM0->PSEL.SCK  = (SCK_PIN  << SPIM_PSEL_PIN_Shft) | (SPIM_PSEL_CONNECT_Connected);
@@ -261,9 +444,9 @@ static void radio_setup(void) {
     RADIO->CRCPOLY = 0x001685F1;
     RADIO->CRCINIT = 0x000656E9;
 
-    /* 2402 MHz, 0dBm */
+    /* 2402 MHz, the profile's TX power */
     RADIO->FREQUENCY = 2;
-    RADIO->TXPOWER   = 0;
+    RADIO->TXPOWER   = (uint8_t) profiles[curr_profile].txpower;
 
     /* configure on-air address.
      * = [PREFIX byte] + [BALEN bytes of BASE]
@@ -280,8 +463,7 @@ static void radio_setup(void) {
     RADIO->RXADDRESSES = RADIO_RXADDRESSES_ADDR1_Enabled;
 
     /* shortcuts */
-    RADIO->SHORTS = RADIO_SHORTS_END_DISABLE_ |
-                    RADIO_SHORTS_RXREADY_START_;
+    RADIO->SHORTS = RADIO_SHORTS_RX;
     
     RADIO->INTENSET = RADIO_INTENSET_TXREADY_Set
                     | RADIO_INTENSET_DISABLED_Set;
@@ -307,6 +489,37 @@ static void comp_setup(void) {
 
 }
 
+/* the cable, clock_power_isr takes it from here (note 9). last in
+ * main(): a mouse booted on the cable goes wired at once
+ */
+static void vbus_setup(void) {
+
+    PPI->CH[PPI_CH_SOF].EEP = (uint32_t) &USBD->EVENTS_SOF;
+    PPI->CH[PPI_CH_SOF].TEP = (uint32_t) &TIMER1->TASKS_START;
+
+    POWER->INTENSET = POWER_INTEN_USBDETECTED_
+                    | POWER_INTEN_USBREMOVED_
+                    | POWER_INTEN_USBPWRRDY_;
+    NVIC->ISER[NVIC_CLOCK_POWER_IRQ / 32] = (1 << (NVIC_CLOCK_POWER_IRQ % 32));
+
+    if (POWER->USBREGSTATUS & POWER_USBREGSTATUS_VBUSDETECT_) {
+        NVIC->ISPR[NVIC_CLOCK_POWER_IRQ / 32] = (1 << (NVIC_CLOCK_POWER_IRQ % 32));
+    }
+
+}
+
+/* on now, off from timer2_isr */
+static void led_blink(uint32_t us) {
+
+    P0->DIRSET = (1 << LED_PIN);
+
+    TIMER2->TASKS_CAPTURE[2]  = 1;
+    TIMER2->CC[2]            += us;
+    TIMER2->EVENTS_COMPARE[2] = 0;
+    TIMER2->INTENSET          = TIMER_INTENSET_COMPARE2_Set;
+
+}
+
 static void comp_start(uint8_t ladder_pos) {
 
     COMP->TH = (ladder_pos << COMP_TH_THUP_Shft)
@@ -317,21 +530,26 @@ static void comp_start(uint8_t ladder_pos) {
 
 }
 
-static void async_get_vbat(void) {
+static void async_get_vbat(uint32_t arg) {
+
+    (void) arg;
 
     if (comp_ctx.active) return;
 
     comp_ctx.active = 1;
-    comp_ctx.ladder = 44;
-    
+    comp_ctx.lo     = 0;
+    comp_ctx.hi     = BATTERY_STEPS - 1;
+    comp_ctx.ladder = BATTERY_STEPS / 2;
+
     COMP->ENABLE = COMP_ENABLE_ENABLE_Enabled;
     comp_start(comp_ctx.ladder);
 
 }
 
-static void async_paw_motion_burst(void) {
+RAMFUNC static void async_paw_motion_burst(void) {
 
-    if (spim_ctx.active) return;
+    /* still busy, or the last burst missed its TX (see note 1) */
+    if (spim_ctx.active || spim_ctx.ready) return;
 
     /* start paw3395 motion burst by sending motion
      * burst address
@@ -341,6 +559,8 @@ static void async_paw_motion_burst(void) {
     spim_ctx.ready  = 0;
     spim_ctx.state  = SPIM_STATE_TX;
 
+    TRACE(TR_BURST);
+
     /* pull NCS low to select paw */
     P0->OUTCLR = (1 << NCS_PIN);
 
@@ -356,48 +576,281 @@ static void async_paw_motion_burst(void) {
 
 }
 
-static void fill_mouse_pkt(void) {
+/* for work deferred from radio_isr: blocking spi_transfer() and
+ * delay_us(TIMER0), so it takes the sensor bus the way a burst does
+ * (note 2)
+ */
+static void paw_bus_take(void) {
+
+    /* a burst in flight ends at IRQ_PRIO_SENSOR, above us */
+    for (;;) {
+        uint32_t primask = irq_save();
+        if (!spim_ctx.active) {
+            spim_ctx.active = 1;
+            irq_restore(primask);
+            break;
+        }
+        irq_restore(primask);
+    }
+
+}
+
+static void paw_dpi_work(uint32_t dpi) {
+
+    paw_bus_take();
+    paw_set_dpi(dpi);
+    spim_ctx.active = 0;
+
+}
+
+static void paw_downshift_work(uint32_t id) {
+
+    const uint8_t *d = profiles[id].downshift;
+
+    paw_bus_take();
+    paw_set_downshift(d[0], d[1], d[2]);
+    spim_ctx.active = 0;
+
+}
+
+/* after a battery reading: the record and the battery state ride on the
+ * next slot's packet, unless one is still waiting or on air (note 7)
+ */
+static void energy_checkpoint_work(uint32_t arg) {
+
+    (void) arg;
+    energy_checkpoint();
+
+}
+
+/* records ride on RX and don't come while wired or without replies,
+ * CYCCNT has to be checked in inside its wrap all the same
+ */
+static void energy_tick(void) {
+
+    if (++link_ctx.checkpoint >= CHECKPOINT_SLOTS && defer(energy_checkpoint_work, 0)) {
+        link_ctx.checkpoint = 0;
+    }
+
+}
+
+static void energy_work(uint32_t arg) {
+
+    (void) arg;
+
+    struct energy_record  r;
+    struct battery_status b;
+    energy_record(&r);
+
+    uint32_t uptime_ms = 0;
+    for (uint8_t i = ENERGY_CPU; i < ENERGY_STATES; i++) {
+        uptime_ms += r.ms[i];
+    }
+    battery_status(&b, r.charge_uc, uptime_ms);
+
+    uint32_t primask = irq_save();
+    if (!link_ctx.energy && mouse_pkt.LENGTH == MOUSE_PKT_LEN) {
+        my_memcpy((void *) &mouse_pkt.energy, &r, sizeof(r));
+        my_memcpy((void *) &mouse_pkt.battery, &b, sizeof(b));
+        link_ctx.energy = 1;
+    }
+    irq_restore(primask);
+
+}
+
+/* the rest of a profile, from radio_isr between RX END and the next slot:
+ * the radio is off. QDEC takes up to a sample to stop, qdec_isr sets
+ * SAMPLEPER on STOPPED (note 6)
+ */
+static void profile_apply(void) {
+
+    RADIO->TXPOWER = (uint8_t) profiles[curr_profile].txpower;
+
+    QDEC->INTENSET   = QDEC_INTENSET_STOPPED_Set;
+    QDEC->TASKS_STOP = 1;
+
+    /* idle stays in LOWPWR, link_active() picks the profile's */
+    if (!link_ctx.idle) {
+        power_setup();
+    }
+
+    TRACE(TR_PROFILE, curr_profile);
+
+}
+
+RAMFUNC static void fill_mouse_pkt(void) {
+
+    /* burst data is consumed, the next slot may start a new one */
+    spim_ctx.ready = 0;
 
     QDEC->TASKS_RDCLRACC = 1;
     mouse_pkt.btn_vbat = (l_click << 0) | (r_click << 1) | (vbat << 2);
     mouse_pkt.dx       = (int16_t) ((paw_data[3] << 8) | (paw_data[2] << 0));
     mouse_pkt.dy       = (int16_t) ((paw_data[5] << 8) | (paw_data[4] << 0));
-    mouse_pkt.wheel    = (int8_t) QDEC->ACCREAD;
+    mouse_pkt.wheel    = (int8_t) QDEC->ACCREAD + wake_wheel;
+    wake_wheel         = 0;
     op_mode = paw_data[0] & PAW3395_MOTION_OP_MODE_Msk;
 
+    /* link activity (note 5) */
+    if (mouse_pkt.dx || mouse_pkt.dy || mouse_pkt.wheel ||
+        (mouse_pkt.btn_vbat & 0b11) != link_ctx.buttons) {
+        link_ctx.quiet = 0;
+    }
+    else if (link_ctx.quiet < profiles[curr_profile].idle_after) {
+        link_ctx.quiet++;
+    }
+    link_ctx.buttons = mouse_pkt.btn_vbat & 0b11;
+
+}
+
+/* back to TIMER1 slots, with the crystal and CONSTLAT kept up between
+ * them. HFCLK is already running: a slot or link_pull_in() started it
+ */
+static void link_active(void) {
+
+    RTC1->EVTENCLR   = RTC_EVTENCLR_COMPARE0_Clear
+                     | RTC_EVTENCLR_COMPARE1_Clear;
+    QDEC->INTENCLR   = QDEC_INTENCLR_REPORTRDY_Clear;
+    GPIOTE->INTENCLR = (1 << CH_MOTION);
+    GPIOTE->CONFIG[CH_MOTION] = 0;
+    power_setup();
+    link_ctx.idle = 0;
+
+}
+
+/* the next slot `us` from now on RTC1, the crystal started just in time
+ * for it. TIMER1 is stopped and cleared, COMPARE1 starts it (note 5)
+ */
+static void idle_slot(uint32_t us) {
+
+    if (!link_ctx.idle) {
+        link_ctx.idle = 1;
+
+        QDEC->EVENTS_REPORTRDY = 0;
+        QDEC->INTENSET = QDEC_INTENSET_REPORTRDY_Set;
+
+        GPIOTE->CONFIG[CH_MOTION] = GPIOTE_CONFIG_MODE_Event
+                                  | GPIOTE_CONFIG_POLARITY_HiToLo
+                                  | (MOTION_PIN << GPIOTE_CONFIG_PSEL_Shft);
+        GPIOTE->EVENTS_IN[CH_MOTION] = 0;
+        GPIOTE->INTENSET = (1 << CH_MOTION);
+
+        POWER->TASKS_LOWPWR = 1;
+        energy_mode(ENERGY_IDLE, 0);
+    }
+    else {
+        /* COMPARE0 started the crystal for the slot just gone */
+        energy_xo((RTC1->COUNTER - RTC1->CC[0]) & RTC_COUNTER_Msk);
+    }
+
+    uint32_t slot = RTC1->COUNTER + RTC_TICKS(us);
+    RTC1->CC[0] = (slot - RTC_XO_TICKS) & RTC_COUNTER_Msk;
+    RTC1->CC[1] = slot & RTC_COUNTER_Msk;
+    RTC1->EVENTS_COMPARE[0] = 0;
+    RTC1->EVENTS_COMPARE[1] = 0;
+    RTC1->EVTENSET = RTC_EVTENSET_COMPARE0_Set
+                   | RTC_EVTENSET_COMPARE1_Set;
+
+    TIMER1->CC[0]   = WAKE_SLOT_US;
+    link_ctx.resync = 1;
+
+    CLOCK->TASKS_HFCLKSTOP = 1;
+
+}
+
+/* start TIMER1 for the next slot `us` from now, or hand it to RTC1 once
+ * the link has gone quiet. returns the time to it
+ */
+static uint32_t next_slot(uint32_t us) {
+
+    if (link_ctx.quiet >= profiles[curr_profile].idle_after) {
+        us += IDLE_SLOT_US - profiles[curr_profile].slot_polls * SLOT_US;
+        idle_slot(us);
+        return us;
+    }
+    if (link_ctx.idle) {
+        link_active();
+    }
+    TIMER1->CC[0] = us;
+    TIMER1->TASKS_START = 1;
+    return us;
+
+}
+
+/* input while the link idles: the next slot now, not at the heartbeat */
+static void link_pull_in(void) {
+
+    uint32_t primask = irq_save();
+
+    if (link_ctx.idle) {
+        RTC1->EVTENCLR = RTC_EVTENCLR_COMPARE0_Clear
+                       | RTC_EVTENCLR_COMPARE1_Clear;
+
+        /* COMPARE1 already started the slot, else start it early */
+        if (!RTC1->EVENTS_COMPARE[1]) {
+            CLOCK->TASKS_HFCLKSTART = 1;
+            TIMER1->CC[0]       = XO_STARTUP_US;
+            TIMER1->TASKS_START = 1;
+        }
+        link_ctx.quiet = 0;
+        link_active();
+    }
+
+    irq_restore(primask);
+
 }
 
 static void enter_sleep(void) {
 
-    /* disable irqs */
-    TIMER0->INTENCLR = 0xFFFFFFFF;
-    TIMER1->INTENCLR = 0xFFFFFFFF;
-    GPIOTE->INTENCLR = 0xFFFFFFFF;
-    SPIM0->INTENCLR  = 0xFFFFFFFF;
-    COMP->INTENCLR   = 0xFFFFFFFF;
-    RADIO->INTENCLR  = 0xFFFFFFFF;
-    NVIC->ICER[0]    = 0xFFFFFFFF;
-    NVIC->ICER[1]    = 0xFFFFFFFF;
+    /* park the irqs. peripheral INTEN and config stay as they are for
+     * exit_sleep() (note 3), only GPIOTE's go, its pins are let go below
+     */
+    sleep_ctx.iser[0] = NVIC->ISER[0];
+    sleep_ctx.iser[1] = NVIC->ISER[1];
+    NVIC->ICER[0]     = 0xFFFFFFFF;
+    NVIC->ICER[1]     = 0xFFFFFFFF;
+    GPIOTE->INTENCLR  = 0xFFFFFFFF;
+    TIMER2->INTENCLR  = TIMER_INTENCLR_COMPARE2_Clear;
+    QDEC->INTENCLR    = QDEC_INTENCLR_REPORTRDY_Clear
+                      | QDEC_INTENCLR_STOPPED_Clear;
+    RTC1->EVTENCLR    = RTC_EVTENCLR_COMPARE0_Clear
+                      | RTC_EVTENCLR_COMPARE1_Clear;
+    link_ctx.idle     = 0;
+    P0->DIRCLR        = (1 << LED_PIN);
+
+    /* RTC1 keeps counting for energy.c, its overflow every 512s too,
+     * and the cable going in wakes us (note 9)
+     */
+    NVIC->ISER[NVIC_RTC1_IRQ / 32] = (1 << (NVIC_RTC1_IRQ % 32));
+    NVIC->ISER[NVIC_CLOCK_POWER_IRQ / 32] = (1 << (NVIC_CLOCK_POWER_IRQ % 32));
+    sleep_ctx.asleep = 1;
+
+    TRACE(TR_SLEEP);
 
     /* low-power mode */
     POWER->TASKS_LOWPWR = 1;
+    energy_mode(ENERGY_SLEEP, 0);
 
     /* disable peripherals (radio/comp already disabled) */
     TIMER0->TASKS_SHUTDOWN  = 1;
     TIMER0->TASKS_CLEAR     = 1;
     TIMER1->TASKS_SHUTDOWN  = 1;    /* errata no.78 */  
     TIMER1->TASKS_CLEAR     = 1;
+    TIMER2->TASKS_SHUTDOWN  = 1;
+    TIMER2->TASKS_CLEAR     = 1;
     QDEC->TASKS_STOP        = 1;
     while (!(QDEC->EVENTS_STOPPED));
     QDEC->EVENTS_STOPPED    = 0;
+    QDEC->SAMPLEPER         = profiles[curr_profile].sampleper;  /* a profile's STOPPED never came */
     QDEC->ENABLE            = QDEC_ENABLE_ENABLE_Disabled;
     SPIM0->ENABLE           = SPIM_ENABLE_ENABLE_Disabled;
     CLOCK->TASKS_HFCLKSTOP  = 1;
 
-    /* set all GPIOs back to reset values */
+    /* set all GPIOs back to reset values, the encoder's keep their
+     * pull-ups (QDEC has let go of them) for the wake sense below
+     */
     uint8_t pins[] = {L_NO_PIN, L_NC_PIN, R_NO_PIN, R_NC_PIN,
-                      NCS_PIN,  MISO_PIN, MOSI_PIN, SCK_PIN,
-                      ENC_A_PIN, ENC_B_PIN};
+                      NCS_PIN,  MISO_PIN, MOSI_PIN, SCK_PIN};
     for (uint8_t i = 0; i < ARR_SIZE(pins); i++) {
         P0->PIN_CNF[pins[i]] = GPIO_PIN_CNF_DIR_Input
                              | GPIO_PIN_CNF_INPUT_Disconnect
@@ -416,12 +869,39 @@ static void enter_sleep(void) {
                          | GPIO_PIN_CNF_DRIVE_S0S1
                          | GPIO_PIN_CNF_SENSE_Disabled;
 
-    /* configure wakeup on GPIOTE PORT event */
+    /* configure wakeup on GPIOTE PORT event: motion, the contact each
+     * button's latch waits for, and the wheel leaving where it is (note 4)
+     */
     P0->PIN_CNF[MOTION_PIN] = GPIO_PIN_CNF_DIR_Input
                             | GPIO_PIN_CNF_INPUT_Connect
                             | GPIO_PIN_CNF_PULL_Disabled
                             | GPIO_PIN_CNF_DRIVE_S0S1
                             | GPIO_PIN_CNF_SENSE_Low;
+
+    uint8_t btn_pins[] = {l_click ? L_NC_PIN : L_NO_PIN,
+                          r_click ? R_NC_PIN : R_NO_PIN};
+    for (uint8_t i = 0; i < ARR_SIZE(btn_pins); i++) {
+        P0->PIN_CNF[btn_pins[i]] = GPIO_PIN_CNF_DIR_Input
+                                 | GPIO_PIN_CNF_INPUT_Connect
+                                 | GPIO_PIN_CNF_PULL_Pullup
+                                 | GPIO_PIN_CNF_DRIVE_S0S1
+                                 | GPIO_PIN_CNF_SENSE_Low;
+    }
+
+    uint32_t in   = P0->IN;
+    sleep_ctx.enc = (((in >> ENC_A_PIN) & 1) << 1) | ((in >> ENC_B_PIN) & 1);
+    P0->PIN_CNF[ENC_A_PIN] = GPIO_PIN_CNF_DIR_Input
+                           | GPIO_PIN_CNF_INPUT_Connect
+                           | GPIO_PIN_CNF_PULL_Pullup
+                           | GPIO_PIN_CNF_DRIVE_S0S1
+                           | ((sleep_ctx.enc & 2) ? GPIO_PIN_CNF_SENSE_Low : GPIO_PIN_CNF_SENSE_High);
+    P0->PIN_CNF[ENC_B_PIN] = GPIO_PIN_CNF_DIR_Input
+                           | GPIO_PIN_CNF_INPUT_Connect
+                           | GPIO_PIN_CNF_PULL_Pullup
+                           | GPIO_PIN_CNF_DRIVE_S0S1
+                           | ((sleep_ctx.enc & 1) ? GPIO_PIN_CNF_SENSE_Low : GPIO_PIN_CNF_SENSE_High);
+
+    P0->LATCH = P0->LATCH;
     GPIOTE->EVENTS_PORT = 0;
     GPIOTE->INTENSET = GPIOTE_INTENSET_PORT_Set;
     NVIC->ISER[NVIC_GPIOTE_IRQ / 32] = (1 << (NVIC_GPIOTE_IRQ % 32));
@@ -430,36 +910,142 @@ static void enter_sleep(void) {
 
 static void exit_sleep(void) {
 
+    /* the crystal takes longest, let it start while the pins come back */
+    CLOCK->EVENTS_HFCLKSTARTED = 0;
+    CLOCK->TASKS_HFCLKSTART    = 1;
+
+    /* what woke us, before the pins move (note 4) */
+    uint32_t latch = P0->LATCH;
+    uint32_t in    = P0->IN;
+    uint8_t  enc   = (((in >> ENC_A_PIN) & 1) << 1) | ((in >> ENC_B_PIN) & 1);
+    P0->LATCH      = latch;
+
+    if (latch & ((1 << L_NO_PIN) | (1 << L_NC_PIN))) {
+        l_click = !l_click;
+    }
+    if (latch & ((1 << R_NO_PIN) | (1 << R_NC_PIN))) {
+        r_click = !r_click;
+    }
+    wake_wheel     = enc_step[(sleep_ctx.enc << 2) | enc];
+    sleep_ctx.hold = WAKE_HOLD_SLOTS;
+    sleep_ctx.asleep = 0;
+    link_ctx.quiet = 0;
+
     /* disable GPIOTE PORT event */
     GPIOTE->INTENCLR = 0xFFFFFFFF;
     P0->PIN_CNF[MOTION_PIN] = GPIO_PIN_CNF_INPUT_Disconnect;
     GPIOTE->EVENTS_PORT = 0;
 
-    /* blink LED to show we still have power */
-    P0->DIRSET = (1 << LED_PIN);
-    delay_us(TIMER0, 100000);
-    P0->DIRCLR = (1 << LED_PIN);
-
-    /* re-enable peripherals */
+    /* only what enter_sleep() let go of, the rest kept its config */
     power_setup();
-    clock_setup();
-    timer_setup();
     gpio_setup();
     gpiote_setup();
-    qdec_setup();
-    spi_setup();
-    comp_setup();
-    radio_setup();
+    spi_pins();
+    SPIM0->ENABLE     = SPIM_ENABLE_ENABLE_Enabled;
+    QDEC->ENABLE      = QDEC_ENABLE_ENABLE_Enabled;
+    QDEC->TASKS_START = 1;
+
+    while (!(CLOCK->EVENTS_HFCLKSTARTED));
+    CLOCK->EVENTS_HFCLKSTARTED = 0;
+
+    TIMER2->TASKS_START = 1;
+
+    /* blink LED to show we still have power, without waiting on it */
+    led_blink(WAKE_BLINK_US);
+
+    TRACE(TR_WAKE, enc, latch);
+
+    /* first slot now, the dongle's reply sets the phase (note 3) */
+    radio_ctx.state = RADIO_STATE_DISABLED;
+    link_ctx.resync = 1;
+    TIMER1->CC[0]   = WAKE_SLOT_US;
+    TIMER1->CC[1]   = 0xFFFFFFFF;
+    TIMER1->EVENTS_COMPARE[0] = 0;
+    TIMER1->EVENTS_COMPARE[1] = 0;
+
+    NVIC->ISER[0] = sleep_ctx.iser[0];
+    NVIC->ISER[1] = sleep_ctx.iser[1];
 
-    /* restart isr timer */
+    TIMER1->TASKS_START = 1;
+
+}
+
+/* VBUS up: the slots stop where they are and the bursts follow the
+ * host's SOF to ep1 instead. the usb stack waits for its regulator
+ */
+static void wired_enter(void) {
+
+    /* before exit_sleep()'s first slot fires, it only starts a burst */
+    link_ctx.wired = 1;
+
+    if (sleep_ctx.asleep) {
+        exit_sleep();
+    }
+
+    uint32_t primask = irq_save();
+
+    TIMER1->TASKS_STOP  = 1;
+    TIMER1->TASKS_CLEAR = 1;
+    TIMER1->EVENTS_COMPARE[0] = 0;
+    TIMER1->EVENTS_COMPARE[1] = 0;
+    TIMER1->CC[0]       = SOF_US - WIRED_LEAD_US;
+    TIMER1->CC[1]       = 0xFFFFFFFF;
+    link_ctx.resync     = 0;
+
+    /* whatever the radio was doing, its DISABLED lands in the default case */
+    RADIO->SHORTS         = RADIO_SHORTS_RX;
+    RADIO->TASKS_DISABLE  = 1;
+    RADIO->EVENTS_TXREADY = 0;
+    radio_ctx.state       = RADIO_STATE_DISABLED;
+    if (mouse_pkt.LENGTH != MOUSE_PKT_LEN) {
+        mouse_pkt.LENGTH = MOUSE_PKT_LEN;
+        RADIO->PCNF1     = (RADIO->PCNF1 & ~RADIO_PCNF1_MAXLEN_Msk)
+                         | (MOUSE_PKT_LEN << RADIO_PCNF1_MAXLEN_Shft);
+    }
+
+    /* the crystal for USBD, an idle link had it stopped */
+    if (link_ctx.idle) {
+        link_active();
+    }
+    CLOCK->TASKS_HFCLKSTART = 1;
+
+    irq_restore(primask);
+
+    PPI->CHENSET = (1 << PPI_CH_SOF);
+
+}
+
+/* VBUS gone: usb off, the first slot right away as after a wake (note 3) */
+static void wired_leave(void) {
+
+    PPI->CHENCLR = (1 << PPI_CH_SOF);
+
+    uint32_t primask = irq_save();
+    link_ctx.wired = 0;
+    TIMER1->TASKS_STOP  = 1;
+    TIMER1->TASKS_CLEAR = 1;
+    TIMER1->EVENTS_COMPARE[0] = 0;
+    irq_restore(primask);
+
+    wired_stop();
+
+    link_ctx.quiet  = 0;
+    link_ctx.resync = 1;
+    TIMER1->CC[0]   = WAKE_SLOT_US;
     TIMER1->TASKS_START = 1;
 
 }
 
 int main(void) {
 
+    ISR_PROF_INIT();
+    TRACE_INIT();
+    energy_init();
+
+    irq_setup();
     power_setup();
     clock_setup();
+    rtc_setup();
     timer_setup();
     gpio_setup();
     gpiote_setup();
@@ -474,29 +1060,64 @@ int main(void) {
     /* start 1KHz timer isr, later synchronized w/ dongle */
     TIMER1->TASKS_START = 1;
 
+    vbus_setup();
+
     for (;;) {
-        __asm__("wfi");
+        wfi();
     }
 
 }
 
-void timer1_isr(void) {
+RAMFUNC void timer1_isr(void) {
+
+    ISR_PROF_SCOPE(TIMER1);
 
     /* TX slot reached -- start TX->RX sequence */
     if (TIMER1->EVENTS_COMPARE[0]) {
         TIMER1->EVENTS_COMPARE[0] = 0;
 
+        /* wired: WIRED_LEAD_US before the next SOF, burst only (note 9) */
+        if (link_ctx.wired) {
+            async_paw_motion_burst();
+            energy_tick();
+            return;
+        }
+
+        mouse_pkt.seq++;
+        if (link_ctx.energy) {
+            link_ctx.energy  = 0;
+            mouse_pkt.LENGTH = sizeof(mouse_pkt) - 1;
+            RADIO->PCNF1     = (RADIO->PCNF1 & ~RADIO_PCNF1_MAXLEN_Msk)
+                             | (mouse_pkt.LENGTH << RADIO_PCNF1_MAXLEN_Shft);
+        }
         RADIO->PACKETPTR = (uint32_t) &mouse_pkt;
+        RADIO->SHORTS    = RADIO_SHORTS_TX;
         RADIO->TASKS_TXEN = 1;
 
+        /* a wake, idle or pulled-in slot's CC[0] is not a period, a short
+         * one would even fire again inside the RX window (note 3)
+         */
+        if (link_ctx.resync) {
+            link_ctx.resync = 0;
+            TIMER1->CC[0]   = SLOT_US;
+        }
+
+        TRACE(TR_TX, mouse_pkt.seq);
+
         async_paw_motion_burst();
         radio_ctx.state = RADIO_STATE_TXRU;
+        energy_tick();
 
     }
 
     /* RX timeout -- enter RXDISABLE */
     if (TIMER1->EVENTS_COMPARE[1]) {
         TIMER1->EVENTS_COMPARE[1] = 0;
+
+        #if ISR_PROF
+        TIMER1->TASKS_CAPTURE[2] = 1;
+        ISR_PROF_LATENCY(TIMER1, (TIMER1->CC[2] - TIMER1->CC[1]) * (ISR_PROF_CPU_HZ / 1000000));
+        #endif
         
         TIMER1->TASKS_STOP  = 1;
         TIMER1->TASKS_CLEAR = 1;
@@ -505,23 +1126,45 @@ void timer1_isr(void) {
         RADIO->TASKS_DISABLE = 1;
         radio_ctx.state = RADIO_STATE_RXTO_RXDISABLE;
 
+        TRACE(TR_RX_TIMEOUT);
+
     }
 
 }
 
-void radio_isr(void) {
+RAMFUNC void radio_isr(void) {
+
+    ISR_PROF_SCOPE(RADIO);
 
     /* TX ramp-up complete */
     if (RADIO->EVENTS_TXREADY) {
         RADIO->EVENTS_TXREADY = 0;
 
+        TIMER2->TASKS_CAPTURE[1] = 1;
+
         if (spim_ctx.ready) {
             fill_mouse_pkt();
+            mouse_pkt.sensor_us = MIN(TIMER2->CC[1] - TIMER2->CC[0], 255);
+        }
+        else {
+            /* burst not done yet: don't resend the last slot's motion,
+             * this burst goes out with the next slot instead
+             */
+            mouse_pkt.dx        = 0;
+            mouse_pkt.dy        = 0;
+            mouse_pkt.wheel     = 0;
+            mouse_pkt.sensor_us = 0;
         }
 
+        /* PACKETPTR is double-buffered, START has taken the TX one:
+         * the reply lands here once the short has the RX up
+         */
         RADIO->TASKS_START = 1;
+        RADIO->PACKETPTR   = (uint32_t) &dongle_pkt;
         radio_ctx.state = RADIO_STATE_TX;
 
+        TRACE(TR_TX_READY, mouse_pkt.sensor_us != 0, mouse_pkt.sensor_us);
+
     }
 
     /* prev xfer complete */
@@ -530,37 +1173,66 @@ void radio_isr(void) {
 
         switch (radio_ctx.state) {
         
-            /* packet sent, start RX and RX timeout
+            /* packet sent, the short has the RX ramping up already:
+             * take it off before the RX's own DISABLED, start the RX timeout
              */
-            case RADIO_STATE_TX:
+            case RADIO_STATE_TX: {
+
+                RADIO->SHORTS = RADIO_SHORTS_RX;
+
+                uint8_t len = mouse_pkt.LENGTH;
+                if (len != MOUSE_PKT_LEN) {
+                    mouse_pkt.LENGTH = MOUSE_PKT_LEN;
+                    RADIO->PCNF1     = (RADIO->PCNF1 & ~RADIO_PCNF1_MAXLEN_Msk)
+                                     | (MOUSE_PKT_LEN << RADIO_PCNF1_MAXLEN_Shft);
+                }
 
-                if (op_mode == PAW3395_MOTION_OP_MODE_Rest3) {
+                /* not with the sensor bus taken, see note 2, nor right
+                 * after a click or a detent woke us (note 4)
+                 */
+                if (sleep_ctx.hold) {
+                    sleep_ctx.hold -= MIN(sleep_ctx.hold, link_ctx.idle ? IDLE_SLOT_US / SLOT_US
+                                                                        : profiles[curr_profile].slot_polls);
+                }
+                else if (op_mode == PAW3395_MOTION_OP_MODE_Rest3 && !spim_ctx.active) {
+                    /* its DISABLED lands in the default case after the wake */
+                    RADIO->TASKS_DISABLE = 1;
+                    radio_ctx.state = RADIO_STATE_DISABLED;
+                    TRACE(TR_TX_END);
+                    energy_tx(RADIO_AIR_US(len), profiles[curr_profile].txpower);
+                    energy_add(ENERGY_RAMP, RAMP_US);
                     enter_sleep();
                     return;
                 }
 
-                RADIO->PACKETPTR  = (uint32_t) &dongle_pkt;
-                RADIO->TASKS_RXEN = 1;
-
                 TIMER1->EVENTS_COMPARE[1] = 0;
-                TIMER1->CC[1] = RX_TIMEOUT_US;
+                TIMER1->CC[1] = profiles[curr_profile].rx_us;
                 TIMER1->TASKS_START = 1;
 
                 radio_ctx.state = RADIO_STATE_RX;
+
+                TRACE(TR_TX_END);
+                energy_tx(RADIO_AIR_US(len), profiles[curr_profile].txpower);
+                energy_add(ENERGY_RAMP, 2 * RAMP_US);
+                TRACE(TR_RX);
                 break;
+            }
 
             /* disable task from RX timeout completed, start TX timer 
              */
             case RADIO_STATE_RXTO_RXDISABLE:
 
-                TIMER1->TASKS_START = 1;
+                next_slot(TIMER1->CC[0]);
                 radio_ctx.state = RADIO_STATE_DISABLED;
+                energy_add(ENERGY_RX, profiles[curr_profile].rx_us - RAMP_US);
+                TRACE(TR_RX_END, 0, 0);
                 break;
 
             /* packet recv'd, evaluate pkt and start TX timer 
              */
             case RADIO_STATE_RX:
                 
+                TIMER1->TASKS_CAPTURE[3] = 1;
                 TIMER1->TASKS_STOP  = 1;
                 TIMER1->TASKS_CLEAR = 1;
                 TIMER1->EVENTS_COMPARE[1] = 0;
@@ -569,27 +1241,43 @@ void radio_isr(void) {
                 radio_ctx.state = RADIO_STATE_DISABLED;
 
                 if (!(RADIO->CRCSTATUS)) {
-                    TIMER1->TASKS_START = 1;
+                    next_slot(TIMER1->CC[0]);
+                    energy_add(ENERGY_RX, TIMER1->CC[3] - RAMP_US);
+                    TRACE(TR_RX_END, 0, 0);
                     return;
                 }
 
-                if (dongle_pkt.cc < RX_TIMEOUT_US + 50) {
-                    dongle_pkt.cc = RX_TIMEOUT_US + 50;
+                if (dongle_pkt.cc < profiles[curr_profile].rx_us + 50) {
+                    dongle_pkt.cc = profiles[curr_profile].rx_us + 50;
                 }
 
-                TIMER1->CC[0] = dongle_pkt.cc;
-                TIMER1->TASKS_START = 1;
+                /* radio and QDEC now, with the radio off and before the
+                 * slot rate is used. the sensor's part takes its bus (note 6)
+                 */
+                if (curr_profile != dongle_pkt.profile && dongle_pkt.profile < PROFILE_COUNT &&
+                    defer(paw_downshift_work, dongle_pkt.profile)) {
+                    curr_profile = dongle_pkt.profile;
+                    profile_apply();
+                }
+
+                uint32_t us = next_slot(dongle_pkt.cc + (profiles[curr_profile].slot_polls - 1) * SLOT_US);
+
+                energy_add(ENERGY_RX, TIMER1->CC[3] - RAMP_US);
+
+                TRACE(TR_RX_END, 1, dongle_pkt.cc);
+                TRACE(TR_SLOT, us);
 
-                if (curr_dpi != dongle_pkt.dpi) {
-                    paw_set_dpi(dongle_pkt.dpi);
+                /* both too slow for this level (note 2) */
+                if (curr_dpi != dongle_pkt.dpi &&
+                    defer(paw_dpi_work, dongle_pkt.dpi)) {
                     curr_dpi = dongle_pkt.dpi;
                 }
 
-                elapsed_us += dongle_pkt.cc;
-                if (elapsed_us > VBAT_INTERVAL) {
+                elapsed_us += us;
+                if (elapsed_us > VBAT_INTERVAL && defer(async_get_vbat, 0)) {
                     elapsed_us = 0;
-                    async_get_vbat();
                 }
+
                 break;
             
             default:
@@ -601,7 +1289,9 @@ void radio_isr(void) {
     
 }
 
-void spi0_spim0_spis0_twi0_twim0_twis0_isr(void) {
+RAMFUNC void spi0_spim0_spis0_twi0_twim0_twis0_isr(void) {
+
+    ISR_PROF_SCOPE(SPIM0);
 
     if (SPIM0->EVENTS_END) {
         SPIM0->EVENTS_END = 0;
@@ -618,10 +1308,24 @@ void spi0_spim0_spis0_twi0_twim0_twis0_isr(void) {
         }
         else { /* burst received, data ready */
 
+            TIMER2->TASKS_CAPTURE[0] = 1;
+
+            /* ready before !active: timer1_isr can preempt us and must
+             * not see an idle sensor with no data (note 2)
+             */
             P0->OUTSET = (1 << NCS_PIN);
             SPIM0->INTENCLR = SPIM_INTENCLR_End_Clear;
-            spim_ctx.active = 0;
             spim_ctx.ready  = 1;
+            spim_ctx.active = 0;
+
+            energy_add(ENERGY_SPI, (1 + BURST_SIZE) * SPI_BYTE_US);
+            TRACE(TR_BURST_END);
+
+            /* wired: no TXREADY to pick it up, straight to ep1 (note 9) */
+            if (link_ctx.wired) {
+                fill_mouse_pkt();
+                wired_report(mouse_pkt.btn_vbat & 0b11, mouse_pkt.dx, mouse_pkt.dy, mouse_pkt.wheel);
+            }
 
         }
 
@@ -629,12 +1333,19 @@ void spi0_spim0_spis0_twi0_twim0_twis0_isr(void) {
 
 }
 
-void timer0_isr(void) {
+RAMFUNC void timer0_isr(void) {
+
+    ISR_PROF_SCOPE(TIMER0);
 
     /* t_srad elapsed, receive burst data */
     if (TIMER0->EVENTS_COMPARE[0]) {
         TIMER0->EVENTS_COMPARE[0] = 0;
 
+        #if ISR_PROF
+        TIMER0->TASKS_CAPTURE[1] = 1;
+        ISR_PROF_LATENCY(TIMER0, (TIMER0->CC[1] - TIMER0->CC[0]) * (ISR_PROF_CPU_HZ / 1000000));
+        #endif
+
         TIMER0->TASKS_STOP  = 1;
         TIMER0->TASKS_CLEAR = 1;
         TIMER0->INTENCLR = TIMER_INTENCLR_COMPARE0_Clear;
@@ -650,8 +1361,25 @@ void timer0_isr(void) {
 
 }
 
+void timer2_isr(void) {
+
+    ISR_PROF_SCOPE(TIMER2);
+
+    /* wake blink over */
+    if (TIMER2->EVENTS_COMPARE[2]) {
+        TIMER2->EVENTS_COMPARE[2] = 0;
+        TIMER2->INTENCLR = TIMER_INTENCLR_COMPARE2_Clear;
+        P0->DIRCLR = (1 << LED_PIN);
+    }
+
+}
+
 void gpiote_isr(void) {
 
+    ISR_PROF_SCOPE(GPIOTE);
+
+    uint8_t clicks = (l_click << 0) | (r_click << 1);
+
     /* SPDT 2-pin debounce (SR-latch emulation) */
 
     /* switch closure:
@@ -718,6 +1446,16 @@ void gpiote_isr(void) {
 
     }
 
+    /* new motion, only armed while the link idles */
+    if (GPIOTE->EVENTS_IN[CH_MOTION]) {
+        GPIOTE->EVENTS_IN[CH_MOTION] = 0;
+        link_pull_in();
+    }
+
+    if (clicks != ((l_click << 0) | (r_click << 1))) {
+        link_pull_in();
+    }
+
     if (GPIOTE->EVENTS_PORT) {
         GPIOTE->EVENTS_PORT = 0;
         exit_sleep();
@@ -725,29 +1463,295 @@ void gpiote_isr(void) {
 
 }
 
+/* RTC1 wrapped, every 512s, asleep or not */
+void rtc1_isr(void) {
+
+    ISR_PROF_SCOPE(RTC1);
+
+    energy_overflow();
+
+}
+
+/* the wheel moved while the link idles, or a profile's stop is done */
+void qdec_isr(void) {
+
+    ISR_PROF_SCOPE(QDEC);
+
+    if (QDEC->EVENTS_REPORTRDY) {
+        QDEC->EVENTS_REPORTRDY = 0;
+        link_pull_in();
+    }
+
+    /* SAMPLEPER only takes while stopped (profile_apply) */
+    if (QDEC->EVENTS_STOPPED) {
+        QDEC->EVENTS_STOPPED = 0;
+        QDEC->INTENCLR       = QDEC_INTENCLR_STOPPED_Clear;
+        QDEC->SAMPLEPER      = profiles[curr_profile].sampleper;
+        QDEC->TASKS_START    = 1;
+    }
+
+}
+
 void comp_lpcomp_isr(void) {
 
-    /* prev voltage comparison finished,
-     * stop if vbat was found or we've gone below 3.0V, 
-     * otherwise, decrement the ladder and try again 
+    ISR_PROF_SCOPE(COMP);
+
+    /* prev voltage comparison finished, keep the half vbat is in
+     * and compare the middle of it, done when one step is left (note 8)
      */
     if (COMP->EVENTS_READY) {
         COMP->EVENTS_READY = 0;
 
-        uint32_t res = COMP->RESULT;
-        if (res || comp_ctx.ladder < 31) {
+        if (COMP->RESULT) {
+            comp_ctx.lo = comp_ctx.ladder;
+        }
+        else {
+            comp_ctx.hi = comp_ctx.ladder - 1;
+        }
+
+        if (comp_ctx.lo == comp_ctx.hi) {
 
             COMP->ENABLE    = COMP_ENABLE_ENABLE_Disabled;
             comp_ctx.active = 0;
 
-            vbat = comp_ctx.ladder;
+            vbat = comp_ctx.lo;
+            battery_reading(vbat);
+            defer(energy_work, 0);
             return;
         }
-        
-        comp_ctx.ladder--;
+
+        comp_ctx.ladder = (comp_ctx.lo + comp_ctx.hi + 1) / 2;
         comp_start(comp_ctx.ladder);
 
     }
 
 }
 
+/* the cable in or out, or its regulator ready. the events only say that
+ * something changed, USBREGSTATUS says where it's at (note 9)
+ */
+void clock_power_isr(void) {
+
+    ISR_PROF_SCOPE(POWER);
+
+    POWER->EVENTS_USBDETECTED = 0;
+    POWER->EVENTS_USBREMOVED  = 0;
+    POWER->EVENTS_USBPWRRDY   = 0;
+
+    uint32_t status = POWER->USBREGSTATUS;
+
+    if ((status & POWER_USBREGSTATUS_VBUSDETECT_) && !link_ctx.wired) {
+        wired_enter();
+    }
+    else if (!(status & POWER_USBREGSTATUS_VBUSDETECT_) && link_ctx.wired) {
+        wired_leave();
+    }
+
+    if ((status & POWER_USBREGSTATUS_OUTPUTRDY_) && link_ctx.wired) {
+        wired_start();
+    }
+
+}
+
+
+/* note 1 : sensor age
+ *
+ *          the motion burst is started at the TX slot and normally completes well
+ *          within the TX ramp-up, so TXREADY finds `spim_ctx.ready` set and sends
+ *          it. `sensor_us` tells the dongle how long the data sat between burst
+ *          completion and TX start (TIMER2 captures), for its latency histograms.
+ *
+ *          if the burst runs late, the packet goes out without motion rather than
+ *          repeating the last slot's (the dongle accumulates, a resend would be
+ *          counted twice). the late burst is held (`ready` stays set, no new burst
+ *          is started) and sent on the next slot, with `sensor_us` saturated.
+ *
+ * note 2 : interrupt priorities
+ *
+ *          TXREADY has to fill the packet inside the 40us fast ramp-up and DISABLED
+ *          has to arm the RX timeout, so the radio and its slot timer get the top
+ *          level. the RX itself is not up to radio_isr: the reply's preamble is done
+ *          41us after our END, TXDISABLE and the RX ramp-up take 44 of it, so the
+ *          TX packet's DISABLED_RXEN short starts it and tracing or profiling at isr
+ *          entry can't make us miss a reply. the sensor burst comes next: its
+ *          deadline is the next TXREADY, hundreds of us away. buttons (GPIOTE) and
+ *          the vbat ladder (COMP) only set flags the next packet picks up, they go
+ *          last.
+ *
+ *            IRQ_PRIO_RADIO   RADIO, TIMER1
+ *            IRQ_PRIO_SENSOR  SPIM0, TIMER0 (t_srad), USBD (wired, note 9)
+ *            IRQ_PRIO_SLOW    GPIOTE, COMP, POWER (VBUS)
+ *            IRQ_PRIO_DEFER   SWI0 (defer.c): dpi change, vbat start
+ *
+ *          what crosses levels is single bytes plus the `spim_ctx` handshake: a
+ *          burst's end sets `ready` before clearing `active`, so a slot that
+ *          preempts in between holds off instead of starting a burst over unread
+ *          data. a late burst is already handled by note 1.
+ *
+ *          paw_set_dpi() used to run inside radio_isr, at the top level: a dozen
+ *          blocking SPI bytes and delay_us() calls, with TIMER1's RX timeout and the
+ *          next TXREADY waiting behind it. radio_isr now only posts it (and the vbat
+ *          ladder start) to the defer queue, drained at the lowest level. the dpi
+ *          work shares SPIM0, NCS and TIMER0 with the burst, so it claims
+ *          `spim_ctx.active` under PRIMASK first (waiting out a burst in flight);
+ *          slots that come up meanwhile skip their burst, the sensor keeps
+ *          accumulating and the next burst reports it. sleep waits for the bus to
+ *          be released, TIMER0 and SPIM0 are shut down there. a post that finds the
+ *          queue full is retried on the next packet.
+ *
+ * note 3 : waking up
+ *
+ *          exit_sleep() used to blink the LED for 100ms with delay_us(), inside
+ *          gpiote_isr, then run every *_setup() again and restart TIMER1 a whole
+ *          slot out: the motion that woke us reached the dongle >100ms later.
+ *
+ *          system ON sleep keeps every register, so enter_sleep() now only parks
+ *          the NVIC enables and lets go of what draws current: HFCLK, the timers,
+ *          QDEC, SPIM0 and the pins (pull-ups on closed NC contacts). exit_sleep()
+ *          starts the crystal first, gives the pins back while it settles, and
+ *          hands the blink to TIMER2 CC[2]. the first slot fires right after, its
+ *          burst picks up the motion that pulled MOTION low. that slot puts
+ *          CC[0] back to SLOT_US (`resync`), TIMER1 restarts for the RX timeout
+ *          from 0. idle and pulled-in slots (note 5) start the same way.
+ *
+ *          the slot phase isn't carried over: sleep only comes after the sensor's
+ *          Rest3 downshift, well over a minute of idle, and 20ppm of crystal is a
+ *          whole slot in under a minute. the dongle listens between replies, so
+ *          the first packet gets through wherever it lands and its reply's `cc`
+ *          puts the next one back on the poll. mouse-sim -w measures the wake up
+ *          to the host's read.
+ *
+ * note 4 : wake sources
+ *
+ *          only MOTION used to be sensed in sleep, with the buttons and the
+ *          encoder disconnected: a click or a scroll did nothing until the mouse
+ *          was moved. now each button senses the contact its SR latch waits for,
+ *          NO for a press or NC for the release of one held into sleep, and the
+ *          encoder pins sense the opposite of the level they went to sleep at.
+ *          the open contact is the one pulled up, so none of it costs current.
+ *          a wheel parked off its detent with a contact closed would: 3V over
+ *          the ~13k pull-up.
+ *
+ *          exit_sleep() reads LATCH and IN before touching a pin. a latched
+ *          button pin is its latch's edge, taken as gpiote_isr would have, so
+ *          gpiote_setup() arms the other contact. QDEC was stopped and only
+ *          samples from its restart on, the step out of the detent comes from
+ *          AB before and after through QDEC's own table, into `wake_wheel`
+ *          for the first packet. a sensor still in Rest3 would put us straight
+ *          back to sleep after that one packet (a lost one loses the click), so
+ *          a wake holds off sleep for WAKE_HOLD_SLOTS.
+ *
+ * note 5 : idle link
+ *
+ *          between sleep and motion the link used to run 1000 slots a second
+ *          with the crystal and CONSTLAT up throughout, ~2.2mA for a mouse at
+ *          rest on the desk until the sensor's Rest3, minutes later. now after
+ *          the profile's `idle_after` slots with no motion, wheel or button
+ *          change the next slot
+ *          goes to RTC1 instead, IDLE_SLOT_US on from the dongle's `cc` so it
+ *          still lands on a poll. between idle slots HFCLK is stopped and POWER
+ *          is in LOWPWR, only the RC oscillator and RTC1 run.
+ *
+ *          RTC1 COMPARE0 starts the crystal over PPI RTC_XO_TICKS before
+ *          COMPARE1 starts TIMER1, whose WAKE_SLOT_US CC[0] sends at once. the
+ *          crystal's lead is XO_STARTUP_US, the datasheet's typical with margin;
+ *          a crystal slower than that would cost the slot's packet, not hang.
+ *          the RC oscillator's +-2% only moves where an idle slot lands, the
+ *          reply's `cc` puts it back each time.
+ *
+ *          idle waits up to IDLE_SLOT_US for the next slot, so input pulls it in:
+ *          MOTION (a GPIOTE channel armed only while idle), a button's latch
+ *          edge or QDEC's REPORTRDY. link_pull_in() takes RTC1's events off and,
+ *          unless COMPARE1 already started the slot, starts the crystal and
+ *          TIMER1 with XO_STARTUP_US to go. that input goes out ~440us later.
+ *          the slot after it is a normal one: CONSTLAT back on, `idle_after` more
+ *          quiet slots before the next heartbeat. sleep comes from an idle slot
+ *          the same way it did from a busy one, WAKE_HOLD_SLOTS counted in time.
+ *
+ * note 6 : profiles
+ *
+ *          one set of numbers used to fit every use: a slot per host poll,
+ *          CONSTLAT and the crystal's worth of margin throughout, 0dBm. the
+ *          host now picks a profile with the dongle's vendor request 0x05
+ *          (wValue 0..2), the dongle puts it in every reply and radio_isr takes
+ *          a change at RX end: TXPOWER for the next slot, QDEC stopped,
+ *          CONSTLAT or LOWPWR, and the sensor's downshift times through the
+ *          defer queue. QDEC can take a sample to stop, up to 512us, too long
+ *          to wait at the radio's level: qdec_isr sets SAMPLEPER on STOPPED
+ *          and restarts it. enter_sleep() parks the irqs first and sets it
+ *          itself if the stop was still under way. a post that
+ *          finds the queue full leaves the profile where it was, the next
+ *          reply asks again. the rest is read where it's used.
+ *
+ *                          slot  TX     RX window  idle after  rest1/rest2/rest3
+ *            competitive   1ms   +4dBm  250us      1s          26s / 30s / 64s
+ *            balanced      1ms    0dBm  200us      100ms       15s / 30s / 64s
+ *            eco           2ms   -4dBm  150us      40ms         5s / 10s / 32s
+ *
+ *          eco sends every other poll: the reply's `cc` is to the next poll,
+ *          one more poll is added. the RX window still covers the reply, which
+ *          ends ~93us after TX END. QDEC at 512us follows the wheel up to
+ *          ~1000 detents/s, more than a finger turns it.
+ *
+ *          mouse-sim -f, 2s of the built-in sweep (mean nRF current, report
+ *          age at the host), and a detent after 4s (idle current until then):
+ *
+ *                          moving           age     idle     detent at host
+ *            competitive   2.51mA           1.63ms  1.00mA   1.0ms
+ *            balanced      2.30mA           1.63ms  0.46mA   2.0ms
+ *            eco           1.13mA           2.13ms  0.33mA   1.0ms
+ *
+ *          competitive idles after a second, so its "idle" is mostly busy slots.
+ *
+ * note 7 : energy record
+ *
+ *          energy.c counts time per state since boot and charges it from a
+ *          current table (energy.c note 1). each battery reading (every
+ *          VBAT_INTERVAL of slots, note 8) posts energy_work, which builds a
+ *          record and the battery state at the top level (the divides take a
+ *          while) and hands them to the next slot: timer1_isr sends that one
+ *          packet with LENGTH and MAXLEN covering both, radio_isr puts them
+ *          back at TX END. the dongle keeps the last of each for its vendor
+ *          requests 0xC0/0x06 (tools/libusb-energy.c) and 0xC0/0x01.
+ *
+ *          the counts are cumulative, so a record that doesn't make it only
+ *          delays the numbers, the next one has them. a dongle whose MAXLEN
+ *          still stops at 8 takes the longer packet as a CRC error, one slot
+ *          every VBAT_INTERVAL.
+ *
+ * note 8 : battery
+ *
+ *          the COMP threshold used to walk down from step 44 (4.22V) one step
+ *          per READY, up to 15 comparisons and interrupts, and stopped at 30
+ *          (3.0V). it's now a binary search of the whole 6-bit TH: six, always,
+ *          and no floor. `vbat` and btn_vbat[7:2] are still that raw step.
+ *          battery.c turns the steps into a filtered voltage, a state of
+ *          charge and the time left at the mean current from the energy
+ *          record, which go out with the record so the host reads mV, % and
+ *          minutes from the dongle instead of doing the ladder math itself.
+ *
+ * note 9 : wired
+ *
+ *          with the cable in the mouse is a USB HID mouse of its own (wired.c,
+ *          on the dongle's usb.c / usb_ep0.c) and the radio stays off. VBUS
+ *          comes in through clock_power_isr, which goes by USBREGSTATUS rather
+ *          than which event it was: USBDETECTED stops the slots wherever they
+ *          are (TIMER1, the radio, an idle link's RTC1, or sleep through
+ *          exit_sleep()), USBPWRRDY starts USBD, USBREMOVED stops it and
+ *          starts the first slot as after a wake (note 3). POWER stays enabled
+ *          in sleep for that.
+ *
+ *          the slot timer is the frame timer meanwhile: PPI_CH_SOF starts
+ *          TIMER1 on every SOF, its COMPARE0 (SOF_US - WIRED_LEAD_US) starts
+ *          the burst and the shorts stop and clear it for the next SOF. the
+ *          burst's end hands the motion to ep1 at IRQ_PRIO_SENSOR, USBD's
+ *          level, so the report is armed ~80us before the host's poll of the
+ *          next frame: one SOF-aligned report per frame, no air or dongle in
+ *          between. mouse-sim -U measures it (sim/README.md, wired).
+ *
+ *          energy.c keeps counting while wired as if on the battery, and there
+ *          are no battery readings or records then (both ride on RX): the
+ *          first record after the cable is out covers the wired time too. the
+ *          bursts still check energy.c in every CHECKPOINT_SLOTS (energy_tick),
+ *          so the cable can stay in past CYCCNT's wrap.
+ */
@@ -257,9 +257,7 @@ void paw_init(void) {
     /* run->rest1 downshift = 15s, rest1->rest2 = 30s, rest2->rest3 = 64s */
     paw_modify(PAW3395_RUN_DOWNSHIFT_MULT, PAW3395_RUN_DOWNSHIFT_MULT_RUN_M_Msk, 
                PAW3395_RUN_DOWNSHIFT_MULT_RUN_M_2048);
-    paw_write(PAW3395_RUN_DOWNSHIFT, 146);
-    paw_write(PAW3395_REST1_DOWNSHIFT, 234);
-    paw_write(PAW3395_REST2_DOWNSHIFT, 10);
+    paw_set_downshift(146, 234, 10);
 
     /* clear bit that causes inversion of X axis */
     paw_modify(PAW3395_AXIS_CONTROL, PAW3395_AXIS_CONTROL_INVX_, 0);
@@ -289,3 +287,15 @@ void paw_set_dpi(uint16_t dpi) {
 
 }
 
+/* time in each mode before the next one down, with the multipliers
+ * paw_init() leaves: run x 102.4ms (2048 x 50us), rest1 x 128ms,
+ * rest2 x 6.4s
+ */
+void paw_set_downshift(uint8_t run, uint8_t rest1, uint8_t rest2) {
+
+    paw_write(PAW3395_RUN_DOWNSHIFT,   run);
+    paw_write(PAW3395_REST1_DOWNSHIFT, rest1);
+    paw_write(PAW3395_REST2_DOWNSHIFT, rest2);
+
+}
+
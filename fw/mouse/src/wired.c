@@ -0,0 +1,250 @@
+/********************************************************************
+ ** file         : wired.c
+ ** description  : USB HID mouse on the cable, the dongle's usb
+ **                stack and HID interface under a PID of its own,
+ **                see note 1
+ **
+ ********************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "device.h"
+#include "utils.h"
+#include "usb.h"
+#include "hid.h"
+#include "hid_mouse.h"
+#include "isr_prof.h"
+#include "wired.h"
+
+/* ep1 report bookkeeping, the dongle's hid_ctx without the stamps */
+struct wired_ctx {
+    uint8_t  started;       /* usb_start() done, until wired_stop()         */
+    uint8_t  armed;         /* ep1 holds a report the host hasn't read yet  */
+    uint8_t  pending;       /* motion/buttons not yet handed to ep1         */
+    uint8_t  idle_rate;     /* always 0, see note 1                         */
+    uint8_t  buttons;
+    int32_t  x;
+    int32_t  y;
+    int32_t  wheel;
+};
+
+static struct wired_ctx w_ctx = {0};
+
+/* our handle (ptr) to the device alloc'd in `usb.c` */
+static usb_device *usb_dev;
+
+/* the dongle's report without the battery feature: the host can see
+ * the battery itself over the cable (note 1)
+ */
+static const uint8_t wired_report_descriptor[] = HID_MOUSE_REPORT_DESCRIPTOR();
+
+static struct hid_mouse_report hid_report = {0};
+
+static const struct usb_device_descriptor device_descriptor = HID_MOUSE_DEVICE_DESCRIPTOR(0x572C);
+
+struct config_block {
+    struct usb_configuration_descriptor config;
+    struct usb_interface_descriptor     if0;
+    struct usb_hid_descriptor           if0_hid;
+    struct usb_endpoint_descriptor      if0_hid_ep;
+} __attribute__((packed));
+
+static const struct config_block wired_cfg_block = {
+
+    .config = {
+        .bLength                = USB_DT_CONFIGURATION_SIZE,
+        .bDescriptorType        = USB_DT_CONFIGURATION,
+        .wTotalLength           = sizeof(struct usb_configuration_descriptor) +
+                                  sizeof(struct usb_interface_descriptor) +
+                                  sizeof(struct usb_hid_descriptor) +
+                                  sizeof(struct usb_endpoint_descriptor),
+        .bNumInterfaces         = 1,
+        .bConfigurationValue    = 1,
+        .iConfiguration         = 0,
+        .bmAttributes           = 0x80,
+        .bMaxPower              = 0x32,
+    },
+
+    HID_MOUSE_IF0(wired_report_descriptor),
+
+};
+
+static enum usb_req_result
+handle_hid_get_report_descriptor(usb_device *dev, struct usb_setup_data *req, uint8_t **buf,
+                                 uint16_t *len, usb_ep0_req_complete_callback *cb) {
+    (void)dev;
+    (void)cb;
+
+    return hid_mouse_get_report_descriptor(req, wired_report_descriptor,
+                                           sizeof(wired_report_descriptor), buf, len);
+}
+
+static enum usb_req_result
+handle_hid_class_request(usb_device *dev, struct usb_setup_data *req, uint8_t **buf,
+                         uint16_t *len, usb_ep0_req_complete_callback *cb) {
+    (void)dev;
+    (void)cb;
+
+    switch (req->bRequest) {
+
+        case USB_HID_REQ_TYPE_SET_IDLE:
+            /* reports go out on change only (note 1) */
+            return (req->wValue >> 8) ? USB_REQ_ERR : USB_REQ_HANDLED;
+
+        case USB_HID_REQ_TYPE_GET_IDLE:
+            *buf = &w_ctx.idle_rate;
+            *len = sizeof(w_ctx.idle_rate);
+            return USB_REQ_HANDLED;
+
+        case USB_HID_REQ_TYPE_GET_REPORT:
+            /* HID1_11 7.2.1: the last input report, the only one there is */
+            if ((req->wValue >> 8) != USB_HID_REPORT_TYPE_INPUT) {
+                return USB_REQ_ERR;
+            }
+            *buf = (uint8_t *) &hid_report;
+            *len = MIN(*len, sizeof(hid_report));
+            return USB_REQ_HANDLED;
+
+        default:
+            return USB_REQ_DEFER;
+    }
+}
+
+/* hand everything accumulated since the last report to ep1. if the
+ * driver refuses the write, it all stays pending for the next burst
+ */
+static void wired_arm_report(usb_device *dev) {
+
+    if (!hid_mouse_write_report(dev, &hid_report, w_ctx.buttons,
+                                &w_ctx.x, &w_ctx.y, &w_ctx.wheel)) {
+        return;
+    }
+
+    w_ctx.pending = w_ctx.x || w_ctx.y || w_ctx.wheel;
+    w_ctx.armed   = 1;
+
+}
+
+/* ep1 IN complete: the host just read our report. the next burst arms
+ * the next one, arming what's pending here would keep a report a frame
+ * old queued ahead of every burst
+ */
+static void wired_report_sent(usb_device *dev, uint8_t ep) {
+
+    (void)dev;
+    (void)ep;
+
+    w_ctx.armed = 0;
+
+}
+
+static void wired_set_configuration(usb_device *dev, uint16_t wValue) {
+
+    (void)wValue;
+
+    usb_setup_ep(dev, 0x81, USB_EP_ATTR_INTERRUPT, sizeof(struct hid_mouse_report), wired_report_sent);
+
+    /* what moved while the host enumerated goes out first */
+    w_ctx.armed = 0;
+    if (w_ctx.pending) {
+        wired_arm_report(dev);
+    }
+
+}
+
+/* VBUS up and the usb regulator ready, from clock_power_isr */
+void wired_start(void) {
+
+    if (w_ctx.started) {
+        return;
+    }
+
+    /* a fresh device every time the cable goes in, handlers included */
+    usb_dev = usb_init(&device_descriptor, &wired_cfg_block.config,
+                       hid_mouse_strings, HID_MOUSE_STRINGS);
+
+    usb_register_set_config_callback(usb_dev, wired_set_configuration);
+
+    /* registered once here, not per SET_CONFIGURATION like the dongle:
+     * a host that configures us again doesn't run out of slots
+     */
+    usb_register_ep0_req_handler(usb_dev,
+        USB_REQ_TYPE_IN        | USB_REQ_TYPE_STANDARD | USB_REQ_TYPE_INTERFACE,
+        USB_REQ_TYPE_DIRECTION | USB_REQ_TYPE_TYPE     | USB_REQ_TYPE_RECIPIENT,
+        handle_hid_get_report_descriptor);
+
+    usb_register_ep0_req_handler(usb_dev,
+        USB_REQ_TYPE_CLASS | USB_REQ_TYPE_INTERFACE,
+        USB_REQ_TYPE_TYPE  | USB_REQ_TYPE_RECIPIENT,
+        handle_hid_class_request);
+
+    w_ctx.started = 1;
+
+    usb_enable_isr();
+    usb_start(usb_dev);
+
+}
+
+/* VBUS gone: pull-up off, peripheral off, nothing left armed */
+void wired_stop(void) {
+
+    if (!w_ctx.started) {
+        return;
+    }
+
+    usb_stop(usb_dev);
+    NVIC->ICER[NVIC_USBD_IRQ / 32] = (1 << (NVIC_USBD_IRQ % 32));
+
+    usb_dev->configured = 0;
+    w_ctx.started = 0;
+    w_ctx.armed   = 0;
+    w_ctx.pending = 0;
+    w_ctx.x       = 0;
+    w_ctx.y       = 0;
+    w_ctx.wheel   = 0;
+
+}
+
+/* one motion burst's worth, from the SPIM0 isr (same priority as usbd_isr) */
+void wired_report(uint8_t buttons, int16_t dx, int16_t dy, int8_t wheel) {
+
+    if (dx || dy || wheel || (buttons != w_ctx.buttons)) {
+        w_ctx.pending = 1;
+    }
+
+    w_ctx.buttons = buttons;
+    w_ctx.x      += dx;
+    w_ctx.y      += dy;
+    w_ctx.wheel  += wheel;
+
+    /* no easyDMA while the bus is suspended (usb.c note 3), it keeps */
+    if (w_ctx.pending && !w_ctx.armed && w_ctx.started && usb_dev->configured &&
+        !usb_dev->suspended) {
+        wired_arm_report(usb_dev);
+    }
+
+}
+
+void usbd_isr(void) {
+    ISR_PROF_SCOPE(USBD);
+    usb_handle_event(usb_dev);
+}
+
+/* note 1 : wired
+ *
+ *          the same usb.c / usb_ep0.c as the dongle (the Makefile puts
+ *          ../dongle/include after ours, so device.h, utils.h and trace.h
+ *          are the mouse's), and the dongle's first interface out of its
+ *          hid_mouse.c under a PID of our own (hid_mouse.c note 1). the
+ *          battery feature is left out, nothing here would fill it.
+ *
+ *          usb.c's USBD errata workarounds, anomalies 187 and 199, are
+ *          on the nrf52820's errata list as well, with the same registers
+ *          and the same workarounds, so they stay as they are.
+ *
+ *          one report per motion burst, and mouse.c starts the burst a
+ *          little before each SOF (mouse.c note 9), so a report is armed
+ *          by the time the frame's IN comes round. SET_IDLE other than 0
+ *          stalls: the host only ever gets changes, which is what linux
+ *          and windows ask a mouse for anyway.
+ */
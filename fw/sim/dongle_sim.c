@@ -0,0 +1,734 @@
+/**********************************************************************************
+ ** file            : dongle_sim.c
+ ** description     : runs the dongle firmware against the peripheral models, with
+ **                   a usb host that enumerates and polls it and a stand-in mouse
+ **                   on the air
+ **
+ **                   build/dongle-sim [-t seconds] [-s seed] [-v] [-m trace]
+ **                                    [-l loss] [-b enter,exit] [-j period_us,width_us]
+ **                                    [-p dongle_ppm] [-P mouse_ppm] [-o hist.csv]
+ **                                    [-e linux|windows] [-u runs] [-c max_ms]
+ **                                    [-S suspends]
+ **
+ **********************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sim.h"
+#include "usb.h"
+#include "link_stats.h"
+
+#define MOUSE_LEN           8           /* LENGTH of a mouse packet             */
+#define RECORD_LEN          41          /* energy.h and battery.h's records     */
+#define BATTERY_MV          3700        /* in the made-up battery record        */
+#define BATTERY_SOC         13
+#define ENERGY_EVERY        1000        /* TX per record, the mouse does ~10s   */
+#define MOUSE_RAMP_US       40          /* fast ramp-up                         */
+#define MOUSE_DISABLE_US    4           /* TXDISABLE at 2Mbit, then RX ramp-up  */
+#define PREAMBLE_US         4           /* 8 bits at 2Mbit                      */
+#define RX_TIMEOUT_US       200         /* mouse.c, from TX END                 */
+#define FIRST_CC_US         1000        /* TIMER1 CC[0] at reset                */
+#define MOTION_START_MS     200         /* after enumeration                    */
+#define MOTION_MAX          64          /* samples per packet, kept apart       */
+#define RUNS_MAX            64          /* -u                                   */
+#define REPLUG_MS           50          /* VBUS off between -u runs             */
+#define STILL_MS            200         /* -S: moving this long, then still     */
+#define SUSPEND_MS          100         /* still this long, the host suspends   */
+#define INPUT_MIN_MS        300         /* input this long after the suspend .. */
+#define INPUT_MAX_MS        800         /* .. up to this                        */
+#define SETTLE_MS           10          /* past the 3ms to SUSPEND              */
+#define NO_WAKE_MS          1000        /* then the host resumes on its own     */
+
+/* the mouse's radio, mouse_sim.c has where these come from */
+#define RAMP_MA             6.0
+#define TX_MA               9.6
+#define RX_MA               9.8
+
+int fw_main(void);
+
+static struct {
+    int32_t  mouse_ppm;
+    const char *trace;
+    const char *csv;
+    const struct sim_usb_script *host;
+    int      usb_only;          /* enumerations, and nothing else       */
+    double   budget_ms;         /* connect to configured                */
+    int      suspends;          /* -S: suspend and wake cycles          */
+} opt = { .host = &sim_usb_linux };
+
+static struct {
+    uint64_t t_configured;
+    uint8_t  usb_done;
+    uint64_t reports;
+    int64_t  x;
+    int64_t  y;
+    uint64_t t_last;
+    uint64_t records;
+    uint64_t delivered;
+    uint64_t undelivered;
+    uint64_t replies;
+    uint64_t no_reply;
+    uint32_t lost_run;
+    uint64_t resumes;           /* sim_usb_stats.resumes at t_last      */
+} st;
+
+/* -S, see note 3 */
+static struct {
+    uint8_t  still;             /* user_input() drops everything        */
+    int      cycles;            /* woken and reported                   */
+    uint64_t t_input;           /* the input that's to wake it, 0 none  */
+    uint64_t wakeups;           /* sim_usb_stats.wakeups at t_input     */
+    uint64_t no_wake;           /* the host resumed on its own          */
+    uint64_t t_asleep;
+    uint64_t asleep_ns;         /* settled suspend, and the radio in it */
+    uint64_t radio_ns;
+    uint64_t ns[8];             /* sim_radio_residency() at t_asleep    */
+} sus;
+
+/* see note 2 */
+static struct sim_hist h_period = { .name = "report_period", .unit = "us",    .width = 10   };
+static struct sim_hist h_age    = { .name = "report_age",    .unit = "us",    .width = 50   };
+static struct sim_hist h_turn   = { .name = "turnaround",    .unit = "us",    .width = 1    };
+static struct sim_hist h_lost   = { .name = "lost_run",      .unit = "slots", .width = 1    };
+static struct sim_hist h_charge = { .name = "charge_slot",   .unit = "uC",    .width = 0.05 };
+static struct sim_hist h_detect = { .name = "wake_detect",   .unit = "ms",    .width = 0.5  };
+static struct sim_hist h_resume = { .name = "wake_resume",   .unit = "ms",    .width = 0.5  };
+static struct sim_hist h_wake   = { .name = "wake_report",   .unit = "ms",    .width = 0.5  };
+
+/* --- STAND-IN MOUSE ---------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+struct motion {
+    uint64_t t;
+    uint32_t counts;
+};
+
+/* what mouse.c's TIMER1/radio_isr do: TX, RX window, next TX `cc` after
+ * the reply, or after the window if there was none
+ */
+static struct {
+    uint64_t tx_end;
+    uint64_t gen;
+    uint64_t tx;
+    uint64_t rx_ok;             /* sim_radio_stats.rx_ok at TX          */
+    uint16_t cc;
+    uint8_t  seq;
+    uint8_t  len;               /* LENGTH of the last TX                */
+    uint8_t  replied;
+
+    int32_t  dx;                /* since the last TX                    */
+    int32_t  dy;
+    int32_t  wheel;
+    uint8_t  buttons;
+    struct motion pending[MOTION_MAX];
+    struct motion in_flight[MOTION_MAX];
+    uint8_t  n_pending;
+    uint8_t  n_in_flight;
+} ms = { .cc = FIRST_CC_US, .len = MOUSE_LEN };
+
+/* `us` on the mouse's crystal */
+static uint64_t mouse_ns(uint64_t us) {
+    return us * SIM_US / (1.0 + opt.mouse_ppm / 1e6);
+}
+
+static int16_t clamp16(int32_t v) {
+    return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v;
+}
+
+static void mouse_tx(void *arg);
+
+static void mouse_next(uint64_t t_timer) {
+    sim_at(t_timer + mouse_ns(MOUSE_RAMP_US), mouse_tx, (void *) (uintptr_t) ++ms.gen);
+}
+
+/* radio charge of one slot: ramp, TX, disable, ramp, listen until `t` */
+static void mouse_slot_charge(uint64_t t) {
+
+    double air    = sim_radio_airtime(ms.len) / 1e3;
+    double listen = (t - ms.tx_end) / 1e3 - MOUSE_DISABLE_US - MOUSE_RAMP_US;
+    double nc     = RAMP_MA * (2 * MOUSE_RAMP_US + MOUSE_DISABLE_US) + TX_MA * air;
+
+    if (listen > 0) {
+        nc += RX_MA * listen;
+    }
+    sim_hist_add(&h_charge, nc / 1e3);
+}
+
+static void mouse_window_closed(void *arg) {
+
+    if ((uintptr_t) arg != ms.gen || ms.replied) {
+        return;
+    }
+    st.no_reply++;
+    mouse_slot_charge(sim_now());
+    mouse_next(sim_now() + mouse_ns(ms.cc));
+}
+
+/* did the dongle get it: its motion counts from now on, or is gone */
+static void mouse_delivered(void *arg) {
+
+    (void) arg;
+
+    if (sim_radio_stats.rx_ok == ms.rx_ok) {
+        st.undelivered++;
+        /* between listen windows nothing is heard, by design */
+        if (st.delivered && sim_usb_stats.suspends == sim_usb_stats.resumes) {
+            st.lost_run++;
+        }
+        return;
+    }
+
+    st.delivered++;
+    if (st.lost_run) {
+        sim_hist_add(&h_lost, st.lost_run);
+        st.lost_run = 0;
+    }
+    for (int i = 0; i < ms.n_in_flight; i++) {
+        sim_age_push(ms.in_flight[i].t, ms.in_flight[i].counts);
+    }
+}
+
+static void mouse_tx(void *arg) {
+
+    if ((uintptr_t) arg != ms.gen) {
+        return;
+    }
+
+    /* LENGTH, btn_vbat, dx, dy, wheel, seq, sensor_us */
+    int16_t dx    = clamp16(ms.dx);
+    int16_t dy    = clamp16(ms.dy);
+    int8_t  wheel = ms.wheel > 127 ? 127 : ms.wheel < -127 ? -127 : ms.wheel;
+
+    /* now and then records on the end, made up but for the battery */
+    ms.len = MOUSE_LEN;
+    if (ms.tx % ENERGY_EVERY == ENERGY_EVERY - 1) {
+        ms.len += RECORD_LEN;
+    }
+
+    struct sim_air_pkt pkt = {
+        .t_start = sim_now(),
+        .address = sim_radio_address(0),
+        .freq    = 2,
+        .crc_ok  = 1,
+        .rssi    = -50,
+        .len     = ms.len + 1,
+    };
+    pkt.data[0] = ms.len;
+    pkt.data[1] = (ms.buttons & 3) | (40 << 2);
+    memcpy(&pkt.data[2], &dx, 2);
+    memcpy(&pkt.data[4], &dy, 2);
+    pkt.data[6] = wheel;
+    pkt.data[7] = ++ms.seq;
+    pkt.data[8] = 20;
+    for (int i = MOUSE_LEN + 1; i <= ms.len; i++) {
+        pkt.data[i] = i;
+    }
+    if (ms.len > MOUSE_LEN) {
+        uint16_t mv = BATTERY_MV;
+        memcpy(&pkt.data[ms.len - 4], &mv, 2);
+        pkt.data[ms.len - 2] = BATTERY_SOC;
+    }
+
+    /* like mouse.c, a packet that doesn't make it takes its motion along */
+    ms.dx = ms.dy = ms.wheel = 0;
+    memcpy(ms.in_flight, ms.pending, ms.n_pending * sizeof(ms.pending[0]));
+    ms.n_in_flight = ms.n_pending;
+    ms.n_pending   = 0;
+
+    ms.tx++;
+    ms.tx_end  = sim_now() + sim_radio_airtime(ms.len);
+    ms.rx_ok   = sim_radio_stats.rx_ok;
+    ms.replied = 0;
+
+    sim_radio_send(&pkt);
+
+    sim_at(ms.tx_end + 1, mouse_delivered, NULL);
+    sim_at(ms.tx_end + mouse_ns(RX_TIMEOUT_US), mouse_window_closed, (void *) (uintptr_t) ms.gen);
+}
+
+/* the dongle's reply: heard if the mouse is in RX by the end of its
+ * preamble and it starts before the window closes
+ */
+static void mouse_rx(const struct sim_air_pkt *pkt) {
+
+    uint64_t open  = ms.tx_end + mouse_ns(MOUSE_DISABLE_US + MOUSE_RAMP_US);
+    uint64_t close = ms.tx_end + mouse_ns(RX_TIMEOUT_US);
+
+    if (ms.replied || pkt->t_start + PREAMBLE_US * SIM_US < open || pkt->t_start >= close) {
+        return;
+    }
+    sim_hist_add(&h_turn, (pkt->t_start - ms.tx_end) / 1e3);
+    if (pkt->lost || !pkt->crc_ok || pkt->data[0] < 4) {
+        return;
+    }
+
+    uint16_t cc;
+    memcpy(&cc, &pkt->data[1], 2);
+    if (cc < RX_TIMEOUT_US + 50) {
+        cc = RX_TIMEOUT_US + 50;
+    }
+
+    uint64_t end = pkt->t_start + sim_radio_airtime(pkt->data[0]);
+
+    ms.replied = 1;
+    ms.cc      = cc;
+    st.replies++;
+    mouse_slot_charge(end);
+    mouse_next(end + mouse_ns(cc));
+}
+
+/* --- USER -------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+static void user_input(int32_t dx, int32_t dy, uint8_t buttons, int8_t wheel) {
+
+    uint32_t counts = abs(dx) + abs(dy);
+
+    if (sus.still) {
+        return;
+    }
+
+    ms.dx     += dx;
+    ms.dy     += dy;
+    ms.wheel  += wheel;
+    ms.buttons = buttons;
+
+    if (!counts) {
+        return;
+    }
+    if (ms.n_pending < MOTION_MAX) {
+        ms.pending[ms.n_pending++] = (struct motion) { sim_now(), counts };
+    }
+    else {
+        ms.pending[MOTION_MAX - 1].counts += counts;
+    }
+}
+
+/* no trace: a slow diagonal, one count per axis every 250us */
+static void move(void *arg) {
+
+    (void) arg;
+    user_input(1, -1, 0, 0);
+    sim_at(sim_now() + 250 * SIM_US, move, NULL);
+}
+
+/* --- USB HOST ---------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+/* -S: the bus idle and the radio's share of it, from SUSPEND on */
+static void sus_asleep(void *arg) {
+
+    (void) arg;
+    sus.t_asleep = sim_now();
+    sim_radio_residency(sus.ns);
+}
+
+static void sus_no_wake(void *arg) {
+
+    if ((intptr_t) arg != sus.cycles || !sus.t_input) {
+        return;
+    }
+    sus.no_wake++;
+    sim_usb_resume();
+}
+
+/* still since the suspend, now it moves: the dongle is to wake the host */
+static void sus_input(void *arg) {
+
+    (void) arg;
+
+    uint64_t ns[8];
+    sim_radio_residency(ns);
+    sus.asleep_ns += sim_now() - sus.t_asleep;
+    for (int i = 1; i < 8; i++) {
+        sus.radio_ns += ns[i] - sus.ns[i];
+    }
+
+    sus.still   = 0;
+    sus.t_input = sim_now();
+    sus.wakeups = sim_usb_stats.wakeups;
+    sim_at(sim_now() + NO_WAKE_MS * SIM_MS, sus_no_wake, (void *) (intptr_t) sus.cycles);
+}
+
+static void sus_suspend(void *arg) {
+
+    (void) arg;
+
+    uint32_t input_ms = INPUT_MIN_MS + rand() % (INPUT_MAX_MS - INPUT_MIN_MS + 1);
+
+    sim_usb_suspend();
+    sim_at(sim_now() + SETTLE_MS * SIM_MS, sus_asleep, NULL);
+    sim_at(sim_now() + input_ms * SIM_MS, sus_input, NULL);
+}
+
+static void sus_still(void *arg) {
+
+    (void) arg;
+    sus.still = 1;
+    sim_at(sim_now() + SUSPEND_MS * SIM_MS, sus_suspend, NULL);
+}
+
+/* the first report after the input: the wake's done */
+static void sus_woken(void) {
+
+    if (sim_usb_stats.wakeups != sus.wakeups) {
+        sim_hist_add(&h_detect, (sim_usb_stats.t_wakeup - sus.t_input) / 1e6);
+    }
+    sim_hist_add(&h_resume, (sim_usb_stats.t_resume - sus.t_input) / 1e6);
+    sim_hist_add(&h_wake,   (sim_now() - sus.t_input) / 1e6);
+
+    sus.t_input = 0;
+    if (++sus.cycles < opt.suspends) {
+        sim_at(sim_now() + STILL_MS * SIM_MS, sus_still, NULL);
+    }
+}
+
+static void ep1_in(uint8_t ep, const uint8_t *data, uint16_t len) {
+
+    (void) ep;
+    if (len < 5) {
+        return;
+    }
+
+    /* buttons, x, y, wheel */
+    int16_t x, y;
+    memcpy(&x, &data[1], 2);
+    memcpy(&y, &data[3], 2);
+    st.x += x;
+    st.y += y;
+    sim_age_retire(abs(x) + abs(y), sim_now(), &h_age);
+
+    /* the report from SET_CONFIGURATION stands alone, see dongle.c,
+     * and so does the first after a resume
+     */
+    st.reports++;
+    if (st.t_last >= MOTION_START_MS * SIM_MS && st.resumes == sim_usb_stats.resumes) {
+        sim_hist_add(&h_period, (sim_now() - st.t_last) / 1e3);
+    }
+    st.t_last  = sim_now();
+    st.resumes = sim_usb_stats.resumes;
+
+    if (sus.t_input && (x || y)) {
+        sus_woken();
+    }
+}
+
+static void ep2_in(uint8_t ep, const uint8_t *data, uint16_t len) {
+
+    (void) ep;
+    (void) data;
+    (void) len;
+    st.records++;
+}
+
+/* the vendor requests dongle.c answers, and the standard ones a driver or
+ * tool may send once it's bound. lengths are checked against what the
+ * firmware's structs say, ones that come out at a multiple of 64 need a ZLP
+ */
+static const struct sim_usb_step vendor_steps[] = {
+    { { 0x40, 0x01, 800,    0x0001, 0   }, 0,                  "set dpi 800, 1ms",    -1 },
+    { { 0xC0, 0x01, 0x0000, 0x0000, 64  }, 0,                  "mouse battery",        5 },
+    { { 0xC0, 0x02, 0x0000, 0x0000, 64  }, 0,                  "usb dma stats",
+      sizeof(struct usb_dma_stats) },
+    { { 0xC0, 0x03, 0x0000, 0x0000, 512 }, 0,                  "link stats",
+      sizeof(struct link_stats_report) },
+    { { 0xC0, 0x04, 0x0000, 0x0000, 512 }, 0,                  "latency histograms",
+      sizeof(struct link_stats_latency_report) },
+    { { 0xC0, 0x04, 0x0000, 0x0000, 128 }, 0,                  "latency, first 128",  -1 },
+    { { 0x40, 0x05, 0x0002, 0x0000, 0   }, 0,                  "set profile eco",     -1 },
+    { { 0xC0, 0x05, 0x0000, 0x0000, 64  }, 0,                  "profile",              1 },
+    { { 0x40, 0x05, 0x0007, 0x0000, 0   }, SIM_USB_MAY_STALL,  "set profile 7",       -1 },
+    { { 0x40, 0x05, 0x0001, 0x0000, 0   }, 0,                  "set profile balanced",-1 },
+    { { 0xC0, 0x06, 0x0000, 0x0000, 64  }, 0,                  "mouse energy",        36 },
+    { { 0xC0, 0x7F, 0x0000, 0x0000, 64  }, SIM_USB_MAY_STALL,  "unknown vendor req",  -1 },
+    { { 0x81, 0x06, 0x2200, 0x0000, 0   }, SIM_USB_REPORT_LEN, "report descriptor",   -1 },
+    { { 0xA1, 0x02, 0x0000, 0x0000, 1   }, 0,                  "GET_IDLE",             1 },
+    { { 0xA1, 0x02, 0x0000, 0x0001, 1   }, SIM_USB_STALLS,     "GET_IDLE interface 1", -1 },
+    { { 0xA1, 0x01, 0x0300, 0x0000, 1   }, SIM_USB_MAY_STALL,  "GET_REPORT battery",   1 },
+    { { 0xA1, 0x01, 0x0100, 0x0000, 8   }, 0,                  "GET_REPORT input",     8 },
+    { { 0x81, 0x0A, 0x0000, 0x0000, 1   }, 0,                  "GET_INTERFACE",        1 },
+    { { 0x80, 0x00, 0x0000, 0x0000, 2   }, 0,                  "GET_STATUS",           2 },
+};
+
+static const struct sim_usb_script vendor = {
+    "vendor", vendor_steps, sizeof(vendor_steps) / sizeof(vendor_steps[0]),
+};
+
+static struct sim_usb_run enum_runs[RUNS_MAX];
+static struct sim_usb_run vendor_runs[RUNS_MAX];
+static int runs;
+
+static void enumerate(void);
+
+static void plug(void *arg) {
+
+    (void) arg;
+    enumerate();
+    sim_usb_vbus(1);
+}
+
+static void usb_finish(void) {
+
+    int ok = 1;
+    for (int i = 0; i < runs; i++) {
+        ok &= enum_runs[i].ok && vendor_runs[i].ok;
+        if (opt.budget_ms && enum_runs[i].t_configured
+            && enum_runs[i].t_configured - enum_runs[i].t_start > opt.budget_ms * SIM_MS) {
+            ok = 0;
+        }
+    }
+    st.usb_done = 1;
+    sim_exit(ok ? 0 : 1);
+}
+
+static void vendor_done(void *arg) {
+
+    (void) arg;
+
+    if (!opt.usb_only) {
+        sim_usb_poll(1, 1, ep1_in);
+        sim_usb_poll(2, 10, ep2_in);
+        if (opt.suspends) {
+            sim_at(MOTION_START_MS * SIM_MS + STILL_MS * SIM_MS, sus_still, NULL);
+        }
+        return;
+    }
+
+    /* -u: unplug and do it all again, see note 1 */
+    runs++;
+    if (runs == opt.usb_only || !vendor_runs[runs - 1].ok) {
+        usb_finish();
+    }
+    sim_usb_vbus(0);
+    sim_at(sim_now() + REPLUG_MS * SIM_MS, plug, NULL);
+}
+
+static void enumerated(void *arg) {
+
+    (void) arg;
+    struct sim_usb_run *run = &enum_runs[runs];
+
+    if (!run->ok) {
+        if (opt.usb_only) {
+            runs++;
+            usb_finish();
+        }
+        return;
+    }
+    st.t_configured = run->t_configured;
+    sim_usb_script_run(&vendor, &vendor_runs[runs], vendor_done, NULL);
+}
+
+static void enumerate(void) {
+    sim_usb_enumerate(opt.host, &enum_runs[runs], enumerated, NULL);
+}
+
+/* --- REPORT ------------------------------------------------------------------------ */
+/* ----------------------------------------------------------------------------------- */
+
+static void report(void *arg) {
+
+    (void) arg;
+
+    fprintf(stderr, "\n--- dongle, %.3f s ---\n", sim_now() / 1e9);
+
+    int n = opt.usb_only ? runs : 1;
+    for (int i = 0; i < n; i++) {
+        char label[24];
+        snprintf(label, sizeof(label), "%s %d", opt.host->name, i);
+        if (!enum_runs[i].t_end) {
+            fprintf(stderr, "%-10s not configured yet\n", label);
+            continue;
+        }
+        sim_usb_run_print(label, &enum_runs[i]);
+        if (opt.budget_ms && enum_runs[i].t_configured
+            && enum_runs[i].t_configured - enum_runs[i].t_start > opt.budget_ms * SIM_MS) {
+            fprintf(stderr, "%-10s over the %.1f ms budget\n", "", opt.budget_ms);
+        }
+        if (vendor_runs[i].t_end) {
+            sim_usb_run_print("vendor", &vendor_runs[i]);
+        }
+    }
+    fprintf(stderr, "usb: setups %llu, done %llu, stalled %llu, timeouts %llu, ep0 in %llu, ep0 naks %llu\n",
+            (unsigned long long) sim_usb_stats.setups, (unsigned long long) sim_usb_stats.ctrl_done,
+            (unsigned long long) sim_usb_stats.ctrl_stalled,
+            (unsigned long long) sim_usb_stats.ctrl_timeouts,
+            (unsigned long long) sim_usb_stats.ep0_in_pkts, (unsigned long long) sim_usb_stats.ep0_naks);
+    fprintf(stderr, "usb: dma %llu (%llu while busy), in %llu, in naks %llu, resets %llu\n",
+            (unsigned long long) sim_usb_stats.dma, (unsigned long long) sim_usb_stats.dma_while_busy,
+            (unsigned long long) sim_usb_stats.in_pkts, (unsigned long long) sim_usb_stats.in_naks,
+            (unsigned long long) sim_usb_stats.resets);
+    if (opt.suspends) {
+        fprintf(stderr, "usb: suspends %llu, remote wakeups %llu (%llu ignored), resumes %llu, "
+                        "no wake %llu, radio on %.1f%% while suspended\n",
+                (unsigned long long) sim_usb_stats.suspends,
+                (unsigned long long) sim_usb_stats.wakeups,
+                (unsigned long long) sim_usb_stats.wakeups_ignored,
+                (unsigned long long) sim_usb_stats.resumes, (unsigned long long) sus.no_wake,
+                sus.asleep_ns ? 100.0 * sus.radio_ns / sus.asleep_ns : 0.0);
+    }
+
+    if (opt.usb_only) {
+        fprintf(stderr, "\n");
+        sim_print_isr_stats();
+        if (!st.usb_done) {
+            fprintf(stderr, "usb: %d of %d runs in %.3f s, give it more -t\n",
+                    runs, opt.usb_only, sim_now() / 1e9);
+            fflush(stderr);
+            exit(1);
+        }
+        return;
+    }
+
+    fprintf(stderr, "reports %llu, x %lld y %lld, telemetry records %llu\n",
+            (unsigned long long) st.reports, (long long) st.x, (long long) st.y,
+            (unsigned long long) st.records);
+    fprintf(stderr, "mouse: tx %llu, delivered %llu, not %llu, replies %llu, no reply %llu\n",
+            (unsigned long long) ms.tx, (unsigned long long) st.delivered,
+            (unsigned long long) st.undelivered, (unsigned long long) st.replies,
+            (unsigned long long) st.no_reply);
+
+    fprintf(stderr, "radio:");
+    for (int i = 0; i < 8; i++) {
+        fprintf(stderr, " %s %.1f%%", sim_radio_state_name[i],
+                sim_now() ? 100.0 * sim_radio_stats.state_ns[i] / sim_now() : 0.0);
+    }
+    fprintf(stderr, "\nradio: tx %llu, rx ok %llu, crc err %llu, missed %llu, air lost %llu, corrupt %llu\n",
+            (unsigned long long) sim_radio_stats.tx, (unsigned long long) sim_radio_stats.rx_ok,
+            (unsigned long long) sim_radio_stats.rx_crc_err,
+            (unsigned long long) sim_radio_stats.rx_missed,
+            (unsigned long long) sim_radio_stats.air_lost,
+            (unsigned long long) sim_radio_stats.air_corrupt);
+
+    struct sim_hist *hs[] = { &h_period, &h_age, &h_turn, &h_lost, &h_charge,
+                              &h_detect, &h_resume, &h_wake };
+    size_t n_hs = sizeof(hs) / sizeof(hs[0]) - (opt.suspends ? 0 : 3);
+    fprintf(stderr, "\n");
+    for (size_t i = 0; i < n_hs; i++) {
+        sim_hist_print(hs[i]);
+    }
+    if (opt.csv) {
+        FILE *f = fopen(opt.csv, "w");
+        if (!f) {
+            perror(opt.csv);
+        }
+        else {
+            fprintf(f, "hist,lo,hi,count\n");
+            for (size_t i = 0; i < n_hs; i++) {
+                sim_hist_csv(hs[i], f);
+            }
+            fclose(f);
+        }
+    }
+
+    fprintf(stderr, "\n");
+    sim_print_isr_stats();
+}
+
+int main(int argc, char **argv) {
+
+    double   seconds = 0;
+    unsigned seed    = 1;
+    int c;
+
+    while ((c = getopt(argc, argv, "t:s:vm:l:b:j:p:P:o:e:u:c:S:")) != -1) {
+        switch (c) {
+            case 't': seconds           = atof(optarg); break;
+            case 's': seed              = atoi(optarg); break;
+            case 'v': sim_cfg.verbose   = 1; break;
+            case 'm': opt.trace         = optarg; break;
+            case 'l': sim_air_cfg.loss  = atof(optarg); break;
+            case 'b': sscanf(optarg, "%lf,%lf", &sim_air_cfg.burst_enter, &sim_air_cfg.burst_exit); break;
+            case 'j': sscanf(optarg, "%u,%u", &sim_air_cfg.jam_period_us, &sim_air_cfg.jam_us); break;
+            case 'p': sim_cfg.hfclk_ppm = atoi(optarg); break;
+            case 'P': opt.mouse_ppm     = atoi(optarg); break;
+            case 'o': opt.csv           = optarg; break;
+            case 'e': opt.host          = sim_usb_script_find(optarg); break;
+            case 'u': opt.usb_only      = atoi(optarg); break;
+            case 'c': opt.budget_ms     = atof(optarg); break;
+            case 'S': opt.suspends      = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-t seconds] [-s seed] [-v] [-m trace]\n"
+                                "       [-l loss] [-b enter,exit] [-j period_us,width_us]\n"
+                                "       [-p dongle_ppm] [-P mouse_ppm] [-o hist.csv]\n"
+                                "       [-e linux|windows] [-u runs] [-c max_ms]\n"
+                                "       [-S suspends]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (!opt.host) {
+        fprintf(stderr, "-e: linux or windows\n");
+        return 2;
+    }
+    if (opt.usb_only > RUNS_MAX) {
+        opt.usb_only = RUNS_MAX;
+    }
+    if (!seconds) {
+        seconds = opt.usb_only ? opt.usb_only : opt.suspends ? 0.5 + opt.suspends : 2.0;
+    }
+    srand(seed);
+
+    sim_init();
+    sim_usb_vbus(1);
+    enumerate();
+    sim_on_exit(report, NULL);
+
+    /* -u: no mouse, nothing on the bus but the control transfers */
+    if (opt.usb_only) {
+        sim_run(fw_main, (uint64_t) (seconds * SIM_S));
+    }
+
+    sim_radio_peer(mouse_rx);
+    mouse_next(0);
+
+    if (opt.trace) {
+        if (sim_motion_replay(opt.trace, MOTION_START_MS * SIM_MS, user_input) < 0) {
+            return 1;
+        }
+    }
+    else {
+        sim_at(MOTION_START_MS * SIM_MS, move, NULL);
+    }
+
+    sim_run(fw_main, (uint64_t) (seconds * SIM_S));
+}
+
+/* note 1 : the enumeration
+ *
+ *          sim_usbhost.c plays linux (default) or windows (-e) from attach to
+ *          the bound driver, then vendor_steps. a step that fails ends the run
+ *          and the report names it. -u n does only that, n times over with
+ *          VBUS dropped for REPLUG_MS in between and no mouse on the air, and
+ *          exits 1 if a run failed or took longer than -c ms from connect to
+ *          configured, so a slower or broken ep0 fails a script that runs it:
+ *
+ *              ./build/dongle-sim -u 3 -e windows -c 145 || echo regressed
+ *
+ * note 2 : what it measures
+ *
+ *          report_period is ep1 IN to ep1 IN at the host. report_age runs from a
+ *          motion sample at the mouse to the host's ep1 IN that carried it, for
+ *          the packets the dongle got (sim_hist.c note 1). turnaround is the
+ *          mouse's TX END to the dongle's reply on air. lost_run counts mouse
+ *          packets in a row that never made it into the dongle, once the first
+ *          one did. charge_slot is the stand-in mouse's radio only, the real
+ *          mouse's whole slot is in mouse-sim. the host's frames are the sim's
+ *          clock, -p moves the dongle's crystal against them and -P the mouse's.
+ *
+ * note 3 : suspend and remote wakeup
+ *
+ *          -S n: n times over the user stops for SUSPEND_MS, the host suspends
+ *          the bus (SET_FEATURE remote wakeup first, the configuration allows
+ *          it), and INPUT_MIN_MS..INPUT_MAX_MS later moves again. wake_detect
+ *          runs from that input to the dongle's K on the bus, wake_resume to
+ *          the host's first SOF after its 20ms of resume, wake_report to the
+ *          first report with motion in it. the radio's share of the suspend
+ *          is counted from SETTLE_MS in to the input. a dongle that doesn't
+ *          wake the host in NO_WAKE_MS gets a resume from the host anyway,
+ *          `no wake` counts those. the stand-in mouse never idles, it's on
+ *          air every ~1.2ms without replies, where the real one is down to
+ *          its 8ms heartbeat until the input pulls it in (mouse.c note 5).
+ */
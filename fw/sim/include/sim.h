@@ -0,0 +1,329 @@
+/**********************************************************************************
+ ** file            : sim.h
+ ** description     : host simulator for the nRF52 firmwares, `make sim`
+ **
+ **                   the firmware is built for the host unmodified (device.h
+ **                   with HOST_SIM=1) and runs against register-level models
+ **                   of the peripherals it uses, in virtual time. a harness
+ **                   (mouse_sim.c, dongle_sim.c) supplies main(), plays the
+ **                   other end of the radio/usb and prints what it measured.
+ **                   see fw/sim/README.md
+ **
+ **********************************************************************************/
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/* --- TIME -------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+#define SIM_NS          1ULL
+#define SIM_US          1000ULL
+#define SIM_MS          1000000ULL
+#define SIM_S           1000000000ULL
+
+typedef void (*sim_fn)(void *arg);
+
+uint64_t sim_now(void);                             /* virtual ns since reset       */
+void     sim_at(uint64_t t, sim_fn fn, void *arg);  /* harness callback at t        */
+
+/* --- CORE -------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+/* what the firmware's code costs between register accesses, see sim.c note 2 */
+struct sim_cfg {
+    uint32_t access_ns;         /* per peripheral register access               */
+    uint32_t isr_entry_ns;      /* exception entry, and again for the exit      */
+    uint32_t cpu_hz;            /* DWT->CYCCNT rate                             */
+    int32_t  hfclk_ppm;         /* crystal error, the TIMERs count off this     */
+    uint8_t  verbose;
+};
+
+extern struct sim_cfg sim_cfg;
+
+struct sim_isr_stats {
+    uint64_t count;
+    uint64_t ns;                /* entry to exit, including preemption          */
+    uint64_t max_ns;
+    uint64_t lat_ns;            /* pending to entry                             */
+    uint64_t lat_max_ns;
+};
+
+struct sim_stats {
+    uint64_t accesses;          /* trapped register reads and writes            */
+    uint64_t polls;             /* busy-wait loops skipped to the next event    */
+    uint64_t events;            /* model events run                             */
+    uint64_t sleep_ns;          /* cpu in wfi                                   */
+    uint64_t max_depth;         /* isr nesting                                  */
+    struct sim_isr_stats isr[64];
+};
+
+extern struct sim_stats sim_stats;
+
+void sim_init(void);
+void sim_on_exit(sim_fn fn, void *arg);
+_Noreturn void sim_run(int (*fw_main)(void), uint64_t duration_ns);
+_Noreturn void sim_stop(const char *why);
+_Noreturn void sim_exit(int status);              /* exit hooks, then exit()      */
+void sim_print_isr_stats(void);
+uint64_t sim_awake_ns(void);                        /* cpu time outside wfi so far  */
+
+/* firmware side, device.h with HOST_SIM */
+uint32_t sim_irq_save(void);
+void     sim_irq_restore(uint32_t primask);
+void     sim_wfi(void);
+
+/* --- CLOCK ------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+struct sim_clock_stats {
+    uint64_t hfxo_ns;           /* HFCLKSTART to HFCLKSTOP, startup included    */
+    uint64_t constlat_ns;       /* POWER in CONSTLAT                            */
+};
+
+extern struct sim_clock_stats sim_clock_stats;
+
+void sim_clock_residency(uint64_t *hfxo_ns, uint64_t *constlat_ns);   /* up to now */
+
+/* --- GPIO -------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+#define SIM_PIN_FLOAT   (-1)
+
+void sim_gpio_set(unsigned pin, int level);         /* external drive, or SIM_PIN_FLOAT */
+int  sim_gpio_level(unsigned pin);                  /* what the pin is at now           */
+
+/* --- QDEC / COMP ------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+void sim_qdec_turn(int32_t steps);
+void sim_comp_set_vddh(double volts);
+double sim_comp_vddh(void);
+
+/* --- RADIO ------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+#define SIM_AIR_MAX     64
+
+/* one packet on air, data[] = LENGTH + payload */
+struct sim_air_pkt {
+    uint64_t t_start;           /* preamble start                               */
+    uint32_t address;           /* prefix << 24 | base, BALEN = 3               */
+    uint8_t  freq;              /* RADIO->FREQUENCY                             */
+    uint8_t  crc_ok;
+    uint8_t  lost;              /* by sim_air_cfg, the peer still sees its own  */
+    int8_t   rssi;              /* dBm                                          */
+    uint8_t  len;               /* bytes in data[]                              */
+    uint8_t  data[SIM_AIR_MAX];
+};
+
+typedef void (*sim_air_fn)(const struct sim_air_pkt *pkt);
+
+struct sim_radio_stats {
+    uint64_t state_ns[8];       /* time in each state, sim_radio_state_name[]   */
+    uint64_t tx;
+    uint64_t rx_ok;
+    uint64_t rx_crc_err;
+    uint64_t rx_missed;         /* radio not listening by the end of the preamble */
+    uint64_t air_lost;          /* dropped by sim_air_cfg, both directions      */
+    uint64_t air_corrupt;       /* hit by the interferer, arrive with bad CRC   */
+    uint64_t no_hfxo;           /* TXEN/RXEN before HFCLKSTARTED                */
+    int8_t   txpower;           /* dBm, TXPOWER at the last TXEN                */
+};
+
+/* what happens to packets between the two radios, see sim_radio.c note 2 */
+struct sim_air_cfg {
+    double   loss;              /* independent, per packet                      */
+    double   burst_enter;       /* gilbert-elliott: good -> bad, per packet     */
+    double   burst_exit;        /* bad -> good, everything is lost while bad    */
+    uint32_t jam_period_us;     /* an interferer on air every period ...        */
+    uint32_t jam_us;            /* ... for this long, 0 = none                  */
+};
+
+extern struct sim_radio_stats sim_radio_stats;
+extern struct sim_air_cfg sim_air_cfg;
+extern const char *const sim_radio_state_name[8];
+
+void     sim_radio_peer(sim_air_fn fn);                /* gets what the firmware sends */
+void     sim_radio_send(const struct sim_air_pkt *pkt);/* put a packet on air          */
+uint32_t sim_radio_address(uint8_t logical);           /* from BASEn/PREFIXn           */
+uint64_t sim_radio_airtime(uint8_t len);               /* preamble to END, 2Mbit       */
+void     sim_radio_residency(uint64_t ns[8]);          /* state_ns[] up to now         */
+
+/* --- PAW3395 ----------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+struct sim_paw_stats {
+    uint64_t bursts;
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t srad_violations;   /* data clocked less than t_srad after the addr */
+    uint16_t dpi;               /* from the RES registers                       */
+    uint8_t  powered_up;        /* 0x3A = 0x5A seen                             */
+};
+
+extern struct sim_paw_stats sim_paw_stats;
+
+/* run -> rest1 -> rest2 -> rest3 times, scaled, so a harness can reach
+ * Rest3 (and the mouse's sleep) without two minutes of idle slots
+ */
+extern double sim_paw_downshift_scale;
+
+void sim_paw_attach(unsigned ncs_pin, unsigned motion_pin);
+void sim_paw_move(int32_t dx, int32_t dy);
+
+/* --- USB HOST ---------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+struct sim_usb_setup {
+    uint8_t  bmRequestType;
+    uint8_t  bRequest;
+    uint16_t wValue;
+    uint16_t wIndex;
+    uint16_t wLength;
+};
+
+#define SIM_USB_OK          0
+#define SIM_USB_STALL       (-1)
+#define SIM_USB_TIMEOUT     (-2)
+#define SIM_USB_GONE        (-3)
+
+/* control transfer done: result SIM_USB_*, IN data and its length */
+typedef void (*sim_usb_ctrl_fn)(void *arg, int result, const uint8_t *data, uint16_t len);
+
+/* interrupt IN data, `len` bytes read by the poll at sim_now() */
+typedef void (*sim_usb_in_fn)(uint8_t ep, const uint8_t *data, uint16_t len);
+
+struct sim_usb_stats {
+    uint64_t setups;
+    uint64_t ctrl_done;
+    uint64_t ctrl_stalled;
+    uint64_t ctrl_timeouts;
+    uint64_t ep0_in_pkts;
+    uint64_t ep0_naks;
+    uint64_t ep0_zlps;          /* zero length IN data packets                  */
+    uint64_t dma;               /* STARTEPIN/STARTEPOUT                         */
+    uint64_t dma_while_busy;    /* started with another still running           */
+    uint64_t in_pkts;           /* ep >= 1                                      */
+    uint64_t in_naks;
+    uint64_t resets;
+    uint64_t t_connect;         /* pull-up seen, or VBUS back with it on        */
+    uint64_t t_address;         /* SET_ADDRESS status done                      */
+    uint64_t suspends;          /* SUSPEND seen by the device                   */
+    uint64_t resumes;           /* frames back after resume signalling          */
+    uint64_t wakeups;           /* remote wakeups the host took                 */
+    uint64_t wakeups_ignored;   /* K not allowed, or driven from LOWPOWER       */
+    uint64_t t_suspend;
+    uint64_t t_wakeup;          /* the device's DPDMDRIVE                       */
+    uint64_t t_resume;
+};
+
+extern struct sim_usb_stats sim_usb_stats;
+
+void sim_usb_vbus(int on);                          /* POWER USBDETECTED/REMOVED        */
+void sim_usb_on_connect(sim_fn fn, void *arg);      /* after pull-up, debounce, reset   */
+void sim_usb_control(const struct sim_usb_setup *setup, const uint8_t *out,
+                     sim_usb_ctrl_fn done, void *arg);
+void sim_usb_poll(uint8_t ep, uint32_t interval_ms, sim_usb_in_fn fn);
+void sim_usb_reset(void);
+uint16_t sim_usb_frame(void);
+
+/* remote wakeup on if the device has it, then no frames until a resume,
+ * from the host or the device, see sim_usbd.c note 2
+ */
+void sim_usb_suspend(void);
+void sim_usb_resume(void);
+
+/* --- USB HOST: SCRIPTS ------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+#define SIM_USB_RESET       0x01    /* a bus reset, not a transfer                  */
+#define SIM_USB_MAY_STALL   0x02    /* a stall is an answer here                    */
+#define SIM_USB_CFG_LEN     0x04    /* wLength = wTotalLength read before           */
+#define SIM_USB_REPORT_LEN  0x08    /* wLength += the HID report descriptor's       */
+#define SIM_USB_STALLS      0x10    /* a stall is the only answer here              */
+
+struct sim_usb_step {
+    struct sim_usb_setup setup;
+    uint8_t     flags;
+    const char *what;
+    int32_t     expect_len;         /* IN data, -1: any. descriptors check bLength  */
+};
+
+struct sim_usb_script {
+    const char *name;
+    const struct sim_usb_step *steps;
+    unsigned    n;
+};
+
+/* what one run of a script cost, see sim_usbhost.c note 1 */
+struct sim_usb_run {
+    uint64_t t_start;               /* pull-up or VBUS, or the script's start       */
+    uint64_t t_first;               /* first SETUP                                  */
+    uint64_t t_configured;          /* SET_CONFIGURATION done, 0 if never           */
+    uint64_t t_end;
+    uint64_t xfer_ns;               /* inside control transfers                     */
+    uint64_t isrs;                  /* USBD interrupts                              */
+    uint64_t dma;
+    uint64_t setups;
+    uint64_t ep0_in;
+    uint64_t naks;
+    uint64_t zlps;
+    uint64_t stalls;
+    int      ok;
+    unsigned step;                  /* the one it failed at                         */
+    char     why[96];
+};
+
+extern const struct sim_usb_script sim_usb_linux;
+extern const struct sim_usb_script sim_usb_windows;
+
+const struct sim_usb_script *sim_usb_script_find(const char *name);
+
+/* enumerate with `script` on every connect, or run it once now */
+void sim_usb_enumerate(const struct sim_usb_script *script, struct sim_usb_run *run,
+                       sim_fn done, void *arg);
+void sim_usb_script_run(const struct sim_usb_script *script, struct sim_usb_run *run,
+                        sim_fn done, void *arg);
+void sim_usb_run_print(const char *label, const struct sim_usb_run *run);
+
+/* --- MEASURING ------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+#define SIM_HIST_BINS   200
+
+/* fixed-width bins from 0, the last one takes everything above */
+struct sim_hist {
+    const char *name;
+    const char *unit;
+    double   width;
+    uint64_t bins[SIM_HIST_BINS];
+    uint64_t n;
+    double   sum;
+    double   min;
+    double   max;
+};
+
+void   sim_hist_add(struct sim_hist *h, double v);
+double sim_hist_pct(const struct sim_hist *h, double pct);     /* lower bin edge   */
+void   sim_hist_print(const struct sim_hist *h);               /* n, mean, pcts    */
+void   sim_hist_csv(const struct sim_hist *h, FILE *f);        /* name,lo,hi,count */
+
+/* motion samples waiting to reach the host, oldest first. the counts a
+ * report carries retire the samples they came from, see sim_hist.c note 1
+ */
+void sim_age_push(uint64_t t, uint32_t counts);
+void sim_age_retire(uint32_t counts, uint64_t t_read, struct sim_hist *age_us);
+void sim_age_drop(uint32_t counts);                            /* lost, never sent */
+
+/* "t_us dx dy [buttons wheel]" per line, `#` comments. samples are
+ * played at t_offset + t_us, returns how many were scheduled or -1
+ */
+typedef void (*sim_motion_fn)(int32_t dx, int32_t dy, uint8_t buttons, int8_t wheel);
+int sim_motion_replay(const char *path, uint64_t t_offset, sim_motion_fn fn);
+
+#endif
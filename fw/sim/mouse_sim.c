@@ -0,0 +1,630 @@
+/**********************************************************************************
+ ** file            : mouse_sim.c
+ ** description     : runs the mouse firmware against the peripheral models, with
+ **                   a PAW3395 on SPIM0 and a stand-in dongle on the air
+ **
+ **                   build/mouse-sim [-t seconds] [-s seed] [-v] [-m trace] [-i idle_s]
+ **                                   [-w wake_s] [-W motion|click|wheel] [-d downshift_scale]
+ **                                   [-f competitive|balanced|eco] [-V vbat[,vbat_end]]
+ **                                   [-l loss] [-b enter,exit] [-j period_us,width_us]
+ **                                   [-p mouse_ppm] [-P dongle_ppm] [-o hist.csv]
+ **                                   [-U plug_s[,unplug_s]]
+ **
+ **********************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sim.h"
+
+#define NCS_PIN         0
+#define MOTION_PIN      6
+#define L_NO_PIN        8
+#define L_NC_PIN        29
+#define R_NO_PIN        15
+#define R_NC_PIN        14
+
+#define POLL_US         1000        /* the dongle's host polls      */
+#define TURNAROUND_US   41          /* dongle.c END -> reply on air */
+#define RAMP_US         40          /* the mouse's, fast ramp-up    */
+#define MOUSE_LEN       8           /* LENGTH without records       */
+#define ARM_US          100         /* dongle.c REPLY_ARM_US        */
+#define CC_MIN_US       300         /* dongle.c REPLY_CC_MIN_US     */
+#define DONGLE_DPI      1600
+#define IDLE_US         4000        /* no packet for this long, or  */
+#define ASLEEP_US       10000       /* this long                    */
+#define CLICK_MS        80
+#define ENERGY_STATES   8           /* fw/mouse/include/energy.h    */
+#define ENERGY_LEN      (4 * (ENERGY_STATES + 1))
+#define BATTERY_LEN     5           /* fw/mouse/include/battery.h   */
+#define VBAT_TICK_MS    100         /* -V ramp                      */
+
+int fw_main(void);
+
+static struct {
+    uint64_t idle_after;            /* stop moving, 0 = never       */
+    uint64_t wake_at;               /* and start again              */
+    char     wake_with;             /* 'm'otion, 'c'lick, 'w'heel   */
+    int32_t  dongle_ppm;
+    uint64_t plug_at;               /* -U: VBUS on, 0 = never       */
+    uint64_t unplug_at;             /* and off again, 0 = never     */
+    uint8_t  profile;               /* what the stand-in forwards   */
+    double   vbat[2];               /* VDDH at the start and end    */
+    uint64_t end;
+    const char *trace;
+    const char *csv;
+} opt;
+
+static struct {
+    uint64_t pkts;
+    uint64_t lost;                  /* sim_air_cfg, either way      */
+    uint64_t crc_err;
+    uint64_t seq_gaps;
+    int64_t  dx;
+    int64_t  dy;
+    uint64_t t_last;
+    int      seq;
+    uint32_t lost_run;
+    uint64_t slot_t0;
+    uint64_t slot_awake;
+    uint64_t slot_radio[8];
+    uint64_t slot_hfxo;
+    uint64_t slot_constlat;
+    double   charge_uc;
+    uint64_t t_wake;                /* input while idle or asleep   */
+    struct sim_hist *h_wake;        /* h_idle or h_wake             */
+    uint64_t wakes;
+    uint8_t  buttons;
+    uint64_t presses;
+    int64_t  wheel;
+    uint64_t records;               /* energy records from the mouse */
+    uint32_t energy[2][ENERGY_STATES + 1];  /* last two, charge last */
+    double   energy_uc[2];          /* st.charge_uc at each         */
+    uint64_t energy_t[2];
+    uint16_t battery_mv;            /* the last battery state       */
+    uint8_t  battery_soc;
+    uint16_t battery_min;
+    double   battery_vddh;          /* what COMP saw then           */
+    uint8_t  wired;                 /* VBUS on                      */
+    uint64_t wired_reports;         /* ep1 reads with data          */
+} st = { .seq = -1 };
+
+static const char *const energy_names[ENERGY_STATES] = {
+    "tx", "rx", "ramp", "spi", "cpu", "wfi", "idle", "sleep",
+};
+
+/* see note 1 */
+static struct sim_hist h_period = { .name = "slot_period", .unit = "us",    .width = 10   };
+static struct sim_hist h_age    = { .name = "report_age",  .unit = "us",    .width = 50   };
+static struct sim_hist h_sensor = { .name = "sensor_us",   .unit = "us",    .width = 1    };
+static struct sim_hist h_lost   = { .name = "lost_run",    .unit = "slots", .width = 1    };
+static struct sim_hist h_charge = { .name = "charge_slot", .unit = "uC",    .width = 0.05 };
+static struct sim_hist h_idle   = { .name = "idle_report", .unit = "us",    .width = 100  };
+static struct sim_hist h_wake   = { .name = "wake_report", .unit = "us",    .width = 100  };
+static struct sim_hist h_wired  = { .name = "wired_age",   .unit = "us",    .width = 50   };
+
+static struct sim_usb_run wired_run;
+
+/* nRF52820 at 3V on the LDO, datasheet typicals: radio by model state
+ * (RX at 2Mbit, TX by TXPOWER), the cpu running from flash, and asleep
+ * with only the RC oscillator and RTC. the crystal and CONSTLAT come on
+ * top whenever they are up, awake or not. the PAW3395 isn't counted
+ */
+static const double radio_ma[8] = { 0.0, 6.0, 8.0, 9.8, 6.0, 7.0, 9.6, 6.0 };
+#define TX_MA(dbm)      ((dbm) >= 4 ? 13.0 : (dbm) >= 0 ? 9.6 : (dbm) >= -4 ? 8.1 : 7.3)
+#define CPU_RUN_MA      3.7
+#define CPU_SLEEP_MA    0.002
+#define HFXO_MA         0.25
+#define CONSTLAT_MA     0.35
+
+/* --- STAND-IN DONGLE --------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+/* charge since the last TX END, the mouse's slot boundary */
+static void slot_charge(void) {
+
+    uint64_t radio[8], hfxo, constlat;
+    uint64_t awake = sim_awake_ns();
+    uint64_t dt    = sim_now() - st.slot_t0;
+    double   pc    = 0;                         /* mA * ns */
+
+    sim_radio_residency(radio);
+    sim_clock_residency(&hfxo, &constlat);
+    for (int i = 0; i < 8; i++) {
+        pc += (i == 6 ? TX_MA(sim_radio_stats.txpower) : radio_ma[i]) * (radio[i] - st.slot_radio[i]);
+    }
+    pc += CPU_RUN_MA   * (awake - st.slot_awake);
+    pc += CPU_SLEEP_MA * (dt - (awake - st.slot_awake));
+    pc += HFXO_MA      * (hfxo - st.slot_hfxo);
+    pc += CONSTLAT_MA  * (constlat - st.slot_constlat);
+
+    if (st.slot_t0) {
+        sim_hist_add(&h_charge, pc / 1e6);
+    }
+    st.charge_uc += pc / 1e6;
+    st.slot_t0    = sim_now();
+    st.slot_awake = awake;
+    st.slot_hfxo     = hfxo;
+    st.slot_constlat = constlat;
+    memcpy(st.slot_radio, radio, sizeof(radio));
+}
+
+/* ms per state and charge since boot (energy.h's record), kept with what
+ * the sim counted up to the same packet (note 2)
+ */
+static void energy_rx(const uint8_t *data) {
+
+    memcpy(&st.battery_mv, &data[ENERGY_LEN], 2);
+    st.battery_soc = data[ENERGY_LEN + 2];
+    memcpy(&st.battery_min, &data[ENERGY_LEN + 3], 2);
+    st.battery_vddh = sim_comp_vddh();
+
+    st.energy_uc[0] = st.energy_uc[1];
+    st.energy_t[0]  = st.energy_t[1];
+    memcpy(st.energy[0], st.energy[1], sizeof(st.energy[0]));
+
+    memcpy(st.energy[1], data, sizeof(st.energy[1]));
+    st.energy_uc[1] = st.charge_uc;
+    st.energy_t[1]  = sim_now();
+    st.records++;
+
+    if (sim_cfg.verbose) {
+        fprintf(stderr, "%10.3f ms  energy record: %u uC, battery %u mV %u%% %u min\n",
+                sim_now() / 1e6, st.energy[1][ENERGY_STATES],
+                st.battery_mv, st.battery_soc, st.battery_min);
+    }
+}
+
+/* the last two records against each other, the first one comes at boot */
+static void energy_report(void) {
+
+    uint32_t d[ENERGY_STATES + 1];
+    double   up_ms = 0;
+
+    for (int i = 0; i <= ENERGY_STATES; i++) {
+        d[i] = st.energy[1][i] - st.energy[0][i];
+    }
+    for (int i = 4; i < ENERGY_STATES; i++) {     /* cpu, wfi, idle, sleep */
+        up_ms += d[i];
+    }
+    if (!up_ms) {
+        return;
+    }
+
+    fprintf(stderr, "energy: %llu records, the last %.1f s:", (unsigned long long) st.records,
+            up_ms / 1e3);
+    for (int i = 0; i < ENERGY_STATES; i++) {
+        fprintf(stderr, " %s %.1f%%", energy_names[i], 100.0 * d[i] / up_ms);
+    }
+
+    double sim_uc = st.energy_uc[1] - st.energy_uc[0];
+    double sim_s  = (st.energy_t[1] - st.energy_t[0]) / 1e9;
+    fprintf(stderr, "\nenergy: mouse says %.3f mA, the sim %.3f mA\n",
+            d[ENERGY_STATES] / up_ms, sim_uc / sim_s / 1e3);
+}
+
+/* what dongle.c's radio_isr answers: time until its host's next ep1 poll,
+ * less 100us, counted on its own crystal
+ */
+static void dongle_rx(const struct sim_air_pkt *pkt) {
+
+    uint64_t end = pkt->t_start + sim_radio_airtime(pkt->data[0]);
+
+    slot_charge();
+
+    /* LENGTH, btn_vbat, dx, dy, wheel, seq, sensor_us */
+    int16_t dx, dy;
+    memcpy(&dx, &pkt->data[2], 2);
+    memcpy(&dy, &pkt->data[4], 2);
+    uint8_t  buttons   = pkt->data[1] & 3;
+    int8_t   wheel     = (int8_t) pkt->data[6];
+    uint8_t  seq       = pkt->data[7];
+    uint8_t  sensor_us = pkt->data[8];
+    uint32_t counts    = abs(dx) + abs(dy);
+
+    if (st.t_last) {
+        sim_hist_add(&h_period, (pkt->t_start - st.t_last) / 1e3);
+    }
+    st.t_last = pkt->t_start;
+
+    if (pkt->lost || !pkt->crc_ok) {
+        if (pkt->lost) {
+            st.lost++;
+        }
+        else {
+            st.crc_err++;
+        }
+        st.lost_run++;
+        sim_age_drop(counts);
+        if (pkt->lost) {
+            return;
+        }
+    }
+    else {
+        if (st.lost_run) {
+            sim_hist_add(&h_lost, st.lost_run);
+            st.lost_run = 0;
+        }
+
+        st.pkts++;
+        st.dx += dx;
+        st.dy += dy;
+        st.wheel   += wheel;
+        st.presses += __builtin_popcount(buttons & ~st.buttons);
+        if (st.seq >= 0 && seq != (uint8_t) (st.seq + 1)) {
+            st.seq_gaps++;
+        }
+        st.seq = seq;
+        if (pkt->data[0] >= 8 + ENERGY_LEN + BATTERY_LEN) {
+            energy_rx(&pkt->data[9]);
+        }
+        if (sensor_us) {
+            sim_hist_add(&h_sensor, sensor_us);
+        }
+
+        uint64_t next_poll = (end / (POLL_US * SIM_US) + 1) * POLL_US * SIM_US;
+        sim_age_retire(counts, next_poll, &h_age);
+
+        if (st.t_wake && (counts || wheel || buttons != st.buttons)) {
+            sim_hist_add(st.h_wake, (next_poll - st.t_wake) / 1e3);
+            if (sim_cfg.verbose) {
+                fprintf(stderr, "%10.3f ms  %s: first input on air +%.1f us, at the host +%.1f us\n",
+                        sim_now() / 1e6, st.h_wake == &h_wake ? "wake" : "idle",
+                        (pkt->t_start - st.t_wake) / 1e3, (next_poll - st.t_wake) / 1e3);
+            }
+            st.t_wake = 0;
+        }
+        st.buttons = buttons;
+    }
+
+    /* a bad CRC still gets its reply, dongle.c doesn't look first.
+     * the next END goes ARM_US ahead of a poll (dongle.c note 8)
+     */
+    int64_t until_poll = POLL_US - (end / SIM_US) % POLL_US;
+    int64_t next_end   = TURNAROUND_US + sim_radio_airtime(5) / SIM_US + RAMP_US
+                       + sim_radio_airtime(MOUSE_LEN) / SIM_US;
+    int64_t cc_us      = until_poll - next_end - ARM_US;
+    if (cc_us < CC_MIN_US) {
+        cc_us += POLL_US;
+    }
+    uint16_t cc  = cc_us * (1.0 + opt.dongle_ppm / 1e6) + 0.5;
+    uint16_t dpi = DONGLE_DPI;
+
+    struct sim_air_pkt reply = {
+        .t_start = end + TURNAROUND_US * SIM_US,
+        .address = sim_radio_address(1),
+        .freq    = pkt->freq,
+        .crc_ok  = 1,
+        .rssi    = -50,
+        .len     = 6,
+    };
+    reply.data[0] = 5;
+    memcpy(&reply.data[1], &cc, 2);
+    memcpy(&reply.data[3], &dpi, 2);
+    reply.data[5] = opt.profile;
+
+    sim_radio_send(&reply);
+}
+
+/* --- CABLE ------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+/* ep1 on the cable, mouse.c note 9: buttons, x, y, wheel, padding */
+static void wired_in(uint8_t ep, const uint8_t *data, uint16_t len) {
+
+    (void) ep;
+    if (len < 7) {
+        return;
+    }
+
+    int16_t dx, dy, wheel;
+    memcpy(&dx, &data[1], 2);
+    memcpy(&dy, &data[3], 2);
+    memcpy(&wheel, &data[5], 2);
+    uint8_t buttons = data[0] & 3;
+
+    st.wired_reports++;
+    st.dx      += dx;
+    st.dy      += dy;
+    st.wheel   += wheel;
+    st.presses += __builtin_popcount(buttons & ~st.buttons);
+    st.buttons  = buttons;
+
+    sim_age_retire(abs(dx) + abs(dy), sim_now(), &h_wired);
+}
+
+static void wired_enumerated(void *arg) {
+
+    (void) arg;
+    if (wired_run.ok) {
+        sim_usb_poll(1, 1, wired_in);
+    }
+}
+
+static void plug(void *arg) {
+
+    (void) arg;
+    st.wired = 1;
+    sim_usb_enumerate(&sim_usb_linux, &wired_run, wired_enumerated, NULL);
+    sim_usb_vbus(1);
+}
+
+/* back on the air: the next packet starts the slot counts over */
+static void unplug(void *arg) {
+
+    (void) arg;
+    st.wired  = 0;
+    st.t_last = 0;
+    sim_usb_vbus(0);
+}
+
+/* --- USER -------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+/* SPDT switches, common to ground: pressed shorts NO, released NC */
+static void button(unsigned no_pin, unsigned nc_pin, int pressed) {
+    sim_gpio_set(no_pin, pressed ? 0 : SIM_PIN_FLOAT);
+    sim_gpio_set(nc_pin, pressed ? SIM_PIN_FLOAT : 0);
+}
+
+static void user_input(int32_t dx, int32_t dy, uint8_t buttons, int8_t wheel) {
+
+    static uint8_t last;
+
+    /* the mouse has gone quiet, this is what wakes it. not on the cable */
+    uint64_t quiet = st.t_last && !st.wired ? sim_now() - st.t_last : 0;
+    if (!st.t_wake && quiet > ASLEEP_US * SIM_US) {
+        st.t_wake = sim_now();
+        st.h_wake = &h_wake;
+        st.wakes++;
+    }
+    else if (!st.t_wake && quiet > IDLE_US * SIM_US) {
+        st.t_wake = sim_now();
+        st.h_wake = &h_idle;
+    }
+
+    sim_age_push(sim_now(), abs(dx) + abs(dy));
+    sim_paw_move(dx, dy);
+
+    if ((buttons ^ last) & 1) button(L_NO_PIN, L_NC_PIN, buttons & 1);
+    if ((buttons ^ last) & 2) button(R_NO_PIN, R_NC_PIN, buttons & 2);
+    last = buttons;
+
+    if (wheel) {
+        sim_qdec_turn(wheel);
+    }
+}
+
+static void release(void *arg) {
+    (void) arg;
+    user_input(0, 0, 0, 0);
+}
+
+/* no trace: a slow diagonal, one count per axis every 250us. -W ends the
+ * idle with a click or a detent instead, and no motion after it
+ */
+static void move(void *arg) {
+
+    (void) arg;
+    if (opt.idle_after && sim_now() >= opt.idle_after && sim_now() < opt.wake_at) {
+        sim_at(opt.wake_at, move, NULL);
+        return;
+    }
+    if (opt.wake_at && sim_now() == opt.wake_at && opt.wake_with == 'c') {
+        user_input(0, 0, 1, 0);
+        sim_at(sim_now() + CLICK_MS * SIM_MS, release, NULL);
+        return;
+    }
+    if (opt.wake_at && sim_now() == opt.wake_at && opt.wake_with == 'w') {
+        user_input(0, 0, 0, 1);
+        return;
+    }
+    user_input(1, -1, 0, 0);
+    sim_at(sim_now() + 250 * SIM_US, move, NULL);
+}
+
+static void report(void *arg) {
+
+    (void) arg;
+
+    fprintf(stderr, "\n--- mouse, %.3f s ---\n", sim_now() / 1e9);
+    fprintf(stderr, "packets %llu, lost on air %llu, crc errors %llu, seq gaps %llu\n",
+            (unsigned long long) st.pkts, (unsigned long long) st.lost,
+            (unsigned long long) st.crc_err, (unsigned long long) st.seq_gaps);
+    fprintf(stderr, "motion dx %lld dy %lld, presses %llu, wheel %lld\n", (long long) st.dx,
+            (long long) st.dy, (unsigned long long) st.presses, (long long) st.wheel);
+    fprintf(stderr, "paw: %s, bursts %llu, reads %llu, writes %llu, t_srad violations %llu, dpi %u\n",
+            sim_paw_stats.powered_up ? "up" : "not powered up",
+            (unsigned long long) sim_paw_stats.bursts, (unsigned long long) sim_paw_stats.reads,
+            (unsigned long long) sim_paw_stats.writes,
+            (unsigned long long) sim_paw_stats.srad_violations, sim_paw_stats.dpi);
+
+    fprintf(stderr, "radio:");
+    for (int i = 0; i < 8; i++) {
+        fprintf(stderr, " %s %.1f%%", sim_radio_state_name[i],
+                sim_now() ? 100.0 * sim_radio_stats.state_ns[i] / sim_now() : 0.0);
+    }
+    fprintf(stderr, "\nradio: tx %llu, rx ok %llu, crc err %llu, missed %llu, without hfxo %llu\n",
+            (unsigned long long) sim_radio_stats.tx, (unsigned long long) sim_radio_stats.rx_ok,
+            (unsigned long long) sim_radio_stats.rx_crc_err,
+            (unsigned long long) sim_radio_stats.rx_missed,
+            (unsigned long long) sim_radio_stats.no_hfxo);
+
+    uint64_t hfxo, constlat;
+    sim_clock_residency(&hfxo, &constlat);
+    fprintf(stderr, "clock: hfxo %.1f%%, constlat %.1f%%\n",
+            sim_now() ? 100.0 * hfxo / sim_now() : 0.0,
+            sim_now() ? 100.0 * constlat / sim_now() : 0.0);
+    if (st.slot_t0) {
+        fprintf(stderr, "nrf current %.3f mA mean over the slots\n",
+                st.charge_uc / (st.slot_t0 / 1e9) / 1e3);
+    }
+
+    if (st.wakes) {
+        fprintf(stderr, "wakes %llu\n", (unsigned long long) st.wakes);
+    }
+    if (st.records > 1) {
+        energy_report();
+    }
+    if (st.records) {
+        fprintf(stderr, "battery: %u mV at VDDH %.0f mV, %u%%, %u min left\n",
+                st.battery_mv, st.battery_vddh * 1e3, st.battery_soc, st.battery_min);
+    }
+    if (opt.plug_at) {
+        if (wired_run.t_end) {
+            sim_usb_run_print("wired", &wired_run);
+        }
+        fprintf(stderr, "wired: %llu reports, ep1 in %llu, in naks %llu\n",
+                (unsigned long long) st.wired_reports, (unsigned long long) sim_usb_stats.in_pkts,
+                (unsigned long long) sim_usb_stats.in_naks);
+    }
+
+    struct sim_hist *hs[] = { &h_period, &h_age, &h_sensor, &h_lost, &h_charge, &h_idle, &h_wake,
+                              &h_wired };
+    fprintf(stderr, "\n");
+    for (size_t i = 0; i < sizeof(hs) / sizeof(hs[0]); i++) {
+        sim_hist_print(hs[i]);
+    }
+    if (opt.csv) {
+        FILE *f = fopen(opt.csv, "w");
+        if (!f) {
+            perror(opt.csv);
+        }
+        else {
+            fprintf(f, "hist,lo,hi,count\n");
+            for (size_t i = 0; i < sizeof(hs) / sizeof(hs[0]); i++) {
+                sim_hist_csv(hs[i], f);
+            }
+            fclose(f);
+        }
+    }
+
+    fprintf(stderr, "\n");
+    sim_print_isr_stats();
+}
+
+/* -V: VDDH from one voltage to the other over the run */
+static void discharge(void *arg) {
+
+    (void) arg;
+
+    double f = (double) sim_now() / opt.end;
+    sim_comp_set_vddh(opt.vbat[0] + (opt.vbat[1] - opt.vbat[0]) * f);
+    sim_at(sim_now() + VBAT_TICK_MS * SIM_MS, discharge, NULL);
+}
+
+int main(int argc, char **argv) {
+
+    double   seconds = 2.0;
+    unsigned seed    = 1;
+    int c;
+
+    opt.profile = 1;
+    while ((c = getopt(argc, argv, "t:s:vm:i:w:W:d:f:V:l:b:j:p:P:o:U:")) != -1) {
+        switch (c) {
+            case 't': seconds           = atof(optarg); break;
+            case 's': seed              = atoi(optarg); break;
+            case 'v': sim_cfg.verbose   = 1; break;
+            case 'm': opt.trace         = optarg; break;
+            case 'i': opt.idle_after    = atof(optarg) * SIM_S; break;
+            case 'w': opt.wake_at       = atof(optarg) * SIM_S; break;
+            case 'W': opt.wake_with     = optarg[0]; break;
+            case 'd': sim_paw_downshift_scale = atof(optarg); break;
+            case 'f': opt.profile       = optarg[0] == 'c' ? 0 : optarg[0] == 'e' ? 2 : 1; break;
+            case 'V':
+                if (sscanf(optarg, "%lf,%lf", &opt.vbat[0], &opt.vbat[1]) < 2) {
+                    opt.vbat[1] = opt.vbat[0];
+                }
+                break;
+            case 'l': sim_air_cfg.loss  = atof(optarg); break;
+            case 'b': sscanf(optarg, "%lf,%lf", &sim_air_cfg.burst_enter, &sim_air_cfg.burst_exit); break;
+            case 'j': sscanf(optarg, "%u,%u", &sim_air_cfg.jam_period_us, &sim_air_cfg.jam_us); break;
+            case 'p': sim_cfg.hfclk_ppm = atoi(optarg); break;
+            case 'P': opt.dongle_ppm    = atoi(optarg); break;
+            case 'o': opt.csv           = optarg; break;
+            case 'U': {
+                double plug = 0, unplug = 0;
+                sscanf(optarg, "%lf,%lf", &plug, &unplug);
+                opt.plug_at   = plug * SIM_S;
+                opt.unplug_at = unplug * SIM_S;
+                break;
+            }
+            default:
+                fprintf(stderr, "usage: %s [-t seconds] [-s seed] [-v] [-m trace] [-i idle_s]\n"
+                                "       [-w wake_s] [-W motion|click|wheel] [-d downshift_scale]\n"
+                                "       [-f competitive|balanced|eco] [-V vbat[,vbat_end]]\n"
+                                "       [-l loss] [-b enter,exit] [-j period_us,width_us]\n"
+                                "       [-p mouse_ppm] [-P dongle_ppm] [-o hist.csv]\n"
+                                "       [-U plug_s[,unplug_s]]\n", argv[0]);
+                return 2;
+        }
+    }
+    srand(seed);
+
+    sim_init();
+    sim_paw_attach(NCS_PIN, MOTION_PIN);
+    button(L_NO_PIN, L_NC_PIN, 0);
+    button(R_NO_PIN, R_NC_PIN, 0);
+    sim_radio_peer(dongle_rx);
+
+    /* motion from 100ms, once paw_init() is through */
+    if (opt.trace) {
+        if (sim_motion_replay(opt.trace, 100 * SIM_MS, user_input) < 0) {
+            return 1;
+        }
+    }
+    else {
+        sim_at(100 * SIM_MS, move, NULL);
+    }
+    sim_on_exit(report, NULL);
+
+    if (opt.plug_at) {
+        sim_at(opt.plug_at, plug, NULL);
+    }
+    if (opt.unplug_at) {
+        sim_at(opt.unplug_at, unplug, NULL);
+    }
+
+    opt.end = seconds * SIM_S;
+    if (opt.vbat[0]) {
+        discharge(NULL);
+    }
+
+    sim_run(fw_main, (uint64_t) (seconds * SIM_S));
+}
+
+/* note 1 : what it measures
+ *
+ *          slot_period is TX start to TX start as the stand-in dongle hears it.
+ *          report_age runs from a motion sample to the host poll after the
+ *          packet that carried it reached the dongle (sim_hist.c note 1).
+ *          lost_run is how many slots in a row the dongle got nothing usable.
+ *          charge_slot is the nRF's charge from one TX END to the next: radio by
+ *          state, cpu awake and asleep, crystal and CONSTLAT, from the currents
+ *          above. the stand-in dongle's host polls on the sim's own clock. -P
+ *          moves the dongle's crystal against it, which shows up in the `cc` it
+ *          answers.
+ *
+ *          wake_report is for input that finds the mouse asleep (no packet
+ *          for ASLEEP_US): from that input to the host's poll after the first
+ *          packet carrying any, motion, a button change or wheel. the built-in
+ *          sweep stops at -i and comes back at -w, or with -W a click (held
+ *          CLICK_MS) or one detent wakes it instead. -d 0.01 gets the sensor to
+ *          Rest3 in about a second.
+ *
+ *          idle_report is the same for input that finds the link idle (no
+ *          packet for IDLE_US, but not ASLEEP_US): the mouse's 8ms heartbeat,
+ *          and how far pulling the next slot in beats it. -w before the sensor
+ *          reaches Rest3 lands there.
+ *
+ *          -U puts the cable in (VBUS) and, with a second time, takes it out
+ *          again. the host enumerates the mouse with the linux script and
+ *          polls its ep1 every frame; wired_age runs from a motion sample to
+ *          the poll that read it. the radio is quiet meanwhile, so the slot
+ *          histograms only cover the time on the air, and the first
+ *          charge_slot after the cable comes out holds the wired time. a
+ *          report still armed when the cable goes is lost with its motion,
+ *          report_age after that reads older by as much.
+ */
@@ -0,0 +1,970 @@
+/**********************************************************************************
+ ** file            : sim.c
+ ** description     : simulator core: register space, virtual time, NVIC
+ **
+ **                   the firmware's peripheral pointers are left as they are
+ **                   (0x40000000, 0x50000000, 0xE0000000) and those pages are
+ **                   mapped with no access, so every register access faults
+ **                   into the models here (note 1). ISRs are called from the
+ **                   fault handlers, nested the way the NVIC would (note 3).
+ **
+ **********************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <time.h>
+#include "sim_hw.h"
+
+#define SIM_STACK_SIZE      (8 << 20)
+#define SIM_PAGE            4096u
+#define SIM_POLL_READS      4           /* same value from the same reg = busy wait */
+#define SIM_SPIN_TICK_US    200         /* wall clock, see note 2                   */
+#define SIM_SPIN_NS         (2 * SIM_MS)
+#define SIM_MAX_PERIPHS     32
+#define SIM_MAX_EXIT        8
+#define SIM_MAX_DEPTH       16
+
+#define EFL_TF              0x100
+
+struct sim_cfg sim_cfg = {
+    .access_ns    = 100,
+    .isr_entry_ns = 200,
+    .cpu_hz       = 64000000,
+    .verbose      = 0,
+};
+
+struct sim_stats sim_stats;
+
+/* --- REGISTER SPACE ---------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+struct sim_region {
+    uint32_t base;
+    uint32_t size;
+    uint8_t *alias;             /* read/write view for the models */
+};
+
+static struct sim_region regions[] = {
+    { 0x40000000, 0x80000, NULL },      /* APB/AHB peripherals      */
+    { 0x50000000, 0x01000, NULL },      /* P0                       */
+    { 0xE0000000, 0x10000, NULL },      /* DWT, NVIC, SCB, debug    */
+};
+
+static struct sim_region *region_of(uintptr_t addr) {
+
+    for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+        if (addr >= regions[i].base && addr < (uintptr_t) regions[i].base + regions[i].size) {
+            return &regions[i];
+        }
+    }
+    return NULL;
+}
+
+volatile uint32_t *sim_reg(uint32_t addr) {
+
+    struct sim_region *r = region_of(addr);
+    if (!r) {
+        fprintf(stderr, "sim: no register at 0x%08X\n", addr);
+        abort();
+    }
+    return (volatile uint32_t *) (r->alias + ((addr - r->base) & ~3u));
+}
+
+static void region_map(struct sim_region *r) {
+
+    int fd = memfd_create("sim-regs", 0);
+    if (fd < 0 || ftruncate(fd, r->size) < 0) {
+        perror("sim: memfd");
+        exit(2);
+    }
+
+    void *fw = mmap((void *) (uintptr_t) r->base, r->size, PROT_NONE,
+                    MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+    if (fw != (void *) (uintptr_t) r->base) {
+        fprintf(stderr, "sim: can't map 0x%08X (build with -no-pie?)\n", r->base);
+        exit(2);
+    }
+
+    r->alias = mmap(NULL, r->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (r->alias == MAP_FAILED) {
+        perror("sim: mmap");
+        exit(2);
+    }
+    close(fd);
+}
+
+static struct sim_periph *periphs[SIM_MAX_PERIPHS];
+static int n_periphs;
+
+void sim_periph_add(struct sim_periph *p) {
+
+    if (n_periphs == SIM_MAX_PERIPHS) {
+        fprintf(stderr, "sim: too many peripherals\n");
+        exit(2);
+    }
+    periphs[n_periphs++] = p;
+    p->inten = 0;
+}
+
+struct sim_periph *sim_periph_at(uint32_t addr) {
+
+    uint32_t page = addr & ~(SIM_PAGE - 1);
+    for (int i = 0; i < n_periphs; i++) {
+        if (periphs[i]->base == page) {
+            return periphs[i];
+        }
+    }
+    return NULL;
+}
+
+/* --- VIRTUAL TIME ------------------------------------------------------------------ */
+/* ----------------------------------------------------------------------------------- */
+
+struct sim_event {
+    uint64_t t;
+    uint64_t seq;               /* FIFO among equal times */
+    sim_cb   fn;
+    void    *obj;
+    uint32_t tag;
+};
+
+static struct {
+    struct sim_event *ev;
+    size_t n;
+    size_t cap;
+    uint64_t seq;
+} heap;
+
+static uint64_t now_ns;
+static uint64_t end_ns = UINT64_MAX;
+static uint64_t wfi_t0;             /* in wfi since, see sim_awake_ns() */
+static uint8_t  in_wfi;
+
+static int ev_before(const struct sim_event *a, const struct sim_event *b) {
+    return (a->t < b->t) || (a->t == b->t && a->seq < b->seq);
+}
+
+void sim_schedule(uint64_t t, sim_cb fn, void *obj, uint32_t tag) {
+
+    if (heap.n == heap.cap) {
+        heap.cap = heap.cap ? heap.cap * 2 : 256;
+        heap.ev  = realloc(heap.ev, heap.cap * sizeof(*heap.ev));
+        if (!heap.ev) {
+            abort();
+        }
+    }
+
+    if (t < now_ns) {
+        t = now_ns;
+    }
+
+    size_t i = heap.n++;
+    struct sim_event e = { t, heap.seq++, fn, obj, tag };
+
+    while (i && ev_before(&e, &heap.ev[(i - 1) / 2])) {
+        heap.ev[i] = heap.ev[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap.ev[i] = e;
+}
+
+static struct sim_event heap_pop(void) {
+
+    struct sim_event top  = heap.ev[0];
+    struct sim_event last = heap.ev[--heap.n];
+    size_t i = 0;
+
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= heap.n) {
+            break;
+        }
+        if (c + 1 < heap.n && ev_before(&heap.ev[c + 1], &heap.ev[c])) {
+            c++;
+        }
+        if (!ev_before(&heap.ev[c], &last)) {
+            break;
+        }
+        heap.ev[i] = heap.ev[c];
+        i = c;
+    }
+    if (heap.n) {
+        heap.ev[i] = last;
+    }
+    return top;
+}
+
+uint64_t sim_now(void) {
+    return now_ns;
+}
+
+struct sim_at_call {
+    sim_fn fn;
+    void  *arg;
+};
+
+static void sim_at_cb(void *obj, uint32_t tag) {
+
+    (void) tag;
+    struct sim_at_call call = *(struct sim_at_call *) obj;
+    free(obj);
+    call.fn(call.arg);
+}
+
+void sim_at(uint64_t t, sim_fn fn, void *arg) {
+
+    struct sim_at_call *call = malloc(sizeof(*call));
+    call->fn  = fn;
+    call->arg = arg;
+    sim_schedule(t, sim_at_cb, call, 0);
+}
+
+static void sim_end(void);
+
+static void run_event(void) {
+
+    struct sim_event e = heap_pop();
+    if (e.t > now_ns) {
+        now_ns = e.t;
+    }
+    sim_stats.events++;
+    e.fn(e.obj, e.tag);
+}
+
+/* everything due up to t, then t */
+static void run_until(uint64_t t) {
+
+    while (heap.n && heap.ev[0].t <= t && heap.ev[0].t < end_ns) {
+        run_event();
+    }
+    if (t > now_ns) {
+        now_ns = t;
+    }
+    if (now_ns >= end_ns) {
+        sim_end();
+    }
+}
+
+/* jump to the next point in time something happens, 0 = nothing left */
+static int run_next(void) {
+
+    if (!heap.n) {
+        return 0;
+    }
+
+    uint64_t t = heap.ev[0].t;
+    if (t >= end_ns) {
+        now_ns = end_ns;
+        sim_end();
+    }
+    run_until(t);
+    return 1;
+}
+
+/* --- NVIC -------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+#define NVIC_BASE       0xE000E000
+#define NVIC_ISER       0x100
+#define NVIC_ICER       0x180
+#define NVIC_ISPR       0x200
+#define NVIC_ICPR       0x280
+#define NVIC_IABR       0x300
+#define NVIC_IPR        0x400
+#define NVIC_STIR       0xF00
+
+#define DWT_BASE        0xE0001000
+#define DWT_CTRL        0x000
+#define DWT_CYCCNT      0x004
+
+#define SIM_VECTORS(X)                                                      \
+    X(0,  clock_power_isr)  X(1,  radio_isr)        X(2,  uart0_uarte0_isr) \
+    X(3,  spi0_spim0_spis0_twi0_twim0_twis0_isr)                            \
+    X(4,  spi1_spim1_spis1_twi1_twim1_twis1_isr)                            \
+    X(5,  nfct_isr)         X(6,  gpiote_isr)       X(7,  saadc_isr)        \
+    X(8,  timer0_isr)       X(9,  timer1_isr)       X(10, timer2_isr)       \
+    X(11, rtc0_isr)         X(12, temp_isr)         X(13, rng_isr)          \
+    X(14, ecb_isr)          X(15, aar_ccm_isr)      X(16, wdt_isr)          \
+    X(17, rtc1_isr)         X(18, qdec_isr)         X(19, comp_lpcomp_isr)  \
+    X(20, egu0_swi0_isr)    X(21, egu1_swi1_isr)    X(22, egu2_swi2_isr)    \
+    X(23, egu3_swi3_isr)    X(24, egu4_swi4_isr)    X(25, egu5_swi5_isr)    \
+    X(26, timer3_isr)       X(27, timer4_isr)       X(28, pwm0_isr)         \
+    X(29, pdm_isr)          X(32, mwu_isr)          X(33, pwm1_isr)         \
+    X(34, pwm2_isr)         X(35, spi2_spim2_spis2_isr)                     \
+    X(36, rtc2_isr)         X(37, i2s_isr)          X(38, fpu_isr)          \
+    X(39, usbd_isr)
+
+/* the firmware's isrs, NULL if it doesn't have one (startup.c isn't built) */
+#define SIM_VECTOR_DECL(n, name)    extern void name(void) __attribute__((weak));
+SIM_VECTORS(SIM_VECTOR_DECL)
+
+struct sim_vector {
+    void (*fn)(void);
+    const char *name;
+};
+
+#define SIM_VECTOR_ENTRY(n, name)   [n] = { name, #name },
+static const struct sim_vector vectors[64] = {
+    SIM_VECTORS(SIM_VECTOR_ENTRY)
+};
+
+static struct {
+    uint64_t enabled;
+    uint64_t pending;
+    uint64_t active;
+    uint8_t  primask;
+    int      depth;
+    uint16_t prio[SIM_MAX_DEPTH];
+    uint64_t pend_t[64];
+} nvic;
+
+static struct sim_periph nvic_periph;
+static struct sim_periph dwt_periph;
+
+static void nvic_sync(void) {
+
+    for (int i = 0; i < 2; i++) {
+        uint32_t en = nvic.enabled >> (32 * i);
+        uint32_t pe = nvic.pending >> (32 * i);
+        REG(&nvic_periph, NVIC_ISER + 4 * i) = en;
+        REG(&nvic_periph, NVIC_ICER + 4 * i) = en;
+        REG(&nvic_periph, NVIC_ISPR + 4 * i) = pe;
+        REG(&nvic_periph, NVIC_ICPR + 4 * i) = pe;
+        REG(&nvic_periph, NVIC_IABR + 4 * i) = nvic.active >> (32 * i);
+    }
+}
+
+static void nvic_pend(int irq) {
+
+    if (!(nvic.pending & (1ULL << irq))) {
+        nvic.pending |= 1ULL << irq;
+        nvic.pend_t[irq] = now_ns;
+    }
+}
+
+static void nvic_write(struct sim_periph *p, uint32_t off, uint32_t val) {
+
+    (void) p;
+    uint32_t w = off & ~3u;
+
+    if (w >= NVIC_ISER && w < NVIC_ISER + 8) {
+        nvic.enabled |= (uint64_t) val << (32 * ((w - NVIC_ISER) / 4));
+    }
+    else if (w >= NVIC_ICER && w < NVIC_ICER + 8) {
+        nvic.enabled &= ~((uint64_t) val << (32 * ((w - NVIC_ICER) / 4)));
+    }
+    else if (w >= NVIC_ISPR && w < NVIC_ISPR + 8) {
+        for (int b = 0; b < 32; b++) {
+            if (val & (1u << b)) {
+                nvic_pend(b + 32 * ((w - NVIC_ISPR) / 4));
+            }
+        }
+    }
+    else if (w >= NVIC_ICPR && w < NVIC_ICPR + 8) {
+        nvic.pending &= ~((uint64_t) val << (32 * ((w - NVIC_ICPR) / 4)));
+    }
+    else if (w == NVIC_STIR) {
+        nvic_pend(val & 63);
+    }
+    else {
+        return;                 /* IPR, SCB, debug: plain memory */
+    }
+    nvic_sync();
+}
+
+static uint16_t nvic_prio(int irq) {
+    return ((volatile uint8_t *) sim_reg(NVIC_BASE + NVIC_IPR + (irq & ~3)))[irq & 3];
+}
+
+static uint16_t exec_prio(void) {
+    return nvic.depth ? nvic.prio[nvic.depth - 1] : 0x100;
+}
+
+/* peripheral lines are levels: any enabled event that is set. they
+ * pend the irq unless its isr is running, then again after it returns
+ */
+static void nvic_update(void) {
+
+    for (int i = 0; i < n_periphs; i++) {
+
+        struct sim_periph *p = periphs[i];
+        if (p->irq < 0 || !p->inten || (nvic.active & (1ULL << p->irq))) {
+            continue;
+        }
+
+        for (uint32_t b = 0; b < 32; b++) {
+            if ((p->inten & (1u << b)) && REG(p, 0x100 + 4 * b)) {
+                nvic_pend(p->irq);
+                break;
+            }
+        }
+    }
+}
+
+/* highest priority enabled and pending irq, -1 = none */
+static int nvic_best(void) {
+
+    uint64_t ready = nvic.enabled & nvic.pending;
+    int best = -1;
+    uint16_t best_prio = 0x100;
+
+    for (int irq = 0; ready; irq++, ready >>= 1) {
+        if ((ready & 1) && nvic_prio(irq) < best_prio) {
+            best = irq;
+            best_prio = nvic_prio(irq);
+        }
+    }
+    return best;
+}
+
+static volatile int busy;       /* in sim code, see note 2 */
+
+static void nvic_take(int irq) {
+
+    struct sim_isr_stats *st = &sim_stats.isr[irq];
+
+    if (!vectors[irq].fn) {
+        fprintf(stderr, "sim: irq %d pending with no isr\n", irq);
+        sim_stop("unhandled irq");
+    }
+    if (nvic.depth == SIM_MAX_DEPTH) {
+        sim_stop("isr nesting too deep");
+    }
+
+    uint64_t lat = now_ns - nvic.pend_t[irq];
+    st->lat_ns += lat;
+    if (lat > st->lat_max_ns) {
+        st->lat_max_ns = lat;
+    }
+
+    nvic.pending &= ~(1ULL << irq);
+    nvic.active  |= 1ULL << irq;
+    nvic.prio[nvic.depth++] = nvic_prio(irq);
+    if ((uint64_t) nvic.depth > sim_stats.max_depth) {
+        sim_stats.max_depth = nvic.depth;
+    }
+    nvic_sync();
+
+    uint64_t t0 = now_ns;
+    run_until(now_ns + sim_cfg.isr_entry_ns);
+
+    int saved = busy;
+    busy = 0;
+    vectors[irq].fn();
+    busy = saved;
+
+    run_until(now_ns + sim_cfg.isr_entry_ns);
+
+    nvic.depth--;
+    nvic.active &= ~(1ULL << irq);
+    nvic_sync();
+
+    uint64_t ns = now_ns - t0;
+    st->count++;
+    st->ns += ns;
+    if (ns > st->max_ns) {
+        st->max_ns = ns;
+    }
+}
+
+/* run whatever may preempt the current level now */
+static void nvic_check(void) {
+
+    for (;;) {
+        nvic_update();
+        int irq = nvic_best();
+        if (irq < 0 || nvic.primask || nvic_prio(irq) >= exec_prio()) {
+            return;
+        }
+        nvic_take(irq);
+    }
+}
+
+/* wfi wakes on what would preempt with PRIMASK clear */
+static int nvic_wake(void) {
+
+    nvic_update();
+    int irq = nvic_best();
+    return irq >= 0 && nvic_prio(irq) < exec_prio();
+}
+
+/* --- DWT --------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+static uint64_t cyccnt_base;
+
+/* the core clock stops in wfi, and CYCCNT with it */
+static uint32_t cyccnt_now(void) {
+    return (uint32_t) (((now_ns - sim_stats.sleep_ns) * sim_cfg.cpu_hz) / SIM_S - cyccnt_base);
+}
+
+static void dwt_read(struct sim_periph *p, uint32_t off) {
+
+    if ((off & ~3u) == DWT_CYCCNT && (REG(p, DWT_CTRL) & 1)) {
+        REG(p, DWT_CYCCNT) = cyccnt_now();
+    }
+}
+
+static void dwt_write(struct sim_periph *p, uint32_t off, uint32_t val) {
+
+    (void) p;
+    if ((off & ~3u) == DWT_CYCCNT) {
+        cyccnt_base = (uint32_t) (cyccnt_now() + cyccnt_base - val);
+    }
+}
+
+/* --- ACCESS TRAPS ------------------------------------------------------------------ */
+/* ----------------------------------------------------------------------------------- */
+
+static struct {
+    uint8_t  active;
+    uint8_t  write;
+    uint32_t addr;
+} step;
+
+static struct {
+    uint32_t addr;
+    uint32_t val;
+    uint32_t n;
+} poll;
+
+static volatile uint64_t activity;      /* trapped accesses + wfi, for the spin check */
+static uint64_t activity_seen;
+static uint64_t activity_cpu;           /* process cpu ns when it was seen */
+
+/* irq_restore() over and over with no access in between, see note 2 */
+static struct {
+    uint64_t activity;
+    uint32_t n;
+} spin;
+static int running;
+
+static void page_protect(uint32_t addr, int prot) {
+    mprotect((void *) (uintptr_t) (addr & ~(SIM_PAGE - 1)), SIM_PAGE, prot);
+}
+
+static void access_before(uint32_t addr, int write) {
+
+    sim_stats.accesses++;
+    run_until(now_ns + sim_cfg.access_ns);
+
+    struct sim_periph *p = sim_periph_at(addr);
+    if (p && p->read) {
+        p->read(p, addr - p->base);
+    }
+
+    /* the same register read with the same value over and over: the
+     * firmware waits for an event, skip to it (note 2)
+     */
+    if (!write) {
+        uint32_t val = *sim_reg(addr);
+        if (addr == poll.addr && val == poll.val) {
+            if (++poll.n >= SIM_POLL_READS) {
+                sim_stats.polls++;
+                if (!run_next()) {
+                    fprintf(stderr, "sim: firmware waits on 0x%08X = 0x%08X, nothing left to happen\n",
+                            addr, val);
+                    sim_stop("deadlock");
+                }
+            }
+        }
+        else {
+            poll.addr = addr;
+            poll.val  = val;
+            poll.n    = 1;
+        }
+    }
+    else {
+        poll.addr = 0;
+    }
+
+    nvic_check();
+}
+
+static void access_write(uint32_t addr) {
+
+    struct sim_periph *p = sim_periph_at(addr);
+    if (!p) {
+        return;                 /* errata registers and such: plain memory */
+    }
+
+    uint32_t off = addr - p->base;
+    uint32_t w   = off & ~3u;
+    volatile uint32_t *reg = sim_reg(addr);
+    uint32_t val = *reg;
+
+    if (p->std && w < SIM_TASKS_END) {
+        *reg = 0;
+        if (val && p->task) {
+            p->task(p, w);
+        }
+        return;
+    }
+    if (p->std && w < SIM_EVENTS_END) {
+        return;
+    }
+    if (p->std && (w == SIM_INTEN || w == SIM_INTENSET || w == SIM_INTENCLR)) {
+        if (w == SIM_INTEN)     p->inten  = val;
+        if (w == SIM_INTENSET)  p->inten |= val;
+        if (w == SIM_INTENCLR)  p->inten &= ~val;
+        REG(p, SIM_INTEN)    = p->inten;
+        REG(p, SIM_INTENSET) = p->inten;
+        REG(p, SIM_INTENCLR) = p->inten;
+        return;
+    }
+    if (p->write) {
+        p->write(p, off, val);
+    }
+}
+
+static void on_segv(int sig, siginfo_t *si, void *ucv) {
+
+    (void) sig;
+    ucontext_t *uc = ucv;
+    uintptr_t a = (uintptr_t) si->si_addr;
+
+    if (!region_of(a) || step.active) {
+        fprintf(stderr, "sim: firmware fault at %p, rip 0x%llx, t = %.3f ms\n", si->si_addr,
+                (unsigned long long) uc->uc_mcontext.gregs[REG_RIP], now_ns / 1e6);
+        signal(SIGSEGV, SIG_DFL);
+        return;
+    }
+
+    int write = (uc->uc_mcontext.gregs[REG_ERR] & 2) != 0;
+
+    busy++;
+    activity++;
+    access_before((uint32_t) a, write);
+    busy--;
+
+    /* let the one instruction through, on_trap puts the page back */
+    step.active = 1;
+    step.write  = write;
+    step.addr   = (uint32_t) a;
+    page_protect(step.addr, PROT_READ | PROT_WRITE);
+    uc->uc_mcontext.gregs[REG_EFL] |= EFL_TF;
+}
+
+static void on_trap(int sig, siginfo_t *si, void *ucv) {
+
+    (void) sig;
+    (void) si;
+    ucontext_t *uc = ucv;
+
+    if (!step.active) {
+        signal(SIGTRAP, SIG_DFL);
+        return;
+    }
+
+    uc->uc_mcontext.gregs[REG_EFL] &= ~EFL_TF;
+    page_protect(step.addr, PROT_NONE);
+    step.active = 0;
+
+    busy++;
+    if (step.write) {
+        access_write(step.addr);
+    }
+    nvic_check();
+    busy--;
+}
+
+static uint64_t cpu_ns(void) {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t) ts.tv_sec * SIM_S + ts.tv_nsec;
+}
+
+/* firmware spinning on RAM only, e.g. a main loop on flags (note 2) */
+static void on_alarm(int sig) {
+
+    (void) sig;
+
+    if (busy || step.active || !running || nvic.depth) {
+        return;
+    }
+    if (activity != activity_seen) {
+        activity_seen = activity;
+        activity_cpu  = cpu_ns();
+        return;
+    }
+    if (cpu_ns() - activity_cpu < SIM_SPIN_TICK_US * SIM_US / 2) {
+        return;                 /* the host stalled us, nothing ran */
+    }
+
+    busy++;
+    uint64_t until = now_ns + SIM_SPIN_NS;
+    for (int n = 0; n < 256 && now_ns < until; n++) {
+        if (!run_next()) {
+            now_ns = end_ns;
+            sim_end();
+        }
+        nvic_check();
+    }
+    activity_seen = activity;
+    activity_cpu  = cpu_ns();
+    busy--;
+}
+
+/* --- FIRMWARE HOOKS ---------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+/* host code the firmware calls into (stdio behind RTT), see note 2 */
+void sim_enter(void) {
+    busy++;
+}
+
+void sim_leave(void) {
+    busy--;
+}
+
+/* models run inside wfi's run_next(), before it counts the sleep */
+uint64_t sim_awake_ns(void) {
+    return now_ns - sim_stats.sleep_ns - (in_wfi ? now_ns - wfi_t0 : 0);
+}
+
+uint32_t sim_irq_save(void) {
+
+    uint32_t primask = nvic.primask;
+    nvic.primask = 1;
+    return primask;
+}
+
+void sim_irq_restore(uint32_t primask) {
+
+    nvic.primask = primask & 1;
+    if (!nvic.primask) {
+        busy++;
+        if (activity != spin.activity) {
+            spin.activity = activity;
+            spin.n        = 1;
+        }
+        else if (++spin.n >= SIM_POLL_READS) {
+            sim_stats.polls++;
+            if (!run_next()) {
+                now_ns = end_ns;
+                sim_end();
+            }
+        }
+        nvic_check();
+        busy--;
+    }
+}
+
+void sim_wfi(void) {
+
+    busy++;
+    activity++;
+
+    while (!nvic_wake()) {
+        uint64_t t0 = now_ns;
+        wfi_t0 = now_ns;
+        in_wfi = 1;
+        if (!run_next()) {
+            sim_stats.sleep_ns += end_ns - now_ns;
+            now_ns = end_ns;
+            sim_end();
+        }
+        in_wfi = 0;
+        sim_stats.sleep_ns += now_ns - t0;
+    }
+
+    nvic_check();
+    busy--;
+}
+
+/* --- RUN --------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+static struct {
+    sim_fn fn;
+    void  *arg;
+} exit_hooks[SIM_MAX_EXIT];
+static int n_exit_hooks;
+
+static ucontext_t host_uc;
+static ucontext_t fw_uc;
+static int (*fw_entry)(void);
+
+void sim_on_exit(sim_fn fn, void *arg) {
+
+    if (n_exit_hooks < SIM_MAX_EXIT) {
+        exit_hooks[n_exit_hooks].fn  = fn;
+        exit_hooks[n_exit_hooks].arg = arg;
+        n_exit_hooks++;
+    }
+}
+
+_Noreturn void sim_exit(int status) {
+
+    struct itimerval off = {0};
+    setitimer(ITIMER_REAL, &off, NULL);
+    running = 0;
+    busy++;
+
+    for (int i = 0; i < n_exit_hooks; i++) {
+        exit_hooks[i].fn(exit_hooks[i].arg);
+    }
+    fflush(stdout);
+    exit(status);
+}
+
+static void sim_end(void) {
+    sim_exit(0);
+}
+
+_Noreturn void sim_stop(const char *why) {
+
+    fprintf(stderr, "sim: stopped at %.3f ms: %s\n", now_ns / 1e6, why);
+    sim_exit(1);
+}
+
+void sim_logf(const char *fmt, ...) {
+
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "[%12.3f us] ", now_ns / 1e3);
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    va_end(ap);
+}
+
+void sim_init(void) {
+
+    for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+        region_map(&regions[i]);
+    }
+
+    nvic_periph = (struct sim_periph) {
+        .name = "NVIC", .base = NVIC_BASE, .irq = -1, .write = nvic_write,
+    };
+    dwt_periph = (struct sim_periph) {
+        .name = "DWT", .base = DWT_BASE, .irq = -1, .read = dwt_read, .write = dwt_write,
+    };
+    sim_periph_add(&nvic_periph);
+    sim_periph_add(&dwt_periph);
+
+    sim_periph_init();
+    sim_radio_init();
+    sim_spim_init();
+    sim_usbd_init();
+}
+
+static void fw_start(void) {
+    fw_entry();
+}
+
+_Noreturn void sim_run(int (*fw_main)(void), uint64_t duration_ns) {
+
+    end_ns   = duration_ns;
+    fw_entry = fw_main;
+
+    /* below 4G: the firmware keeps stack addresses in 32-bit registers */
+    void *stack = mmap(NULL, SIM_STACK_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (stack == MAP_FAILED) {
+        perror("sim: stack");
+        exit(2);
+    }
+
+    getcontext(&fw_uc);
+    fw_uc.uc_stack.ss_sp   = stack;
+    fw_uc.uc_stack.ss_size = SIM_STACK_SIZE;
+    fw_uc.uc_link          = &host_uc;
+    makecontext(&fw_uc, fw_start, 0);
+
+    struct sigaction sa = {0};
+    sa.sa_flags     = SA_SIGINFO | SA_NODEFER;
+    sa.sa_sigaction = on_segv;
+    sigaction(SIGSEGV, &sa, NULL);
+    sa.sa_sigaction = on_trap;
+    sigaction(SIGTRAP, &sa, NULL);
+
+    struct sigaction alrm = {0};
+    alrm.sa_handler = on_alarm;
+    alrm.sa_flags   = SA_RESTART;
+    sigaction(SIGALRM, &alrm, NULL);
+
+    struct itimerval tick = {
+        .it_interval = { 0, SIM_SPIN_TICK_US },
+        .it_value    = { 0, SIM_SPIN_TICK_US },
+    };
+    setitimer(ITIMER_REAL, &tick, NULL);
+
+    running = 1;
+    swapcontext(&host_uc, &fw_uc);
+    sim_stop("firmware main() returned");
+}
+
+void sim_print_isr_stats(void) {
+
+    fprintf(stderr, "%-40s %9s %9s %9s %9s %9s\n", "isr", "count", "mean_us", "max_us",
+            "lat_us", "latmax_us");
+
+    for (int i = 0; i < 64; i++) {
+
+        struct sim_isr_stats *st = &sim_stats.isr[i];
+        if (!st->count) {
+            continue;
+        }
+        fprintf(stderr, "%-40s %9llu %9.2f %9.2f %9.2f %9.2f\n", vectors[i].name,
+                (unsigned long long) st->count, st->ns / 1e3 / st->count, st->max_ns / 1e3,
+                st->lat_ns / 1e3 / st->count, st->lat_max_ns / 1e3);
+    }
+    fprintf(stderr, "accesses %llu, polls skipped %llu, events %llu, nesting %llu, asleep %.1f%%\n",
+            (unsigned long long) sim_stats.accesses, (unsigned long long) sim_stats.polls,
+            (unsigned long long) sim_stats.events, (unsigned long long) sim_stats.max_depth,
+            now_ns ? 100.0 * sim_stats.sleep_ns / now_ns : 0.0);
+}
+
+/* note 1 : register access
+ *
+ *          each peripheral region is one memfd mapped twice: at its real address
+ *          with no access for the firmware, and read/write elsewhere for the models
+ *          (sim_reg). an access faults into on_segv, which charges its cost, lets
+ *          the model refresh the register (a counter, say) and runs anything that
+ *          became due. the page is then opened for exactly one instruction (the
+ *          trap flag), and on_trap closes it again and hands a write to the model:
+ *          task, INTENSET/CLR, or the model's own write(). reads and writes land in
+ *          the shared pages, so the firmware's loads and stores are untouched.
+ *
+ * note 2 : time
+ *
+ *          time is virtual, in ns, and only moves through the event queue: each
+ *          trapped access costs `sim_cfg.access_ns`, an isr `isr_entry_ns` each way,
+ *          and code between accesses is free. that is coarse, but the firmware's
+ *          timing logic is about peripheral events (ramp-up, airtime, compare) and
+ *          those are exact.
+ *
+ *          waiting is skipped rather than simulated: wfi jumps to the next event
+ *          until an irq can be taken, a register read SIM_POLL_READS times with the
+ *          same value jumps one event per read, and so does irq_restore() after
+ *          SIM_POLL_READS rounds with no access in between (a flag an isr sets,
+ *          under PRIMASK). a thread-level loop that touches no register at all (the
+ *          dongle's main loop) is caught by a wall-clock tick that finds no access
+ *          since the last one, with half a tick of cpu time spent since, and
+ *          runs up to SIM_SPIN_NS worth of events. `busy` keeps that tick out of
+ *          the sim's own code, and it leaves isrs alone. without the cpu check a
+ *          host that stalled the process for two ticks landed it between two
+ *          ordinary accesses, and moved time under code with no loop in it.
+ *
+ * note 3 : interrupts
+ *
+ *          irq lines are levels, as on the nRF: an enabled event that is set keeps
+ *          the irq pending, re-checked after every access, every isr return and every
+ *          irq_restore(). an irq is taken when its IPR is below the running level and
+ *          PRIMASK is clear, by calling the isr from wherever the firmware is, so
+ *          nesting and preemption follow the NVIC. latency is counted from the line
+ *          going up to the isr call.
+ */
@@ -0,0 +1,139 @@
+/**********************************************************************************
+ ** file            : sim_hist.c
+ ** description     : distributions for the harnesses, and the motion age queue
+ **                   behind their report-age numbers
+ **
+ **********************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim_hw.h"
+
+/* --- HISTOGRAMS -------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+void sim_hist_add(struct sim_hist *h, double v) {
+
+    if (h->n == 0 || v < h->min) h->min = v;
+    if (h->n == 0 || v > h->max) h->max = v;
+    h->n++;
+    h->sum += v;
+
+    long b = v > 0 ? (long) (v / h->width) : 0;
+    h->bins[b < SIM_HIST_BINS ? b : SIM_HIST_BINS - 1]++;
+}
+
+double sim_hist_pct(const struct sim_hist *h, double pct) {
+
+    if (!h->n) {
+        return 0;
+    }
+
+    uint64_t want = (uint64_t) (pct / 100.0 * h->n + 0.5);
+    uint64_t seen = 0;
+
+    for (int b = 0; b < SIM_HIST_BINS - 1; b++) {
+        seen += h->bins[b];
+        if (seen >= want && seen) {
+            double edge = b * h->width;
+            return edge < h->min ? h->min : edge;
+        }
+    }
+    return h->max;
+}
+
+void sim_hist_print(const struct sim_hist *h) {
+
+    if (!h->n) {
+        fprintf(stderr, "%-14s -\n", h->name);
+        return;
+    }
+    fprintf(stderr, "%-14s n %-7llu mean %8.2f  p50 %8.2f  p90 %8.2f  p99 %8.2f  max %8.2f %s\n",
+            h->name, (unsigned long long) h->n, h->sum / h->n, sim_hist_pct(h, 50),
+            sim_hist_pct(h, 90), sim_hist_pct(h, 99), h->max, h->unit);
+}
+
+void sim_hist_csv(const struct sim_hist *h, FILE *f) {
+
+    for (int b = 0; b < SIM_HIST_BINS; b++) {
+        if (h->bins[b]) {
+            fprintf(f, "%s,%g,%g,%llu\n", h->name, b * h->width,
+                    b == SIM_HIST_BINS - 1 ? h->max : (b + 1) * h->width,
+                    (unsigned long long) h->bins[b]);
+        }
+    }
+}
+
+/* --- MOTION AGE -------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+struct age_sample {
+    uint64_t t;
+    uint32_t counts;
+};
+
+static struct {
+    struct age_sample *q;
+    size_t head;
+    size_t n;
+    size_t cap;
+} age;
+
+void sim_age_push(uint64_t t, uint32_t counts) {
+
+    if (!counts) {
+        return;
+    }
+    if (age.n == age.cap) {
+        size_t cap = age.cap ? 2 * age.cap : 256;
+        struct age_sample *q = malloc(cap * sizeof(*q));
+        for (size_t i = 0; i < age.n; i++) {
+            q[i] = age.q[(age.head + i) % age.cap];
+        }
+        free(age.q);
+        age.q    = q;
+        age.cap  = cap;
+        age.head = 0;
+    }
+    age.q[(age.head + age.n) % age.cap] = (struct age_sample) { t, counts };
+    age.n++;
+}
+
+/* oldest first: whole samples retire, a partly sent one waits for the rest */
+static void age_take(uint32_t counts, uint64_t t_read, struct sim_hist *age_us) {
+
+    while (counts && age.n) {
+        struct age_sample *s = &age.q[age.head];
+        if (counts < s->counts) {
+            s->counts -= counts;
+            return;
+        }
+        counts -= s->counts;
+        if (age_us) {
+            sim_hist_add(age_us, (double) (t_read - s->t) / SIM_US);
+        }
+        age.head = (age.head + 1) % age.cap;
+        age.n--;
+    }
+}
+
+void sim_age_retire(uint32_t counts, uint64_t t_read, struct sim_hist *age_us) {
+    age_take(counts, t_read, age_us);
+}
+
+void sim_age_drop(uint32_t counts) {
+    age_take(counts, 0, NULL);
+}
+
+/* note 1 : report age
+ *
+ *          a report doesn't say which motion it carries, only how much. so the
+ *          harness pushes every sample it makes with its time and size
+ *          (|dx| + |dy| counts), and each report or packet that gets through
+ *          retires that many counts from the front, one age per sample it
+ *          finishes. motion lost on the way has to be dropped the same way, or
+ *          everything after it would look older than it is. counts that cancel
+ *          out in an accumulator (left then right within one report) retire
+ *          late, so a trace full of direction changes reads a little high.
+ */
@@ -0,0 +1,101 @@
+/**********************************************************************************
+ ** file            : sim_hw.h
+ ** description     : between the simulator core (sim.c) and the peripheral
+ **                   models
+ **
+ **********************************************************************************/
+
+#ifndef SIM_HW_H
+#define SIM_HW_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "sim.h"
+
+/* nRF peripheral layout: tasks, events, then INTEN/INTENSET/INTENCLR */
+#define SIM_TASKS_END       0x100
+#define SIM_EVENTS_END      0x200
+#define SIM_SHORTS          0x200
+#define SIM_INTEN           0x300
+#define SIM_INTENSET        0x304
+#define SIM_INTENCLR        0x308
+
+struct sim_periph;
+
+typedef void (*sim_task_fn)(struct sim_periph *p, uint32_t off);
+typedef void (*sim_write_fn)(struct sim_periph *p, uint32_t off, uint32_t val);
+typedef void (*sim_read_fn)(struct sim_periph *p, uint32_t off);
+typedef void (*sim_event_fn)(struct sim_periph *p, uint32_t off);
+
+/* one 4k register block. tasks/events/INTEN are handled by the core
+ * for `std` blocks, the rest goes to write(). read() refreshes a
+ * register before the firmware sees it, event() applies SHORTS
+ */
+struct sim_periph {
+    const char  *name;
+    uint32_t     base;
+    int          irq;           /* -1: none */
+    uint8_t      std;
+    sim_task_fn  task;
+    sim_write_fn write;
+    sim_read_fn  read;
+    sim_event_fn event;
+    void        *ctx;
+    uint32_t     inten;
+};
+
+/* the sim's own view of the register space, never trapped */
+volatile uint32_t *sim_reg(uint32_t addr);
+
+#define REG(p, off)     (*sim_reg((p)->base + (off)))
+
+void sim_periph_add(struct sim_periph *p);
+struct sim_periph *sim_periph_at(uint32_t addr);
+
+/* hardware event: EVENTS_x = 1, SHORTS, PPI, irq line */
+void sim_raise(struct sim_periph *p, uint32_t off);
+
+/* hardware task by address (PPI) */
+void sim_trigger(uint32_t addr);
+
+/* time-ordered callbacks for the models. `tag` lets a model drop
+ * stale ones: compare against a generation count it keeps
+ */
+typedef void (*sim_cb)(void *obj, uint32_t tag);
+void sim_schedule(uint64_t t, sim_cb fn, void *obj, uint32_t tag);
+
+/* firmware RAM through a register value (PTR registers) */
+static inline void *sim_ptr(uint32_t addr) {
+    return (void *) (uintptr_t) addr;
+}
+
+/* model init, called from sim_init() */
+void sim_periph_init(void);
+void sim_radio_init(void);
+void sim_spim_init(void);
+void sim_usbd_init(void);
+
+#define SIM_USBD_IRQ    39
+
+/* the frames stop, sim_usb_suspend()'s last step (sim_usbd.c) */
+void sim_usb_bus_suspend(void);
+
+/* HFCLK on the crystal and settled (sim_periph.c) */
+int  sim_hfxo_running(void);
+
+/* VBUS, POWER USBDETECTED/USBREMOVED/USBPWRRDY (sim_periph.c) */
+int  sim_power_vbus(void);
+void sim_power_set_vbus(int on);
+
+/* around host code called from the firmware, keeps the spin tick out */
+void sim_enter(void);
+void sim_leave(void);
+
+/* gpio watch, for slaves on a chip select */
+typedef void (*sim_pin_fn)(unsigned pin, int level);
+void sim_gpio_watch(unsigned pin, sim_pin_fn fn);
+
+#define sim_log(...)    do { if (sim_cfg.verbose) sim_logf(__VA_ARGS__); } while (0)
+void sim_logf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+#endif
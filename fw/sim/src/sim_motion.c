@@ -0,0 +1,67 @@
+/**********************************************************************************
+ ** file            : sim_motion.c
+ ** description     : replays a recorded motion trace into a harness
+ **
+ **                   one sample per line, `t_us dx dy [buttons wheel]`, times
+ **                   from the start of the recording. tools/hidraw-rate.c
+ **                   writes this from the host's side of a real mouse
+ **
+ **********************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim_hw.h"
+
+struct motion_sample {
+    int32_t dx;
+    int32_t dy;
+    uint8_t buttons;
+    int8_t  wheel;
+    sim_motion_fn fn;
+};
+
+static void motion_play(void *arg) {
+
+    struct motion_sample *m = arg;
+    m->fn(m->dx, m->dy, m->buttons, m->wheel);
+    free(m);
+}
+
+int sim_motion_replay(const char *path, uint64_t t_offset, sim_motion_fn fn) {
+
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    char line[256];
+    int  n = 0, lineno = 0;
+
+    while (fgets(line, sizeof(line), f)) {
+
+        lineno++;
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+
+        double t_us;
+        int dx, dy, buttons = 0, wheel = 0;
+        if (sscanf(line, "%lf %d %d %d %d", &t_us, &dx, &dy, &buttons, &wheel) < 3 || t_us < 0) {
+            fprintf(stderr, "%s:%d: expected `t_us dx dy [buttons wheel]`\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+
+        struct motion_sample *m = malloc(sizeof(*m));
+        *m = (struct motion_sample) {
+            .dx = dx, .dy = dy, .buttons = buttons, .wheel = wheel, .fn = fn,
+        };
+        sim_at(t_offset + (uint64_t) (t_us * SIM_US), motion_play, m);
+        n++;
+    }
+
+    fclose(f);
+    return n;
+}
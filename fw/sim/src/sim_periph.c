@@ -0,0 +1,964 @@
+/**********************************************************************************
+ ** file            : sim_periph.c
+ ** description     : CLOCK/POWER, TIMER, RTC, PPI, GPIO/GPIOTE, QDEC and COMP models
+ **
+ **********************************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "sim_hw.h"
+
+/* --- EVENTS / TASKS / PPI ---------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+#define PPI_BASE        0x4001F000
+#define PPI_CHEN        0x500
+#define PPI_CHENSET     0x504
+#define PPI_CHENCLR     0x508
+#define PPI_CH_EEP(n)   (0x510 + 8 * (n))
+#define PPI_CH_TEP(n)   (0x514 + 8 * (n))
+#define PPI_FORK_TEP(n) (0x910 + 4 * (n))
+#define PPI_CHANNELS    20
+
+static struct sim_periph ppi;
+static uint32_t ppi_chen;
+
+void sim_trigger(uint32_t addr) {
+
+    struct sim_periph *p = sim_periph_at(addr);
+    if (p && p->task) {
+        p->task(p, addr - p->base);
+    }
+}
+
+static void ppi_event(uint32_t addr) {
+
+    for (int n = 0; n < PPI_CHANNELS; n++) {
+        if ((ppi_chen & (1u << n)) && REG(&ppi, PPI_CH_EEP(n)) == addr) {
+            if (REG(&ppi, PPI_CH_TEP(n))) {
+                sim_trigger(REG(&ppi, PPI_CH_TEP(n)));
+            }
+            if (REG(&ppi, PPI_FORK_TEP(n))) {
+                sim_trigger(REG(&ppi, PPI_FORK_TEP(n)));
+            }
+        }
+    }
+}
+
+static void ppi_write(struct sim_periph *p, uint32_t off, uint32_t val) {
+
+    switch (off) {
+        case PPI_CHEN:      ppi_chen  = val;  break;
+        case PPI_CHENSET:   ppi_chen |= val;  break;
+        case PPI_CHENCLR:   ppi_chen &= ~val; break;
+        default:            return;
+    }
+    REG(p, PPI_CHEN)    = ppi_chen;
+    REG(p, PPI_CHENSET) = ppi_chen;
+    REG(p, PPI_CHENCLR) = ppi_chen;
+}
+
+void sim_raise(struct sim_periph *p, uint32_t off) {
+
+    REG(p, off) = 1;
+    if (p->event) {
+        p->event(p, off);
+    }
+    ppi_event(p->base + off);
+}
+
+/* --- CLOCK / POWER ----------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+#define CLOCK_BASE              0x40000000
+#define CLOCK_HFCLKSTART        0x000
+#define CLOCK_HFCLKSTOP         0x004
+#define CLOCK_LFCLKSTART        0x008
+#define CLOCK_LFCLKSTOP         0x00C
+#define POWER_CONSTLAT          0x078
+#define POWER_LOWPWR            0x07C
+#define CLOCK_HFCLKSTARTED      0x100
+#define CLOCK_LFCLKSTARTED      0x104
+#define POWER_USBDETECTED       0x11C
+#define POWER_USBREMOVED        0x120
+#define POWER_USBPWRRDY         0x124
+#define CLOCK_HFCLKRUN          0x408
+#define CLOCK_HFCLKSTAT         0x40C
+#define CLOCK_LFCLKRUN          0x414
+#define CLOCK_LFCLKSTAT         0x418
+#define POWER_USBREGSTATUS      0x438
+#define CLOCK_LFCLKSRC          0x518
+
+#define HFXO_STARTUP_NS         (300 * SIM_US)
+#define USBREG_STARTUP_NS       (1 * SIM_MS)
+
+static struct sim_periph clock_power;
+
+static struct {
+    uint32_t hf_gen;
+    uint32_t lf_gen;
+    uint8_t  vbus;
+    uint8_t  hfxo;              /* HFCLKSTART to HFCLKSTOP, ramping included */
+    uint8_t  constlat;
+    uint64_t t;                 /* residency below counted up to here       */
+} clk;
+
+struct sim_clock_stats sim_clock_stats;
+
+static void clock_account(void) {
+
+    uint64_t dt = sim_now() - clk.t;
+    if (clk.hfxo)     sim_clock_stats.hfxo_ns     += dt;
+    if (clk.constlat) sim_clock_stats.constlat_ns += dt;
+    clk.t = sim_now();
+}
+
+void sim_clock_residency(uint64_t *hfxo_ns, uint64_t *constlat_ns) {
+
+    clock_account();
+    *hfxo_ns     = sim_clock_stats.hfxo_ns;
+    *constlat_ns = sim_clock_stats.constlat_ns;
+}
+
+int sim_hfxo_running(void) {
+    return (REG(&clock_power, CLOCK_HFCLKSTAT) & ((1 << 16) | 1)) == ((1 << 16) | 1);
+}
+
+static void hfclk_started(void *obj, uint32_t tag) {
+
+    (void) obj;
+    if (tag != clk.hf_gen) {
+        return;
+    }
+    REG(&clock_power, CLOCK_HFCLKSTAT) = (1 << 16) | 1;
+    sim_raise(&clock_power, CLOCK_HFCLKSTARTED);
+}
+
+static void lfclk_started(void *obj, uint32_t tag) {
+
+    (void) obj;
+    if (tag != clk.lf_gen) {
+        return;
+    }
+    REG(&clock_power, CLOCK_LFCLKSTAT) = (1 << 16) | (REG(&clock_power, CLOCK_LFCLKSRC) & 3);
+    sim_raise(&clock_power, CLOCK_LFCLKSTARTED);
+}
+
+static void clock_task(struct sim_periph *p, uint32_t off) {
+
+    static const uint64_t lf_startup_ns[4] = {
+        600 * SIM_US,           /* RC       */
+        250 * SIM_MS,           /* Xtal     */
+        100 * SIM_US,           /* Synth    */
+        600 * SIM_US,
+    };
+
+    switch (off) {
+
+        case CLOCK_HFCLKSTART:
+            if (clk.hfxo) {
+                break;          /* running or on its way */
+            }
+            clock_account();
+            clk.hfxo = 1;
+            REG(p, CLOCK_HFCLKRUN) = 1;
+            sim_schedule(sim_now() + HFXO_STARTUP_NS, hfclk_started, NULL, ++clk.hf_gen);
+            break;
+
+        case CLOCK_HFCLKSTOP:
+            clock_account();
+            clk.hfxo = 0;
+            clk.hf_gen++;
+            REG(p, CLOCK_HFCLKRUN)  = 0;
+            REG(p, CLOCK_HFCLKSTAT) = 0;
+            break;
+
+        case CLOCK_LFCLKSTART:
+            REG(p, CLOCK_LFCLKRUN) = 1;
+            sim_schedule(sim_now() + lf_startup_ns[REG(p, CLOCK_LFCLKSRC) & 3],
+                         lfclk_started, NULL, ++clk.lf_gen);
+            break;
+
+        case CLOCK_LFCLKSTOP:
+            clk.lf_gen++;
+            REG(p, CLOCK_LFCLKRUN)  = 0;
+            REG(p, CLOCK_LFCLKSTAT) = 0;
+            break;
+
+        case POWER_CONSTLAT:
+        case POWER_LOWPWR:
+            if (clk.constlat != (off == POWER_CONSTLAT)) {
+                clock_account();
+                clk.constlat = off == POWER_CONSTLAT;
+                sim_log("POWER: %s", clk.constlat ? "CONSTLAT" : "LOWPWR");
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void usbreg_ready(void *obj, uint32_t tag) {
+
+    (void) obj;
+    (void) tag;
+    if (clk.vbus) {
+        REG(&clock_power, POWER_USBREGSTATUS) |= 2;
+        sim_raise(&clock_power, POWER_USBPWRRDY);
+    }
+}
+
+int sim_power_vbus(void) {
+    return clk.vbus;
+}
+
+void sim_power_set_vbus(int on) {
+
+    if (on == clk.vbus) {
+        return;
+    }
+    clk.vbus = on;
+
+    if (on) {
+        REG(&clock_power, POWER_USBREGSTATUS) = 1;
+        sim_raise(&clock_power, POWER_USBDETECTED);
+        sim_schedule(sim_now() + USBREG_STARTUP_NS, usbreg_ready, NULL, 0);
+    }
+    else {
+        REG(&clock_power, POWER_USBREGSTATUS) = 0;
+        sim_raise(&clock_power, POWER_USBREMOVED);
+    }
+}
+
+/* --- TIMER ------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+#define TIMER_START             0x000
+#define TIMER_STOP              0x004
+#define TIMER_CLEAR             0x00C
+#define TIMER_SHUTDOWN          0x010
+#define TIMER_CAPTURE(n)        (0x040 + 4 * (n))
+#define TIMER_COMPARE(n)        (0x140 + 4 * (n))
+#define TIMER_SHORTS            0x200
+#define TIMER_BITMODE           0x508
+#define TIMER_PRESCALER         0x510
+#define TIMER_CC(n)             (0x540 + 4 * (n))
+#define TIMER_CCS               6
+
+/* compares further out are re-checked at this distance instead of
+ * queued, so a timer that is rescheduled often (CAPTURE writes CC)
+ * doesn't leave a pile of stale far-future events behind
+ */
+#define TIMER_HORIZON_NS        (10 * SIM_MS)
+
+struct sim_timer {
+    struct sim_periph p;
+    uint8_t  running;
+    uint32_t count0;            /* count at t0                  */
+    uint64_t t0;
+    uint32_t gen;
+};
+
+static struct sim_timer timers[5];
+
+static uint32_t timer_mask(struct sim_timer *tm) {
+
+    static const uint32_t masks[4] = { 0xFFFF, 0xFF, 0xFFFFFF, 0xFFFFFFFF };
+    return masks[REG(&tm->p, TIMER_BITMODE) & 3];
+}
+
+static uint32_t timer_prescaler(struct sim_timer *tm) {
+    uint32_t p = REG(&tm->p, TIMER_PRESCALER) & 15;
+    return p > 9 ? 9 : p;
+}
+
+/* 16MHz, off by sim_cfg.hfclk_ppm */
+static uint64_t hfclk_hz(void) {
+    return 16000000 + 16 * (int64_t) sim_cfg.hfclk_ppm;
+}
+
+/* HFCLK >> prescaler: ticks in dt, and the time n ticks take (rounded up) */
+static uint64_t timer_ticks(struct sim_timer *tm, uint64_t dt) {
+    return (uint64_t) ((unsigned __int128) dt * hfclk_hz() / SIM_S) >> timer_prescaler(tm);
+}
+
+static uint64_t timer_ticks_ns(struct sim_timer *tm, uint64_t n) {
+    return (uint64_t) (((unsigned __int128) n << timer_prescaler(tm)) * SIM_S / hfclk_hz()) + 1;
+}
+
+static uint32_t timer_count(struct sim_timer *tm) {
+
+    if (!tm->running) {
+        return tm->count0;
+    }
+    return (uint32_t) ((tm->count0 + timer_ticks(tm, sim_now() - tm->t0)) & timer_mask(tm));
+}
+
+static void timer_rebase(struct sim_timer *tm) {
+    tm->count0 = timer_count(tm);
+    tm->t0     = sim_now();
+}
+
+static void timer_compare(void *obj, uint32_t tag);
+
+/* the next CC the count reaches (a CC equal to the count is a full wrap away) */
+static void timer_resched(struct sim_timer *tm) {
+
+    tm->gen++;
+    if (!tm->running) {
+        return;
+    }
+
+    uint32_t mask  = timer_mask(tm);
+    uint32_t count = timer_count(tm);
+    uint64_t ahead = (uint64_t) mask + 1;
+
+    for (int i = 0; i < TIMER_CCS; i++) {
+        uint64_t k = (REG(&tm->p, TIMER_CC(i)) - count) & mask;
+        if (k == 0) {
+            k = (uint64_t) mask + 1;
+        }
+        if (k < ahead) {
+            ahead = k;
+        }
+    }
+
+    uint64_t elapsed = timer_ticks(tm, sim_now() - tm->t0);
+    uint64_t t = tm->t0 + timer_ticks_ns(tm, elapsed + ahead);
+
+    if (t > sim_now() + TIMER_HORIZON_NS) {
+        t = sim_now() + TIMER_HORIZON_NS;
+    }
+    sim_schedule(t, timer_compare, tm, tm->gen);
+}
+
+static void timer_compare(void *obj, uint32_t tag) {
+
+    struct sim_timer *tm = obj;
+    if (tag != tm->gen || !tm->running) {
+        return;
+    }
+
+    uint32_t count = timer_count(tm);
+    uint8_t  match = 0;
+
+    for (int i = 0; i < TIMER_CCS; i++) {
+        if ((REG(&tm->p, TIMER_CC(i)) & timer_mask(tm)) == count) {
+            match |= 1 << i;
+        }
+    }
+    for (int i = 0; i < TIMER_CCS; i++) {
+        if (match & (1 << i)) {
+            sim_raise(&tm->p, TIMER_COMPARE(i));
+        }
+    }
+    timer_resched(tm);
+}
+
+/* SHORTS: COMPARE[i]_CLEAR = bit i, COMPARE[i]_STOP = bit 8 + i */
+static void timer_event(struct sim_periph *p, uint32_t off) {
+
+    struct sim_timer *tm = (struct sim_timer *) p;
+    int i = (off - TIMER_COMPARE(0)) / 4;
+    uint32_t shorts = REG(p, TIMER_SHORTS);
+
+    if (shorts & (1u << (8 + i))) {
+        timer_rebase(tm);
+        tm->running = 0;
+    }
+    if (shorts & (1u << i)) {
+        tm->count0 = 0;
+        tm->t0     = sim_now();
+    }
+}
+
+static void timer_task(struct sim_periph *p, uint32_t off) {
+
+    struct sim_timer *tm = (struct sim_timer *) p;
+
+    switch (off) {
+
+        case TIMER_START:
+            if (!tm->running) {
+                tm->t0      = sim_now();
+                tm->running = 1;
+            }
+            break;
+
+        case TIMER_STOP:
+        case TIMER_SHUTDOWN:
+            timer_rebase(tm);
+            tm->running = 0;
+            break;
+
+        case TIMER_CLEAR:
+            tm->count0 = 0;
+            tm->t0     = sim_now();
+            break;
+
+        default:
+            if (off >= TIMER_CAPTURE(0) && off < TIMER_CAPTURE(TIMER_CCS)) {
+                REG(p, TIMER_CC((off - TIMER_CAPTURE(0)) / 4)) = timer_count(tm);
+            }
+            break;
+    }
+    timer_resched(tm);
+}
+
+static void timer_write(struct sim_periph *p, uint32_t off, uint32_t val) {
+
+    struct sim_timer *tm = (struct sim_timer *) p;
+    (void) val;
+
+    if (off == TIMER_PRESCALER || off == TIMER_BITMODE) {
+        timer_rebase(tm);
+    }
+    timer_resched(tm);
+}
+
+/* --- RTC --------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+#define RTC_START               0x000
+#define RTC_STOP                0x004
+#define RTC_CLEAR               0x008
+#define RTC_TICK                0x100
+#define RTC_OVRFLW              0x104
+#define RTC_COMPARE(n)          (0x140 + 4 * (n))
+#define RTC_EVTEN               0x340
+#define RTC_EVTENSET            0x344
+#define RTC_EVTENCLR            0x348
+#define RTC_COUNTER             0x504
+#define RTC_PRESCALER           0x508
+#define RTC_CC(n)               (0x540 + 4 * (n))
+#define RTC_CCS                 4
+#define RTC_MASK                0xFFFFFF
+
+#define LFCLK_HZ                32768
+
+/* 24-bit, LFCLK / (PRESCALER + 1). COMPARE and OVRFLW only, no TICK.
+ * an event happens only if INTEN or EVTEN has it, EVTEN goes to PPI
+ */
+struct sim_rtc {
+    struct sim_periph p;
+    uint8_t  running;
+    uint32_t count0;
+    uint64_t t0;
+    uint32_t gen;
+    uint32_t evten;
+};
+
+static struct sim_rtc rtcs[3];
+
+static uint64_t rtc_div(struct sim_rtc *rt) {
+    return (REG(&rt->p, RTC_PRESCALER) & 0xFFF) + 1;
+}
+
+static uint32_t rtc_count(struct sim_rtc *rt) {
+
+    if (!rt->running) {
+        return rt->count0;
+    }
+    uint64_t ticks = (sim_now() - rt->t0) * LFCLK_HZ / SIM_S / rtc_div(rt);
+    return (uint32_t) ((rt->count0 + ticks) & RTC_MASK);
+}
+
+static void rtc_rebase(struct sim_rtc *rt) {
+    rt->count0 = rtc_count(rt);
+    rt->t0     = sim_now();
+}
+
+static void rtc_compare(void *obj, uint32_t tag);
+
+static void rtc_resched(struct sim_rtc *rt) {
+
+    rt->gen++;
+    if (!rt->running) {
+        return;
+    }
+
+    uint32_t count = rtc_count(rt);
+    uint64_t ahead = RTC_MASK + 1 - count;         /* OVRFLW */
+
+    for (int i = 0; i < RTC_CCS; i++) {
+        uint64_t k = (REG(&rt->p, RTC_CC(i)) - count) & RTC_MASK;
+        if (k && k < ahead) {
+            ahead = k;
+        }
+    }
+
+    uint64_t elapsed = (sim_now() - rt->t0) * LFCLK_HZ / SIM_S / rtc_div(rt);
+    uint64_t t = rt->t0 + ((elapsed + ahead) * rtc_div(rt) * SIM_S + LFCLK_HZ - 1) / LFCLK_HZ;
+
+    if (t > sim_now() + TIMER_HORIZON_NS) {
+        t = sim_now() + TIMER_HORIZON_NS;
+    }
+    sim_schedule(t, rtc_compare, rt, rt->gen);
+}
+
+static void rtc_event(struct sim_rtc *rt, uint32_t off, uint32_t bit) {
+    if ((rt->p.inten | rt->evten) & bit) {
+        sim_raise(&rt->p, off);
+    }
+}
+
+static void rtc_compare(void *obj, uint32_t tag) {
+
+    struct sim_rtc *rt = obj;
+    if (tag != rt->gen || !rt->running) {
+        return;
+    }
+
+    uint32_t count = rtc_count(rt);
+    if (count == 0) {
+        rtc_event(rt, RTC_OVRFLW, 1u << 1);
+    }
+    for (int i = 0; i < RTC_CCS; i++) {
+        if ((REG(&rt->p, RTC_CC(i)) & RTC_MASK) == count) {
+            rtc_event(rt, RTC_COMPARE(i), 1u << (16 + i));
+        }
+    }
+    rtc_resched(rt);
+}
+
+static void rtc_task(struct sim_periph *p, uint32_t off) {
+
+    struct sim_rtc *rt = (struct sim_rtc *) p;
+
+    switch (off) {
+        case RTC_START:
+            if (!rt->running) {
+                rt->t0      = sim_now();
+                rt->running = 1;
+            }
+            break;
+        case RTC_STOP:
+            rtc_rebase(rt);
+            rt->running = 0;
+            break;
+        case RTC_CLEAR:
+            rt->count0 = 0;
+            rt->t0     = sim_now();
+            break;
+        default:
+            break;
+    }
+    rtc_resched(rt);
+}
+
+static void rtc_read(struct sim_periph *p, uint32_t off) {
+
+    if (off == RTC_COUNTER) {
+        REG(p, RTC_COUNTER) = rtc_count((struct sim_rtc *) p);
+    }
+}
+
+static void rtc_write(struct sim_periph *p, uint32_t off, uint32_t val) {
+
+    struct sim_rtc *rt = (struct sim_rtc *) p;
+
+    switch (off) {
+        case RTC_EVTEN:     rt->evten  = val;  break;
+        case RTC_EVTENSET:  rt->evten |= val;  break;
+        case RTC_EVTENCLR:  rt->evten &= ~val; break;
+        case RTC_PRESCALER: rtc_rebase(rt);    break;
+        default:                               break;
+    }
+    REG(p, RTC_EVTEN)    = rt->evten;
+    REG(p, RTC_EVTENSET) = rt->evten;
+    REG(p, RTC_EVTENCLR) = rt->evten;
+    rtc_resched(rt);
+}
+
+/* --- GPIO / GPIOTE ----------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+#define P0_BASE                 0x50000000
+#define P0_OUT                  0x504
+#define P0_OUTSET               0x508
+#define P0_OUTCLR               0x50C
+#define P0_IN                   0x510
+#define P0_DIR                  0x514
+#define P0_DIRSET               0x518
+#define P0_DIRCLR               0x51C
+#define P0_LATCH                0x520
+#define P0_PIN_CNF(n)           (0x700 + 4 * (n))
+
+#define CNF_DIR_OUT             (1 << 0)
+#define CNF_INPUT_DISCONNECT    (1 << 1)
+#define CNF_PULL(cnf)           (((cnf) >> 2) & 3)
+#define CNF_SENSE(cnf)          (((cnf) >> 16) & 3)
+
+#define GPIOTE_BASE             0x40006000
+#define GPIOTE_IN(n)            (0x100 + 4 * (n))
+#define GPIOTE_PORT             0x17C
+#define GPIOTE_CONFIG(n)        (0x510 + 4 * (n))
+#define GPIOTE_CHANNELS         8
+
+static struct sim_periph p0;
+static struct sim_periph gpiote;
+
+static struct {
+    uint32_t out;
+    uint32_t dir;
+    uint32_t level;
+    uint8_t  detect;
+    int8_t   ext[32];
+    sim_pin_fn watch[32];
+} gpio;
+
+static int pin_level(unsigned pin) {
+
+    uint32_t cnf = REG(&p0, P0_PIN_CNF(pin));
+
+    if (gpio.dir & (1u << pin)) {
+        return (gpio.out >> pin) & 1;
+    }
+    if (gpio.ext[pin] != SIM_PIN_FLOAT) {
+        return gpio.ext[pin];
+    }
+    return CNF_PULL(cnf) == 3;          /* pull-up, else low */
+}
+
+static void gpiote_edge(unsigned pin, int level) {
+
+    for (int n = 0; n < GPIOTE_CHANNELS; n++) {
+
+        uint32_t cfg = REG(&gpiote, GPIOTE_CONFIG(n));
+        if ((cfg & 3) != 1 || ((cfg >> 8) & 31) != pin) {
+            continue;
+        }
+
+        uint32_t pol = (cfg >> 16) & 3;
+        if (pol == 3 || (pol == 1 && level) || (pol == 2 && !level)) {
+            sim_raise(&gpiote, GPIOTE_IN(n));
+        }
+    }
+}
+
+/* recompute every pin after any change, edges go to GPIOTE and watchers */
+static void gpio_update(void) {
+
+    uint32_t level  = 0;
+    uint32_t in     = 0;
+    uint8_t  detect = 0;
+
+    for (unsigned pin = 0; pin < 32; pin++) {
+
+        uint32_t cnf = REG(&p0, P0_PIN_CNF(pin));
+        int l = pin_level(pin);
+
+        level |= (uint32_t) l << pin;
+        if (!(cnf & CNF_INPUT_DISCONNECT)) {
+            in |= (uint32_t) l << pin;
+        }
+        if ((CNF_SENSE(cnf) == 2 && l) || (CNF_SENSE(cnf) == 3 && !l)) {
+            detect = 1;
+            REG(&p0, P0_LATCH) |= 1u << pin;
+        }
+    }
+
+    uint32_t changed = level ^ gpio.level;
+    gpio.level = level;
+
+    REG(&p0, P0_OUT)    = gpio.out;
+    REG(&p0, P0_OUTSET) = gpio.out;
+    REG(&p0, P0_OUTCLR) = gpio.out;
+    REG(&p0, P0_DIR)    = gpio.dir;
+    REG(&p0, P0_DIRSET) = gpio.dir;
+    REG(&p0, P0_DIRCLR) = gpio.dir;
+    REG(&p0, P0_IN)     = in;
+
+    for (unsigned pin = 0; pin < 32; pin++) {
+        if (changed & (1u << pin)) {
+            int l = (level >> pin) & 1;
+            gpiote_edge(pin, l);
+            if (gpio.watch[pin]) {
+                gpio.watch[pin](pin, l);
+            }
+        }
+    }
+
+    /* PORT is the rising edge of DETECT */
+    if (detect && !gpio.detect) {
+        sim_raise(&gpiote, GPIOTE_PORT);
+    }
+    gpio.detect = detect;
+}
+
+static void p0_write(struct sim_periph *p, uint32_t off, uint32_t val) {
+
+    (void) p;
+
+    switch (off) {
+        case P0_OUT:    gpio.out  = val;  break;
+        case P0_OUTSET: gpio.out |= val;  break;
+        case P0_OUTCLR: gpio.out &= ~val; break;
+        case P0_DIR:    gpio.dir  = val;  break;
+        case P0_DIRSET: gpio.dir |= val;  break;
+        case P0_DIRCLR: gpio.dir &= ~val; break;
+        case P0_LATCH:  REG(&p0, P0_LATCH) = 0; break;
+        default:
+            if (off >= P0_PIN_CNF(0) && off < P0_PIN_CNF(32)) {
+                unsigned pin = (off - P0_PIN_CNF(0)) / 4;
+                if (val & CNF_DIR_OUT) {
+                    gpio.dir |= 1u << pin;
+                }
+                else {
+                    gpio.dir &= ~(1u << pin);
+                }
+            }
+            break;
+    }
+    gpio_update();
+}
+
+void sim_gpio_set(unsigned pin, int level) {
+
+    gpio.ext[pin & 31] = level;
+    gpio_update();
+}
+
+int sim_gpio_level(unsigned pin) {
+    return (gpio.level >> (pin & 31)) & 1;
+}
+
+void sim_gpio_watch(unsigned pin, sim_pin_fn fn) {
+    gpio.watch[pin & 31] = fn;
+}
+
+/* --- QDEC -------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+#define QDEC_BASE               0x40012000
+#define QDEC_START              0x000
+#define QDEC_STOP               0x004
+#define QDEC_READCLRACC         0x008
+#define QDEC_RDCLRACC           0x00C
+#define QDEC_REPORTRDY          0x104
+#define QDEC_STOPPED            0x110
+#define QDEC_ENABLE             0x500
+#define QDEC_ACC                0x514
+#define QDEC_ACCREAD            0x518
+#define QDEC_PSEL_A             0x520
+#define QDEC_PSEL_B             0x524
+
+static struct sim_periph qdec;
+static uint8_t qdec_running;
+static uint8_t qdec_phase;              /* 0 = in a detent, both contacts open */
+
+static void qdec_task(struct sim_periph *p, uint32_t off) {
+
+    switch (off) {
+
+        case QDEC_START:
+            qdec_running = REG(p, QDEC_ENABLE) & 1;
+            break;
+
+        case QDEC_STOP:
+            qdec_running = 0;
+            sim_raise(p, QDEC_STOPPED);
+            break;
+
+        case QDEC_READCLRACC:
+        case QDEC_RDCLRACC:
+            REG(p, QDEC_ACCREAD) = REG(p, QDEC_ACC);
+            REG(p, QDEC_ACC)     = 0;
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* the contacts go to ground, AB 11 -> 10 -> 00 -> 01 is +1 as QDEC counts
+ * it, one step per count. QDEC only counts while
+ * started, the pins move regardless so SENSE sees a turn in sleep
+ */
+void sim_qdec_turn(int32_t steps) {
+
+    static const uint8_t ab[4] = { 0b11, 0b10, 0b00, 0b01 };
+    unsigned a = REG(&qdec, QDEC_PSEL_A) & 31;
+    unsigned b = REG(&qdec, QDEC_PSEL_B) & 31;
+
+    for (int32_t i = 0; i != steps; i += steps > 0 ? 1 : -1) {
+        qdec_phase = (qdec_phase + (steps > 0 ? 1 : 3)) & 3;
+        gpio.ext[a] = ab[qdec_phase] & 2 ? SIM_PIN_FLOAT : 0;
+        gpio.ext[b] = ab[qdec_phase] & 1 ? SIM_PIN_FLOAT : 0;
+        gpio_update();
+    }
+    if (qdec_running) {
+        REG(&qdec, QDEC_ACC) = (uint32_t) ((int32_t) REG(&qdec, QDEC_ACC) + steps);
+        sim_raise(&qdec, QDEC_REPORTRDY);
+    }
+}
+
+/* --- COMP -------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+#define COMP_BASE               0x40013000
+#define COMP_START              0x000
+#define COMP_STOP               0x004
+#define COMP_SAMPLE             0x008
+#define COMP_READY              0x100
+#define COMP_SHORTS             0x200
+#define COMP_RESULT             0x400
+#define COMP_ENABLE             0x500
+#define COMP_PSEL               0x504
+#define COMP_REFSEL             0x508
+#define COMP_TH                 0x530
+
+#define COMP_STARTUP_NS         (10 * SIM_US)
+#define COMP_PSEL_VDDHDIV5      7
+
+static struct sim_periph comp;
+
+static struct {
+    double   vddh;
+    uint8_t  running;
+    uint32_t gen;
+} cmp = { .vddh = 3.7 };
+
+static double comp_vref(void) {
+
+    switch (REG(&comp, COMP_REFSEL) & 7) {
+        case 0:  return 1.2;
+        case 1:  return 1.8;
+        case 2:  return 2.4;
+        default: return 3.0;        /* VDD */
+    }
+}
+
+static void comp_sample(void) {
+
+    double vin = ((REG(&comp, COMP_PSEL) & 7) == COMP_PSEL_VDDHDIV5) ? cmp.vddh / 5 : 0;
+    double vth = (((REG(&comp, COMP_TH) >> 8) & 63) + 1) / 64.0 * comp_vref();
+
+    REG(&comp, COMP_RESULT) = vin > vth;
+}
+
+static void comp_ready(void *obj, uint32_t tag) {
+
+    (void) obj;
+    if (tag != cmp.gen || !cmp.running) {
+        return;
+    }
+    sim_raise(&comp, COMP_READY);
+}
+
+/* SHORTS: READY_SAMPLE bit 0, READY_STOP bit 1 */
+static void comp_event(struct sim_periph *p, uint32_t off) {
+
+    if (off != COMP_READY) {
+        return;
+    }
+    if (REG(p, COMP_SHORTS) & 1) {
+        comp_sample();
+    }
+    if (REG(p, COMP_SHORTS) & 2) {
+        cmp.running = 0;
+    }
+}
+
+static void comp_task(struct sim_periph *p, uint32_t off) {
+
+    switch (off) {
+
+        case COMP_START:
+            if ((REG(p, COMP_ENABLE) & 3) == 2 && !cmp.running) {
+                cmp.running = 1;
+                sim_schedule(sim_now() + COMP_STARTUP_NS, comp_ready, NULL, ++cmp.gen);
+            }
+            break;
+
+        case COMP_STOP:
+            cmp.running = 0;
+            cmp.gen++;
+            break;
+
+        case COMP_SAMPLE:
+            if (cmp.running) {
+                comp_sample();
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void sim_comp_set_vddh(double volts) {
+    cmp.vddh = volts;
+}
+
+double sim_comp_vddh(void) {
+    return cmp.vddh;
+}
+
+/* ----------------------------------------------------------------------------------- */
+
+void sim_periph_init(void) {
+
+    static const uint32_t timer_base[5] = {
+        0x40008000, 0x40009000, 0x4000A000, 0x4001A000, 0x4001B000,
+    };
+    static const int timer_irq[5] = { 8, 9, 10, 26, 27 };
+    static const char *timer_name[5] = { "TIMER0", "TIMER1", "TIMER2", "TIMER3", "TIMER4" };
+    static const uint32_t rtc_base[3] = { 0x4000B000, 0x40011000, 0x40024000 };
+    static const int rtc_irq[3] = { 11, 17, 36 };
+    static const char *rtc_name[3] = { "RTC0", "RTC1", "RTC2" };
+
+    clock_power = (struct sim_periph) {
+        .name = "CLOCK/POWER", .base = CLOCK_BASE, .irq = 0, .std = 1, .task = clock_task,
+    };
+    sim_periph_add(&clock_power);
+
+    for (int i = 0; i < 5; i++) {
+        timers[i].p = (struct sim_periph) {
+            .name = timer_name[i], .base = timer_base[i], .irq = timer_irq[i], .std = 1,
+            .task = timer_task, .write = timer_write, .event = timer_event,
+        };
+        sim_periph_add(&timers[i].p);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        rtcs[i].p = (struct sim_periph) {
+            .name = rtc_name[i], .base = rtc_base[i], .irq = rtc_irq[i], .std = 1,
+            .task = rtc_task, .read = rtc_read, .write = rtc_write,
+        };
+        sim_periph_add(&rtcs[i].p);
+    }
+
+    ppi = (struct sim_periph) {
+        .name = "PPI", .base = PPI_BASE, .irq = -1, .std = 1, .write = ppi_write,
+    };
+    sim_periph_add(&ppi);
+
+    p0 = (struct sim_periph) {
+        .name = "P0", .base = P0_BASE, .irq = -1, .write = p0_write,
+    };
+    sim_periph_add(&p0);
+    for (int i = 0; i < 32; i++) {
+        gpio.ext[i] = SIM_PIN_FLOAT;
+        REG(&p0, P0_PIN_CNF(i)) = CNF_INPUT_DISCONNECT;
+    }
+    gpio_update();
+
+    gpiote = (struct sim_periph) {
+        .name = "GPIOTE", .base = GPIOTE_BASE, .irq = 6, .std = 1, .write = NULL,
+    };
+    sim_periph_add(&gpiote);
+
+    qdec = (struct sim_periph) {
+        .name = "QDEC", .base = QDEC_BASE, .irq = 18, .std = 1, .task = qdec_task,
+    };
+    sim_periph_add(&qdec);
+
+    comp = (struct sim_periph) {
+        .name = "COMP", .base = COMP_BASE, .irq = 19, .std = 1, .task = comp_task,
+        .event = comp_event,
+    };
+    sim_periph_add(&comp);
+}
@@ -0,0 +1,522 @@
+/**********************************************************************************
+ ** file            : sim_radio.c
+ ** description     : RADIO model, nrf 2Mbit packets on a shared air
+ **
+ **********************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim_hw.h"
+
+#define RADIO_BASE              0x40001000
+
+#define RADIO_TXEN              0x000
+#define RADIO_RXEN              0x004
+#define RADIO_START             0x008
+#define RADIO_STOP              0x00C
+#define RADIO_DISABLE           0x010
+#define RADIO_RSSISTART         0x014
+#define RADIO_RSSISTOP          0x018
+
+#define RADIO_READY             0x100
+#define RADIO_ADDRESS           0x104
+#define RADIO_PAYLOAD           0x108
+#define RADIO_END               0x10C
+#define RADIO_DISABLED          0x110
+#define RADIO_RSSIEND           0x11C
+#define RADIO_CRCOK             0x130
+#define RADIO_CRCERROR          0x134
+#define RADIO_TXREADY           0x154
+#define RADIO_RXREADY           0x158
+
+#define RADIO_SHORTS            0x200
+#define RADIO_CRCSTATUS         0x400
+#define RADIO_RXMATCH           0x408
+#define RADIO_PACKETPTR         0x504
+#define RADIO_FREQUENCY         0x508
+#define RADIO_TXPOWER           0x50C
+#define RADIO_PCNF1             0x518
+#define RADIO_BASE0             0x51C
+#define RADIO_BASE1             0x520
+#define RADIO_PREFIX0           0x524
+#define RADIO_PREFIX1           0x528
+#define RADIO_TXADDRESS         0x52C
+#define RADIO_RXADDRESSES       0x530
+#define RADIO_CRCCNF            0x534
+#define RADIO_RSSISAMPLE        0x548
+#define RADIO_STATE             0x550
+#define RADIO_MODECNF0          0x650
+
+#define SHORT_READY_START       (1u << 0)
+#define SHORT_END_DISABLE       (1u << 1)
+#define SHORT_DISABLED_TXEN     (1u << 2)
+#define SHORT_DISABLED_RXEN     (1u << 3)
+#define SHORT_ADDRESS_RSSISTART (1u << 4)
+#define SHORT_END_START         (1u << 5)
+#define SHORT_TXREADY_START     (1u << 18)
+#define SHORT_RXREADY_START     (1u << 19)
+
+#define RAMP_FAST_NS            (40 * SIM_US)
+#define RAMP_NS                 (130 * SIM_US)
+#define TXDISABLE_NS            (4 * SIM_US)            /* 2Mbit */
+#define RSSI_NS                 (250 * SIM_NS)
+#define BYTE_NS                 (4 * SIM_US)            /* 2Mbit */
+
+/* model states, sim_radio_stats.state_ns[] is indexed by these */
+enum {
+    S_DISABLED,
+    S_RXRU,
+    S_RXIDLE,
+    S_RX,
+    S_TXRU,
+    S_TXIDLE,
+    S_TX,
+    S_TXDISABLE,
+};
+
+/* RADIO->STATE codes */
+static const uint8_t state_code[8] = { 0, 1, 2, 3, 9, 10, 11, 12 };
+
+const char *const sim_radio_state_name[8] = {
+    "disabled", "rxru", "rxidle", "rx", "txru", "txidle", "tx", "txdisable",
+};
+
+struct sim_radio_stats sim_radio_stats;
+struct sim_air_cfg    sim_air_cfg;
+
+static struct sim_periph radio;
+
+static struct {
+    uint8_t  state;
+    uint64_t t_state;
+    uint32_t gen;               /* bumps on every state change, drops stale steps */
+    sim_air_fn peer;
+    struct sim_air_pkt tx;
+    struct sim_air_pkt rx;      /* the packet being received */
+    uint8_t  rx_logical;
+} rad;
+
+enum { STEP_READY, STEP_ADDRESS, STEP_PAYLOAD, STEP_END, STEP_DISABLED };
+
+static void radio_task(struct sim_periph *p, uint32_t off);
+
+static void state_set(uint8_t s) {
+
+    sim_radio_stats.state_ns[rad.state] += sim_now() - rad.t_state;
+    rad.t_state = sim_now();
+    rad.state   = s;
+    rad.gen++;
+    REG(&radio, RADIO_STATE) = state_code[s];
+}
+
+static uint8_t balen(void) {
+    return (REG(&radio, RADIO_PCNF1) >> 16) & 7;
+}
+
+static uint8_t maxlen(void) {
+    return REG(&radio, RADIO_PCNF1) & 0xFF;
+}
+
+uint32_t sim_radio_address(uint8_t logical) {
+
+    uint32_t base   = REG(&radio, logical ? RADIO_BASE1 : RADIO_BASE0);
+    uint32_t prefix = REG(&radio, logical < 4 ? RADIO_PREFIX0 : RADIO_PREFIX1);
+
+    return ((prefix >> (8 * (logical & 3))) & 0xFF) << 24 | (base & 0xFFFFFF);
+}
+
+/* preamble, address, LENGTH, payload, CRC */
+static uint64_t address_ns(void) {
+    return (1 + 1 + balen()) * BYTE_NS;
+}
+
+uint64_t sim_radio_airtime(uint8_t len) {
+    return address_ns() + (1 + len + (REG(&radio, RADIO_CRCCNF) & 3)) * BYTE_NS;
+}
+
+/* --- STEPS ------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+static void step(void *obj, uint32_t tag);
+static void air_channel(struct sim_air_pkt *pkt);
+
+static void step_at(uint64_t t, int what) {
+    sim_schedule(t, step, (void *) (uintptr_t) what, rad.gen);
+}
+
+static void tx_end(void) {
+
+    sim_radio_stats.tx++;
+    state_set(S_TXIDLE);
+    sim_raise(&radio, RADIO_PAYLOAD);
+    sim_raise(&radio, RADIO_END);
+    air_channel(&rad.tx);
+    if (rad.peer) {
+        rad.peer(&rad.tx);
+    }
+}
+
+static void rx_end(void) {
+
+    uint8_t *dst = sim_ptr(REG(&radio, RADIO_PACKETPTR));
+    uint8_t  len = rad.rx.len ? rad.rx.data[0] : 0;
+
+    if (len > maxlen()) {
+        len = maxlen();
+    }
+    dst[0] = len;
+    memcpy(dst + 1, rad.rx.data + 1, len);
+
+    REG(&radio, RADIO_CRCSTATUS) = rad.rx.crc_ok;
+    REG(&radio, RADIO_RXMATCH)   = rad.rx_logical;
+
+    if (rad.rx.crc_ok) {
+        sim_radio_stats.rx_ok++;
+    }
+    else {
+        sim_radio_stats.rx_crc_err++;
+    }
+
+    state_set(S_RXIDLE);
+    sim_raise(&radio, RADIO_PAYLOAD);
+    sim_raise(&radio, rad.rx.crc_ok ? RADIO_CRCOK : RADIO_CRCERROR);
+    sim_raise(&radio, RADIO_END);
+}
+
+static void step(void *obj, uint32_t tag) {
+
+    if (tag != rad.gen) {
+        return;
+    }
+
+    switch ((int) (uintptr_t) obj) {
+
+        case STEP_READY:
+            if (rad.state == S_TXRU) {
+                state_set(S_TXIDLE);
+                sim_raise(&radio, RADIO_READY);
+                sim_raise(&radio, RADIO_TXREADY);
+            }
+            else if (rad.state == S_RXRU) {
+                state_set(S_RXIDLE);
+                sim_raise(&radio, RADIO_READY);
+                sim_raise(&radio, RADIO_RXREADY);
+            }
+            break;
+
+        case STEP_ADDRESS:
+            /* no state change, the END step keeps its generation */
+            sim_raise(&radio, RADIO_ADDRESS);
+            break;
+
+        case STEP_END:
+            if (rad.state == S_TX) {
+                tx_end();
+            }
+            else if (rad.state == S_RX) {
+                rx_end();
+            }
+            break;
+
+        case STEP_DISABLED:
+            state_set(S_DISABLED);
+            sim_raise(&radio, RADIO_DISABLED);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* --- TASKS / SHORTS ---------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+static void start_tx(void) {
+
+    const uint8_t *src = sim_ptr(REG(&radio, RADIO_PACKETPTR));
+    uint8_t len = src[0] > maxlen() ? maxlen() : src[0];
+
+    if (len + 1 > SIM_AIR_MAX) {
+        sim_stop("radio: packet longer than SIM_AIR_MAX");
+    }
+
+    rad.tx.t_start = sim_now();
+    rad.tx.address = sim_radio_address(REG(&radio, RADIO_TXADDRESS) & 7);
+    rad.tx.freq    = REG(&radio, RADIO_FREQUENCY) & 0x7F;
+    rad.tx.crc_ok  = 1;
+    rad.tx.lost    = 0;
+    rad.tx.rssi    = -40;
+    rad.tx.len     = 1 + len;
+    memcpy(rad.tx.data, src, 1 + len);
+
+    state_set(S_TX);
+    step_at(sim_now() + address_ns(), STEP_ADDRESS);
+    step_at(sim_now() + sim_radio_airtime(len), STEP_END);
+}
+
+static void radio_task(struct sim_periph *p, uint32_t off) {
+
+    uint64_t ramp = (REG(p, RADIO_MODECNF0) & 1) ? RAMP_FAST_NS : RAMP_NS;
+
+    switch (off) {
+
+        case RADIO_TXEN:
+            if (!sim_hfxo_running()) {
+                sim_radio_stats.no_hfxo++;
+            }
+            sim_radio_stats.txpower = (int8_t) REG(p, RADIO_TXPOWER);
+            if (rad.state == S_DISABLED) {
+                state_set(S_TXRU);
+                step_at(sim_now() + ramp, STEP_READY);
+            }
+            break;
+
+        case RADIO_RXEN:
+            if (!sim_hfxo_running()) {
+                sim_radio_stats.no_hfxo++;
+            }
+            if (rad.state == S_DISABLED) {
+                state_set(S_RXRU);
+                step_at(sim_now() + ramp, STEP_READY);
+            }
+            break;
+
+        case RADIO_START:
+            if (rad.state == S_TXIDLE) {
+                start_tx();
+            }
+            else if (rad.state == S_RXIDLE) {
+                state_set(S_RX);        /* listening, see sim_radio_send */
+            }
+            break;
+
+        case RADIO_STOP:
+            if (rad.state == S_TX) {
+                state_set(S_TXIDLE);
+            }
+            else if (rad.state == S_RX) {
+                state_set(S_RXIDLE);
+            }
+            break;
+
+        case RADIO_DISABLE:
+            if (rad.state == S_DISABLED || rad.state == S_TXDISABLE) {
+                break;
+            }
+            if (rad.state >= S_TXRU) {
+                state_set(S_TXDISABLE);
+                step_at(sim_now() + TXDISABLE_NS, STEP_DISABLED);
+            }
+            else {
+                state_set(S_DISABLED);
+                sim_raise(p, RADIO_DISABLED);
+            }
+            break;
+
+        case RADIO_RSSISTART:
+            REG(p, RADIO_RSSISAMPLE) = (uint8_t) -rad.rx.rssi;
+            sim_raise(p, RADIO_RSSIEND);
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void radio_event(struct sim_periph *p, uint32_t off) {
+
+    uint32_t shorts = REG(p, RADIO_SHORTS);
+
+    switch (off) {
+
+        case RADIO_READY:
+            if (shorts & SHORT_READY_START) {
+                radio_task(p, RADIO_START);
+            }
+            break;
+
+        case RADIO_TXREADY:
+            if (shorts & SHORT_TXREADY_START) {
+                radio_task(p, RADIO_START);
+            }
+            break;
+
+        case RADIO_RXREADY:
+            if (shorts & SHORT_RXREADY_START) {
+                radio_task(p, RADIO_START);
+            }
+            break;
+
+        case RADIO_ADDRESS:
+            if (shorts & SHORT_ADDRESS_RSSISTART) {
+                radio_task(p, RADIO_RSSISTART);
+            }
+            break;
+
+        case RADIO_END:
+            if (shorts & SHORT_END_DISABLE) {
+                radio_task(p, RADIO_DISABLE);
+            }
+            else if (shorts & SHORT_END_START) {
+                radio_task(p, RADIO_START);
+            }
+            break;
+
+        case RADIO_DISABLED:
+            if (shorts & SHORT_DISABLED_TXEN) {
+                radio_task(p, RADIO_TXEN);
+            }
+            else if (shorts & SHORT_DISABLED_RXEN) {
+                radio_task(p, RADIO_RXEN);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* --- AIR --------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+static double air_rand(void) {
+    return (double) rand() / ((double) RAND_MAX + 1);
+}
+
+/* lost or hit by the interferer on the way, see note 2 */
+static void air_channel(struct sim_air_pkt *pkt) {
+
+    struct sim_air_cfg *c = &sim_air_cfg;
+    static uint8_t bad;
+
+    if (bad) {
+        bad = air_rand() >= c->burst_exit;
+    }
+    else if (c->burst_enter > 0) {
+        bad = air_rand() < c->burst_enter;
+    }
+
+    if (bad || (c->loss > 0 && air_rand() < c->loss)) {
+        pkt->lost = 1;
+        sim_radio_stats.air_lost++;
+        return;
+    }
+
+    if (c->jam_us && c->jam_period_us) {
+        uint64_t period = c->jam_period_us * SIM_US;
+        uint64_t t0     = pkt->t_start % period;
+        uint64_t len    = pkt->len ? pkt->data[0] : 0;
+        if (t0 < c->jam_us * SIM_US || t0 + sim_radio_airtime(len) > period) {
+            pkt->crc_ok = 0;
+            sim_radio_stats.air_corrupt++;
+        }
+    }
+}
+
+/* end of the preamble: locks on if the radio is listening on that
+ * frequency for that address by now, else the packet is missed
+ */
+static void air_arrive(void *obj, uint32_t tag) {
+
+    struct sim_air_pkt *pkt = obj;
+    (void) tag;
+
+    uint32_t rxaddr = REG(&radio, RADIO_RXADDRESSES);
+    int logical = -1;
+
+    for (int n = 0; n < 8; n++) {
+        if ((rxaddr & (1u << n)) && sim_radio_address(n) == pkt->address) {
+            logical = n;
+            break;
+        }
+    }
+
+    if (rad.state != S_RX || logical < 0 || pkt->freq != (REG(&radio, RADIO_FREQUENCY) & 0x7F)) {
+        sim_radio_stats.rx_missed++;
+        free(pkt);
+        return;
+    }
+
+    rad.rx = *pkt;
+    rad.rx_logical = logical;
+    free(pkt);
+
+    /* a state change (DISABLE, STOP) before END drops the packet */
+    uint8_t len = rad.rx.len ? rad.rx.data[0] : 0;
+    rad.gen++;
+    step_at(rad.rx.t_start + address_ns(), STEP_ADDRESS);
+    step_at(rad.rx.t_start + sim_radio_airtime(len), STEP_END);
+}
+
+void sim_radio_send(const struct sim_air_pkt *pkt) {
+
+    struct sim_air_pkt *copy = malloc(sizeof(*copy));
+    *copy = *pkt;
+    if (copy->t_start < sim_now()) {
+        copy->t_start = sim_now();
+    }
+    copy->lost = 0;
+    air_channel(copy);
+    if (copy->lost) {
+        free(copy);
+        return;
+    }
+    sim_schedule(copy->t_start + BYTE_NS, air_arrive, copy, 0);
+}
+
+void sim_radio_residency(uint64_t ns[8]) {
+
+    memcpy(ns, sim_radio_stats.state_ns, sizeof(sim_radio_stats.state_ns));
+    ns[rad.state] += sim_now() - rad.t_state;
+}
+
+void sim_radio_peer(sim_air_fn fn) {
+    rad.peer = fn;
+}
+
+static void radio_exit(void *arg) {
+
+    (void) arg;
+    sim_radio_stats.state_ns[rad.state] += sim_now() - rad.t_state;
+    rad.t_state = sim_now();
+}
+
+void sim_radio_init(void) {
+
+    radio = (struct sim_periph) {
+        .name = "RADIO", .base = RADIO_BASE, .irq = 1, .std = 1,
+        .task = radio_task, .event = radio_event,
+    };
+    sim_periph_add(&radio);
+
+    /* reset values the firmware relies on */
+    REG(&radio, RADIO_PCNF1)  = 0;
+    REG(&radio, RADIO_CRCCNF) = 0;
+
+    sim_on_exit(radio_exit, NULL);
+}
+
+/* note 1 : what's modelled
+ *
+ *          state machine, ramp-up (fast or default), airtime from BALEN, LENGTH
+ *          and CRC length at 2Mbit, the ADDRESS/PAYLOAD/END/DISABLED events and
+ *          the shorts both firmwares use. a packet is received only if the radio
+ *          is in RX on the right frequency and address by the end of its
+ *          preamble, the real thing can't lock on mid-packet. CRC and whitening are
+ *          not computed: a packet carries crc_ok, set by whoever sent it. addresses
+ *          are compared as identifiers (prefix, low BALEN bytes of the base), not
+ *          bit patterns. there is one peer, and nothing collides.
+ *
+ * note 2 : the channel
+ *
+ *          sim_air_cfg applies to every packet in both directions, at the
+ *          firmware's END or when the harness sends. lost is lost: independent
+ *          `loss`, or a gilbert-elliott burst that starts with `burst_enter`
+ *          per packet and ends with `burst_exit`, so its mean length is
+ *          1 / burst_exit packets. the interferer is periodic (a wifi beacon,
+ *          another 2.4GHz link) and a packet that overlaps it still gets an
+ *          ADDRESS but fails CRC, which the firmware sees unlike a loss. a
+ *          lost firmware packet still goes to the peer with `lost` set, so a
+ *          harness can account for what was in it.
+ */
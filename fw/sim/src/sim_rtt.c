@@ -0,0 +1,64 @@
+/**********************************************************************************
+ ** file            : sim_rtt.c
+ ** description     : SEGGER RTT for the host build: channel 0 goes to stdout
+ **
+ **********************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include "sim_hw.h"
+
+/* same signatures as include/rtt/SEGGER_RTT.h, which the mouse doesn't have */
+void     SEGGER_RTT_Init(void);
+unsigned SEGGER_RTT_Write(unsigned BufferIndex, const void *pBuffer, unsigned NumBytes);
+unsigned SEGGER_RTT_WriteString(unsigned BufferIndex, const char *s);
+unsigned SEGGER_RTT_GetAvailWriteSpace(unsigned BufferIndex);
+int      SEGGER_RTT_vprintf(unsigned BufferIndex, const char *sFormat, va_list *pParamList);
+int      SEGGER_RTT_printf(unsigned BufferIndex, const char *sFormat, ...);
+
+void SEGGER_RTT_Init(void) {
+}
+
+unsigned SEGGER_RTT_Write(unsigned BufferIndex, const void *pBuffer, unsigned NumBytes) {
+
+    (void) BufferIndex;
+    sim_enter();
+    fwrite(pBuffer, 1, NumBytes, stdout);
+    sim_leave();
+    return NumBytes;
+}
+
+unsigned SEGGER_RTT_WriteString(unsigned BufferIndex, const char *s) {
+
+    (void) BufferIndex;
+    sim_enter();
+    int n = fputs(s, stdout);
+    sim_leave();
+    return n < 0 ? 0 : (unsigned) n;
+}
+
+/* the host reads as fast as we write */
+unsigned SEGGER_RTT_GetAvailWriteSpace(unsigned BufferIndex) {
+
+    (void) BufferIndex;
+    return 1024;
+}
+
+int SEGGER_RTT_vprintf(unsigned BufferIndex, const char *sFormat, va_list *pParamList) {
+
+    (void) BufferIndex;
+    sim_enter();
+    int n = vprintf(sFormat, *pParamList);
+    sim_leave();
+    return n;
+}
+
+int SEGGER_RTT_printf(unsigned BufferIndex, const char *sFormat, ...) {
+
+    va_list ap;
+    va_start(ap, sFormat);
+    int n = SEGGER_RTT_vprintf(BufferIndex, sFormat, &ap);
+    va_end(ap);
+    return n;
+}
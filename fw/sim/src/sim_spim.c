@@ -0,0 +1,321 @@
+/**********************************************************************************
+ ** file            : sim_spim.c
+ ** description     : SPIM0 model and a PAW3395 on its bus
+ **
+ **********************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include "sim_hw.h"
+
+#define SPIM0_BASE              0x40003000
+
+#define SPIM_START              0x010
+#define SPIM_STOP               0x014
+#define SPIM_STOPPED            0x104
+#define SPIM_ENDRX              0x110
+#define SPIM_END                0x118
+#define SPIM_ENDTX              0x120
+#define SPIM_STARTED            0x14C
+#define SPIM_ENABLE             0x500
+#define SPIM_FREQUENCY          0x524
+#define SPIM_RXD_PTR            0x534
+#define SPIM_RXD_MAXCNT         0x538
+#define SPIM_RXD_AMOUNT         0x53C
+#define SPIM_TXD_PTR            0x544
+#define SPIM_TXD_MAXCNT         0x548
+#define SPIM_TXD_AMOUNT         0x54C
+#define SPIM_ORC                0x5C0
+
+#define SPIM_ENABLED            7
+
+/* t_srad: address to first data clock, reads and bursts */
+#define PAW_T_SRAD_NS           (2 * SIM_US)
+
+/* downshift register units, with the multipliers paw_init() leaves */
+#define PAW_RUN_UNIT_NS         (2048 * 50 * SIM_US)
+#define PAW_REST1_UNIT_NS       (128 * SIM_MS)
+#define PAW_REST2_UNIT_NS       (6400 * SIM_MS)
+
+#define PAW_MOTION              0x02
+#define PAW_DELTA_X_L           0x03
+#define PAW_DELTA_Y_H           0x06
+#define PAW_MOTION_BURST        0x16
+#define PAW_POWER_UP_RESET      0x3A
+#define PAW_SET_RESOLUTION      0x47
+#define PAW_RES_X_LOW           0x48
+#define PAW_RES_X_HIGH          0x49
+#define PAW_RUN_DOWNSHIFT       0x77
+#define PAW_REST1_DOWNSHIFT     0x79
+#define PAW_REST2_DOWNSHIFT     0x7B
+#define PAW_BANK                0x7F
+
+struct sim_paw_stats sim_paw_stats;
+
+static struct sim_periph spim;
+
+/* --- PAW3395 ----------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+static struct {
+    uint8_t  attached;
+    uint8_t  motion_pin;
+    uint8_t  selected;
+    uint8_t  n;                 /* bytes since NCS went low         */
+    uint8_t  addr;
+    uint8_t  burst[12];
+    uint64_t t_addr;            /* end of the address byte          */
+    uint8_t  regs[32][128];     /* bank, address                    */
+    int32_t  dx;
+    int32_t  dy;
+    int16_t  latch[2];          /* Motion read latches the deltas   */
+    uint64_t t_motion;
+} paw;
+
+double sim_paw_downshift_scale = 1.0;
+
+static uint8_t paw_op_mode(void) {
+
+    uint64_t idle  = (sim_now() - paw.t_motion) / sim_paw_downshift_scale;
+    uint64_t run   = paw.regs[0][PAW_RUN_DOWNSHIFT]   * PAW_RUN_UNIT_NS;
+    uint64_t rest1 = paw.regs[0][PAW_REST1_DOWNSHIFT] * PAW_REST1_UNIT_NS;
+    uint64_t rest2 = paw.regs[0][PAW_REST2_DOWNSHIFT] * PAW_REST2_UNIT_NS;
+
+    if (idle < run)                         return 0;
+    if (idle < run + rest1)                 return 1;
+    if (idle < run + rest1 + rest2)         return 2;
+    return 3;
+}
+
+static int16_t clamp16(int32_t v) {
+    return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v;
+}
+
+/* MOTION is active low while deltas are pending */
+static void paw_motion_pin(void) {
+    sim_gpio_set(paw.motion_pin, !(paw.dx || paw.dy));
+}
+
+static void paw_take_deltas(void) {
+
+    paw.latch[0] = clamp16(paw.dx);
+    paw.latch[1] = clamp16(paw.dy);
+    paw.dx = 0;
+    paw.dy = 0;
+    paw_motion_pin();
+}
+
+static uint8_t paw_motion_reg(void) {
+    return ((paw.dx || paw.dy) ? 0x80 : 0) | paw_op_mode();
+}
+
+static void paw_reset(void) {
+
+    memset(paw.regs, 0, sizeof(paw.regs));
+    paw.regs[0][0x00] = 0x51;                   /* product id */
+    paw.regs[0][0x6C] = 0x80;                   /* init done, step 139 */
+    paw.dx = paw.dy = 0;
+    paw.t_motion = sim_now();
+    paw_motion_pin();
+}
+
+static void paw_write(uint8_t addr, uint8_t val) {
+
+    uint8_t bank = paw.regs[0][PAW_BANK] & 31;
+
+    sim_paw_stats.writes++;
+
+    if (addr == PAW_BANK) {
+        paw.regs[0][PAW_BANK] = val;
+        return;
+    }
+    if (addr == PAW_POWER_UP_RESET && val == 0x5A) {
+        paw_reset();
+        sim_paw_stats.powered_up = 1;
+        return;
+    }
+
+    paw.regs[bank][addr] = val;
+
+    if (bank == 0 && addr == PAW_SET_RESOLUTION && (val & 1)) {
+        uint16_t res = paw.regs[0][PAW_RES_X_LOW] | (paw.regs[0][PAW_RES_X_HIGH] << 8);
+        sim_paw_stats.dpi = res * 50;
+    }
+}
+
+static uint8_t paw_read(uint8_t addr) {
+
+    uint8_t bank = paw.regs[0][PAW_BANK] & 31;
+
+    sim_paw_stats.reads++;
+
+    if (bank == 0 && addr == PAW_MOTION) {
+        uint8_t m = paw_motion_reg();
+        paw_take_deltas();
+        return m;
+    }
+    if (bank == 0 && addr >= PAW_DELTA_X_L && addr <= PAW_DELTA_Y_H) {
+        uint16_t v = paw.latch[(addr - PAW_DELTA_X_L) / 2];
+        return (addr - PAW_DELTA_X_L) & 1 ? v >> 8 : v & 0xFF;
+    }
+    return paw.regs[bank][addr & 0x7F];
+}
+
+/* one byte clocked between t0 and t0 + dt */
+static uint8_t paw_byte(uint8_t mosi, uint64_t t0, uint64_t dt) {
+
+    if (!paw.selected) {
+        return 0xFF;
+    }
+
+    uint8_t n = paw.n++;
+
+    if (n == 0) {
+        paw.addr   = mosi;
+        paw.t_addr = t0 + dt;
+        if (mosi == PAW_MOTION_BURST && (paw.regs[0][PAW_BANK] & 31) == 0) {
+            sim_paw_stats.bursts++;
+            paw.burst[0] = paw_motion_reg();
+            paw_take_deltas();
+            paw.burst[2] = paw.latch[0] & 0xFF;
+            paw.burst[3] = paw.latch[0] >> 8;
+            paw.burst[4] = paw.latch[1] & 0xFF;
+            paw.burst[5] = paw.latch[1] >> 8;
+        }
+        return 0xFF;
+    }
+
+    if (paw.addr & 0x80) {
+        if (n == 1) {
+            paw_write(paw.addr & 0x7F, mosi);
+        }
+        return 0xFF;
+    }
+
+    if (n == 1 && t0 < paw.t_addr + PAW_T_SRAD_NS) {
+        sim_paw_stats.srad_violations++;
+    }
+    if (paw.addr == PAW_MOTION_BURST) {
+        return n - 1 < (int) sizeof(paw.burst) ? paw.burst[n - 1] : 0;
+    }
+    return n == 1 ? paw_read(paw.addr) : 0xFF;
+}
+
+static void paw_ncs(unsigned pin, int level) {
+
+    (void) pin;
+    paw.selected = !level;
+    paw.n = 0;
+}
+
+void sim_paw_attach(unsigned ncs_pin, unsigned motion_pin) {
+
+    paw.attached   = 1;
+    paw.motion_pin = motion_pin;
+    paw_reset();
+    sim_gpio_watch(ncs_pin, paw_ncs);
+    paw.selected = !sim_gpio_level(ncs_pin);
+}
+
+void sim_paw_move(int32_t dx, int32_t dy) {
+
+    if (!dx && !dy) {
+        return;
+    }
+    paw.dx += dx;
+    paw.dy += dy;
+    paw.t_motion = sim_now();
+    paw_motion_pin();
+}
+
+/* --- SPIM -------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+static struct {
+    uint32_t gen;
+    uint8_t  busy;
+} sp;
+
+/* FREQUENCY is 125kbps * (value >> 25) */
+static uint64_t byte_ns(void) {
+
+    uint32_t f = REG(&spim, SPIM_FREQUENCY) >> 25;
+    return f ? 8 * SIM_S / (125000ULL * f) : 8 * SIM_S / 125000ULL;
+}
+
+static void spim_end(void *obj, uint32_t tag) {
+
+    (void) obj;
+    if (tag != sp.gen) {
+        return;
+    }
+    sp.busy = 0;
+    REG(&spim, SPIM_TXD_AMOUNT) = REG(&spim, SPIM_TXD_MAXCNT);
+    REG(&spim, SPIM_RXD_AMOUNT) = REG(&spim, SPIM_RXD_MAXCNT);
+    sim_raise(&spim, SPIM_ENDTX);
+    sim_raise(&spim, SPIM_ENDRX);
+    sim_raise(&spim, SPIM_END);
+}
+
+/* the bytes go to the slave now, END comes when the last one is clocked */
+static void spim_task(struct sim_periph *p, uint32_t off) {
+
+    switch (off) {
+
+        case SPIM_START: {
+
+            if (REG(p, SPIM_ENABLE) != SPIM_ENABLED) {
+                break;
+            }
+
+            const uint8_t *tx = sim_ptr(REG(p, SPIM_TXD_PTR));
+            uint8_t *rx       = sim_ptr(REG(p, SPIM_RXD_PTR));
+            uint32_t ntx      = REG(p, SPIM_TXD_MAXCNT) & 0xFF;
+            uint32_t nrx      = REG(p, SPIM_RXD_MAXCNT) & 0xFF;
+            uint32_t n        = ntx > nrx ? ntx : nrx;
+            uint64_t dt       = byte_ns();
+
+            for (uint32_t i = 0; i < n; i++) {
+                uint8_t mosi = i < ntx ? tx[i] : REG(p, SPIM_ORC);
+                uint8_t miso = paw.attached ? paw_byte(mosi, sim_now() + i * dt, dt) : 0xFF;
+                if (i < nrx) {
+                    rx[i] = miso;
+                }
+            }
+
+            sp.busy = 1;
+            sim_raise(p, SPIM_STARTED);
+            sim_schedule(sim_now() + n * dt, spim_end, NULL, ++sp.gen);
+            break;
+        }
+
+        case SPIM_STOP:
+            sp.gen++;
+            sp.busy = 0;
+            sim_raise(p, SPIM_STOPPED);
+            break;
+
+        default:
+            break;
+    }
+}
+
+void sim_spim_init(void) {
+
+    spim = (struct sim_periph) {
+        .name = "SPIM0", .base = SPIM0_BASE, .irq = 3, .std = 1, .task = spim_task,
+    };
+    sim_periph_add(&spim);
+    REG(&spim, SPIM_FREQUENCY) = 0x04000000;    /* reset: 250kbps */
+}
+
+/* note 1 : the PAW3395
+ *
+ *          enough of it for the firmware: NCS framing, the address byte with
+ *          bit 7 for writes, banks through 0x7F, power-up reset, the 0x6C check
+ *          of the init sequence, Motion/Delta reads, the motion burst, MOTION
+ *          held low while deltas are pending, the resolution registers and the
+ *          downshift to Rest3. every other register is plain storage. bytes are
+ *          exchanged when the transfer starts, with the time each one would be
+ *          clocked, which is what t_srad is checked against.
+ */
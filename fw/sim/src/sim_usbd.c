@@ -0,0 +1,712 @@
+/**********************************************************************************
+ ** file            : sim_usbd.c
+ ** description     : USBD model (nRF52840) and the host at the other end of the
+ **                   cable: control transfers on ep0, interrupt IN polls, SOF,
+ **                   suspend, resume and remote wakeup
+ **
+ **********************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include "sim_hw.h"
+
+#define USBD_BASE               0x40027000
+
+#define USBD_STARTEPIN(n)       (0x004 + 4 * (n))
+#define USBD_STARTEPOUT(n)      (0x028 + 4 * (n))
+#define USBD_EP0RCVOUT          0x04C
+#define USBD_EP0STATUS          0x050
+#define USBD_EP0STALL           0x054
+#define USBD_DPDMDRIVE          0x058
+
+#define USBD_USBRESET           0x100
+#define USBD_STARTED            0x104
+#define USBD_ENDEPIN(n)         (0x108 + 4 * (n))
+#define USBD_EP0DATADONE        0x128
+#define USBD_ENDEPOUT(n)        (0x130 + 4 * (n))
+#define USBD_SOF                0x154
+#define USBD_USBEVENT           0x158
+#define USBD_EP0SETUP           0x15C
+#define USBD_EPDATA             0x160
+
+#define USBD_EVENTCAUSE         0x400
+#define USBD_EPSTATUS           0x468
+#define USBD_EPDATASTATUS       0x46C
+#define USBD_USBADDR            0x470
+#define USBD_BMREQUESTTYPE      0x480
+#define USBD_BREQUEST           0x484
+#define USBD_WVALUEL            0x488
+#define USBD_WVALUEH            0x48C
+#define USBD_WINDEXL            0x490
+#define USBD_WINDEXH            0x494
+#define USBD_WLENGTHL           0x498
+#define USBD_WLENGTHH           0x49C
+#define USBD_ENABLE             0x500
+#define USBD_USBPULLUP          0x504
+#define USBD_DPDMVALUE          0x508
+#define USBD_FRAMECNTR          0x520
+#define USBD_LOWPOWER           0x52C
+#define USBD_EPIN_PTR(n)        (0x600 + 0x14 * (n))
+#define USBD_EPIN_MAXCNT(n)     (0x604 + 0x14 * (n))
+#define USBD_EPIN_AMOUNT(n)     (0x608 + 0x14 * (n))
+#define USBD_EPOUT_PTR(n)       (0x700 + 0x14 * (n))
+#define USBD_EPOUT_MAXCNT(n)    (0x704 + 0x14 * (n))
+#define USBD_EPOUT_AMOUNT(n)    (0x708 + 0x14 * (n))
+
+#define EVENTCAUSE_SUSPEND      (1 << 8)
+#define EVENTCAUSE_RESUME       (1 << 9)
+#define EVENTCAUSE_USBWUALLOWED (1 << 10)
+#define EVENTCAUSE_READY        (1 << 11)
+#define DPDMVALUE_RESUME        (1 << 0)
+
+#define USB_EPS                 8
+#define USB_MPS0                64
+#define USB_REQ_CLEAR_FEATURE   0x01
+#define USB_REQ_SET_FEATURE     0x03
+#define USB_REQ_SET_ADDRESS     0x05
+#define USB_FEAT_REMOTE_WAKEUP  0x01
+
+#define DEBOUNCE_NS             (100 * SIM_MS)      /* host: attach debounce    */
+#define RESET_NS                (10 * SIM_MS)       /* host: bus reset          */
+#define RECOVERY_NS             (10 * SIM_MS)       /* host: after reset        */
+#define RETRY_NS                (20 * SIM_US)       /* host: NAKed token again  */
+#define CTRL_TIMEOUT_NS         (5 * SIM_S)
+#define DMA_NS(len)             (2 * SIM_US + (len) * 30 * SIM_NS)
+#define SUSPEND_NS              (3 * SIM_MS)        /* idle bus -> SUSPEND      */
+#define WAKE_NS                 (1 * SIM_MS)        /* host: K seen -> its own  */
+#define RESUME_NS               (20 * SIM_MS)       /* host: resume signalling  */
+#define LOWPOWER_EXIT_NS        (10 * SIM_US)       /* -> USBWUALLOWED          */
+
+/* full speed, a transaction with `len` data bytes: tokens, pids, crc, handshake */
+#define BUS_NS(len)             (((len) + 13) * 667 * SIM_NS)
+
+struct sim_usb_stats sim_usb_stats;
+
+static struct sim_periph usbd;
+
+enum ctrl_stage {
+    CTRL_IDLE,
+    CTRL_SETUP,
+    CTRL_DATA_IN,
+    CTRL_DATA_OUT,
+    CTRL_STATUS,
+};
+
+static struct {
+
+    /* device side */
+    uint32_t eventcause;
+    uint32_t epstatus;
+    uint32_t epdatastatus;
+    uint8_t  pullup;
+    uint8_t  attached;          /* pull-up seen with VBUS, reset done   */
+    uint8_t  dma_busy;
+    uint32_t dma_gen;
+    uint8_t  in_ready[USB_EPS];
+    uint8_t  in_len[USB_EPS];
+    uint8_t  in_buf[USB_EPS][64];
+    uint8_t  ep0_stall;
+    uint8_t  ep0_status;        /* EP0STATUS since the SETUP            */
+    uint16_t frame;
+    uint32_t bus_gen;           /* bumps on reset/detach                */
+    uint8_t  lowpower;          /* LOWPOWER = LowPower                  */
+
+    /* host side */
+    uint8_t  idle;              /* no SOFs, suspended or on the way     */
+    uint8_t  suspended;         /* the device has seen SUSPEND          */
+    uint8_t  resuming;          /* resume signalling on the bus         */
+    uint8_t  remote_wakeup;     /* DEVICE_REMOTE_WAKEUP set             */
+    sim_fn   on_connect;
+    void    *on_connect_arg;
+    uint32_t poll_ms[USB_EPS];
+    sim_usb_in_fn poll_fn[USB_EPS];
+
+    struct {
+        enum ctrl_stage stage;
+        struct sim_usb_setup setup;
+        uint8_t  out[256];
+        uint8_t  data[1024];
+        uint16_t len;
+        uint64_t t_start;
+        uint32_t gen;
+        sim_usb_ctrl_fn done;
+        void    *arg;
+    } ctrl;
+
+} usb;
+
+static void ctrl_token(void *obj, uint32_t tag);
+static void wakeup_seen(void *obj, uint32_t tag);
+
+/* --- DEVICE ------------------------------------------------------------------------ */
+/* ----------------------------------------------------------------------------------- */
+
+static void dma_end(void *obj, uint32_t tag) {
+
+    int ep = (int) (uintptr_t) obj & 0xFF;
+    int in = !((uintptr_t) obj & 0x100);
+
+    if (tag != usb.dma_gen) {
+        return;
+    }
+    usb.dma_busy = 0;
+
+    if (in) {
+        uint32_t len = REG(&usbd, USBD_EPIN_MAXCNT(ep)) & 0x7F;
+        if (len > sizeof(usb.in_buf[ep])) {
+            len = sizeof(usb.in_buf[ep]);
+        }
+        if (len) {
+            memcpy(usb.in_buf[ep], sim_ptr(REG(&usbd, USBD_EPIN_PTR(ep))), len);
+        }
+        usb.in_len[ep]   = len;
+        usb.in_ready[ep] = 1;
+        REG(&usbd, USBD_EPIN_AMOUNT(ep)) = len;
+        sim_raise(&usbd, USBD_ENDEPIN(ep));
+    }
+    else {
+        REG(&usbd, USBD_EPOUT_AMOUNT(ep)) = 0;
+        sim_raise(&usbd, USBD_ENDEPOUT(ep));
+    }
+}
+
+static void dma_start(int ep, int in) {
+
+    sim_usb_stats.dma++;
+    if (usb.dma_busy) {
+        sim_usb_stats.dma_while_busy++;
+    }
+    usb.dma_busy = 1;
+
+    uint32_t len = REG(&usbd, in ? USBD_EPIN_MAXCNT(ep) : USBD_EPOUT_MAXCNT(ep)) & 0x7F;
+
+    sim_raise(&usbd, USBD_STARTED);
+    sim_schedule(sim_now() + DMA_NS(len), dma_end, (void *) (uintptr_t) (ep | (in ? 0 : 0x100)),
+                 ++usb.dma_gen);
+}
+
+static void raise_cause(uint32_t cause) {
+
+    usb.eventcause |= cause;
+    REG(&usbd, USBD_EVENTCAUSE) = usb.eventcause;
+    sim_raise(&usbd, USBD_USBEVENT);
+}
+
+/* resume (K) on the lines, see note 2 */
+static void dpdm_drive(void) {
+
+    if (!(REG(&usbd, USBD_DPDMVALUE) & DPDMVALUE_RESUME) || !usb.suspended || usb.resuming) {
+        return;
+    }
+    if (!usb.remote_wakeup || usb.lowpower) {
+        sim_usb_stats.wakeups_ignored++;
+        return;
+    }
+    sim_usb_stats.wakeups++;
+    sim_usb_stats.t_wakeup = sim_now();
+    sim_schedule(sim_now() + WAKE_NS, wakeup_seen, NULL, usb.bus_gen);
+}
+
+static void lowpower_exited(void *obj, uint32_t tag) {
+
+    (void) obj;
+    if (tag != usb.bus_gen || !usb.suspended) {
+        return;
+    }
+    raise_cause(EVENTCAUSE_USBWUALLOWED);
+}
+
+static void usbd_task(struct sim_periph *p, uint32_t off) {
+
+    (void) p;
+
+    if (off >= USBD_STARTEPIN(0) && off < USBD_STARTEPIN(USB_EPS)) {
+        dma_start((off - USBD_STARTEPIN(0)) / 4, 1);
+        return;
+    }
+    if (off >= USBD_STARTEPOUT(0) && off < USBD_STARTEPOUT(USB_EPS)) {
+        dma_start((off - USBD_STARTEPOUT(0)) / 4, 0);
+        return;
+    }
+
+    switch (off) {
+        case USBD_EP0STATUS: usb.ep0_status = 1; break;
+        case USBD_EP0STALL:  usb.ep0_stall  = 1; break;
+        case USBD_DPDMDRIVE: dpdm_drive();       break;
+        default:             break;
+    }
+}
+
+static void sof(void *obj, uint32_t tag);
+
+static void bus_reset_done(void *obj, uint32_t tag) {
+
+    (void) obj;
+    if (tag != usb.bus_gen) {
+        return;
+    }
+    usb.attached = 1;
+    sim_schedule(sim_now() + SIM_MS, sof, NULL, usb.bus_gen);
+    if (usb.on_connect) {
+        sim_at(sim_now() + RECOVERY_NS, usb.on_connect, usb.on_connect_arg);
+    }
+}
+
+static void ctrl_finish(int result);
+
+void sim_usb_reset(void) {
+
+    usb.bus_gen++;
+    usb.attached  = 0;
+    usb.ep0_stall = 0;
+    usb.idle      = 0;
+    usb.suspended = 0;
+    usb.resuming  = 0;
+    usb.remote_wakeup = 0;
+    memset(usb.in_ready, 0, sizeof(usb.in_ready));
+    REG(&usbd, USBD_USBADDR) = 0;
+
+    if (usb.ctrl.stage != CTRL_IDLE) {
+        ctrl_finish(SIM_USB_GONE);
+    }
+
+    sim_usb_stats.resets++;
+    sim_raise(&usbd, USBD_USBRESET);
+    sim_schedule(sim_now() + RESET_NS, bus_reset_done, NULL, usb.bus_gen);
+}
+
+static void attach_debounced(void *obj, uint32_t tag) {
+
+    (void) obj;
+    if (tag != usb.bus_gen || !usb.pullup || !sim_power_vbus()) {
+        return;
+    }
+    sim_usb_reset();
+}
+
+static void usbd_write(struct sim_periph *p, uint32_t off, uint32_t val) {
+
+    switch (off) {
+
+        case USBD_ENABLE:
+            if (val & 1) {
+                raise_cause(EVENTCAUSE_READY);
+            }
+            break;
+
+        /* out of low power while suspended: clear to drive resume */
+        case USBD_LOWPOWER:
+            if (!(val & 1) && usb.lowpower && usb.suspended) {
+                sim_schedule(sim_now() + LOWPOWER_EXIT_NS, lowpower_exited, NULL, usb.bus_gen);
+            }
+            usb.lowpower = val & 1;
+            break;
+
+        /* write one to clear */
+        case USBD_EVENTCAUSE:
+            usb.eventcause &= ~val;
+            REG(p, USBD_EVENTCAUSE) = usb.eventcause;
+            break;
+
+        case USBD_EPSTATUS:
+            usb.epstatus &= ~val;
+            REG(p, USBD_EPSTATUS) = usb.epstatus;
+            break;
+
+        case USBD_EPDATASTATUS:
+            usb.epdatastatus &= ~val;
+            REG(p, USBD_EPDATASTATUS) = usb.epdatastatus;
+            break;
+
+        case USBD_USBPULLUP:
+            if ((val & 1) && !usb.pullup) {
+                usb.pullup = 1;
+                sim_usb_stats.t_connect = sim_now();
+                if (sim_power_vbus()) {
+                    sim_schedule(sim_now() + DEBOUNCE_NS, attach_debounced, NULL, ++usb.bus_gen);
+                }
+            }
+            else if (!(val & 1) && usb.pullup) {
+                usb.pullup    = 0;
+                usb.attached  = 0;
+                usb.idle      = 0;
+                usb.suspended = 0;
+                usb.resuming  = 0;
+                usb.bus_gen++;
+                if (usb.ctrl.stage != CTRL_IDLE) {
+                    ctrl_finish(SIM_USB_GONE);
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* --- HOST: SOF, INTERRUPT IN ------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+static void in_poll(void *obj, uint32_t tag) {
+
+    int ep = (int) (uintptr_t) obj;
+
+    if (tag != usb.bus_gen || !usb.attached || !usb.poll_fn[ep]) {
+        return;
+    }
+
+    if (!usb.in_ready[ep]) {
+        sim_usb_stats.in_naks++;
+        return;
+    }
+
+    usb.in_ready[ep] = 0;
+    sim_usb_stats.in_pkts++;
+
+    usb.epdatastatus |= 1u << ep;
+    REG(&usbd, USBD_EPDATASTATUS) = usb.epdatastatus;
+    sim_raise(&usbd, USBD_EPDATA);
+
+    usb.poll_fn[ep](ep, usb.in_buf[ep], usb.in_len[ep]);
+}
+
+/* frames run from the end of a reset until the next one or a detach */
+static void sof(void *obj, uint32_t tag) {
+
+    (void) obj;
+    if (tag != usb.bus_gen || !usb.attached || usb.idle) {
+        return;
+    }
+
+    usb.frame = (usb.frame + 1) & 0x7FF;
+    REG(&usbd, USBD_FRAMECNTR) = usb.frame;
+    sim_raise(&usbd, USBD_SOF);
+
+    /* each endpoint at its own spot in the frame */
+    for (int ep = 1; ep < USB_EPS; ep++) {
+        if (usb.poll_fn[ep] && usb.frame % usb.poll_ms[ep] == 0) {
+            sim_schedule(sim_now() + ep * BUS_NS(8), in_poll, (void *) (uintptr_t) ep,
+                         usb.bus_gen);
+        }
+    }
+    sim_schedule(sim_now() + SIM_MS, sof, NULL, usb.bus_gen);
+}
+
+void sim_usb_poll(uint8_t ep, uint32_t interval_ms, sim_usb_in_fn fn) {
+
+    ep &= 7;
+    usb.poll_ms[ep] = interval_ms ? interval_ms : 1;
+    usb.poll_fn[ep] = fn;
+}
+
+uint16_t sim_usb_frame(void) {
+    return usb.frame;
+}
+
+/* --- HOST: SUSPEND, RESUME --------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+static void suspend_seen(void *obj, uint32_t tag) {
+
+    (void) obj;
+    if (tag != usb.bus_gen || !usb.idle) {
+        return;
+    }
+    usb.suspended = 1;
+    sim_usb_stats.suspends++;
+    sim_usb_stats.t_suspend = sim_now();
+    raise_cause(EVENTCAUSE_SUSPEND);
+}
+
+/* the frames stop, the device suspends after SUSPEND_NS of idle bus */
+void sim_usb_bus_suspend(void) {
+
+    if (!usb.attached || usb.idle) {
+        return;
+    }
+    usb.idle = 1;
+    sim_schedule(sim_now() + SUSPEND_NS, suspend_seen, NULL, usb.bus_gen);
+}
+
+static void resume_done(void *obj, uint32_t tag) {
+
+    (void) obj;
+    if (tag != usb.bus_gen) {
+        return;
+    }
+    usb.idle      = 0;
+    usb.suspended = 0;
+    usb.resuming  = 0;
+    sim_usb_stats.resumes++;
+    sim_usb_stats.t_resume = sim_now();
+
+    /* the end of resume signalling, frames from here */
+    sof(NULL, usb.bus_gen);
+}
+
+static void resume_start(void) {
+
+    usb.resuming = 1;
+    raise_cause(EVENTCAUSE_RESUME);
+    sim_schedule(sim_now() + RESUME_NS, resume_done, NULL, usb.bus_gen);
+}
+
+/* the device's K reached the host, which takes the resume over */
+static void wakeup_seen(void *obj, uint32_t tag) {
+
+    (void) obj;
+    if (tag != usb.bus_gen || !usb.suspended || usb.resuming) {
+        return;
+    }
+    resume_start();
+}
+
+void sim_usb_resume(void) {
+
+    if (usb.suspended && !usb.resuming) {
+        resume_start();
+    }
+}
+
+/* --- HOST: CONTROL TRANSFERS ------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+static void ctrl_finish(int result) {
+
+    switch (result) {
+        case SIM_USB_OK:      sim_usb_stats.ctrl_done++;     break;
+        case SIM_USB_STALL:   sim_usb_stats.ctrl_stalled++;  break;
+        case SIM_USB_TIMEOUT: sim_usb_stats.ctrl_timeouts++; break;
+        default:              break;
+    }
+
+    /* the device's remote wakeup, as far as the host knows */
+    struct sim_usb_setup *s = &usb.ctrl.setup;
+    if (result == SIM_USB_OK && s->bmRequestType == 0x00 && s->wValue == USB_FEAT_REMOTE_WAKEUP
+        && (s->bRequest == USB_REQ_SET_FEATURE || s->bRequest == USB_REQ_CLEAR_FEATURE)) {
+        usb.remote_wakeup = s->bRequest == USB_REQ_SET_FEATURE;
+    }
+
+    usb.ctrl.stage = CTRL_IDLE;
+    usb.ctrl.gen++;
+
+    if (usb.ctrl.done) {
+        usb.ctrl.done(usb.ctrl.arg, result, usb.ctrl.data, usb.ctrl.len);
+    }
+}
+
+static void ctrl_retry(void) {
+    sim_schedule(sim_now() + RETRY_NS, ctrl_token, NULL, usb.ctrl.gen);
+}
+
+static void ctrl_setup(void) {
+
+    struct sim_usb_setup *s = &usb.ctrl.setup;
+
+    sim_usb_stats.setups++;
+
+    usb.ep0_stall   = 0;
+    usb.ep0_status  = 0;
+    usb.in_ready[0] = 0;
+
+    /* SET_ADDRESS never reaches the firmware, the USBD answers it */
+    if (s->bmRequestType == 0x00 && s->bRequest == USB_REQ_SET_ADDRESS) {
+        REG(&usbd, USBD_USBADDR) = s->wValue & 0x7F;
+        sim_usb_stats.t_address = sim_now();
+        ctrl_finish(SIM_USB_OK);
+        return;
+    }
+
+    REG(&usbd, USBD_BMREQUESTTYPE) = s->bmRequestType;
+    REG(&usbd, USBD_BREQUEST)      = s->bRequest;
+    REG(&usbd, USBD_WVALUEL)       = s->wValue & 0xFF;
+    REG(&usbd, USBD_WVALUEH)       = s->wValue >> 8;
+    REG(&usbd, USBD_WINDEXL)       = s->wIndex & 0xFF;
+    REG(&usbd, USBD_WINDEXH)       = s->wIndex >> 8;
+    REG(&usbd, USBD_WLENGTHL)      = s->wLength & 0xFF;
+    REG(&usbd, USBD_WLENGTHH)      = s->wLength >> 8;
+    sim_raise(&usbd, USBD_EP0SETUP);
+
+    if (!s->wLength) {
+        usb.ctrl.stage = CTRL_STATUS;
+    }
+    else if (s->bmRequestType & 0x80) {
+        usb.ctrl.stage = CTRL_DATA_IN;
+    }
+    else {
+        usb.ctrl.stage = CTRL_DATA_OUT;
+    }
+    sim_schedule(sim_now() + BUS_NS(8), ctrl_token, NULL, usb.ctrl.gen);
+}
+
+/* one token from the host, NAKed ones come back after RETRY_NS */
+static void ctrl_token(void *obj, uint32_t tag) {
+
+    (void) obj;
+    if (tag != usb.ctrl.gen || usb.ctrl.stage == CTRL_IDLE) {
+        return;
+    }
+
+    if (sim_now() - usb.ctrl.t_start > CTRL_TIMEOUT_NS) {
+        ctrl_finish(SIM_USB_TIMEOUT);
+        return;
+    }
+    if (usb.ep0_stall && usb.ctrl.stage != CTRL_SETUP) {
+        ctrl_finish(SIM_USB_STALL);
+        return;
+    }
+
+    switch (usb.ctrl.stage) {
+
+        case CTRL_SETUP:
+            ctrl_setup();
+            break;
+
+        case CTRL_DATA_IN: {
+
+            if (!usb.in_ready[0]) {
+                sim_usb_stats.ep0_naks++;
+                ctrl_retry();
+                break;
+            }
+
+            uint8_t n = usb.in_len[0];
+            uint16_t room = usb.ctrl.setup.wLength - usb.ctrl.len;
+            if (n > room) {
+                n = room;
+            }
+            memcpy(usb.ctrl.data + usb.ctrl.len, usb.in_buf[0], n);
+            usb.ctrl.len += n;
+            usb.in_ready[0] = 0;
+            sim_usb_stats.ep0_in_pkts++;
+            if (!usb.in_len[0]) {
+                sim_usb_stats.ep0_zlps++;
+            }
+            sim_raise(&usbd, USBD_EP0DATADONE);
+
+            /* a short packet or everything asked for ends the data stage */
+            if (usb.in_len[0] < USB_MPS0 || usb.ctrl.len >= usb.ctrl.setup.wLength) {
+                usb.ctrl.stage = CTRL_STATUS;
+            }
+            sim_schedule(sim_now() + BUS_NS(n), ctrl_token, NULL, usb.ctrl.gen);
+            break;
+        }
+
+        case CTRL_DATA_OUT:
+            /* nothing takes OUT data stages (usb_ep0.c stalls them) */
+            sim_usb_stats.ep0_naks++;
+            ctrl_retry();
+            break;
+
+        case CTRL_STATUS:
+            if (!usb.ep0_status) {
+                sim_usb_stats.ep0_naks++;
+                ctrl_retry();
+                break;
+            }
+            ctrl_finish(SIM_USB_OK);
+            break;
+
+        default:
+            break;
+    }
+}
+
+void sim_usb_control(const struct sim_usb_setup *setup, const uint8_t *out,
+                     sim_usb_ctrl_fn done, void *arg) {
+
+    if (usb.ctrl.stage != CTRL_IDLE) {
+        sim_stop("usb: control transfer while another one is running");
+    }
+    if (usb.idle) {
+        sim_stop("usb: control transfer on a suspended bus");
+    }
+
+    usb.ctrl.setup   = *setup;
+    usb.ctrl.len     = 0;
+    usb.ctrl.done    = done;
+    usb.ctrl.arg     = arg;
+    usb.ctrl.t_start = sim_now();
+    usb.ctrl.gen++;
+
+    if (out && setup->wLength && setup->wLength <= sizeof(usb.ctrl.out)) {
+        memcpy(usb.ctrl.out, out, setup->wLength);
+    }
+    if (setup->wLength > sizeof(usb.ctrl.data)) {
+        sim_stop("usb: control transfer longer than the host buffer");
+    }
+
+    if (!usb.attached) {
+        usb.ctrl.stage = CTRL_SETUP;
+        ctrl_finish(SIM_USB_GONE);
+        return;
+    }
+
+    usb.ctrl.stage = CTRL_SETUP;
+    sim_schedule(sim_now() + BUS_NS(8), ctrl_token, NULL, usb.ctrl.gen);
+}
+
+/* --- VBUS -------------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+void sim_usb_vbus(int on) {
+
+    sim_power_set_vbus(on);
+
+    if (!on) {
+        usb.attached  = 0;
+        usb.idle      = 0;
+        usb.suspended = 0;
+        usb.resuming  = 0;
+        usb.bus_gen++;
+        if (usb.ctrl.stage != CTRL_IDLE) {
+            ctrl_finish(SIM_USB_GONE);
+        }
+    }
+    else if (usb.pullup) {
+        sim_usb_stats.t_connect = sim_now();
+        sim_schedule(sim_now() + DEBOUNCE_NS, attach_debounced, NULL, ++usb.bus_gen);
+    }
+}
+
+void sim_usb_on_connect(sim_fn fn, void *arg) {
+    usb.on_connect     = fn;
+    usb.on_connect_arg = arg;
+}
+
+void sim_usbd_init(void) {
+
+    usbd = (struct sim_periph) {
+        .name = "USBD", .base = USBD_BASE, .irq = SIM_USBD_IRQ, .std = 1, .task = usbd_task,
+        .write = usbd_write,
+    };
+    sim_periph_add(&usbd);
+}
+
+/* note 1 : what the host does
+ *
+ *          attach is seen 100ms after the pull-up goes on with VBUS present, then
+ *          a 10ms reset (USBRESET on the device side) and 10ms of recovery before
+ *          sim_usb_on_connect()'s callback, which drives enumeration with
+ *          sim_usb_control(), one transfer at a time like a real host does on
+ *          ep0. tokens the device NAKs are retried every RETRY_NS. SET_ADDRESS
+ *          is answered by the USBD itself, as on the nRF, and never shows up as
+ *          EP0SETUP. interrupt IN endpoints are polled once every `interval_ms`
+ *          frames at a fixed spot in the frame, a poll that finds no data is a
+ *          NAK. SOF runs from the end of a reset until the next reset or detach.
+ *
+ * note 2 : suspend and resume
+ *
+ *          sim_usb_suspend() (sim_usbhost.c) stops the frames, and with them the
+ *          IN polls; SUSPEND_NS of idle bus later the device gets USBEVENT with
+ *          EVENTCAUSE SUSPEND. sim_usb_resume() is the host waking it: RESUME
+ *          right away, frames again after RESUME_NS of resume signalling (the
+ *          spec's minimum, linux holds it for 40ms). remote wakeup is the
+ *          device's DPDMDRIVE with DPDMVALUE Resume while suspended. the host
+ *          only takes it if it set DEVICE_REMOTE_WAKEUP and the USBD is out of
+ *          LOWPOWER, anything else counts in `wakeups_ignored`. WAKE_NS later
+ *          the host drives the resume itself, the same as one it started.
+ *          leaving LOWPOWER while suspended gives USBWUALLOWED after
+ *          LOWPOWER_EXIT_NS, the go-ahead nrfx waits for before DPDMDRIVE.
+ *          a reset or a detach ends a suspend like it ends everything else.
+ */
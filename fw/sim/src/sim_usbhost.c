@@ -0,0 +1,438 @@
+/**********************************************************************************
+ ** file            : sim_usbhost.c
+ ** description     : scripted usb hosts. the control transfers linux and windows
+ **                   make between attach and a bound driver, run one at a time
+ **                   against the USBD model, with what came back checked and
+ **                   what it cost counted
+ **
+ **********************************************************************************/
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "sim_hw.h"
+
+#define REQ_SET_FEATURE         0x03
+#define REQ_GET_DESCRIPTOR      0x06
+#define REQ_SET_CONFIGURATION   0x09
+
+#define DT_DEVICE               0x01
+#define DT_CONFIGURATION        0x02
+#define DT_STRING               0x03
+#define DT_HID                  0x21
+#define DT_REPORT               0x22
+
+#define CFG_ATTR_REMOTE_WAKEUP  0x20
+#define FEAT_REMOTE_WAKEUP      0x01
+
+/* --- SCRIPTS ----------------------------------------------------------------------- */
+/* ----------------------------------------------------------------------------------- */
+
+/* both start after the attach reset, see note 2 */
+static const struct sim_usb_step linux_steps[] = {
+    { { 0x80, 0x06, 0x0100, 0x0000, 64  }, 0,                  "device, 64 byte probe", -1 },
+    { { 0                               }, SIM_USB_RESET,      "bus reset",             -1 },
+    { { 0x00, 0x05, 0x0001, 0x0000, 0   }, 0,                  "SET_ADDRESS",           -1 },
+    { { 0x80, 0x06, 0x0100, 0x0000, 18  }, 0,                  "device",                -1 },
+    { { 0x80, 0x06, 0x0200, 0x0000, 9   }, 0,                  "configuration header",  -1 },
+    { { 0x80, 0x06, 0x0200, 0x0000, 0   }, SIM_USB_CFG_LEN,    "configuration",         -1 },
+    { { 0x80, 0x06, 0x0300, 0x0000, 255 }, 0,                  "langids",               -1 },
+    { { 0x80, 0x06, 0x0302, 0x0409, 255 }, 0,                  "product",               -1 },
+    { { 0x80, 0x06, 0x0301, 0x0409, 255 }, 0,                  "manufacturer",          -1 },
+    { { 0x80, 0x06, 0x0303, 0x0409, 255 }, 0,                  "serial",                -1 },
+    { { 0x00, 0x09, 0x0001, 0x0000, 0   }, 0,                  "SET_CONFIGURATION",     -1 },
+    { { 0x21, 0x0A, 0x0000, 0x0000, 0   }, SIM_USB_MAY_STALL,  "SET_IDLE",              -1 },
+    { { 0x81, 0x06, 0x2200, 0x0000, 0   }, SIM_USB_REPORT_LEN, "report descriptor",     -1 },
+};
+
+static const struct sim_usb_step windows_steps[] = {
+    { { 0x80, 0x06, 0x0100, 0x0000, 64  }, 0,                  "device, 64 byte probe", -1 },
+    { { 0                               }, SIM_USB_RESET,      "bus reset",             -1 },
+    { { 0x00, 0x05, 0x0001, 0x0000, 0   }, 0,                  "SET_ADDRESS",           -1 },
+    { { 0x80, 0x06, 0x0100, 0x0000, 18  }, 0,                  "device",                -1 },
+    { { 0x80, 0x06, 0x0200, 0x0000, 255 }, 0,                  "configuration",         -1 },
+    { { 0x80, 0x06, 0x03EE, 0x0000, 18  }, SIM_USB_MAY_STALL,  "ms os string",          -1 },
+    { { 0x80, 0x06, 0x0300, 0x0000, 255 }, 0,                  "langids",               -1 },
+    { { 0x80, 0x06, 0x0303, 0x0409, 255 }, 0,                  "serial",                -1 },
+    { { 0x80, 0x06, 0x0600, 0x0000, 10  }, SIM_USB_MAY_STALL,  "device qualifier",      -1 },
+    { { 0x80, 0x06, 0x0100, 0x0000, 18  }, 0,                  "device",                -1 },
+    { { 0x80, 0x06, 0x0200, 0x0000, 9   }, 0,                  "configuration header",  -1 },
+    { { 0x80, 0x06, 0x0200, 0x0000, 0   }, SIM_USB_CFG_LEN,    "configuration",         -1 },
+    { { 0x80, 0x00, 0x0000, 0x0000, 2   }, 0,                  "GET_STATUS",             2 },
+    { { 0x00, 0x09, 0x0001, 0x0000, 0   }, 0,                  "SET_CONFIGURATION",     -1 },
+    { { 0x80, 0x06, 0x0302, 0x0409, 255 }, 0,                  "product",               -1 },
+    { { 0x21, 0x0A, 0x0000, 0x0000, 0   }, SIM_USB_MAY_STALL,  "SET_IDLE",              -1 },
+    { { 0x81, 0x06, 0x2200, 0x0000, 64  }, SIM_USB_REPORT_LEN, "report descriptor",     -1 },
+};
+
+const struct sim_usb_script sim_usb_linux = {
+    "linux", linux_steps, sizeof(linux_steps) / sizeof(linux_steps[0]),
+};
+
+const struct sim_usb_script sim_usb_windows = {
+    "windows", windows_steps, sizeof(windows_steps) / sizeof(windows_steps[0]),
+};
+
+const struct sim_usb_script *sim_usb_script_find(const char *name) {
+
+    if (!strcmp(name, sim_usb_linux.name)) {
+        return &sim_usb_linux;
+    }
+    if (!strcmp(name, sim_usb_windows.name)) {
+        return &sim_usb_windows;
+    }
+    return NULL;
+}
+
+/* --- RUNNER ------------------------------------------------------------------------ */
+/* ----------------------------------------------------------------------------------- */
+
+static struct {
+
+    /* the script running */
+    const struct sim_usb_script *script;
+    struct sim_usb_run *run;
+    sim_fn   done;
+    void    *arg;
+    unsigned step;
+    uint8_t  resetting;
+    struct sim_usb_setup setup;
+    uint64_t t_xfer;
+
+    /* what the host has learned about the device */
+    uint16_t cfg_len;
+    uint16_t report_len;
+    uint8_t  cfg_attr;          /* bmAttributes                         */
+
+    /* counters when this run's share began */
+    struct sim_usb_stats base;
+    uint64_t isr_base;
+
+    /* sim_usb_enumerate() */
+    const struct sim_usb_script *enum_script;
+    struct sim_usb_run *enum_run;
+    sim_fn   enum_done;
+    void    *enum_arg;
+
+} host;
+
+static void counters_mark(void) {
+    host.base     = sim_usb_stats;
+    host.isr_base = sim_stats.isr[SIM_USBD_IRQ].count;
+}
+
+static const char *result_name(int result) {
+
+    switch (result) {
+        case SIM_USB_OK:      return "ok";
+        case SIM_USB_STALL:   return "stall";
+        case SIM_USB_TIMEOUT: return "timeout";
+        case SIM_USB_GONE:    return "gone";
+        default:              return "?";
+    }
+}
+
+static void run_end(const char *fmt, ...) {
+
+    struct sim_usb_run *r = host.run;
+
+    r->t_end  = sim_now();
+    r->isrs   = sim_stats.isr[SIM_USBD_IRQ].count - host.isr_base;
+    r->dma    = sim_usb_stats.dma          - host.base.dma;
+    r->setups = sim_usb_stats.setups       - host.base.setups;
+    r->ep0_in = sim_usb_stats.ep0_in_pkts  - host.base.ep0_in_pkts;
+    r->naks   = sim_usb_stats.ep0_naks     - host.base.ep0_naks;
+    r->zlps   = sim_usb_stats.ep0_zlps     - host.base.ep0_zlps;
+    r->stalls = sim_usb_stats.ctrl_stalled - host.base.ctrl_stalled;
+    r->step   = host.step;
+    r->ok     = !fmt;
+
+    if (fmt) {
+        va_list ap;
+        va_start(ap, fmt);
+        vsnprintf(r->why, sizeof(r->why), fmt, ap);
+        va_end(ap);
+    }
+
+    counters_mark();
+    host.script = NULL;
+    if (host.done) {
+        host.done(host.arg);
+    }
+}
+
+/* how much IN data the answer should have, -1 if there's no telling */
+static int want_len(const struct sim_usb_step *st, const uint8_t *data, uint16_t len) {
+
+    const struct sim_usb_setup *s = &host.setup;
+
+    if (st->expect_len >= 0) {
+        return st->expect_len < s->wLength ? st->expect_len : s->wLength;
+    }
+    if (s->bRequest != REQ_GET_DESCRIPTOR || !(s->bmRequestType & 0x80) || !len) {
+        return -1;
+    }
+
+    int natural = -1;
+
+    switch (s->wValue >> 8) {
+
+        case DT_DEVICE:
+        case DT_STRING:
+            natural = data[0];
+            break;
+
+        case DT_CONFIGURATION:
+            if (len < 4) {
+                break;
+            }
+            natural = data[2] | (data[3] << 8);
+            host.cfg_len = natural;
+            if (len >= 8) {
+                host.cfg_attr = data[7];
+            }
+
+            /* the HID descriptor has the report descriptor's length */
+            for (unsigned i = 0; i + 1 < len && data[i]; i += data[i]) {
+                if (data[i + 1] == DT_HID && i + 8 < len) {
+                    host.report_len = data[i + 7] | (data[i + 8] << 8);
+                }
+            }
+            break;
+
+        case DT_REPORT:
+            natural = host.report_len ? host.report_len : -1;
+            break;
+
+        default:
+            break;
+    }
+
+    if (natural < 0) {
+        return -1;
+    }
+    return natural < s->wLength ? natural : s->wLength;
+}
+
+static void step_next(void);
+
+static void xfer_done(void *arg, int result, const uint8_t *data, uint16_t len) {
+
+    (void) arg;
+
+    const struct sim_usb_step  *st = &host.script->steps[host.step];
+    const struct sim_usb_setup *s  = &host.setup;
+
+    host.run->xfer_ns += sim_now() - host.t_xfer;
+
+    if (sim_cfg.verbose) {
+        fprintf(stderr, "%10.3f ms  %-22s %02X %02X %04X %04X %3u -> %s, %u bytes\n",
+                sim_now() / 1e6, st->what, s->bmRequestType, s->bRequest, s->wValue,
+                s->wIndex, s->wLength, result_name(result), len);
+    }
+
+    if (result == SIM_USB_STALL && (st->flags & (SIM_USB_MAY_STALL | SIM_USB_STALLS))) {
+        host.step++;
+        step_next();
+        return;
+    }
+    if (result == SIM_USB_OK && (st->flags & SIM_USB_STALLS)) {
+        run_end("%s: answered, expected a stall", st->what);
+        return;
+    }
+    if (result != SIM_USB_OK) {
+        run_end("%s: %s", st->what, result_name(result));
+        return;
+    }
+
+    int want = want_len(st, data, len);
+    if (want >= 0 && len != want) {
+        run_end("%s: %u bytes, expected %d", st->what, len, want);
+        return;
+    }
+
+    if (s->bmRequestType == 0x00 && s->bRequest == REQ_SET_CONFIGURATION && s->wValue) {
+        host.run->t_configured = sim_now();
+    }
+
+    host.step++;
+    step_next();
+}
+
+static void step_next(void) {
+
+    if (host.step == host.script->n) {
+        run_end(NULL);
+        return;
+    }
+
+    const struct sim_usb_step *st = &host.script->steps[host.step];
+
+    /* the next step runs from on_connect() once the reset is over */
+    if (st->flags & SIM_USB_RESET) {
+        host.resetting = 1;
+        sim_usb_reset();
+        return;
+    }
+
+    host.setup = st->setup;
+    if (st->flags & SIM_USB_CFG_LEN) {
+        if (!host.cfg_len) {
+            run_end("%s: no configuration header read before", st->what);
+            return;
+        }
+        host.setup.wLength = host.cfg_len;
+    }
+    if (st->flags & SIM_USB_REPORT_LEN) {
+        if (!host.report_len) {
+            run_end("%s: no HID descriptor seen before", st->what);
+            return;
+        }
+        host.setup.wLength += host.report_len;
+    }
+
+    if (!host.run->t_first) {
+        host.run->t_first = sim_now();
+    }
+    host.t_xfer = sim_now();
+    sim_usb_control(&host.setup, NULL, xfer_done, NULL);
+}
+
+static void script_start(const struct sim_usb_script *script, struct sim_usb_run *run,
+                         sim_fn done, void *arg, uint64_t t_start) {
+
+    if (host.script) {
+        sim_stop("usb: a script started while another one is running");
+    }
+
+    memset(run, 0, sizeof(*run));
+    run->t_start = t_start;
+
+    host.script    = script;
+    host.run       = run;
+    host.done      = done;
+    host.arg       = arg;
+    host.step      = 0;
+    host.resetting = 0;
+
+    step_next();
+}
+
+/* after the attach reset, and after every reset a script asks for */
+static void on_connect(void *arg) {
+
+    (void) arg;
+
+    if (host.resetting && host.script) {
+        host.resetting = 0;
+        host.step++;
+        step_next();
+        return;
+    }
+
+    /* a new device as far as the host knows */
+    host.cfg_len    = 0;
+    host.report_len = 0;
+    host.cfg_attr   = 0;
+    script_start(host.enum_script, host.enum_run, host.enum_done, host.enum_arg,
+                 sim_usb_stats.t_connect);
+}
+
+void sim_usb_enumerate(const struct sim_usb_script *script, struct sim_usb_run *run,
+                       sim_fn done, void *arg) {
+
+    host.enum_script = script;
+    host.enum_run    = run;
+    host.enum_done   = done;
+    host.enum_arg    = arg;
+
+    counters_mark();
+    sim_usb_on_connect(on_connect, NULL);
+}
+
+void sim_usb_script_run(const struct sim_usb_script *script, struct sim_usb_run *run,
+                        sim_fn done, void *arg) {
+
+    counters_mark();
+    script_start(script, run, done, arg, sim_now());
+}
+
+static void suspend_feature_done(void *arg, int result, const uint8_t *data, uint16_t len) {
+
+    (void) arg;
+    (void) data;
+    (void) len;
+
+    if (sim_cfg.verbose) {
+        fprintf(stderr, "%10.3f ms  %-22s -> %s\n", sim_now() / 1e6, "remote wakeup on",
+                result_name(result));
+    }
+    sim_usb_bus_suspend();
+}
+
+/* what linux and windows do before a suspend: remote wakeup on if the
+ * configuration said the device has it, then the bus goes idle
+ */
+void sim_usb_suspend(void) {
+
+    static const struct sim_usb_setup set_feature = {
+        0x00, REQ_SET_FEATURE, FEAT_REMOTE_WAKEUP, 0x0000, 0,
+    };
+
+    if (host.cfg_attr & CFG_ATTR_REMOTE_WAKEUP) {
+        sim_usb_control(&set_feature, NULL, suspend_feature_done, NULL);
+        return;
+    }
+    sim_usb_bus_suspend();
+}
+
+void sim_usb_run_print(const char *label, const struct sim_usb_run *run) {
+
+    if (!run->ok) {
+        fprintf(stderr, "%-10s FAILED at step %u, %s\n", label, run->step, run->why);
+    }
+    else if (run->t_configured) {
+        fprintf(stderr, "%-10s configured %.3f ms after connect, %.3f ms after the first setup\n",
+                label, (run->t_configured - run->t_start) / 1e6,
+                (run->t_configured - run->t_first) / 1e6);
+    }
+    else {
+        fprintf(stderr, "%-10s done in %.3f ms\n", label, (run->t_end - run->t_start) / 1e6);
+    }
+    fprintf(stderr, "%-10s %.3f ms in transfers, setups %llu, usbd isrs %llu, dma %llu, "
+                    "ep0 in %llu, naks %llu, zlps %llu, stalls %llu\n",
+            "", run->xfer_ns / 1e6, (unsigned long long) run->setups,
+            (unsigned long long) run->isrs, (unsigned long long) run->dma,
+            (unsigned long long) run->ep0_in, (unsigned long long) run->naks,
+            (unsigned long long) run->zlps, (unsigned long long) run->stalls);
+}
+
+/* note 1 : what a run counts
+ *
+ *          time from the pull-up (or VBUS coming back) to SET_CONFIGURATION's
+ *          status stage, most of which is the host's own debounce and reset
+ *          waits, so the first setup is given too. the time inside transfers
+ *          is what the device's answers cost, NAKed tokens included, and
+ *          moves when the firmware gets slower. USBD interrupts, EasyDMA
+ *          starts, data/zero length packets and stalls are the ones since the
+ *          run before ended, or since sim_usb_enumerate() for the first, so the
+ *          attach reset is counted with the enumeration it starts.
+ *
+ *          every descriptor that comes back is held to its own length: bLength,
+ *          or wTotalLength for the configuration, cut to wLength. a missing zero
+ *          length packet shows up as a timeout (the host keeps asking), an extra
+ *          or a short one as the wrong length.
+ *
+ * note 2 : the scripts
+ *
+ *          linux as usbcore and usbhid do it: the 64 byte probe (usb_ep0.c note
+ *          3) and a second reset, the configuration read twice (header, then
+ *          wTotalLength), strings at 255 bytes, SET_CONFIGURATION, SET_IDLE and
+ *          the report descriptor at its exact length. windows as it shows up on
+ *          a bus analyser: the whole configuration at 255, the MS OS string at
+ *          0xEE and the device qualifier (both may stall, ours do), the device
+ *          and configuration again, GET_STATUS before SET_CONFIGURATION, and the
+ *          report descriptor asked for with 64 bytes to spare. the order moves a
+ *          little between versions, what matters is the mix of lengths.
+ */
@@ -0,0 +1,125 @@
+/********************************************************************
+ ** file         : hidraw-rate.c
+ ** description  : count HID reports/s the host receives from the dongle
+ **
+ ** compilation  : gcc hidraw-rate.c -o hidraw-rate
+ **
+ ** permissions  : read access to the hidraw node, e.g. add to the rules file
+ **                KERNEL=="hidraw*", ATTRS{idVendor}=="1915", ATTRS{idProduct}=="572b", MODE="0666"
+ **
+ ** usage        : ./hidraw-rate /dev/hidrawN [seconds] [trace.txt]
+ **
+ **                prints one line per second: total reports, and how many
+ **                of those carried motion/wheel (the rest are button-only
+ **                or idle repeats). leave the mouse still, then move it,
+ **                to compare idle vs moving interrupt load.
+ **
+ **                with a trace file, every report also goes there as
+ **                `t_us dx dy buttons wheel`, what fw/sim's -m replays
+ **
+ *******************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+/* matches `struct hid_mouse_report` in fw/dongle/include/hid_mouse.h */
+#define REPORT_SIZE 8
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+
+    int seconds = 10;
+
+    if (argc < 2 || argc > 4) {
+        fprintf(stderr, "Usage: ./hidraw-rate /dev/hidrawN [seconds] [trace.txt]\n");
+        return 1;
+    }
+    if (argc >= 3) {
+        seconds = atoi(argv[2]);
+    }
+
+    FILE *trace = NULL;
+    if (argc == 4) {
+        trace = fopen(argv[3], "w");
+        if (!trace) {
+            perror(argv[3]);
+            return 1;
+        }
+        fprintf(trace, "# t_us dx dy buttons wheel, from %s\n", argv[1]);
+    }
+
+    int fd = open(argv[1], O_RDONLY);
+    if (fd < 0) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    uint8_t buf[64];
+    uint32_t reports = 0;
+    uint32_t motion  = 0;
+    uint32_t total   = 0;
+    double   start   = now_s();
+    double   mark    = start;
+
+    printf("%6s %10s %10s\n", "t(s)", "reports/s", "motion/s");
+
+    while (now_s() - start < seconds) {
+
+        int ret = poll(&pfd, 1, 100);
+        if (ret < 0) {
+            perror("poll");
+            break;
+        }
+
+        if (ret > 0) {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n < 0) {
+                perror("read");
+                break;
+            }
+            if (n >= REPORT_SIZE) {
+                int16_t x     = (int16_t) (buf[1] | (buf[2] << 8));
+                int16_t y     = (int16_t) (buf[3] | (buf[4] << 8));
+                int16_t wheel = (int16_t) (buf[5] | (buf[6] << 8));
+                motion += (x || y || wheel);
+                if (trace) {
+                    fprintf(trace, "%.0f %d %d %u %d\n", (now_s() - start) * 1e6,
+                            x, y, buf[0], wheel);
+                }
+            }
+            reports++;
+        }
+
+        double t = now_s();
+        if (t - mark >= 1.0) {
+            printf("%6.1f %10.1f %10.1f\n", t - start, reports / (t - mark), motion / (t - mark));
+            fflush(stdout);
+            total  += reports;
+            reports = 0;
+            motion  = 0;
+            mark    = t;
+        }
+    }
+
+    total += reports;
+    printf("total: %u reports in %.1fs (%.1f/s)\n", total, now_s() - start,
+                                                    total / (now_s() - start));
+
+    if (trace) {
+        fclose(trace);
+    }
+    close(fd);
+    return 0;
+}
@@ -87,8 +87,11 @@ static gboolean update_vbat_label(gpointer data) {
     (void)data;
     libusb_context *ctx = NULL;
     libusb_device_handle *dev_handle = NULL;
-    uint8_t vbat_step = 0;
-    float vbat = 0;
+    struct {
+        uint16_t mv;
+        uint8_t  soc;
+        uint16_t minutes;
+    } __attribute__((packed)) bat = {0};    /* fw/mouse/include/battery.h */
     int ret;
     
     ret = libusb_init_context(&ctx, NULL, 0);
@@ -104,9 +107,9 @@ static gboolean update_vbat_label(gpointer data) {
         return G_SOURCE_CONTINUE;
     }
 
-    ret = libusb_control_transfer(dev_handle, 0xC0, 0x01, 0, 0, &vbat_step, 1, 100);
-    if (ret < 0) {
-        printf("%s\n", libusb_strerror(ret));
+    ret = libusb_control_transfer(dev_handle, 0xC0, 0x01, 0, 0, (uint8_t *) &bat, sizeof(bat), 100);
+    if (ret != sizeof(bat)) {
+        printf("%s\n", ret < 0 ? libusb_strerror(ret) : "short battery status");
         gtk_label_set_text(GTK_LABEL(bat_label), "Battery: N/A");
         libusb_close(dev_handle);
         libusb_exit(ctx);
@@ -116,12 +119,15 @@ static gboolean update_vbat_label(gpointer data) {
     libusb_close(dev_handle);
     libusb_exit(ctx);
 
-    /* mask out button bits [1:0], convert to V */
-    vbat_step = (vbat_step & 0b11111100) >> 2;
-    vbat = ((vbat_step + 1) * 1.2 * 5) / 64;
-
+    /* calibrated on the mouse, 0mV until its first reading */
     char label_text[64];
-    snprintf(label_text, sizeof(label_text), "Battery: %1.4fV", vbat);
+    if (!bat.mv) {
+        snprintf(label_text, sizeof(label_text), "Battery: —");
+    }
+    else {
+        snprintf(label_text, sizeof(label_text), "Battery: %u%% (%1.2fV, %uh left)",
+                 bat.soc, bat.mv / 1000.0, bat.minutes / 60);
+    }
     gtk_label_set_text(GTK_LABEL(bat_label), label_text);
 
     /* keep ticking */
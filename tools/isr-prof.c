@@ -0,0 +1,118 @@
+/********************************************************************
+ ** file         : isr-prof.c
+ ** description  : decode an isr profiler table dumped from the target
+ **
+ ** compilation  : gcc isr-prof.c -o isr-prof
+ **
+ ** usage        : ./isr-prof prof.bin
+ **
+ **                prof.bin comes from fw/mouse/prof.exp (raw copy of the
+ **                `isr_prof` symbol of a `make PROF=1` build). the dongle
+ **                prints the same table over RTT by itself.
+ **
+ *******************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+/* matches fw/{dongle,mouse}/include/isr_prof.h */
+#define ISR_PROF_MAGIC  0x50525349
+#define ISR_PROF_BINS   16
+
+struct isr_prof_entry {
+    char     name[8];
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t sum;
+    uint32_t sum_n;
+    uint32_t preempted;
+    uint32_t preempt_cycles;
+    uint32_t lat_n;
+    uint32_t lat_sum;
+    uint32_t lat_max;
+    uint16_t hist[ISR_PROF_BINS];
+};
+
+struct isr_prof_header {
+    uint32_t magic;
+    uint16_t count;
+    uint16_t entry_size;
+    uint32_t cpu_hz;
+};
+
+int main(int argc, char **argv) {
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: ./isr-prof prof.bin\n");
+        return 1;
+    }
+
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    uint8_t buf[4096];
+    size_t  n = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+
+    struct isr_prof_header hdr;
+    if (n < sizeof(hdr)) {
+        fprintf(stderr, "Error: file too short\n");
+        return 1;
+    }
+    memcpy(&hdr, buf, sizeof(hdr));
+
+    if (hdr.magic != ISR_PROF_MAGIC) {
+        fprintf(stderr, "Error: bad magic 0x%08X, not a PROF=1 build?\n", hdr.magic);
+        return 1;
+    }
+    if (hdr.entry_size != sizeof(struct isr_prof_entry) ||
+        n < sizeof(hdr) + (size_t) hdr.count * hdr.entry_size) {
+        fprintf(stderr, "Error: table layout doesn't match this decoder\n");
+        return 1;
+    }
+
+    double us = 1e6 / hdr.cpu_hz;
+
+    printf("%-8s %9s %8s %8s %8s %8s %10s %8s %8s\n", "isr", "count", "min(us)", "mean(us)",
+           "max(us)", "preempt", "lost(us)", "lat(us)", "latmax");
+
+    for (int i = 0; i < hdr.count; i++) {
+
+        struct isr_prof_entry e;
+        memcpy(&e, buf + sizeof(hdr) + i * hdr.entry_size, sizeof(e));
+
+        char name[9] = {0};
+        memcpy(name, e.name, sizeof(e.name));
+
+        printf("%-8s %9u %8.2f %8.2f %8.2f %8u %10.1f %8.2f %8.2f\n", name, e.count,
+               e.count ? e.min * us : 0.0,
+               e.sum_n ? (double) e.sum / e.sum_n * us : 0.0,
+               e.max * us, e.preempted, e.preempt_cycles * us,
+               e.lat_n ? (double) e.lat_sum / e.lat_n * us : 0.0,
+               e.lat_max * us);
+    }
+
+    printf("\nself time histogram, log2 cycles (bin i = [2^i, 2^(i+1)))\n");
+    for (int i = 0; i < hdr.count; i++) {
+
+        struct isr_prof_entry e;
+        memcpy(&e, buf + sizeof(hdr) + i * hdr.entry_size, sizeof(e));
+
+        char name[9] = {0};
+        memcpy(name, e.name, sizeof(e.name));
+
+        printf("%-8s", name);
+        for (int j = 0; j < ISR_PROF_BINS; j++) {
+            printf(" %5u", e.hist[j]);
+        }
+        printf("\n");
+    }
+
+    return 0;
+}
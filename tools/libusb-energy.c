@@ -0,0 +1,144 @@
+/**************************************************************************************************
+ ** file         : libusb-energy.c
+ ** description  : print the mouse's state residency and mean current from the energy records
+ **                it sends through the dongle, and the battery life that comes to
+ **
+ ** compilation  : gcc libusb-energy.c -lusb-1.0 -o libusb-energy
+ **
+ ** permissions  : create a rules file, e.g., `/etc/udev/rules.d/99-hiiri.rules`
+ **                and write:
+ **                SUBSYSTEM=="usb", ATTR{idVendor}=="1915", ATTR{idProduct}=="572b", MODE="0666"
+ **
+ ** usage        : ./libusb-energy [capacity_mAh]
+ **
+ **                waits for the next record (the mouse sends one about every 10s of
+ **                link time) and reports the interval between the two, or boot to
+ **                the first one if there was none yet. the charge is from the
+ **                mouse's current table (fw/mouse/src/energy.c note 2), not a
+ **                measurement
+ **
+ *************************************************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <libusb-1.0/libusb.h>
+
+#define WAIT_S  60
+
+/* matches fw/mouse/include/energy.h */
+#define ENERGY_STATES   8
+#define ENERGY_CPU      4
+
+struct energy_record {
+    uint32_t ms[ENERGY_STATES];
+    uint32_t charge_uc;
+} __attribute__((packed));
+
+static const char *state_names[ENERGY_STATES] = {
+    "tx", "rx", "ramp", "spi", "cpu", "wfi", "idle", "sleep"
+};
+
+static const char *profiles[] = { "competitive", "balanced", "eco" };
+
+/* cpu, wfi, idle and sleep add up to the uptime, the rest overlaps them */
+static uint32_t uptime_ms(const struct energy_record *r) {
+
+    uint32_t ms = 0;
+    for (int i = ENERGY_CPU; i < ENERGY_STATES; i++) {
+        ms += r->ms[i];
+    }
+    return ms;
+}
+
+static int read_record(libusb_device_handle *dev_handle, struct energy_record *r) {
+
+    int ret = libusb_control_transfer(dev_handle, 0b11000000, 0x06, 0, 0,
+                                      (uint8_t *) r, sizeof(*r), 100);
+    if (ret < 0) {
+        fprintf(stderr, "Error: control transfer error: %s\n", libusb_strerror(ret));
+        return -1;
+    }
+    if (ret != sizeof(*r)) {
+        fprintf(stderr, "Error: short record, %d bytes (old dongle firmware?)\n", ret);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+
+    libusb_context *ctx = NULL;
+    libusb_device_handle *dev_handle = NULL;
+    struct energy_record first = {0};
+    struct energy_record next  = {0};
+    uint8_t profile = 0xFF;
+    double capacity_mah = 0;
+    int ret;
+
+    if (argc > 1) {
+        capacity_mah = atof(argv[1]);
+        if (capacity_mah <= 0) {
+            fprintf(stderr, "Usage: %s [capacity_mAh]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    ret = libusb_init_context(&ctx, NULL, 0);
+    if (ret < 0) {
+        fprintf(stderr, "Failed to initialize libusb\n");
+        return 1;
+    }
+
+    dev_handle = libusb_open_device_with_vid_pid(ctx, 0x1915, 0x572B);
+    if (dev_handle == NULL) {
+        fprintf(stderr, "Error: cannot open device 0x1915:0x572B\n");
+        libusb_exit(ctx);
+        return 1;
+    }
+
+    libusb_control_transfer(dev_handle, 0b11000000, 0x05, 0, 0, &profile, 1, 100);
+
+    ret = read_record(dev_handle, &first);
+    for (int s = 0; !ret && s < WAIT_S; s++) {
+        sleep(1);
+        ret = read_record(dev_handle, &next);
+        if (!ret && uptime_ms(&next) != uptime_ms(&first)) {
+            break;
+        }
+    }
+
+    libusb_close(dev_handle);
+    libusb_exit(ctx);
+
+    if (ret) {
+        return 1;
+    }
+
+    /* a reboot of the mouse restarts its counts */
+    uint32_t up = uptime_ms(&next);
+    if (up <= uptime_ms(&first)) {
+        fprintf(stderr, "Error: no new record in %ds (mouse asleep or out of range?)\n", WAIT_S);
+        return 1;
+    }
+    int since_boot = uptime_ms(&first) == 0;
+    up -= uptime_ms(&first);
+
+    printf("profile: %s\n", profile < 3 ? profiles[profile] : "?");
+    printf("%s: %.1f s\n", since_boot ? "boot to the first record" : "between records", up / 1e3);
+    for (int i = 0; i < ENERGY_STATES; i++) {
+        uint32_t ms = next.ms[i] - first.ms[i];
+        printf("  %-6s %10.1f ms  %5.1f%%\n", state_names[i], (double) ms, 100.0 * ms / up);
+    }
+
+    /* uC / ms = mA */
+    double ma = (double) (next.charge_uc - first.charge_uc) / up;
+    printf("mean current: %.3f mA\n", ma);
+    if (capacity_mah) {
+        printf("battery life: %.1f h at this mix, %.0f mAh\n", capacity_mah / ma, capacity_mah);
+    }
+
+    return 0;
+}
@@ -0,0 +1,203 @@
+/**************************************************************************************************
+ ** file         : libusb-ep0-stress.c
+ ** description  : keep the dongle's ep0 busy with descriptor requests (what enumeration
+ **                does, back to back) and watch what it does to the radio turnaround
+ **
+ ** compilation  : gcc libusb-ep0-stress.c -lusb-1.0 -o libusb-ep0-stress
+ **
+ ** permissions  : create a rules file, e.g., `/etc/udev/rules.d/99-hiiri.rules`
+ **                and write:
+ **                SUBSYSTEM=="usb", ATTR{idVendor}=="1915", ATTR{idProduct}=="572b", MODE="0666"
+ **
+ ** usage        : ./libusb-ep0-stress [-t seconds] [-r]
+ **
+ **                -t  load duration, default 10s
+ **                -r  also reset the device every second, the host re-enumerates it
+ **
+ **                the mouse has to be on and moving (or at least awake), the
+ **                turnaround only gets sampled for packets it sends. the idle
+ **                baseline comes first, then one line per second under load.
+ **                with a `make PROF=1` dongle, the RTT isr dump has the radio
+ **                isr's entry latency (lat/latmax) for the same run
+ **
+ *************************************************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <libusb-1.0/libusb.h>
+
+/* matches fw/dongle/include/link_stats.h */
+#define HIST_BINS       16
+#define TURN_MIN_US     40
+#define TURN_BIN_US     8
+
+struct link_stats_pct {
+    uint16_t p50;
+    uint16_t p90;
+    uint16_t p99;
+    uint16_t max;
+} __attribute__((packed));
+
+struct link_stats_report {
+    uint16_t window_ms;
+    uint16_t rx_ok;
+    uint16_t rx_crc_err;
+    uint16_t missed;
+    uint16_t resync;
+    uint16_t turnarounds;
+    struct link_stats_pct rssi;
+    struct link_stats_pct turnaround;
+    uint16_t rssi_hist[HIST_BINS];
+    uint16_t turnaround_hist[HIST_BINS];
+} __attribute__((packed, aligned(4)));
+
+static double now_s(void) {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int read_stats(libusb_device_handle *dev, struct link_stats_report *stats) {
+
+    int ret = libusb_control_transfer(dev, 0b11000000, 0x03, 0, 0,
+                                      (uint8_t *) stats, sizeof(*stats), 100);
+    if (ret < 0) {
+        fprintf(stderr, "Error: link stats: %s\n", libusb_strerror(ret));
+    }
+    return ret;
+}
+
+static void print_stats(const char *label, const struct link_stats_report *s) {
+
+    printf("%-8s rx %5u  crc %4u  missed %4u  turnaround p50 %3u  p99 %3u  max %3u us\n",
+           label, s->rx_ok, s->rx_crc_err, s->missed,
+           s->turnaround.p50, s->turnaround.p99, s->turnaround.max);
+}
+
+/* one round of what the host asks for while enumerating */
+static int ep0_round(libusb_device_handle *dev) {
+
+    static const struct {
+        uint8_t  bmRequestType;
+        uint16_t wValue;
+        uint16_t wIndex;
+        uint16_t wLength;
+    } reqs[] = {
+        { 0x80, 0x0100, 0,      18  },  /* device                       */
+        { 0x80, 0x0200, 0,      255 },  /* configuration, multi-packet  */
+        { 0x80, 0x0300, 0,      255 },  /* string 0..3                  */
+        { 0x80, 0x0301, 0x0409, 255 },
+        { 0x80, 0x0302, 0x0409, 255 },
+        { 0x80, 0x0303, 0x0409, 255 },
+        { 0x81, 0x2200, 0,      255 },  /* HID report descriptor        */
+    };
+
+    uint8_t buf[255];
+    int n = 0;
+
+    for (size_t i = 0; i < sizeof(reqs) / sizeof(reqs[0]); i++) {
+        int ret = libusb_control_transfer(dev, reqs[i].bmRequestType, LIBUSB_REQUEST_GET_DESCRIPTOR,
+                                          reqs[i].wValue, reqs[i].wIndex, buf, reqs[i].wLength, 100);
+        if (ret < 0) {
+            return ret;
+        }
+        n++;
+    }
+    return n;
+}
+
+int main(int argc, char **argv) {
+
+    libusb_context *ctx = NULL;
+    libusb_device_handle *dev_handle = NULL;
+    struct link_stats_report base, stats;
+    int seconds = 10;
+    int reset   = 0;
+    int rc      = 1;
+    int ret;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            seconds = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-r")) {
+            reset = 1;
+        }
+        else {
+            fprintf(stderr, "Usage: ./libusb-ep0-stress [-t seconds] [-r]\n");
+            return 1;
+        }
+    }
+
+    ret = libusb_init_context(&ctx, NULL, 0);
+    if (ret < 0) {
+        fprintf(stderr, "Failed to initialize libusb\n");
+        return 1;
+    }
+
+    dev_handle = libusb_open_device_with_vid_pid(ctx, 0x1915, 0x572B);
+    if (dev_handle == NULL) {
+        fprintf(stderr, "Error: cannot open device 0x1915:0x572B\n");
+        libusb_exit(ctx);
+        return 1;
+    }
+
+    /* a full window with nothing but the host's own polling */
+    sleep(1);
+    if (read_stats(dev_handle, &base) < 0) {
+        goto out;
+    }
+    print_stats("idle", &base);
+
+    uint16_t worst_max = 0;
+    uint16_t worst_p99 = 0;
+    long     xfers     = 0;
+
+    for (int s = 0; s < seconds; s++) {
+
+        double end = now_s() + 1.0;
+
+        if (reset && libusb_reset_device(dev_handle) < 0) {
+            fprintf(stderr, "Error: reset failed, device re-enumerated with a new handle?\n");
+            goto out;
+        }
+
+        while (now_s() < end) {
+            ret = ep0_round(dev_handle);
+            if (ret < 0) {
+                fprintf(stderr, "Error: control transfer error: %s\n", libusb_strerror(ret));
+                goto out;
+            }
+            xfers += ret;
+        }
+
+        if (read_stats(dev_handle, &stats) < 0) {
+            goto out;
+        }
+
+        char label[16];
+        snprintf(label, sizeof(label), "load %d", s + 1);
+        print_stats(label, &stats);
+
+        if (stats.turnaround.max > worst_max) worst_max = stats.turnaround.max;
+        if (stats.turnaround.p99 > worst_p99) worst_p99 = stats.turnaround.p99;
+    }
+
+    printf("\n%ld control transfers in %ds\n", xfers, seconds);
+    printf("turnaround  idle: p99 %u  max %u us   load: p99 %u  max %u us\n",
+           base.turnaround.p99, base.turnaround.max, worst_p99, worst_max);
+    printf("(bin upper edges; %u means off the top of the histogram)\n",
+           TURN_MIN_US + HIST_BINS * TURN_BIN_US);
+    rc = 0;
+
+out:
+    libusb_close(dev_handle);
+    libusb_exit(ctx);
+    return rc;
+}
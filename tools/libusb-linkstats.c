@@ -0,0 +1,143 @@
+/**************************************************************************************************
+ ** file         : libusb-linkstats.c
+ ** description  : print the dongle's rolling-window radio link and motion latency
+ **                statistics (last ~1s)
+ **
+ ** compilation  : gcc libusb-linkstats.c -lusb-1.0 -o libusb-linkstats
+ **
+ ** permissions  : create a rules file, e.g., `/etc/udev/rules.d/99-hiiri.rules`
+ **                and write:
+ **                SUBSYSTEM=="usb", ATTR{idVendor}=="1915", ATTR{idProduct}=="572b", MODE="0666"
+ **
+ ** usage        : ./libusb-linkstats [-h]
+ **
+ **                -h also dumps the RSSI, turnaround and latency histograms
+ **
+ *************************************************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <libusb-1.0/libusb.h>
+
+/* matches fw/dongle/include/link_stats.h */
+#define HIST_BINS       16
+#define RSSI_MIN        30
+#define RSSI_BIN        5
+#define TURN_MIN_US     40
+#define TURN_BIN_US     8
+#define STAGES          5
+
+struct link_stats_pct {
+    uint16_t p50;
+    uint16_t p90;
+    uint16_t p99;
+    uint16_t max;
+} __attribute__((packed));
+
+struct link_stats_report {
+    uint16_t window_ms;
+    uint16_t rx_ok;
+    uint16_t rx_crc_err;
+    uint16_t missed;
+    uint16_t resync;
+    uint16_t turnarounds;
+    struct link_stats_pct rssi;
+    struct link_stats_pct turnaround;
+    uint16_t rssi_hist[HIST_BINS];
+    uint16_t turnaround_hist[HIST_BINS];
+} __attribute__((packed, aligned(4)));
+
+struct link_stats_latency_report {
+    uint16_t window_ms;
+    uint16_t samples;
+    struct link_stats_pct stage[STAGES];
+    uint16_t hist[STAGES][HIST_BINS];
+} __attribute__((packed, aligned(4)));
+
+static const char *stage_names[STAGES] = {
+    "sensor->tx", "tx->rx", "rx->arm", "arm->IN", "total"
+};
+
+/* width = 0: log2 bins */
+static void print_hist(const char *name, const uint16_t *hist, int min, int width) {
+
+    printf("%s\n", name);
+    for (int i = 0; i < HIST_BINS; i++) {
+        int lo = width ? (min + i * width)       : (i ? (1 << i) : 0);
+        int hi = width ? (min + (i + 1) * width) : (2 << i);
+        printf("  %5d..%-5d %6u\n", lo, hi, hist[i]);
+    }
+}
+
+int main(int argc, char **argv) {
+
+    libusb_context *ctx = NULL;
+    libusb_device_handle *dev_handle = NULL;
+    struct link_stats_report stats = {0};
+    struct link_stats_latency_report lat = {0};
+    int ret;
+
+    int hist = (argc == 2) && !strcmp(argv[1], "-h");
+
+    ret = libusb_init_context(&ctx, NULL, 0);
+    if (ret < 0) {
+        fprintf(stderr, "Failed to initialize libusb\n");
+        return 1;
+    }
+
+    dev_handle = libusb_open_device_with_vid_pid(ctx, 0x1915, 0x572B);
+    if (dev_handle == NULL) {
+        fprintf(stderr, "Error: cannot open device 0x1915:0x572B\n");
+        libusb_exit(ctx);
+        return 1;
+    }
+
+    ret = libusb_control_transfer(dev_handle, 0b11000000, 0x03, 0, 0,
+                                  (uint8_t *) &stats, sizeof(stats), 100);
+    if (ret >= 0) {
+        ret = libusb_control_transfer(dev_handle, 0b11000000, 0x04, 0, 0,
+                                      (uint8_t *) &lat, sizeof(lat), 100);
+    }
+    if (ret < 0) {
+        fprintf(stderr, "Error: control transfer error: %s\n", libusb_strerror(ret));
+        libusb_close(dev_handle);
+        libusb_exit(ctx);
+        return 1;
+    }
+
+    libusb_close(dev_handle);
+    libusb_exit(ctx);
+
+    uint32_t slots = stats.rx_ok + stats.rx_crc_err + stats.missed;
+
+    printf("window:     %ums\n", stats.window_ms);
+    printf("rx ok:      %u\n", stats.rx_ok);
+    printf("crc fail:   %u\n", stats.rx_crc_err);
+    printf("missed:     %u\n", stats.missed);
+    printf("resync:     %u\n", stats.resync);
+    if (slots) {
+        printf("loss:       %.2f%%\n", 100.0 * (stats.rx_crc_err + stats.missed) / slots);
+    }
+    printf("rssi:       p50 -%u  p90 -%u  p99 -%u  worst -%u dBm\n",
+           stats.rssi.p50, stats.rssi.p90, stats.rssi.p99, stats.rssi.max);
+    printf("turnaround: p50 %u  p90 %u  p99 %u  max %u us\n",
+           stats.turnaround.p50, stats.turnaround.p90, stats.turnaround.p99, stats.turnaround.max);
+
+    printf("latency:    %u reports, percentiles are log2 bin edges\n", lat.samples);
+    for (int i = 0; i < STAGES; i++) {
+        printf("  %-10s p50 %5u  p90 %5u  p99 %5u  max %5u us\n", stage_names[i],
+               lat.stage[i].p50, lat.stage[i].p90, lat.stage[i].p99, lat.stage[i].max);
+    }
+
+    if (hist) {
+        print_hist("rssi (-dBm)", stats.rssi_hist, RSSI_MIN, RSSI_BIN);
+        print_hist("turnaround (us)", stats.turnaround_hist, TURN_MIN_US, TURN_BIN_US);
+        for (int i = 0; i < STAGES; i++) {
+            print_hist(stage_names[i], lat.hist[i], 0, 0);
+        }
+    }
+
+    return 0;
+}
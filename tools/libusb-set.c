@@ -1,6 +1,7 @@
 /********************************************************************
  ** file         : libusb-set.c
- ** description  : set dpi and polling rate
+ ** description  : set dpi and polling rate, and optionally the power
+ **                profile (competitive, balanced or eco)
  **
  ** compilation  : gcc libusb-set.c -lusb-1.0 -o libusb-set
  **
@@ -8,7 +9,7 @@
  **                and write: 
  **                SUBSYSTEM=="usb", ATTR{idVendor}=="1915", ATTR{idProduct}=="572b", MODE="0666"
  **
- ** usage        : ./libusb-set <dpi> <binterval>
+ ** usage        : ./libusb-set <dpi> <binterval> [profile]
  **
  *******************************************************************/
 
@@ -16,8 +17,11 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <libusb-1.0/libusb.h>
 
+static const char *profiles[] = { "competitive", "balanced", "eco" };
+
 int main(int argc, char **argv) {
     
     libusb_context *ctx = NULL;
@@ -25,9 +29,10 @@ int main(int argc, char **argv) {
     int ret;
     uint16_t dpi;
     uint16_t binterval;
+    int profile = -1;
 
-    if (argc != 3) {
-        fprintf(stderr, "Usage: ./libusb-set <dpi> <binterval> \n");
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "Usage: ./libusb-set <dpi> <binterval> [competitive|balanced|eco] \n");
         return 1;
     }
     else {
@@ -35,6 +40,18 @@ int main(int argc, char **argv) {
         binterval = atoi(argv[2]);
     }
 
+    if (argc == 4) {
+        for (int i = 0; i < 3; i++) {
+            if (!strcmp(argv[3], profiles[i])) {
+                profile = i;
+            }
+        }
+        if (profile < 0) {
+            fprintf(stderr, "Error: unknown profile `%s`\n", argv[3]);
+            return 1;
+        }
+    }
+
     ret = libusb_init_context(&ctx, NULL, 0);
     if (ret < 0) {
         fprintf(stderr, "Failed to initialize libusb\n");
@@ -57,6 +74,17 @@ int main(int argc, char **argv) {
     }
 
     printf("Successfully sent `set_mousesettings` request: dpi = %d, binterval = %d\n", dpi, binterval);
+
+    if (profile >= 0) {
+        ret = libusb_control_transfer(dev_handle, 0b01000000, 0x05, profile, 0, NULL, 0, 100);
+        if (ret < 0) {
+            fprintf(stderr, "Error: control transfer error: %s\n", libusb_strerror(ret));
+            libusb_close(dev_handle);
+            libusb_exit(ctx);
+            return 1;
+        }
+        printf("Successfully sent `set_profile` request: %s\n", profiles[profile]);
+    }
     libusb_close(dev_handle);
     libusb_exit(ctx);
 
@@ -0,0 +1,117 @@
+/**************************************************************************************************
+ ** file         : libusb-telemetry.c
+ ** description  : stream link telemetry records from the dongle's vendor interface (ep2)
+ **
+ ** compilation  : gcc libusb-telemetry.c -lusb-1.0 -o libusb-telemetry
+ **
+ ** permissions  : create a rules file, e.g., `/etc/udev/rules.d/99-hiiri.rules`
+ **                and write:
+ **                SUBSYSTEM=="usb", ATTR{idVendor}=="1915", ATTR{idProduct}=="572b", MODE="0666"
+ **
+ ** usage        : ./libusb-telemetry [records]
+ **
+ **                one line per record (every 100ms), 0 = run until killed.
+ **                only interface 1 is claimed, the mouse keeps working.
+ **
+ *************************************************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <libusb-1.0/libusb.h>
+
+/* matches `struct telemetry_record` in fw/dongle/src/dongle.c */
+struct telemetry_record {
+    uint16_t seq;
+    uint16_t interval_ms;
+    uint16_t rx_ok;
+    uint16_t rx_crc_err;
+    int16_t  phase_min_us;
+    int16_t  phase_max_us;
+    uint16_t age_avg_us;
+    uint16_t age_max_us;
+    uint16_t reports;
+    uint16_t usb_dropped;
+    uint8_t  soc;
+    uint8_t  rssi_avg;
+    uint8_t  rssi_worst;
+    uint8_t  padding;
+} __attribute__((packed));
+
+int main(int argc, char **argv) {
+
+    libusb_context *ctx = NULL;
+    libusb_device_handle *dev_handle = NULL;
+    int ret;
+    int records = 0;
+
+    if (argc > 2) {
+        fprintf(stderr, "Usage: ./libusb-telemetry [records]\n");
+        return 1;
+    }
+    if (argc == 2) {
+        records = atoi(argv[1]);
+    }
+
+    ret = libusb_init_context(&ctx, NULL, 0);
+    if (ret < 0) {
+        fprintf(stderr, "Failed to initialize libusb\n");
+        return 1;
+    }
+
+    dev_handle = libusb_open_device_with_vid_pid(ctx, 0x1915, 0x572B);
+    if (dev_handle == NULL) {
+        fprintf(stderr, "Error: cannot open device 0x1915:0x572B\n");
+        libusb_exit(ctx);
+        return 1;
+    }
+
+    ret = libusb_claim_interface(dev_handle, 1);
+    if (ret < 0) {
+        fprintf(stderr, "Error: cannot claim interface 1: %s\n", libusb_strerror(ret));
+        libusb_close(dev_handle);
+        libusb_exit(ctx);
+        return 1;
+    }
+
+    printf("%5s %6s %6s %6s %13s %13s %6s %6s %5s %7s\n",
+           "seq", "ms", "rx_ok", "crc", "phase(us)", "age(us)", "rpt", "drop", "bat%", "rssi");
+
+    uint16_t last_seq = 0;
+    int first = 1;
+
+    for (int n = 0; (records == 0) || (n < records); n++) {
+
+        struct telemetry_record rec;
+        int got = 0;
+
+        ret = libusb_interrupt_transfer(dev_handle, 0x82, (uint8_t *) &rec, sizeof(rec), &got, 1000);
+        if (ret < 0) {
+            fprintf(stderr, "Error: interrupt transfer error: %s\n", libusb_strerror(ret));
+            break;
+        }
+        if (got != sizeof(rec)) {
+            fprintf(stderr, "Error: short record (%d bytes)\n", got);
+            continue;
+        }
+
+        if (!first && (uint16_t) (rec.seq - last_seq) != 1) {
+            printf("-- %u record(s) missed\n", (uint16_t) (rec.seq - last_seq - 1));
+        }
+        first    = 0;
+        last_seq = rec.seq;
+
+        printf("%5u %6u %6u %6u %6d/%-6d %6u/%-6u %6u %6u %5u -%u/-%u\n",
+               rec.seq, rec.interval_ms, rec.rx_ok, rec.rx_crc_err,
+               rec.phase_min_us, rec.phase_max_us, rec.age_avg_us, rec.age_max_us,
+               rec.reports, rec.usb_dropped, rec.soc, rec.rssi_avg, rec.rssi_worst);
+        fflush(stdout);
+    }
+
+    libusb_release_interface(dev_handle, 1);
+    libusb_close(dev_handle);
+    libusb_exit(ctx);
+
+    return 0;
+}
@@ -1,6 +1,7 @@
 /**************************************************************************************************
  ** file         : libusb-vbat.c
- ** description  : print current battery voltage of connected mouse
+ ** description  : print the connected mouse's battery voltage, state of charge and
+ **                time left, calibrated on the mouse (fw/mouse/src/battery.c)
  **
  ** compilation  : gcc libusb-vbat.c -lusb-1.0 -o libusb-vbat
  **
@@ -18,13 +19,19 @@
 #include <stdlib.h>
 #include <libusb-1.0/libusb.h>
 
+/* matches fw/mouse/include/battery.h */
+struct battery_status {
+    uint16_t mv;
+    uint8_t  soc;
+    uint16_t minutes;
+} __attribute__((packed));
+
 int main(int argc, char **argv) {
     
     libusb_context *ctx = NULL;
     libusb_device_handle *dev_handle = NULL;
     int ret;
-    uint8_t vbat_step = 0;
-    uint16_t vbat_mv = 0;
+    struct battery_status bat = {0};
 
     ret = libusb_init_context(&ctx, NULL, 0);
     if (ret < 0) {
@@ -39,7 +46,8 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    ret = libusb_control_transfer(dev_handle, 0b11000000, 0x01, 0, 0, &vbat_step, 1, 100);
+    ret = libusb_control_transfer(dev_handle, 0b11000000, 0x01, 0, 0,
+                                  (uint8_t *) &bat, sizeof(bat), 100);
     if (ret < 0) {
         fprintf(stderr, "Error: control transfer error: %s\n", libusb_strerror(ret));
         libusb_close(dev_handle);
@@ -50,13 +58,25 @@ int main(int argc, char **argv) {
     libusb_close(dev_handle);
     libusb_exit(ctx);
 
-    /* mask out button bits [1:0] */
-    vbat_step = (vbat_step & 0b11111100) >> 2;
-    printf("vbat_step: %d\n", vbat_step);
+    if (ret != sizeof(bat)) {
+        fprintf(stderr, "Error: %d bytes, expected %zu (old dongle firmware?)\n", ret, sizeof(bat));
+        return 1;
+    }
 
-    /* convert ref ladder step to mV */
-    vbat_mv = ((vbat_step + 1) * 1200U * 5U) / 64U;
-    printf("vbat_mv: %dmV\n", vbat_mv);
+    /* the mouse sends it about every 10s */
+    if (!bat.mv) {
+        printf("no reading yet\n");
+        return 0;
+    }
+
+    printf("vbat_mv: %umV\n", bat.mv);
+    printf("soc: %u%%\n", bat.soc);
+    if (bat.minutes == 0xFFFF) {
+        printf("time left: > 45 days\n");
+    }
+    else {
+        printf("time left: %uh %02um\n", bat.minutes / 60, bat.minutes % 60);
+    }
 
     return 0;
 }
@@ -0,0 +1,77 @@
+/********************************************************************
+ ** file         : trace-decode.c
+ ** description  : decode the dongle's deferred trace from an RTT capture
+ **
+ ** compilation  : gcc trace-decode.c -o trace-decode
+ **
+ ** usage        : ./trace-decode telnet.txt
+ **
+ **                telnet.txt comes from fw/dongle/log.exp on a `make DBG=1`
+ **                build (`./log.exp -d trace.txt` runs this for you).
+ **                trace lines become `time  event`, anything else is
+ **                passed through as is
+ **
+ *******************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../fw/dongle/include/trace_events.h"
+
+#define TRACE_EVENT_FMT(id, ph, track, fmt)  fmt,
+
+static const char *formats[] = {
+    TRACE_EVENTS(TRACE_EVENT_FMT)
+};
+
+int main(int argc, char **argv) {
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: ./trace-decode telnet.txt\n");
+        return 1;
+    }
+
+    FILE *f = fopen(argv[1], "r");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    char     line[512];
+    uint64_t now   = 0;     /* unwrapped TIMER4 */
+    uint32_t last  = 0;
+    int      first = 1;
+
+    while (fgets(line, sizeof(line), f)) {
+
+        uint32_t ts, id_a0, a1, a2;
+        int      len = 0;
+
+        if (sscanf(line, "#%8x%8x%8x%8x%n", &ts, &id_a0, &a1, &a2, &len) != 4 || len != 33) {
+            fputs(line, stdout);
+            continue;
+        }
+
+        /* TIMER4 wraps every ~71min, fine as long as something gets traced in between */
+        now  += first ? 0 : (uint32_t) (ts - last);
+        last  = ts;
+        first = 0;
+
+        uint32_t id = id_a0 & 0xFF;
+        uint32_t a0 = id_a0 >> 8;
+
+        printf("%12.3f ms  ", now * 1e3 / TRACE_TICK_HZ);
+        if (id < sizeof(formats) / sizeof(formats[0])) {
+            printf(formats[id], a0, a1, a2);
+        }
+        else {
+            printf("?? event %u: %u %u %u", id, a0, a1, a2);
+        }
+        printf("\n");
+    }
+
+    fclose(f);
+    return 0;
+}
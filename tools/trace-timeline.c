@@ -0,0 +1,469 @@
+/********************************************************************
+ ** file         : trace-timeline.c
+ ** description  : put dongle and mouse traces on one timeline, as
+ **                Chrome trace event JSON (ui.perfetto.dev, chrome://tracing)
+ **
+ ** compilation  : gcc trace-timeline.c -o trace-timeline
+ **
+ ** usage        : ./trace-timeline [-d telnet.txt] [-m trace.bin] [-a us] > trace.json
+ **
+ **                -d  dongle capture, fw/dongle/log.exp on a `make DBG=2` build
+ **                -m  mouse ring dump, fw/mouse/trace.exp on a `make DBG=1` build
+ **                -a  mouse -> dongle clock offset in us, instead of working
+ **                    it out from the packet sequence numbers
+ **
+ **                PROF=1 DBG=2 builds add isr nesting. the mouse ring only
+ **                holds its last events, so capture the dongle around the
+ **                same moment (dump the mouse, then stop log.exp)
+ **
+ *******************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct event_desc {
+    const char *id;
+    char        ph;
+    const char *track;
+    const char *fmt;
+};
+
+#define TRACE_EVENT_DESC(id, ph, track, fmt)    { #id, ph, track, fmt },
+
+/* both firmwares use the same names, take them one at a time */
+#include "../fw/dongle/include/trace_events.h"
+static const struct event_desc dongle_events[] = { TRACE_EVENTS(TRACE_EVENT_DESC) };
+static const double dongle_tick_hz = TRACE_TICK_HZ;
+#undef TRACE_EVENTS_H
+#undef TRACE_EVENTS
+#undef TRACE_TICK_HZ
+
+#include "../fw/mouse/include/trace_events.h"
+static const struct event_desc mouse_events[] = { TRACE_EVENTS(TRACE_EVENT_DESC) };
+
+/* matches fw/{dongle,mouse}/include/isr_prof.h */
+static const char *dongle_isrs[] = { "radio", "usbd", "timer0", "timer1", "timer2", "swi0", "power" };
+static const char *mouse_isrs[]  = { "radio", "timer0", "timer1", "timer2", "gpiote", "qdec", "rtc1", "spim0", "comp", "swi0",
+                                     "usbd", "power" };
+
+/* matches fw/mouse/include/trace.h */
+#define TRACE_MAGIC     0x45435254
+
+struct trace_header {
+    uint32_t magic;
+    uint16_t records;
+    uint16_t record_size;
+    uint32_t tick_hz;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t dropped;
+};
+
+struct trace_record {
+    uint32_t ts;
+    uint32_t id_a0;
+    uint32_t a1;
+    uint32_t a2;
+};
+
+/* mouse TX start (TR_TX) -> dongle radio_isr (TR_RADIO_RX): fast ramp-up 40us,
+ * 16 bytes on air at 2Mbit 64us, isr entry and reply setup ~10us
+ */
+#define RX_LAG_US       114
+#define MATCH_US        60
+
+#define MAX_TRACKS      16
+
+struct event {
+    double   us;
+    uint32_t id;
+    uint32_t a0;
+    uint32_t a1;
+    uint32_t a2;
+};
+
+struct source {
+    const char              *name;
+    int                      pid;
+    const struct event_desc *desc;
+    size_t                   n_desc;
+    const char             **isrs;
+    size_t                   n_isrs;
+    struct event            *ev;
+    size_t                   n;
+    size_t                   cap;
+    double                   offset_us;
+    const char              *tracks[MAX_TRACKS];
+    int                      n_tracks;
+};
+
+/* derived counter tracks, to see jitter without reading slices */
+struct counter {
+    int         pid;
+    const char *id;
+    const char *name;
+    int         delta;          /* plot the time since the previous one, not a0 */
+};
+
+static const struct counter counters[] = {
+    { 1, "TR_RADIO_RX",        "rx interval (us)", 1 },
+    { 1, "TR_RADIO_REPLY_END", "turnaround (us)",  0 },
+    { 1, "TR_HID_IN",          "IN interval (us)", 1 },
+    { 2, "TR_TX",              "tx interval (us)", 1 },
+    { 2, "TR_SLOT",            "cc (us)",          0 },
+};
+
+static void add_event(struct source *src, const struct event *e) {
+
+    if (src->n == src->cap) {
+        src->cap = src->cap ? src->cap * 2 : 1024;
+        src->ev  = realloc(src->ev, src->cap * sizeof(*src->ev));
+        if (!src->ev) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    src->ev[src->n++] = *e;
+}
+
+/* ticks -> us, unwrapped. a backwards step is a timebase restart
+ * (mouse TIMER2 after sleep), counted as no time passing
+ */
+struct clock {
+    double   us;
+    uint32_t last;
+    int      started;
+};
+
+static double clock_us(struct clock *c, uint32_t ts, double tick_hz) {
+
+    uint32_t delta = ts - c->last;
+
+    if (!c->started || delta >= 0x80000000) {
+        delta = 0;
+    }
+    c->started = 1;
+    c->last    = ts;
+    c->us     += delta * 1e6 / tick_hz;
+
+    return c->us;
+}
+
+static void add_record(struct source *src, struct clock *c, double tick_hz,
+                       uint32_t ts, uint32_t id_a0, uint32_t a1, uint32_t a2) {
+
+    struct event e = {
+        .us = clock_us(c, ts, tick_hz),
+        .id = id_a0 & 0xFF,
+        .a0 = id_a0 >> 8,
+        .a1 = a1,
+        .a2 = a2,
+    };
+    add_event(src, &e);
+}
+
+static int load_dongle(struct source *src, const char *path) {
+
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    struct clock c = {0};
+    char line[512];
+
+    while (fgets(line, sizeof(line), f)) {
+
+        uint32_t ts, id_a0, a1, a2;
+        int      len = 0;
+
+        if (sscanf(line, "#%8x%8x%8x%8x%n", &ts, &id_a0, &a1, &a2, &len) == 4 && len == 33) {
+            add_record(src, &c, dongle_tick_hz, ts, id_a0, a1, a2);
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
+
+static int load_mouse(struct source *src, const char *path) {
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    struct trace_header hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != TRACE_MAGIC) {
+        fprintf(stderr, "Error: %s: bad magic, not a DBG=1 build?\n", path);
+        fclose(f);
+        return -1;
+    }
+    if (hdr.record_size != sizeof(struct trace_record) || hdr.records == 0) {
+        fprintf(stderr, "Error: %s: ring layout doesn't match this tool\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    struct trace_record *rec = calloc(hdr.records, sizeof(*rec));
+    if (!rec || fread(rec, sizeof(*rec), hdr.records, f) != hdr.records) {
+        fprintf(stderr, "Error: %s: file too short\n", path);
+        free(rec);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    /* oldest first, the ring overwrites once head passes records */
+    uint32_t n     = hdr.head < hdr.records ? hdr.head : hdr.records;
+    uint32_t first = hdr.head - n;
+    struct clock c = {0};
+
+    for (uint32_t i = 0; i < n; i++) {
+        const struct trace_record *r = &rec[(first + i) % hdr.records];
+        add_record(src, &c, hdr.tick_hz, r->ts, r->id_a0, r->a1, r->a2);
+    }
+
+    free(rec);
+    return 0;
+}
+
+static int find_id(const struct source *src, const char *id) {
+
+    for (size_t i = 0; i < src->n_desc; i++) {
+        if (!strcmp(src->desc[i].id, id)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* dongle RX with this seq closest to `us`, or NULL */
+static const struct event *nearest_rx(const struct source *d, int rx_id, uint8_t seq, double us) {
+
+    const struct event *best = NULL;
+
+    for (size_t i = 0; i < d->n; i++) {
+        const struct event *e = &d->ev[i];
+        if (e->id != (uint32_t) rx_id || !e->a1 || (uint8_t) e->a0 != seq) {
+            continue;
+        }
+        if (!best || abs((int) (e->us - us)) < abs((int) (best->us - us))) {
+            best = e;
+        }
+    }
+    return best;
+}
+
+/* try every dongle RX of the mouse's first TX seq as the anchor, keep the
+ * offset that lines up the most TX/RX seq pairs. seq is 8-bit, so a single
+ * pair is ambiguous, a run of them isn't
+ */
+static int align(const struct source *d, struct source *m) {
+
+    int rx_id = find_id(d, "TR_RADIO_RX");
+    int tx_id = find_id(m, "TR_TX");
+    const struct event *anchor = NULL;
+
+    for (size_t i = 0; i < m->n; i++) {
+        if (m->ev[i].id == (uint32_t) tx_id) {
+            anchor = &m->ev[i];
+            break;
+        }
+    }
+    if (rx_id < 0 || tx_id < 0 || !anchor) {
+        return -1;
+    }
+
+    int    best_score  = 0;
+    double best_offset = 0;
+
+    for (size_t i = 0; i < d->n; i++) {
+
+        const struct event *rx = &d->ev[i];
+        if (rx->id != (uint32_t) rx_id || !rx->a1 || (uint8_t) rx->a0 != (uint8_t) anchor->a0) {
+            continue;
+        }
+
+        double offset = rx->us - RX_LAG_US - anchor->us;
+        int    score  = 0;
+
+        for (size_t j = 0; j < m->n; j++) {
+            const struct event *tx = &m->ev[j];
+            if (tx->id != (uint32_t) tx_id) {
+                continue;
+            }
+            double at = tx->us + offset + RX_LAG_US;
+            const struct event *match = nearest_rx(d, rx_id, tx->a0, at);
+            if (match && abs((int) (match->us - at)) < MATCH_US) {
+                score++;
+            }
+        }
+
+        if (score > best_score) {
+            best_score  = score;
+            best_offset = offset;
+        }
+    }
+
+    if (best_score < 2) {
+        return -1;
+    }
+
+    m->offset_us = best_offset;
+    fprintf(stderr, "aligned on %d packets, mouse clock offset %.1f us\n", best_score, best_offset);
+    return 0;
+}
+
+static int track_id(struct source *src, const char *track) {
+
+    for (int i = 0; i < src->n_tracks; i++) {
+        if (!strcmp(src->tracks[i], track)) {
+            return i + 1;
+        }
+    }
+    if (src->n_tracks == MAX_TRACKS) {
+        return MAX_TRACKS;
+    }
+    src->tracks[src->n_tracks++] = track;
+    return src->n_tracks;
+}
+
+static void emit(struct source *src, int *first) {
+
+    double last_us[sizeof(counters) / sizeof(counters[0])];
+    int    have[sizeof(counters) / sizeof(counters[0])] = {0};
+
+    if (src->n == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < src->n; i++) {
+
+        const struct event *e = &src->ev[i];
+        double us = e->us + src->offset_us;
+
+        if (e->id >= src->n_desc) {
+            continue;
+        }
+
+        const struct event_desc *d = &src->desc[e->id];
+        char text[160];
+
+        if (!strcmp(d->track, "isr")) {
+            snprintf(text, sizeof(text), "%s",
+                     e->a0 < src->n_isrs ? src->isrs[e->a0] : "isr ?");
+        }
+        else {
+            snprintf(text, sizeof(text), d->fmt, e->a0, e->a1, e->a2);
+        }
+
+        printf("%s\n  {\"ph\": \"%c\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f", *first ? "" : ",",
+               d->ph, src->pid, track_id(src, d->track), us);
+        *first = 0;
+
+        if (d->ph == 'E') {
+            if (text[0] && strcmp(d->track, "isr")) {
+                printf(", \"args\": {\"end\": \"%s\"}", text);
+            }
+        }
+        else {
+            printf(", \"name\": \"%s\"", text);
+            if (d->ph == 'i') {
+                printf(", \"s\": \"t\"");
+            }
+        }
+        printf("}");
+
+        for (size_t c = 0; c < sizeof(counters) / sizeof(counters[0]); c++) {
+
+            if (counters[c].pid != src->pid || strcmp(counters[c].id, d->id)) {
+                continue;
+            }
+
+            double val = e->a0;
+            if (counters[c].delta) {
+                val = have[c] ? us - last_us[c] : -1;
+                last_us[c] = us;
+                have[c]    = 1;
+            }
+            if (val >= 0) {
+                printf(",\n  {\"ph\": \"C\", \"pid\": %d, \"ts\": %.3f, \"name\": \"%s\", "
+                       "\"args\": {\"us\": %.1f}}", src->pid, us, counters[c].name, val);
+            }
+        }
+    }
+
+    printf(",\n  {\"ph\": \"M\", \"pid\": %d, \"name\": \"process_name\", \"args\": {\"name\": \"%s\"}}",
+           src->pid, src->name);
+    for (int i = 0; i < src->n_tracks; i++) {
+        printf(",\n  {\"ph\": \"M\", \"pid\": %d, \"tid\": %d, \"name\": \"thread_name\", "
+               "\"args\": {\"name\": \"%s\"}}", src->pid, i + 1, src->tracks[i]);
+    }
+}
+
+int main(int argc, char **argv) {
+
+    struct source dongle = {
+        .name = "dongle", .pid = 1,
+        .desc = dongle_events, .n_desc = sizeof(dongle_events) / sizeof(dongle_events[0]),
+        .isrs = dongle_isrs,   .n_isrs = sizeof(dongle_isrs) / sizeof(dongle_isrs[0]),
+    };
+    struct source mouse = {
+        .name = "mouse", .pid = 2,
+        .desc = mouse_events,  .n_desc = sizeof(mouse_events) / sizeof(mouse_events[0]),
+        .isrs = mouse_isrs,    .n_isrs = sizeof(mouse_isrs) / sizeof(mouse_isrs[0]),
+    };
+
+    const char *dongle_path = NULL;
+    const char *mouse_path  = NULL;
+    int         manual      = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+            dongle_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+            mouse_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-a") && i + 1 < argc) {
+            mouse.offset_us = atof(argv[++i]);
+            manual = 1;
+        }
+        else {
+            dongle_path = mouse_path = NULL;
+            break;
+        }
+    }
+
+    if (!dongle_path && !mouse_path) {
+        fprintf(stderr, "Usage: ./trace-timeline [-d telnet.txt] [-m trace.bin] [-a us] > trace.json\n");
+        return 1;
+    }
+
+    if (dongle_path && load_dongle(&dongle, dongle_path) < 0) {
+        return 1;
+    }
+    if (mouse_path && load_mouse(&mouse, mouse_path) < 0) {
+        return 1;
+    }
+
+    if (dongle.n && mouse.n && !manual && align(&dongle, &mouse) < 0) {
+        fprintf(stderr, "Warning: no TX/RX seq run in common, mouse starts at 0 (try -a)\n");
+    }
+
+    int first = 1;
+    printf("{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+    emit(&dongle, &first);
+    emit(&mouse, &first);
+    printf("\n]}\n");
+
+    free(dongle.ev);
+    free(mouse.ev);
+    return 0;
+}